@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../tests/tf_test_support.h"
+#include <string>
+
+// Measurements next to the op cases of the benchmark, each prints its results and fails when the network does not run
+
+namespace benchmark {
+
+	struct Case_Result
+	{
+		std::string name;
+		tests::Resolution resolution;
+		TF::Status status;
+		double median_ns = 0.0;
+		double min_ns = 0.0;
+		double bytes_per_pixel = 0.0;
+		double allocations_per_run = 0.0;
+	};
+
+	// Times Session::Run of the graph in a session of its own after the warmup runs
+	void run_graph(const TF::GraphDef& graph, const std::string& fetch, const TF::Tensor& input, PLUGIN_NAMESPACE::CUDA_transfer_data& data, const tests::Test_Options& options, Case_Result& result);
+
+	bool measure_quality(const TF::GraphDef& network, const tests::Test_Options& options, const std::string& input_path, const std::string& truth_path);
+	bool measure_temporal(const TF::GraphDef* network, const tests::Test_Options& options, const std::string& camera_path);
+	bool measure_tiles(const TF::GraphDef& network, const tests::Test_Options& options);
+	bool measure_tiled(const TF::GraphDef& network, const tests::Test_Options& options);
+	bool measure_views(const TF::GraphDef& network, const tests::Test_Options& options);
+	bool measure_startup(const TF::GraphDef& network, const tests::Test_Options& options);
+
+} // namespace benchmark
@@ -0,0 +1,407 @@
+#include "tf_benchmark.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Headless benchmark of the interactive ops and the frozen NNAO graph on the cpu device, no engine involved. The
+// transfer data points to host buffers, the same way a session running on the cpu sets it up. The checks live in the
+// tests next to it, the benchmark only measures.
+//
+//   interactive_ops_benchmark [--graph python/frozen_nnao.pb] [--slim-graph path] [--runs 50] [--warmup 5] [--threads 0] [--output results.json]
+//   interactive_ops_benchmark --quality achieved_results/Castle/Input_Castle.exr achieved_results/Castle/AO_Castle.exr [--graph path]
+//   interactive_ops_benchmark --temporal [--camera-path path] [--graph path]
+//   interactive_ops_benchmark --tiles [--graph path]
+//   interactive_ops_benchmark --tiled [--runs 10] [--graph path]
+//   interactive_ops_benchmark --views [--runs 50] [--graph path]
+//   interactive_ops_benchmark --startup [--warmup 1] [--graph path]
+//
+// Every case runs at every shipped resolution and reports the median wall time of Session::Run, ns per pixel, GB/s
+// over the bytes the op has to touch and the cpu allocations per run. The Identity case is the session overhead the
+// other cases include.
+//
+// The full network also runs without folding the transposes around the interactive ops as frozen_nnao_unfolded.
+// The depth only network runs next to the full one. Without --slim-graph it is derived from the full network by keeping
+// the depth weights of the first convolution, which times the slim network correctly but computes nothing meaningful.
+// The first_conv cases time the first convolution of the network behind the input op for the 4, 3 and 1 channel packings.
+// The quality mode runs the network on a rendered input at full, half and quarter resolution with the cpu resample passes
+// and reports the error against the ground truth and against the full resolution result next to the time it took.
+// The temporal mode runs the reuse along camera paths through the synthetic room of the tests and reports how often the
+// network ran and the average cost of a frame against running it always. The tiles mode dirties a growing share of the
+// tiles and reports the hash and window time against the frame time. The tiled mode runs 1920x1072 and 3840x2160 under
+// shrinking memory ceilings and reports the measured peak and throughput against the whole frame. The views mode runs
+// one to four views one after another and as one batch. The startup mode reports loading, warm-up and the time to the
+// first result at every resolution, and the runs of a session while another one loads next to it.
+
+using namespace tests;
+
+namespace benchmark {
+
+	void run_graph(const TF::GraphDef& graph, const std::string& fetch, const TF::Tensor& input, PLUGIN_NAMESPACE::CUDA_transfer_data& data, const Test_Options& options, Case_Result& result) {
+		std::unique_ptr<TF::Session> session;
+		PLUGIN_NAMESPACE::TFBinding* binding = nullptr;
+		result.status = create_session(graph, options, session, &binding);
+		if (!result.status.ok())
+			return;
+
+		std::vector<std::pair<std::string, TF::Tensor>> inputs = { { "image_data", input } };
+		std::vector<TF::Tensor> outputs;
+		std::vector<double> times;
+		TF::int64 allocations = 0;
+		{
+			PLUGIN_NAMESPACE::Binding_Scope scope(binding, &data);
+			for (int i = 0; i < options.warmup && result.status.ok(); ++i)
+				result.status = session->Run(inputs, { fetch }, {}, &outputs);
+
+			allocations = cpu_allocations();
+			for (int i = 0; i < options.runs && result.status.ok(); ++i) {
+				auto start = std::chrono::steady_clock::now();
+				result.status = session->Run(inputs, { fetch }, {}, &outputs);
+				times.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			}
+			allocations = cpu_allocations() - allocations;
+		}
+		binding->Unref();
+		session->Close();
+		if (!result.status.ok() || times.empty())
+			return;
+
+		std::sort(times.begin(), times.end());
+		result.median_ns = times[times.size() / 2];
+		result.min_ns = times.front();
+		result.allocations_per_run = (double)allocations / times.size();
+	}
+
+} // namespace benchmark
+
+namespace {
+
+	using benchmark::Case_Result;
+
+	struct Op_Case
+	{
+		std::string name;
+		std::string op;
+		int channels;
+		double bytes_per_pixel;
+		std::vector<std::pair<std::string, TF::AttrValue>> attributes;
+	};
+
+	struct Options
+	{
+		Test_Options test;
+		std::string slim_graph_path;
+		std::string output_path;
+		std::string quality_input_path;
+		std::string quality_truth_path;
+		bool temporal = false;
+		std::string camera_path;
+		bool tiles = false;
+		bool tiled = false;
+		bool views = false;
+		bool startup = false;
+	};
+
+	TF::AttrValue string_attribute(const char* value) {
+		TF::AttrValue result;
+		TF::SetAttrValue(TF::StringPiece(value), &result);
+		return result;
+	}
+
+	TF::AttrValue int_attribute(TF::int64 value) {
+		TF::AttrValue result;
+		TF::SetAttrValue(value, &result);
+		return result;
+	}
+
+	TF::AttrValue int_list_attribute(const std::vector<TF::int64>& values) {
+		TF::AttrValue result;
+		for (TF::int64 value : values)
+			result.mutable_list()->add_i(value);
+		return result;
+	}
+
+	TF::AttrValue list_attribute(const std::vector<std::string>& values) {
+		TF::AttrValue result;
+		TF::SetAttrValue(TF::gtl::ArraySlice<std::string>(values), &result);
+		return result;
+	}
+
+	std::vector<Op_Case> op_cases() {
+		std::vector<Op_Case> cases;
+		cases.push_back({ "Identity", "Identity", 4, 0.0, {} });
+		cases.push_back({ "InteractiveInput", "InteractiveInput", 4, 4.0 + 4.0 + 16.0, {} });
+		cases.push_back({ "InteractiveNormalsInput", "InteractiveNormalsInput", 4, 4.0 + 16.0, {} });
+		cases.push_back({ "InteractiveDepthInput", "InteractiveDepthInput", 4, 4.0 + 16.0, {} });
+		cases.push_back({ "InteractiveInput_3ch", "InteractiveInput", 3, 4.0 + 4.0 + 12.0, {} });
+		cases.push_back({ "InteractiveInput_1ch", "InteractiveInput", 1, 4.0 + 4.0, {} });
+		cases.push_back({ "InteractiveDepthInput_1ch", "InteractiveDepthInput", 1, 4.0 + 4.0, {} });
+		cases.push_back({ "InteractiveOutput_R32F", "InteractiveOutput", 1, 4.0 + 4.0, { { "format", string_attribute("R32F") } } });
+		cases.push_back({ "InteractiveOutput_R16F", "InteractiveOutput", 1, 4.0 + 2.0, { { "format", string_attribute("R16F") } } });
+		cases.push_back({ "InteractiveOutput_R8", "InteractiveOutput", 1, 4.0 + 1.0, { { "format", string_attribute("R8") } } });
+		cases.push_back({ "InteractiveDepthOutput", "InteractiveDepthOutput", 4, 16.0 + 4.0, {} });
+		cases.push_back({ "InteractiveIO_gather", "InteractiveIO", 5, 4.0 + 4.0 + 20.0, {
+			{ "mode", string_attribute("gather") },
+			{ "bindings", list_attribute({ "normals", "depth" }) },
+			{ "formats", list_attribute({ "R8G8B8A8", "R32F" }) },
+			{ "swizzles", list_attribute({ "rgba", "r" }) } } });
+		cases.push_back({ "InteractiveIO_scatter", "InteractiveIO", 1, 4.0 + 4.0, {
+			{ "mode", string_attribute("scatter") },
+			{ "bindings", list_attribute({ "output" }) },
+			{ "formats", list_attribute({ "R32F" }) },
+			{ "swizzles", list_attribute({ "r" }) } } });
+		cases.push_back({ "InteractiveTensorStats", "InteractiveTensorStats", 4, 16.0, { { "interval", int_attribute(1) } } });
+		return cases;
+	}
+
+	TF::Status op_graph(const Op_Case& op_case, TF::GraphDef& graph) {
+		TF::NodeDef* input = graph.add_node();
+		TF_RETURN_IF_ERROR(TF::NodeDefBuilder("image_data", "Placeholder").Attr("dtype", TF::DT_FLOAT).Finalize(input));
+
+		TF::NodeDefBuilder builder("benchmark", op_case.op);
+		builder.Input("image_data", 0, TF::DT_FLOAT);
+		for (const auto& attribute : op_case.attributes)
+			builder.Attr(attribute.first, attribute.second);
+		return builder.Finalize(graph.add_node());
+	}
+
+	// The input op feeding the first convolution of the network, 8 features with 3x3 filters like convolution_0_down
+	TF::Status first_conv_graph(int channels, TF::GraphDef& graph) {
+		TF::Tensor weights(TF::DT_FLOAT, TF::TensorShape({ 3, 3, channels, 8 }));
+		auto values = weights.flat<float>();
+		for (TF::int64 i = 0; i < values.size(); ++i)
+			values(i) = (float)(i % 17) / 17.0f - 0.5f;
+
+		TF_RETURN_IF_ERROR(TF::NodeDefBuilder("image_data", "Placeholder").Attr("dtype", TF::DT_FLOAT).Finalize(graph.add_node()));
+		TF_RETURN_IF_ERROR(TF::NodeDefBuilder("input", "InteractiveInput")
+			.Input("image_data", 0, TF::DT_FLOAT)
+			.Attr("layout", string_attribute("NHWC"))
+			.Finalize(graph.add_node()));
+		TF_RETURN_IF_ERROR(TF::NodeDefBuilder("filter", "Const").Attr("dtype", TF::DT_FLOAT).Attr("value", weights).Finalize(graph.add_node()));
+		return TF::NodeDefBuilder("convolution_0_down", "Conv2D")
+			.Input("input", 0, TF::DT_FLOAT)
+			.Input("filter", 0, TF::DT_FLOAT)
+			.Attr("strides", int_list_attribute({ 1, 1, 1, 1 }))
+			.Attr("padding", string_attribute("SAME"))
+			.Finalize(graph.add_node());
+	}
+
+	// Follows Identity nodes like the "/read" of frozen variables back to their constant
+	TF::NodeDef* constant_of(TF::GraphDef& graph, const std::string& input) {
+		TF::NodeDef* node = PLUGIN_NAMESPACE::TFGraph::find_node(graph, input);
+		while (node != nullptr && node->op() == "Identity" && node->input_size() > 0)
+			node = PLUGIN_NAMESPACE::TFGraph::find_node(graph, node->input(0));
+		return node != nullptr && node->op() == "Const" ? node : nullptr;
+	}
+
+	// Turns the full network into one with the shape of the depth only network. The first convolution is the only one
+	// reading the four input channels, it keeps the weights of the depth channel.
+	TF::Status slim_network(const TF::GraphDef& network, TF::GraphDef& slim) {
+		slim = network;
+		TF::NodeDef* input = PLUGIN_NAMESPACE::TFGraph::find_node(slim, "image_data");
+		if (input == nullptr || !input->attr().count("shape") || input->attr().at("shape").shape().dim_size() != 4)
+			return TF::errors::InvalidArgument("Network has no 4 dimensional image_data placeholder");
+		(*input->mutable_attr())["shape"].mutable_shape()->mutable_dim(3)->set_size(1);
+
+		const int depth_channel = PLUGIN_NAMESPACE::DEFAULT_INPUT_CHANNELS - 1;
+		for (TF::NodeDef& node : *slim.mutable_node()) {
+			if (node.op() != "Conv2D" || node.input_size() < 2)
+				continue;
+
+			TF::NodeDef* filter = constant_of(slim, node.input(1));
+			TF::Tensor weights;
+			if (filter == nullptr || !weights.FromProto(filter->attr().at("value").tensor()) || weights.dtype() != TF::DT_FLOAT ||
+				weights.dims() != 4 || weights.dim_size(2) != PLUGIN_NAMESPACE::DEFAULT_INPUT_CHANNELS)
+				continue;
+
+			TF::Tensor depth_weights(TF::DT_FLOAT, TF::TensorShape({ weights.dim_size(0), weights.dim_size(1), 1, weights.dim_size(3) }));
+			auto source = weights.tensor<float, 4>();
+			auto dest = depth_weights.tensor<float, 4>();
+			for (TF::int64 y = 0; y < weights.dim_size(0); ++y)
+				for (TF::int64 x = 0; x < weights.dim_size(1); ++x)
+					for (TF::int64 feature = 0; feature < weights.dim_size(3); ++feature)
+						dest(y, x, 0, feature) = source(y, x, depth_channel, feature);
+			depth_weights.AsProtoTensorContent((*filter->mutable_attr())["value"].mutable_tensor());
+			return TF::Status::OK();
+		}
+		return TF::errors::NotFound("Network has no convolution reading the input channels");
+	}
+
+	bool parse_options(int argc, char** argv, Options& options) {
+		std::vector<std::string> rest;
+		parse_test_options(argc, argv, options.test, rest);
+		for (size_t i = 0; i < rest.size(); ++i) {
+			const bool has_value = i + 1 < rest.size();
+			if (rest[i] == "--slim-graph" && has_value)
+				options.slim_graph_path = rest[++i];
+			else if (rest[i] == "--output" && has_value)
+				options.output_path = rest[++i];
+			else if (rest[i] == "--temporal")
+				options.temporal = true;
+			else if (rest[i] == "--camera-path" && has_value)
+				options.camera_path = rest[++i];
+			else if (rest[i] == "--tiles")
+				options.tiles = true;
+			else if (rest[i] == "--tiled")
+				options.tiled = true;
+			else if (rest[i] == "--views")
+				options.views = true;
+			else if (rest[i] == "--startup")
+				options.startup = true;
+			else if (rest[i] == "--quality" && i + 2 < rest.size()) {
+				options.quality_input_path = rest[++i];
+				options.quality_truth_path = rest[++i];
+			}
+			else {
+				fprintf(stderr, "Usage: %s [--graph path] [--slim-graph path] [--runs n] [--warmup n] [--threads n] [--output path] [--quality input.exr truth.exr] [--temporal [--camera-path path]] [--tiles] [--tiled] [--views] [--startup]\n", argv[0]);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// One result per line in a fixed order so two runs diff cleanly
+	void write_json(FILE* file, const Options& options, const std::vector<Case_Result>& results) {
+		fprintf(file, "{\n\t\"device\": \"cpu\",\n\t\"runs\": %d,\n\t\"warmup\": %d,\n\t\"threads\": %d,\n\t\"results\": [\n",
+			options.test.runs, options.test.warmup, options.test.threads);
+		for (size_t i = 0; i < results.size(); ++i) {
+			const Case_Result& result = results[i];
+			const double pixels = (double)result.resolution.width * result.resolution.height;
+			fprintf(file, "\t\t{ \"case\": \"%s\", \"width\": %u, \"height\": %u, ", result.name.c_str(), result.resolution.width, result.resolution.height);
+			if (result.status.ok()) {
+				fprintf(file, "\"median_ns\": %.0f, \"min_ns\": %.0f, \"ns_per_pixel\": %.4f, ", result.median_ns, result.min_ns, result.median_ns / pixels);
+				if (result.bytes_per_pixel > 0.0)
+					fprintf(file, "\"gb_per_s\": %.3f, ", result.bytes_per_pixel * pixels / result.median_ns);
+				else
+					fprintf(file, "\"gb_per_s\": null, ");
+				fprintf(file, "\"allocations_per_run\": %.2f, \"status\": \"ok\" }", result.allocations_per_run);
+			}
+			else {
+				std::string message = result.status.error_message();
+				std::replace(message.begin(), message.end(), '"', '\'');
+				std::replace(message.begin(), message.end(), '\n', ' ');
+				fprintf(file, "\"status\": \"%s\" }", message.c_str());
+			}
+			fprintf(file, "%s\n", i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+	}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parse_options(argc, argv, options))
+		return 1;
+	setup();
+
+	TF::GraphDef network;
+	TF::Status network_status = read_network(options.test.graph_path, network);
+
+	if (options.temporal)
+		return benchmark::measure_temporal(network_status.ok() ? &network : nullptr, options.test, options.camera_path) ? 0 : 1;
+
+	if (options.tiles || options.tiled || options.views || options.startup || !options.quality_input_path.empty()) {
+		if (!network_status.ok()) {
+			fprintf(stderr, "%s\n", network_status.ToString().c_str());
+			return 1;
+		}
+		if (options.tiles)
+			return benchmark::measure_tiles(network, options.test) ? 0 : 1;
+		if (options.tiled)
+			return benchmark::measure_tiled(network, options.test) ? 0 : 1;
+		if (options.views)
+			return benchmark::measure_views(network, options.test) ? 0 : 1;
+		if (options.startup)
+			return benchmark::measure_startup(network, options.test) ? 0 : 1;
+		return benchmark::measure_quality(network, options.test, options.quality_input_path, options.quality_truth_path) ? 0 : 1;
+	}
+
+	TF::GraphDef slim;
+	TF::Status slim_status = network_status;
+	if (!options.slim_graph_path.empty())
+		slim_status = read_network(options.slim_graph_path, slim);
+	else if (slim_status.ok())
+		slim_status = slim_network(network, slim);
+
+	// The unfolded network keeps the transposes around the interactive ops, the way graphs run with set_fold_transposes(false)
+	struct Network_Case
+	{
+		const char* name;
+		const TF::GraphDef& graph;
+		TF::Status status;
+		bool fold;
+	};
+	const Network_Case networks[] = {
+		{ "frozen_nnao", network, network_status, true },
+		{ "frozen_nnao_unfolded", network, network_status, false },
+		{ "frozen_nnao_slim", slim, slim_status, true } };
+
+	std::vector<Op_Case> cases = op_cases();
+	std::vector<Case_Result> results;
+	for (const Resolution& resolution : RESOLUTIONS) {
+		Host_Surfaces surfaces(resolution, 0.0f);
+
+		for (const Op_Case& op_case : cases) {
+			Case_Result result;
+			result.name = op_case.name;
+			result.resolution = resolution;
+			result.bytes_per_pixel = op_case.bytes_per_pixel;
+
+			TF::GraphDef graph;
+			result.status = op_graph(op_case, graph);
+			if (result.status.ok())
+				benchmark::run_graph(graph, "benchmark", input_tensor(resolution, op_case.channels), surfaces.data, options.test, result);
+			fprintf(stderr, "%-26s %4ux%-4u %s\n", result.name.c_str(), resolution.width, resolution.height, result.status.ok() ? "done" : result.status.ToString().c_str());
+			results.push_back(result);
+		}
+
+		for (int channels : { 4, 3, 1 }) {
+			Case_Result result;
+			result.name = "first_conv_" + std::to_string(channels) + "ch";
+			result.resolution = resolution;
+			TF::GraphDef graph;
+			result.status = first_conv_graph(channels, graph);
+			if (result.status.ok())
+				benchmark::run_graph(graph, "convolution_0_down", input_tensor(resolution, channels), surfaces.data, options.test, result);
+			fprintf(stderr, "%-26s %4ux%-4u %s\n", result.name.c_str(), resolution.width, resolution.height, result.status.ok() ? "done" : result.status.ToString().c_str());
+			results.push_back(result);
+		}
+
+		// The networks the way the model cache prepares them, fed with as many channels as their placeholder takes
+		for (const Network_Case& network_case : networks) {
+			Case_Result result;
+			result.name = network_case.name;
+			result.resolution = resolution;
+			result.status = network_case.status;
+			TF::GraphDef graph = network_case.graph;
+			if (result.status.ok())
+				result.status = PLUGIN_NAMESPACE::TFGraph::specialize(graph, "image_data", resolution.width, resolution.height);
+			if (result.status.ok()) {
+				if (network_case.fold)
+					PLUGIN_NAMESPACE::TFGraph::fold_transposes(graph);
+				std::string fetch = output_node(graph);
+				int channels = (int)PLUGIN_NAMESPACE::TFGraph::input_channels(graph, "image_data");
+				if (fetch.empty())
+					result.status = TF::errors::NotFound("No interactive output op in ", network_case.name);
+				else
+					benchmark::run_graph(graph, fetch, input_tensor(resolution, channels), surfaces.data, options.test, result);
+			}
+			fprintf(stderr, "%-26s %4ux%-4u %s\n", result.name.c_str(), resolution.width, resolution.height, result.status.ok() ? "done" : result.status.ToString().c_str());
+			results.push_back(result);
+		}
+	}
+
+	FILE* file = options.output_path.empty() ? stdout : fopen(options.output_path.c_str(), "w");
+	if (file == nullptr) {
+		fprintf(stderr, "Could not write %s\n", options.output_path.c_str());
+		return 1;
+	}
+	write_json(file, options, results);
+	if (file != stdout)
+		fclose(file);
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include "tf_benchmark.h"
+#include "../tests/tf_exr.h"
+#include "../tf_resample.h"
+#include <cstdio>
+
+using namespace tests;
+
+namespace benchmark {
+
+	// The input exr holds the normals as normal * 0.5 + 0.5 in R, G and B and the linear depth in depth.V, the truth holds
+	// the occlusion in R. The network runs with the camera range the training data was rendered with.
+	bool measure_quality(const TF::GraphDef& network, const Test_Options& options, const std::string& input_path, const std::string& truth_path) {
+		Exr_Image input, truth;
+		TF::Status status = read_exr(input_path, input);
+		if (status.ok())
+			status = read_exr(truth_path, truth);
+		if (status.ok() && (input.width != truth.width || input.height != truth.height))
+			status = TF::errors::InvalidArgument("Input and truth differ in size");
+		if (status.ok() && (!input.channels.count("R") || !input.channels.count("G") || !input.channels.count("B") ||
+			!input.channels.count("depth.V") || !truth.channels.count("R")))
+			status = TF::errors::InvalidArgument("Input needs R, G, B and depth.V, the truth needs R");
+		if (!status.ok()) {
+			fprintf(stderr, "%s\n", status.ToString().c_str());
+			return false;
+		}
+
+		const int width = input.width;
+		const int height = input.height;
+		const size_t pixels = (size_t)width * height;
+		std::vector<unsigned char> normals(pixels * 4);
+		for (size_t i = 0; i < pixels; ++i) {
+			normals[4 * i + 0] = quantize_byte(input.channels["R"][i]);
+			normals[4 * i + 1] = quantize_byte(input.channels["G"][i]);
+			normals[4 * i + 2] = quantize_byte(input.channels["B"][i]);
+			normals[4 * i + 3] = 255;
+		}
+		const std::vector<float>& depth = input.channels["depth.V"];
+		const std::vector<float>& occlusion = truth.channels["R"];
+
+		std::vector<float> full_result;
+		double full_network_ms = 0.0;
+		bool passed = true;
+		for (int factor : { 1, 2, MAX_RESOLUTION_FACTOR }) {
+			const Resample_Params params = resample_params(width, height, factor);
+			const unsigned network_width = PLUGIN_NAMESPACE::TFGraph::align_network_size(params.low_width);
+			const unsigned network_height = PLUGIN_NAMESPACE::TFGraph::align_network_size(params.low_height);
+
+			TF::GraphDef graph = network;
+			status = PLUGIN_NAMESPACE::TFGraph::specialize(graph, "image_data", network_width, network_height);
+			std::string fetch;
+			if (status.ok()) {
+				PLUGIN_NAMESPACE::TFGraph::fold_transposes(graph);
+				fetch = output_node(graph);
+				if (fetch.empty())
+					status = TF::errors::NotFound("No interactive output op in the network");
+			}
+			const int format = status.ok() ? PLUGIN_NAMESPACE::TFGraph::output_format(graph, fetch) : PixelR32F;
+			const int size = pixel_size(format);
+
+			// Network sized buffers like the slots of a session, the part outside of the image stays zero
+			std::vector<unsigned char> low_normals((size_t)network_width * network_height * 4, 0);
+			std::vector<float> low_depth((size_t)network_width * network_height, 0.0f);
+			std::vector<unsigned char> low_output((size_t)network_width * network_height * size, 0);
+			std::vector<unsigned char> output(pixels * size, 0);
+
+			Resample_Surfaces surfaces;
+			surfaces.normals = normals.data();
+			surfaces.depth = depth.data();
+			surfaces.pitch = (size_t)width * 4;
+			surfaces.low_normals = low_normals.data();
+			surfaces.low_depth = low_depth.data();
+			surfaces.low_pitch = (size_t)network_width * 4;
+			surfaces.low_output = low_output.data();
+			surfaces.low_output_pitch = (size_t)network_width * size;
+			surfaces.output = output.data();
+			surfaces.output_pitch = (size_t)width * size;
+			surfaces.output_format = format;
+
+			// The full resolution network reads the image as it is
+			double downsample_ms = 0.0;
+			if (factor > 1)
+				downsample_ms = time_ms(options.runs, [&]() { PLUGIN_NAMESPACE::TFResample::downsample_cpu(params, surfaces); });
+			else {
+				for (int y = 0; y < height; ++y) {
+					memcpy(resample_row(surfaces.low_normals, surfaces.low_pitch, y), resample_row(surfaces.normals, surfaces.pitch, y), (size_t)width * 4);
+					memcpy(resample_row(surfaces.low_depth, surfaces.low_pitch, y), resample_row(surfaces.depth, surfaces.pitch, y), (size_t)width * sizeof(float));
+				}
+			}
+
+			PLUGIN_NAMESPACE::CUDA_transfer_data data;
+			bind_host_surfaces(data, low_normals.data(), low_depth.data(), surfaces.low_pitch, low_output.data(), surfaces.low_output_pitch);
+
+			Case_Result result;
+			if (status.ok()) {
+				const Resolution resolution = { network_width, network_height };
+				int channels = (int)PLUGIN_NAMESPACE::TFGraph::input_channels(graph, "image_data");
+				run_graph(graph, fetch, input_tensor(resolution, channels), data, options, result);
+				status = result.status;
+			}
+			if (!status.ok()) {
+				fprintf(stderr, "Factor %d: %s\n", factor, status.ToString().c_str());
+				passed = false;
+				continue;
+			}
+
+			double upsample_ms = 0.0;
+			std::vector<float> values(pixels);
+			if (factor > 1) {
+				upsample_ms = time_ms(options.runs, [&]() { PLUGIN_NAMESPACE::TFResample::upsample_cpu(params, surfaces); });
+				for (size_t i = 0; i < pixels; ++i)
+					values[i] = decode_output(format, output.data() + size * i);
+			}
+			else {
+				for (int y = 0; y < height; ++y)
+					for (int x = 0; x < width; ++x)
+						values[(size_t)y * width + x] = decode_output(format, resample_row(surfaces.low_output, surfaces.low_output_pitch, y) + size * x);
+			}
+
+			const double network_ms = result.median_ns / 1e6;
+			const double truth_mse = mean_squared_error(values, occlusion);
+			if (factor == 1) {
+				full_result = values;
+				full_network_ms = network_ms;
+			}
+			const double full_mse = full_result.empty() ? 0.0 : mean_squared_error(values, full_result);
+			const double total_ms = network_ms + downsample_ms + upsample_ms;
+			fprintf(stderr, "Factor %d %4ux%-4u network %8.2f ms, down %6.2f ms, up %6.2f ms, speedup %5.2fx, truth mse %.6f (%.2f dB), full resolution mse %.6f (%.2f dB)\n",
+				factor, network_width, network_height, network_ms, downsample_ms, upsample_ms, full_network_ms / total_ms,
+				truth_mse, psnr(truth_mse), full_mse, psnr(full_mse));
+		}
+		return passed;
+	}
+
+} // namespace benchmark
@@ -0,0 +1,89 @@
+#include "tf_benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace tests;
+
+namespace benchmark {
+
+	namespace {
+
+		double elapsed_ms(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+	} // anonymous namespace
+
+	// Splits the start of a session the way the plugin reports it. Loading specializes the network and creates the session
+	// like the model cache, warm-up is the first runs a session does before it is ready and the first result comes from
+	// the run after that. A running session keeps going while another one loads next to it, which is what the separate
+	// loader thread of the plugin relies on.
+	bool measure_startup(const TF::GraphDef& network, const Test_Options& options) {
+		const int warmup_runs = std::max(options.warmup, 1);
+		TF::Status status;
+		for (const Resolution& resolution : RESOLUTIONS) {
+			Host_Surfaces surfaces(resolution, 0.0f);
+			const auto start = std::chrono::steady_clock::now();
+
+			Network_Session session;
+			status = create_network_session(network, resolution.width, resolution.height, 1, options, session);
+			const double load_ms = elapsed_ms(start);
+			for (int i = 0; i < warmup_runs && status.ok(); ++i)
+				status = run_session(session, surfaces.data);
+			const double warmup_ms = elapsed_ms(start) - load_ms;
+			if (status.ok())
+				status = run_session(session, surfaces.data);
+			const double first_result_ms = elapsed_ms(start);
+			const double steady_ms = time_ms(options.runs, [&]() { status = run_session(session, surfaces.data); });
+			if (!status.ok())
+				break;
+
+			fprintf(stderr, "Startup %4ux%-4u: loading %8.2f ms, warm-up %8.2f ms (%d runs), first result after %8.2f ms, steady run %7.2f ms\n",
+				resolution.width, resolution.height, load_ms, warmup_ms, warmup_runs, first_result_ms, steady_ms);
+		}
+
+		// Runs of the first resolution while the largest one loads and warms up on another thread
+		const Resolution& running = RESOLUTIONS[0];
+		const Resolution& loading = RESOLUTIONS[sizeof(RESOLUTIONS) / sizeof(RESOLUTIONS[0]) - 1];
+		Host_Surfaces surfaces(running, 0.0f);
+		Network_Session session;
+		if (status.ok())
+			status = create_network_session(network, running.width, running.height, 1, options, session);
+		for (int i = 0; i < warmup_runs && status.ok(); ++i)
+			status = run_session(session, surfaces.data);
+		const double idle_ms = time_ms(options.runs, [&]() { status = run_session(session, surfaces.data); });
+
+		std::atomic<bool> loaded(false);
+		TF::Status load_status;
+		std::thread loader([&]() {
+			Host_Surfaces loading_surfaces(loading, 0.0f);
+			Network_Session loading_session;
+			load_status = create_network_session(network, loading.width, loading.height, 1, options, loading_session);
+			for (int i = 0; i < warmup_runs && load_status.ok(); ++i)
+				load_status = run_session(loading_session, loading_surfaces.data);
+			loaded = true;
+		});
+		std::vector<double> times;
+		while (!loaded && status.ok()) {
+			const auto start = std::chrono::steady_clock::now();
+			status = run_session(session, surfaces.data);
+			times.push_back(elapsed_ms(start));
+		}
+		loader.join();
+		if (status.ok())
+			status = load_status;
+		if (!status.ok()) {
+			fprintf(stderr, "%s\n", status.ToString().c_str());
+			return false;
+		}
+
+		const double worst_ms = times.empty() ? 0.0 : *std::max_element(times.begin(), times.end());
+		fprintf(stderr, "Runs of %ux%u while %ux%u loads: %zu runs, median %7.2f ms, worst %7.2f ms, idle median %7.2f ms\n",
+			running.width, running.height, loading.width, loading.height, times.size(), median_ms(times), worst_ms, idle_ms);
+		return true;
+	}
+
+} // namespace benchmark
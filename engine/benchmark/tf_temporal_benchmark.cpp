@@ -0,0 +1,104 @@
+#include "tf_benchmark.h"
+#include <cstdio>
+
+using namespace tests;
+
+namespace benchmark {
+
+	namespace {
+
+		// Runs the temporal reuse along a camera path with the rendered occlusion standing in for the network result, the
+		// frame cost counts the cpu passes plus the network time of every frame the policy decided to run it
+		void measure_temporal_path(const Camera_Path& path, int width, int height, double network_ms) {
+			const float aspect = (float)width / height;
+			const unsigned pixels = (unsigned)(width * height);
+			Temporal_History temporal(width, height);
+			Synthetic_Frame frame;
+			unsigned frames_since_run = 0;
+			unsigned network_runs = 0;
+			double temporal_ms = 0.0;
+			double invalid_fraction = 0.0;
+			double error = 0.0;
+
+			for (const Camera_Key& key : path.keys) {
+				Synthetic_Camera synthetic = synthetic_camera(key.position, key.yaw, key.pitch, aspect);
+				render_synthetic(synthetic, width, height, frame);
+				Temporal_Camera camera = PLUGIN_NAMESPACE::TFTemporal::camera(synthetic.pose, synthetic.projection);
+
+				auto start = std::chrono::steady_clock::now();
+				Reproject_Params params = PLUGIN_NAMESPACE::TFTemporal::reproject_params(camera, temporal.previous_camera, width, height, temporal.has_history, DEFAULT_TEMPORAL_BLEND);
+				unsigned invalid = PLUGIN_NAMESPACE::TFTemporal::reproject_cpu(params, temporal.surfaces(frame, nullptr));
+				const bool run = PLUGIN_NAMESPACE::TFTemporal::needs_network(params.has_history, frames_since_run, DEFAULT_TEMPORAL_INTERVAL, invalid, pixels, DEFAULT_TEMPORAL_INVALID_FRACTION);
+				PLUGIN_NAMESPACE::TFTemporal::resolve_cpu(params, temporal.surfaces(frame, run ? &frame.occlusion : nullptr));
+				temporal_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				network_runs += run ? 1 : 0;
+				frames_since_run = run ? 0 : frames_since_run + 1;
+				invalid_fraction += (double)invalid / pixels;
+				error += mean_absolute_error(temporal.output, frame.occlusion);
+				temporal.advance(frame, camera);
+			}
+
+			const double frames = (double)path.keys.size();
+			const double frame_ms = (temporal_ms + network_runs * network_ms) / frames;
+			fprintf(stderr, "%-12s %4.0f frames, network in %3u, invalid %5.2f%%, temporal %6.2f ms, frame %7.2f ms against %7.2f ms, mean error %.5f\n",
+				path.name.c_str(), frames, network_runs, 100.0 * invalid_fraction / frames, temporal_ms / frames, frame_ms, network_ms, error / frames);
+		}
+
+	} // anonymous namespace
+
+	// The network time is the median of the full network on a synthetic frame at 960x512, without a graph the frame cost
+	// only covers the temporal passes. The paths run at the same size.
+	bool measure_temporal(const TF::GraphDef* network, const Test_Options& options, const std::string& camera_path) {
+		const int width = 960;
+		const int height = 512;
+		double network_ms = 0.0;
+		if (network) {
+			const unsigned network_width = PLUGIN_NAMESPACE::TFGraph::align_network_size(width);
+			const unsigned network_height = PLUGIN_NAMESPACE::TFGraph::align_network_size(height);
+			TF::GraphDef graph = *network;
+			TF::Status status = PLUGIN_NAMESPACE::TFGraph::specialize(graph, "image_data", network_width, network_height);
+			std::string fetch;
+			if (status.ok()) {
+				PLUGIN_NAMESPACE::TFGraph::fold_transposes(graph);
+				fetch = output_node(graph);
+				if (fetch.empty())
+					status = TF::errors::NotFound("No interactive output op in the network");
+			}
+
+			Synthetic_Frame frame;
+			render_default(network_width, network_height, frame);
+			std::vector<float> output((size_t)network_width * network_height, 0.0f);
+
+			PLUGIN_NAMESPACE::CUDA_transfer_data data;
+			bind_host_surfaces(data, frame.normals.data(), frame.depth.data(), (size_t)network_width * 4, output.data(), (size_t)network_width * sizeof(float));
+
+			Case_Result result;
+			if (status.ok()) {
+				const Resolution resolution = { network_width, network_height };
+				run_graph(graph, fetch, input_tensor(resolution, (int)PLUGIN_NAMESPACE::TFGraph::input_channels(graph, "image_data")), data, options, result);
+				status = result.status;
+			}
+			if (status.ok())
+				network_ms = result.median_ns / 1e6;
+			else
+				fprintf(stderr, "Network: %s\n", status.ToString().c_str());
+		}
+
+		std::vector<Camera_Path> paths = builtin_camera_paths();
+		if (!camera_path.empty()) {
+			paths.resize(1);
+			if (!read_camera_path(camera_path, paths[0])) {
+				fprintf(stderr, "%s has no camera keys\n", camera_path.c_str());
+				return false;
+			}
+		}
+
+		fprintf(stderr, "Temporal reuse at %dx%d, interval %u, invalid fraction %.2f, blend %.2f\n", width, height,
+			DEFAULT_TEMPORAL_INTERVAL, DEFAULT_TEMPORAL_INVALID_FRACTION, DEFAULT_TEMPORAL_BLEND);
+		for (const Camera_Path& path : paths)
+			measure_temporal_path(path, width, height, network_ms);
+		return true;
+	}
+
+} // namespace benchmark
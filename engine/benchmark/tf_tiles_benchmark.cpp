@@ -0,0 +1,159 @@
+#include "tf_benchmark.h"
+#include <cstdio>
+
+using namespace tests;
+
+namespace benchmark {
+
+	// Dirties a growing share of the tiles of a synthetic frame and compares running the dirty tiles and the tiles within
+	// the halo around them in batches of windows with running the whole frame, both in time and in the result
+	bool measure_tiles(const TF::GraphDef& network, const Test_Options& options) {
+		const unsigned width = 1920;
+		const unsigned height = 1088;
+		Synthetic_Frame frame;
+		render_default(width, height, frame);
+
+		const Tile_Grid grid = PLUGIN_NAMESPACE::TFTiles::grid(width, height, TILE_SIZE);
+		const unsigned tiles = grid.columns * grid.rows;
+		const unsigned size = PLUGIN_NAMESPACE::TFTiles::window_size(grid, TILE_HALO);
+		Network_Session frame_network, window_network;
+		TF::Status status = create_network_session(network, width, height, 1, options, frame_network);
+		if (status.ok())
+			status = create_network_session(network, size, size, MAX_BATCH_ENTRIES, options, window_network);
+
+		std::vector<float> before((size_t)width * height), after((size_t)width * height);
+		for (int i = 0; i < options.warmup && status.ok(); ++i)
+			status = run_network(frame_network, frame, width, 0, 0, before, width);
+		if (status.ok())
+			status = run_dirty_tiles(window_network, frame, grid, { PLUGIN_NAMESPACE::TFTiles::window(grid, 0, TILE_HALO, width, height) }, before);
+		if (status.ok())
+			status = run_network(frame_network, frame, width, 0, 0, before, width);
+		if (!status.ok()) {
+			fprintf(stderr, "%s\n", status.ToString().c_str());
+			return false;
+		}
+
+		std::vector<uint64_t> previous(tiles), hashes(tiles);
+		PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, frame.normals.data(), frame.depth.data(), (size_t)width * 4, previous.data());
+		const double frame_ms = time_ms(options.runs, [&]() { status = run_network(frame_network, frame, width, 0, 0, after, width); });
+
+		fprintf(stderr, "Dirty tiles at %ux%u, %u tiles, windows of %ux%u, frame %.2f ms\n", width, height, tiles, size, size, frame_ms);
+		for (double ratio : { 0.0, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1 }) {
+			// The same tiles get dirty on every run, a small rectangle in the middle of each
+			Synthetic_Frame changed = frame;
+			unsigned seed = 7;
+			std::vector<bool> picked(tiles, false);
+			for (unsigned count = 0; count < (unsigned)(ratio * tiles + 0.5); ) {
+				seed = seed * 1664525u + 1013904223u;
+				const unsigned tile = (seed >> 8) % tiles;
+				if (picked[tile])
+					continue;
+				picked[tile] = true;
+				disturb_frame(changed, width, tile % grid.columns * TILE_SIZE + 24, tile / grid.columns * TILE_SIZE + 24, 16, 16);
+				++count;
+			}
+
+			std::vector<unsigned> dirty;
+			std::vector<Tile_Window> windows;
+			const double hash_ms = time_ms(options.runs, [&]() { PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, changed.normals.data(), changed.depth.data(), (size_t)width * 4, hashes.data()); });
+			const unsigned changed_tiles = PLUGIN_NAMESPACE::TFTiles::dirty_tiles(grid, hashes.data(), previous.data(), dirty);
+			PLUGIN_NAMESPACE::TFTiles::grow_dirty(grid, TILE_HALO, dirty);
+			const bool tiled = PLUGIN_NAMESPACE::TFTiles::plan_windows(grid, dirty, TILE_HALO, width, height, windows);
+
+			std::vector<float> result = before;
+			double run_ms = 0.0;
+			if (tiled)
+				run_ms = time_ms(options.runs, [&]() { result = before; status = run_dirty_tiles(window_network, changed, grid, windows, result); });
+			else if (!dirty.empty())
+				run_ms = time_ms(options.runs, [&]() { status = run_network(frame_network, changed, width, 0, 0, result, width); });
+			if (status.ok())
+				status = run_network(frame_network, changed, width, 0, 0, after, width);
+			if (!status.ok()) {
+				fprintf(stderr, "%s\n", status.ToString().c_str());
+				return false;
+			}
+
+			fprintf(stderr, "Dirty %5.1f%% %3u tiles, %3zu with the halo, %-6s hash %6.2f ms, run %8.2f ms, frame cost %6.2fx, max error %.6f\n",
+				100.0 * ratio, changed_tiles, dirty.size(), tiled ? "tiled" : (dirty.empty() ? "reuse" : "frame"), hash_ms, run_ms,
+				(hash_ms + run_ms) / frame_ms, max_absolute_error(result, after));
+		}
+		return true;
+	}
+
+	// Runs large frames whole and tiled under shrinking memory ceilings and reports the measured peak of the activations
+	// next to the estimate the plan was made with, the time and the error against the whole frame. The plans use the
+	// bytes per pixel measured on the probe window like a session does.
+	bool measure_tiled(const TF::GraphDef& network, const Test_Options& options) {
+		const Resolution sizes[] = { { 1920, 1072 }, { 3840, 2160 } };
+		const int runs = std::min(options.runs, 10);
+
+		const unsigned probe = PLUGIN_NAMESPACE::TFTiles::probe_size(TILE_HALO);
+		Synthetic_Frame probe_frame;
+		render_default(probe, probe, probe_frame);
+		Network_Session probe_network;
+		std::vector<float> probe_output((size_t)probe * probe);
+		TF::Status probe_status = create_network_session(network, probe, probe, 1, options, probe_network);
+		if (probe_status.ok())
+			probe_status = run_network(probe_network, probe_frame, probe, 0, 0, probe_output, probe);
+		TF::int64 probe_peak = 0;
+		if (probe_status.ok())
+			probe_peak = peak_allocation([&]() { probe_status = run_network(probe_network, probe_frame, probe, 0, 0, probe_output, probe); });
+		if (!probe_status.ok()) {
+			fprintf(stderr, "%s\n", probe_status.ToString().c_str());
+			return false;
+		}
+		const unsigned bytes_per_pixel = PLUGIN_NAMESPACE::TFTiles::bytes_per_pixel((uint64_t)probe_peak, probe, probe);
+		fprintf(stderr, "Probe window %ux%u: peak %8.1f MB, %u bytes per pixel\n", probe, probe, probe_peak / 1048576.0, bytes_per_pixel);
+
+		for (const Resolution& size : sizes) {
+			Synthetic_Frame frame;
+			render_default(size.width, size.height, frame);
+			const double pixels = (double)size.width * size.height;
+
+			Network_Session frame_network;
+			TF::Status status = create_network_session(network, size.width, size.height, 1, options, frame_network);
+			std::vector<float> reference((size_t)size.width * size.height);
+			if (status.ok())
+				status = run_network(frame_network, frame, size.width, 0, 0, reference, size.width);
+			TF::int64 frame_peak = 0;
+			if (status.ok())
+				frame_peak = peak_allocation([&]() { status = run_network(frame_network, frame, size.width, 0, 0, reference, size.width); });
+			const double frame_ms = time_ms(runs, [&]() { status = run_network(frame_network, frame, size.width, 0, 0, reference, size.width); });
+			if (!status.ok()) {
+				fprintf(stderr, "%s\n", status.ToString().c_str());
+				return false;
+			}
+
+			const uint64_t estimate = (uint64_t)pixels * bytes_per_pixel;
+			fprintf(stderr, "Frame %ux%u: peak %8.1f MB (%.0f bytes per pixel), estimate %8.1f MB, %8.2f ms, %6.2f Mpx/s\n",
+				size.width, size.height, frame_peak / 1048576.0, frame_peak / pixels, estimate / 1048576.0, frame_ms, pixels / frame_ms / 1000.0);
+
+			for (unsigned divisor : { 2u, 4u, 8u, 16u }) {
+				Tile_Plan plan;
+				if (!PLUGIN_NAMESPACE::TFTiles::plan_tiling(size.width, size.height, estimate / divisor, bytes_per_pixel, TILE_HALO, plan))
+					continue;
+
+				Network_Session window_network;
+				status = create_network_session(network, plan.window_size, plan.window_size, plan.batch, options, window_network);
+				std::vector<float> output((size_t)size.width * size.height);
+				if (status.ok())
+					status = run_tiled(window_network, plan, frame, output);
+				TF::int64 peak = 0;
+				if (status.ok())
+					peak = peak_allocation([&]() { status = run_tiled(window_network, plan, frame, output); });
+				const double tiled_ms = time_ms(runs, [&]() { status = run_tiled(window_network, plan, frame, output); });
+				if (!status.ok()) {
+					fprintf(stderr, "%s\n", status.ToString().c_str());
+					return false;
+				}
+
+				fprintf(stderr, "  ceiling %7.1f MB: %3u tiles of %4u, windows %4ux%-4u %2u per run in %3u runs, peak %8.1f MB, estimate %8.1f MB, %8.2f ms, %6.2f Mpx/s, max error %.6f\n",
+					estimate / divisor / 1048576.0, plan.grid.columns * plan.grid.rows, plan.grid.tile_size, plan.window_size, plan.window_size,
+					plan.batch, plan.runs, peak / 1048576.0, PLUGIN_NAMESPACE::TFTiles::peak_bytes(plan, bytes_per_pixel) / 1048576.0,
+					tiled_ms, pixels / tiled_ms / 1000.0, max_absolute_error(output, reference));
+			}
+		}
+		return true;
+	}
+
+} // namespace benchmark
@@ -0,0 +1,60 @@
+#include "tf_benchmark.h"
+#include <cstdio>
+
+using namespace tests;
+
+namespace benchmark {
+
+	// Runs one to four views of 960x512 one after another and as one batch, the batch has to give every view the result
+	// of its own run
+	bool measure_views(const TF::GraphDef& network, const Test_Options& options) {
+		const unsigned view_width = 960;
+		const unsigned height = 512;
+		Network_Session view_network;
+		TF::Status status = create_network_session(network, view_width, height, 1, options, view_network);
+
+		bool passed = true;
+		double single_ms = 0.0;
+		for (unsigned views = 1; views <= 4 && status.ok(); ++views) {
+			const unsigned width = views * view_width;
+			Synthetic_Frame frame;
+			render_default(width, height, frame);
+
+			Network_Session batch_network;
+			status = create_network_session(network, view_width, height, views, options, batch_network);
+			std::vector<float> view_output((size_t)view_width * height), sequential((size_t)width * height), batched((size_t)width * height);
+			for (int i = 0; i < options.warmup && status.ok(); ++i)
+				status = run_views(batch_network, views, frame, width, height, batched);
+			for (int i = 0; i < options.warmup && status.ok(); ++i)
+				status = run_network(view_network, frame, width, 0, 0, view_output, view_width);
+
+			const double sequential_ms = time_ms(options.runs, [&]() {
+				for (unsigned view = 0; view < views && status.ok(); ++view)
+					status = run_network(view_network, frame, width, view * view_width, 0, view_output, view_width);
+			});
+			for (unsigned view = 0; view < views && status.ok(); ++view) {
+				status = run_network(view_network, frame, width, view * view_width, 0, view_output, view_width);
+				for (unsigned y = 0; y < height; ++y)
+					std::copy(view_output.begin() + (size_t)y * view_width, view_output.begin() + (size_t)(y + 1) * view_width, sequential.begin() + (size_t)y * width + view * view_width);
+			}
+			const double batched_ms = time_ms(options.runs, [&]() { status = run_views(batch_network, views, frame, width, height, batched); });
+			if (!status.ok())
+				break;
+
+			if (views == 1)
+				single_ms = batched_ms;
+			const double error = max_absolute_error(batched, sequential);
+			const bool views_passed = error <= 1e-3;
+			fprintf(stderr, "Views %u of %ux%u: one after another %8.2f ms (%7.2f ms per view), batched %8.2f ms (%7.2f ms per view), %5.2fx faster, %5.2fx the views per second of batch 1, max error %.6f %s\n",
+				views, view_width, height, sequential_ms, sequential_ms / views, batched_ms, batched_ms / views, sequential_ms / batched_ms,
+				single_ms * views / batched_ms, error, views_passed ? "" : "FAILED");
+			passed = views_passed && passed;
+		}
+		if (!status.ok()) {
+			fprintf(stderr, "%s\n", status.ToString().c_str());
+			return false;
+		}
+		return passed;
+	}
+
+} // namespace benchmark
@@ -2,12 +2,24 @@
 
 #include "tf_kernel.h"
 
-#define KERNEL_SIZE 128
+// Every image kernel runs KERNEL_SIZE x KERNEL_SIZE threads per block on a grid of blocks covering the image, like the
+// resample and temporal kernels
+#define KERNEL_SIZE 16
+#define STATS_THREADS 256
+#define STATS_BLOCKS 64
 
 namespace TF = tensorflow;
 
+inline dim3 kernel_threads() {
+	return dim3(KERNEL_SIZE, KERNEL_SIZE);
+}
+
+inline dim3 kernel_blocks(int width, int height) {
+	return dim3((width + KERNEL_SIZE - 1) / KERNEL_SIZE, (height + KERNEL_SIZE - 1) / KERNEL_SIZE);
+}
+
 template <typename T>
-__global__ void InteractiveInputKernel(int width, int height, size_t pitch, float min, float max, const unsigned char* normals, const float* depth, T* out) {
+__global__ void InteractiveInputKernel(int width, int height, size_t pitch, int channels, float min, float max, const unsigned char* normals, const float* depth, T* out) {
 
 	int x = blockIdx.x*blockDim.x + threadIdx.x;
 	int y = blockIdx.y*blockDim.y + threadIdx.y;
@@ -24,7 +36,17 @@ __global__ void InteractiveInputKernel(int width, int height, size_t pitch, floa
 	// get a pointer to the pixel at (x,y)
 	normal_src = (normals + y*pitch) + 4*x;
 	depth_src = (depth + y*pitch/4) + x;
-	dest = (out + y*pitch) + 4*x;
+	dest = out + ((size_t)y*width + x)*channels;
+
+	// three channels hold the octahedral normal and the depth
+	if (channels == 3) {
+		float u, v;
+		octahedral_normal(normal_src, u, v);
+		dest[0] = (T) u;
+		dest[1] = (T) v;
+		dest[2] = (T) ((depth_src[0] - min) / range);
+		return;
+	}
 
 	dest[0] = ((T) normal_src[0]) / 255.0f;
 	dest[1] = ((T) normal_src[1]) / 255.0f;
@@ -47,7 +69,7 @@ __global__ void InteractiveNormalsInputKernel(int width, int height, size_t pitc
 
 	// get a pointer to the pixel at (x,y)
 	src = (in + y*pitch) + 4*x;
-	dest = (out + y*pitch) + 4*x;
+	dest = out + ((size_t)y*width + x)*4;
 
 	dest[0] = ((T) src[0]) / 255.0f;
 	dest[1] = ((T) src[1]) / 255.0f;
@@ -56,7 +78,7 @@ __global__ void InteractiveNormalsInputKernel(int width, int height, size_t pitc
 }
 
 template <typename T>
-__global__ void InteractiveDepthInputKernel(int width, int height, size_t pitch, float min, float max, const float* in, T* out) {
+__global__ void InteractiveDepthInputKernel(int width, int height, size_t pitch, int channels, float min, float max, const float* in, T* out) {
 
 	int x = blockIdx.x*blockDim.x + threadIdx.x;
 	int y = blockIdx.y*blockDim.y + threadIdx.y;
@@ -69,44 +91,43 @@ __global__ void InteractiveDepthInputKernel(int width, int height, size_t pitch,
 	// correspond to valid pixels
 	if (x >= width || y >= height) return;
 
-	// get a pointer to the pixel at (x,y)
+	// get a pointer to the pixel at (x,y), the depth is written into every channel
 	src = (in + y*pitch/4) + x;
-	dest = (out + y*pitch) + 4*x;
+	dest = out + ((size_t)y*width + x)*channels;
 
-	dest[0] = (T) ((src[0] - min) / range);
-	dest[1] = (T) ((src[0] - min) / range);
-	dest[2] = (T) ((src[0] - min) / range);
-	dest[3] = (T) ((src[0] - min) / range);
+	for (int channel = 0; channel < channels; ++channel)
+		dest[channel] = (T) ((src[0] - min) / range);
 }
 
 template <typename T>
-__global__ void InteractiveOutputKernel(int width, int height, size_t pitch, const T* in, float* out) {
+__global__ void InteractiveOutputKernel(int width, int height, int stride, size_t pitch, int format, const T* in, unsigned char* out) {
 
 	int x = blockIdx.x*blockDim.x + threadIdx.x;
 	int y = blockIdx.y*blockDim.y + threadIdx.y;
 	const T *cuda_src;
-	float *dest;
+	unsigned char *dest;
 
 	// in the case where, due to quantization into grids, we have
 	// more threads than pixels, skip the threads which don't
 	// correspond to valid pixels
 	if (x >= width || y >= height) return;
 
-	// get a pointer to the pixel at (x,y)
-	cuda_src = (in + y*pitch/4) + x;
-	dest = (out + y*pitch/4) + x;
+	// get a pointer to the pixel at (x,y), the tensor rows are stride pixels apart and the output buffer has the pitch of
+	// its format
+	cuda_src = (in + (size_t)y*stride) + x;
+	dest = (out + y*pitch) + x*pixel_size(format);
 
-	*dest = (float) (*cuda_src);
+	encode_output(format, (float) (*cuda_src), dest);
 }
 
 template <typename T>
-__global__ void InteractiveDepthOutputKernel(int width, int height, size_t pitch, float min, float max, const T* in, float* out) {
+__global__ void InteractiveDepthOutputKernel(int width, int height, int stride, size_t pitch, int format, float min, float max, const T* in, unsigned char* out) {
 
 	int x = blockIdx.x*blockDim.x + threadIdx.x;
 	int y = blockIdx.y*blockDim.y + threadIdx.y;
 	const T *src;
 	const float range = max - min;
-	float *dest;
+	unsigned char *dest;
 
 	// in the case where, due to quantization into grids, we have
 	// more threads than pixels, skip the threads which don't
@@ -114,18 +135,39 @@ __global__ void InteractiveDepthOutputKernel(int width, int height, size_t pitch
 	if (x >= width || y >= height) return;
 
 	// get a pointer to the pixel at (x,y)
-	src = (in + y*pitch) + 4*x;
-	dest = (out + y*pitch/4) + x;
+	src = (in + (size_t)y*stride*4) + 4*x;
+	dest = (out + y*pitch) + x*pixel_size(format);
 
-	*dest = (float) (src[1] * range) + min;
+	encode_output(format, (float) (src[1] * range) + min, dest);
+}
+
+template <typename T>
+__global__ void InteractiveGatherKernel(int width, int height, IO_Params params, T* out) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x >= width || y >= height) return;
+
+	// the tensor is dense, every pixel holds the channels of all bindings
+	gather_pixel(params, x, y, out + ((size_t)y*width + x)*params.tensor_channels);
+}
+
+template <typename T>
+__global__ void InteractiveScatterKernel(int width, int height, IO_Params params, const T* in) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x >= width || y >= height) return;
+
+	scatter_pixel(params, x, y, in + ((size_t)y*width + x)*params.tensor_channels);
 }
 
 template <typename T>
 struct InteractiveInputFunctor<Eigen::GpuDevice, T> {
-	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, float min, float max, const void* normals, const void* depth, T* out) {
-		dim3 blockSize = dim3(KERNEL_SIZE, KERNEL_SIZE);
-		dim3 threadSize = dim3((width + blockSize.x - 1) / blockSize.x, (height + blockSize.y - 1) / blockSize.y);
-		InteractiveInputKernel<T><<<blockSize, threadSize, 0, d.stream()>>>(width, height, pitch, min, max, (const unsigned char *)normals, (const float *)depth, out);
+	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, int channels, float min, float max, const void* normals, const void* depth, T* out) {
+		InteractiveInputKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, pitch, channels, min, max, (const unsigned char *)normals, (const float *)depth, out);
 		return cudaGetLastError();
 	}
 };
@@ -133,39 +175,110 @@ struct InteractiveInputFunctor<Eigen::GpuDevice, T> {
 template <typename T>
 struct InteractiveNormalsInputFunctor<Eigen::GpuDevice, T> {
 	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, const void* in, T* out) {
-		dim3 blockSize = dim3(KERNEL_SIZE, KERNEL_SIZE);
-		dim3 threadSize = dim3((width + blockSize.x - 1) / blockSize.x, (height + blockSize.y - 1) / blockSize.y);
-		InteractiveNormalsInputKernel<T><<<blockSize, threadSize, 0, d.stream()>>>(width, height, pitch, (const unsigned char *) in, out);
+		InteractiveNormalsInputKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, pitch, (const unsigned char *) in, out);
 		return cudaGetLastError();
 	}
 };
 
 template <typename T>
 struct InteractiveDepthInputFunctor<Eigen::GpuDevice, T> {
-	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, float min, float max, const void* in, T* out) {
-		dim3 blockSize = dim3(KERNEL_SIZE, KERNEL_SIZE);
-		dim3 threadSize = dim3((width + blockSize.x - 1) / blockSize.x, (height + blockSize.y - 1) / blockSize.y);
-		InteractiveDepthInputKernel<T><<<blockSize, threadSize, 0, d.stream()>>>(width, height, pitch, min, max, (const float *) in, out);
+	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, int channels, float min, float max, const void* in, T* out) {
+		InteractiveDepthInputKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, pitch, channels, min, max, (const float *) in, out);
 		return cudaGetLastError();
 	}
 };
 
 template <typename T>
 struct InteractiveOutputFunctor<Eigen::GpuDevice, T> {
-	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, const T* in, void* out) {
-		dim3 blockSize = dim3(KERNEL_SIZE, KERNEL_SIZE);
-		dim3 threadSize = dim3((width + blockSize.x - 1) / blockSize.x, (height + blockSize.y - 1) / blockSize.y);
-		InteractiveOutputKernel<T><<<blockSize, threadSize, 0, d.stream()>>>(width, height, pitch, in, (float *) out);
+	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, int stride, size_t pitch, int format, const T* in, void* out) {
+		InteractiveOutputKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, stride, pitch, format, in, (unsigned char *) out);
 		return cudaGetLastError();
 	}
 };
 
 template <typename T>
 struct InteractiveDepthOutputFunctor<Eigen::GpuDevice, T> {
-	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, size_t pitch, float min, float max, const T* in, void* out) {
-		dim3 blockSize = dim3(KERNEL_SIZE, KERNEL_SIZE);
-		dim3 threadSize = dim3((width + blockSize.x - 1) / blockSize.x, (height + blockSize.y - 1) / blockSize.y);
-		InteractiveDepthOutputKernel<T><<<blockSize, threadSize, 0, d.stream()>>>(width, height, pitch, min, max, in, (float *) out);
+	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, int stride, size_t pitch, int format, float min, float max, const T* in, void* out) {
+		InteractiveDepthOutputKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, stride, pitch, format, min, max, in, (unsigned char *) out);
+		return cudaGetLastError();
+	}
+};
+
+// One launch covers all bindings, the parameters of every binding travel with the kernel arguments
+template <typename T>
+struct InteractiveGatherFunctor<Eigen::GpuDevice, T> {
+	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, const IO_Params& params, T* out) {
+		InteractiveGatherKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, params, out);
+		return cudaGetLastError();
+	}
+};
+
+template <typename T>
+struct InteractiveScatterFunctor<Eigen::GpuDevice, T> {
+	cudaError_t operator()(const Eigen::GpuDevice& d, int width, int height, const IO_Params& params, const T* in) {
+		InteractiveScatterKernel<T><<<kernel_blocks(width, height), kernel_threads(), 0, d.stream()>>>(width, height, params, in);
+		return cudaGetLastError();
+	}
+};
+
+// Every thread reduces a grid stride slice, the block then folds the thread results in shared memory
+template <typename T>
+__global__ void InteractiveTensorStatsKernel(long long count, float histogram_min, float histogram_max, const T* in, PLUGIN_NAMESPACE::Tensor_Stats* partials) {
+	__shared__ PLUGIN_NAMESPACE::Tensor_Stats block_stats[STATS_THREADS];
+
+	PLUGIN_NAMESPACE::Tensor_Stats stats;
+	PLUGIN_NAMESPACE::clear_tensor_stats(stats, histogram_min, histogram_max);
+	for (long long i = blockIdx.x * (long long)blockDim.x + threadIdx.x; i < count; i += (long long)blockDim.x * gridDim.x)
+		PLUGIN_NAMESPACE::accumulate_tensor_stats(stats, (float)in[i]);
+
+	block_stats[threadIdx.x] = stats;
+	__syncthreads();
+
+	for (unsigned stride = blockDim.x / 2; stride > 0; stride >>= 1) {
+		if (threadIdx.x < stride)
+			PLUGIN_NAMESPACE::merge_tensor_stats(block_stats[threadIdx.x], block_stats[threadIdx.x + stride]);
+		__syncthreads();
+	}
+
+	if (threadIdx.x == 0)
+		partials[blockIdx.x] = block_stats[0];
+}
+
+// Merges the block results in order into the slot behind them
+__global__ void InteractiveTensorStatsMergeKernel(PLUGIN_NAMESPACE::Tensor_Stats* partials, int blocks, unsigned long long run) {
+	PLUGIN_NAMESPACE::Tensor_Stats result = partials[0];
+	for (int b = 1; b < blocks; ++b)
+		PLUGIN_NAMESPACE::merge_tensor_stats(result, partials[b]);
+	result.run = run;
+	partials[blocks] = result;
+}
+
+// Runs once the host copy of a sample landed, later work on the stream waits for it so the copy is not overwritten meanwhile
+static void CUDART_CB PublishTensorStats(cudaStream_t stream, cudaError_t status, void* data) {
+	const Tensor_Stats_Target* target = (const Tensor_Stats_Target*)data;
+	if (status == cudaSuccess)
+		PLUGIN_NAMESPACE::TFTensorStats::publish(target->slot, *target->host);
+}
+
+// The reduction, the copy back and the publish are all queued on the stream, the op never waits for the sample
+template <typename T>
+struct InteractiveTensorStatsFunctor<Eigen::GpuDevice, T> {
+	cudaError_t operator()(const Eigen::GpuDevice& d, TF::int64 count, float histogram_min, float histogram_max, const T* in, Tensor_Stats_Target& target) {
+		if (target.device == nullptr) {
+			cudaError_t result = cudaMalloc((void**)&target.device, sizeof(PLUGIN_NAMESPACE::Tensor_Stats) * (STATS_BLOCKS + 1));
+			if (result != cudaSuccess)
+				return result;
+		}
+		if (target.host == nullptr) {
+			cudaError_t result = cudaMallocHost((void**)&target.host, sizeof(PLUGIN_NAMESPACE::Tensor_Stats));
+			if (result != cudaSuccess)
+				return result;
+		}
+
+		InteractiveTensorStatsKernel<T><<<STATS_BLOCKS, STATS_THREADS, 0, d.stream()>>>(count, histogram_min, histogram_max, in, target.device);
+		InteractiveTensorStatsMergeKernel<<<1, 1, 0, d.stream()>>>(target.device, STATS_BLOCKS, target.run);
+		cudaMemcpyAsync(target.host, target.device + STATS_BLOCKS, sizeof(PLUGIN_NAMESPACE::Tensor_Stats), cudaMemcpyDeviceToHost, d.stream());
+		cudaStreamAddCallback(d.stream(), PublishTensorStats, &target, 0);
 		return cudaGetLastError();
 	}
 };
@@ -175,5 +288,8 @@ template struct InteractiveNormalsInputFunctor<Eigen::GpuDevice, float>;
 template struct InteractiveDepthInputFunctor<Eigen::GpuDevice, float>;
 template struct InteractiveOutputFunctor<Eigen::GpuDevice, float>;
 template struct InteractiveDepthOutputFunctor<Eigen::GpuDevice, float>;
+template struct InteractiveGatherFunctor<Eigen::GpuDevice, float>;
+template struct InteractiveScatterFunctor<Eigen::GpuDevice, float>;
+template struct InteractiveTensorStatsFunctor<Eigen::GpuDevice, float>;
 
 #endif  // __CUDACC__
\ No newline at end of file
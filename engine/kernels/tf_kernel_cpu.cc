@@ -0,0 +1,408 @@
+#include "tf_kernel.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define INTERACTIVE_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INTERACTIVE_SSE2
+#endif
+
+// Cpu versions of the interactive functors, the transfer data has to point to host memory when the graph runs on the cpu.
+// The conversions match the cuda kernels, the tensors are read and written densely while the interactive buffers use the pitch.
+// The output functors read rows of stride pixels so a batch entry can write a part of its window.
+
+namespace {
+
+	// Pixels converted at once when the output buffer is not R32F
+	const int OUTPUT_CHUNK = 256;
+
+	// Rough per pixel cost for the thread pool to decide how many rows a task gets
+	const double CYCLES_PER_PIXEL = 8.0;
+
+	// Elements reduced into one partial result by the stats functor
+	const TF::int64 STATS_BLOCK = 1 << 16;
+
+	template <typename Body>
+	void for_each_row(const Eigen::ThreadPoolDevice& d, int width, int height, double bytes_loaded, double bytes_stored, Body body) {
+		Eigen::TensorOpCost cost(bytes_loaded * width, bytes_stored * width, CYCLES_PER_PIXEL * width);
+		d.parallelFor(height, cost, [&body](Eigen::Index first, Eigen::Index last) {
+			for (Eigen::Index y = first; y < last; ++y)
+				body(static_cast<int>(y));
+		});
+	}
+
+	template <typename T>
+	void normals_row(int width, const unsigned char* src, T* dest) {
+		for (int i = 0; i < width * 4; ++i)
+			dest[i] = ((T) src[i]) / 255.0f;
+	}
+
+	template <typename T>
+	void input_row(int width, float min, float range, const unsigned char* normals, const float* depth, T* dest) {
+		for (int x = 0; x < width; ++x) {
+			dest[4 * x + 0] = ((T) normals[4 * x + 0]) / 255.0f;
+			dest[4 * x + 1] = ((T) normals[4 * x + 1]) / 255.0f;
+			dest[4 * x + 2] = ((T) normals[4 * x + 2]) / 255.0f;
+			dest[4 * x + 3] = (T) ((depth[x] - min) / range);
+		}
+	}
+
+	template <typename T>
+	void depth_input_row(int width, float min, float range, const float* src, T* dest) {
+		for (int x = 0; x < width; ++x) {
+			T value = (T) ((src[x] - min) / range);
+			dest[4 * x + 0] = value;
+			dest[4 * x + 1] = value;
+			dest[4 * x + 2] = value;
+			dest[4 * x + 3] = value;
+		}
+	}
+
+	template <typename T>
+	void octahedral_input_row(int width, float min, float range, const unsigned char* normals, const float* depth, T* dest) {
+		for (int x = 0; x < width; ++x) {
+			float u, v;
+			octahedral_normal(normals + 4 * x, u, v);
+			dest[3 * x + 0] = (T) u;
+			dest[3 * x + 1] = (T) v;
+			dest[3 * x + 2] = (T) ((depth[x] - min) / range);
+		}
+	}
+
+	// Packing of single channel inputs, the depth is all the slim network reads
+	template <typename T>
+	void depth_channel_row(int width, float min, float range, const float* src, T* dest) {
+		for (int x = 0; x < width; ++x)
+			dest[x] = (T) ((src[x] - min) / range);
+	}
+
+	template <typename T>
+	void output_row(int width, const T* src, float* dest) {
+		for (int x = 0; x < width; ++x)
+			dest[x] = (float) src[x];
+	}
+
+	template <typename T>
+	void depth_output_row(int width, float min, float range, const T* src, float* dest) {
+		for (int x = 0; x < width; ++x)
+			dest[x] = (float) (src[4 * x + 1] * range) + min;
+	}
+
+	// Rounds like the gpu output kernels, so both devices write the same halfs
+	void half_row(int width, const float* src, unsigned short* dest) {
+		for (int x = 0; x < width; ++x)
+			dest[x] = float_to_half(src[x]);
+	}
+
+	void unorm_row(int width, const float* src, unsigned char* dest) {
+		int x = 0;
+#ifdef INTERACTIVE_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (; x + 16 <= width; x += 16) {
+			__m128i values[4];
+			for (int k = 0; k < 4; ++k) {
+				__m128 clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + x + 4 * k), zero), one);
+				values[k] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, scale), half));
+			}
+			__m128i low = _mm_packs_epi32(values[0], values[1]);
+			__m128i high = _mm_packs_epi32(values[2], values[3]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm_packus_epi16(low, high));
+		}
+#endif
+		for (; x < width; ++x)
+			dest[x] = quantize_byte(src[x] * 255.0f);
+	}
+
+	// Converts R32F results to the format of the output buffer
+	void store_output_row(int format, int width, const float* row, void* dest) {
+		if (format == PixelR8)
+			unorm_row(width, row, static_cast<unsigned char*>(dest));
+		else if (format == PixelR16F)
+			half_row(width, row, static_cast<unsigned short*>(dest));
+		else
+			memcpy(dest, row, width * sizeof(float));
+	}
+
+#ifdef INTERACTIVE_SSE2
+	// Widens 16 bytes into four vectors of four floats divided by 255, vector k holds the channels of pixel k
+	inline void widen_bytes(const unsigned char* src, __m128 out[4]) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale = _mm_set1_ps(255.0f);
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		__m128i low = _mm_unpacklo_epi8(bytes, zero);
+		__m128i high = _mm_unpackhi_epi8(bytes, zero);
+		out[0] = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale);
+		out[1] = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale);
+		out[2] = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale);
+		out[3] = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale);
+	}
+
+	template <>
+	void normals_row<float>(int width, const unsigned char* src, float* dest) {
+		int count = width * 4;
+		int i = 0;
+#ifdef INTERACTIVE_AVX2
+		const __m256 scale = _mm256_set1_ps(255.0f);
+		for (; i + 8 <= count; i += 8) {
+			__m256i values = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+			_mm256_storeu_ps(dest + i, _mm256_div_ps(_mm256_cvtepi32_ps(values), scale));
+		}
+#endif
+		for (; i + 16 <= count; i += 16) {
+			__m128 pixels[4];
+			widen_bytes(src + i, pixels);
+			for (int k = 0; k < 4; ++k)
+				_mm_storeu_ps(dest + i + 4 * k, pixels[k]);
+		}
+		for (; i < count; ++i)
+			dest[i] = ((float) src[i]) / 255.0f;
+	}
+
+	template <>
+	void input_row<float>(int width, float min, float range, const unsigned char* normals, const float* depth, float* dest) {
+		const __m128 rgb_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 min_vector = _mm_set1_ps(min);
+		const __m128 range_vector = _mm_set1_ps(range);
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			__m128 pixels[4];
+			widen_bytes(normals + 4 * x, pixels);
+			__m128 remapped = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(depth + x), min_vector), range_vector);
+
+			// Moves the remapped depth of pixel k into its alpha channel
+			__m128 depth_0 = _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 depth_1 = _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 depth_2 = _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(2, 2, 2, 2));
+			__m128 depth_3 = _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(3, 3, 3, 3));
+			_mm_storeu_ps(dest + 4 * x + 0, _mm_or_ps(_mm_and_ps(rgb_mask, pixels[0]), _mm_andnot_ps(rgb_mask, depth_0)));
+			_mm_storeu_ps(dest + 4 * x + 4, _mm_or_ps(_mm_and_ps(rgb_mask, pixels[1]), _mm_andnot_ps(rgb_mask, depth_1)));
+			_mm_storeu_ps(dest + 4 * x + 8, _mm_or_ps(_mm_and_ps(rgb_mask, pixels[2]), _mm_andnot_ps(rgb_mask, depth_2)));
+			_mm_storeu_ps(dest + 4 * x + 12, _mm_or_ps(_mm_and_ps(rgb_mask, pixels[3]), _mm_andnot_ps(rgb_mask, depth_3)));
+		}
+		for (; x < width; ++x) {
+			dest[4 * x + 0] = ((float) normals[4 * x + 0]) / 255.0f;
+			dest[4 * x + 1] = ((float) normals[4 * x + 1]) / 255.0f;
+			dest[4 * x + 2] = ((float) normals[4 * x + 2]) / 255.0f;
+			dest[4 * x + 3] = (depth[x] - min) / range;
+		}
+	}
+
+	template <>
+	void depth_input_row<float>(int width, float min, float range, const float* src, float* dest) {
+		const __m128 min_vector = _mm_set1_ps(min);
+		const __m128 range_vector = _mm_set1_ps(range);
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			__m128 remapped = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(src + x), min_vector), range_vector);
+			_mm_storeu_ps(dest + 4 * x + 0, _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(0, 0, 0, 0)));
+			_mm_storeu_ps(dest + 4 * x + 4, _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(1, 1, 1, 1)));
+			_mm_storeu_ps(dest + 4 * x + 8, _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(2, 2, 2, 2)));
+			_mm_storeu_ps(dest + 4 * x + 12, _mm_shuffle_ps(remapped, remapped, _MM_SHUFFLE(3, 3, 3, 3)));
+		}
+		for (; x < width; ++x) {
+			float value = (src[x] - min) / range;
+			dest[4 * x + 0] = value;
+			dest[4 * x + 1] = value;
+			dest[4 * x + 2] = value;
+			dest[4 * x + 3] = value;
+		}
+	}
+
+	template <>
+	void depth_channel_row<float>(int width, float min, float range, const float* src, float* dest) {
+		const __m128 min_vector = _mm_set1_ps(min);
+		const __m128 range_vector = _mm_set1_ps(range);
+		int x = 0;
+		for (; x + 4 <= width; x += 4)
+			_mm_storeu_ps(dest + x, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(src + x), min_vector), range_vector));
+		for (; x < width; ++x)
+			dest[x] = (src[x] - min) / range;
+	}
+
+	template <>
+	void output_row<float>(int width, const float* src, float* dest) {
+		memcpy(dest, src, width * sizeof(float));
+	}
+
+	template <>
+	void depth_output_row<float>(int width, float min, float range, const float* src, float* dest) {
+		const __m128 min_vector = _mm_set1_ps(min);
+		const __m128 range_vector = _mm_set1_ps(range);
+		int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			// Gathers the second channel of four pixels
+			__m128 low = _mm_shuffle_ps(_mm_loadu_ps(src + 4 * x + 0), _mm_loadu_ps(src + 4 * x + 4), _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 high = _mm_shuffle_ps(_mm_loadu_ps(src + 4 * x + 8), _mm_loadu_ps(src + 4 * x + 12), _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 values = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_ps(dest + x, _mm_add_ps(_mm_mul_ps(values, range_vector), min_vector));
+		}
+		for (; x < width; ++x)
+			dest[x] = (src[4 * x + 1] * range) + min;
+	}
+#endif
+
+	template <typename T>
+	const T* byte_offset(const void* base, size_t bytes) {
+		return reinterpret_cast<const T*>(static_cast<const unsigned char*>(base) + bytes);
+	}
+
+} // anonymous namespace
+
+template <typename T>
+struct InteractiveInputFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, size_t pitch, int channels, float min, float max, const void* normals, const void* depth, T* out) {
+		const float range = max - min;
+		for_each_row(d, width, height, 4.0 + sizeof(float), channels * sizeof(T), [=](int y) {
+			const unsigned char* normals_src = byte_offset<unsigned char>(normals, y * pitch);
+			const float* depth_src = byte_offset<float>(depth, y * pitch);
+			T* dest = out + (size_t)y * width * channels;
+			if (channels == 3)
+				octahedral_input_row<T>(width, min, range, normals_src, depth_src, dest);
+			else
+				input_row<T>(width, min, range, normals_src, depth_src, dest);
+		});
+		return cudaSuccess;
+	}
+};
+
+template <typename T>
+struct InteractiveNormalsInputFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, size_t pitch, const void* in, T* out) {
+		for_each_row(d, width, height, 4.0, 4.0 * sizeof(T), [=](int y) {
+			normals_row<T>(width, byte_offset<unsigned char>(in, y * pitch), out + (size_t)y * width * 4);
+		});
+		return cudaSuccess;
+	}
+};
+
+template <typename T>
+struct InteractiveDepthInputFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, size_t pitch, int channels, float min, float max, const void* in, T* out) {
+		const float range = max - min;
+		for_each_row(d, width, height, sizeof(float), channels * sizeof(T), [=](int y) {
+			const float* src = byte_offset<float>(in, y * pitch);
+			T* dest = out + (size_t)y * width * channels;
+			if (channels == 1)
+				depth_channel_row<T>(width, min, range, src, dest);
+			else
+				depth_input_row<T>(width, min, range, src, dest);
+		});
+		return cudaSuccess;
+	}
+};
+
+// Quantized formats are converted through a float chunk on the stack, the plain R32F case writes straight into the buffer
+template <typename T>
+struct InteractiveOutputFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, int stride, size_t pitch, int format, const T* in, void* out) {
+		for_each_row(d, width, height, sizeof(T), pixel_size(format), [=](int y) {
+			const T* src = in + (size_t)y * stride;
+			unsigned char* dest = const_cast<unsigned char*>(byte_offset<unsigned char>(out, y * pitch));
+			if (format == PixelR32F) {
+				output_row<T>(width, src, reinterpret_cast<float*>(dest));
+				return;
+			}
+			float chunk[OUTPUT_CHUNK];
+			for (int x = 0; x < width; x += OUTPUT_CHUNK) {
+				int count = std::min(OUTPUT_CHUNK, width - x);
+				output_row<T>(count, src + x, chunk);
+				store_output_row(format, count, chunk, dest + x * pixel_size(format));
+			}
+		});
+		return cudaSuccess;
+	}
+};
+
+template <typename T>
+struct InteractiveDepthOutputFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, int stride, size_t pitch, int format, float min, float max, const T* in, void* out) {
+		const float range = max - min;
+		for_each_row(d, width, height, 4.0 * sizeof(T), pixel_size(format), [=](int y) {
+			const T* src = in + (size_t)y * stride * 4;
+			unsigned char* dest = const_cast<unsigned char*>(byte_offset<unsigned char>(out, y * pitch));
+			if (format == PixelR32F) {
+				depth_output_row<T>(width, min, range, src, reinterpret_cast<float*>(dest));
+				return;
+			}
+			float chunk[OUTPUT_CHUNK];
+			for (int x = 0; x < width; x += OUTPUT_CHUNK) {
+				int count = std::min(OUTPUT_CHUNK, width - x);
+				depth_output_row<T>(count, min, range, src + 4 * x, chunk);
+				store_output_row(format, count, chunk, dest + x * pixel_size(format));
+			}
+		});
+		return cudaSuccess;
+	}
+};
+
+template <typename T>
+struct InteractiveGatherFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, const IO_Params& params, T* out) {
+		const int channels = params.tensor_channels;
+		for_each_row(d, width, height, 4.0 * params.binding_count, channels * sizeof(T), [=](int y) {
+			T* dest = out + (size_t)y * width * channels;
+			for (int x = 0; x < width; ++x)
+				gather_pixel(params, x, y, dest + x * channels);
+		});
+		return cudaSuccess;
+	}
+};
+
+template <typename T>
+struct InteractiveScatterFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, int width, int height, const IO_Params& params, const T* in) {
+		const int channels = params.tensor_channels;
+		for_each_row(d, width, height, channels * sizeof(T), 4.0 * params.binding_count, [=](int y) {
+			const T* src = in + (size_t)y * width * channels;
+			for (int x = 0; x < width; ++x)
+				scatter_pixel(params, x, y, src + x * channels);
+		});
+		return cudaSuccess;
+	}
+};
+
+// Every block reduces into its own partial result, the partials are merged in order afterwards so a sample does not
+// depend on how the thread pool split the work
+template <typename T>
+struct InteractiveTensorStatsFunctor<Eigen::ThreadPoolDevice, T> {
+	cudaError_t operator()(const Eigen::ThreadPoolDevice& d, TF::int64 count, float histogram_min, float histogram_max, const T* in, Tensor_Stats_Target& target) {
+		const TF::int64 blocks = (count + STATS_BLOCK - 1) / STATS_BLOCK;
+		std::vector<PLUGIN_NAMESPACE::Tensor_Stats> partials((size_t)blocks);
+
+		Eigen::TensorOpCost cost(STATS_BLOCK * sizeof(T), 0.0, STATS_BLOCK * CYCLES_PER_PIXEL);
+		d.parallelFor(blocks, cost, [&](Eigen::Index first, Eigen::Index last) {
+			for (Eigen::Index b = first; b < last; ++b) {
+				PLUGIN_NAMESPACE::Tensor_Stats& partial = partials[(size_t)b];
+				PLUGIN_NAMESPACE::clear_tensor_stats(partial, histogram_min, histogram_max);
+				const TF::int64 end = std::min(count, (b + 1) * STATS_BLOCK);
+				for (TF::int64 i = b * STATS_BLOCK; i < end; ++i)
+					PLUGIN_NAMESPACE::accumulate_tensor_stats(partial, (float) in[i]);
+			}
+		});
+
+		PLUGIN_NAMESPACE::Tensor_Stats result;
+		PLUGIN_NAMESPACE::clear_tensor_stats(result, histogram_min, histogram_max);
+		for (const PLUGIN_NAMESPACE::Tensor_Stats& partial : partials)
+			PLUGIN_NAMESPACE::merge_tensor_stats(result, partial);
+		result.run = target.run;
+		PLUGIN_NAMESPACE::TFTensorStats::publish(target.slot, result);
+		return cudaSuccess;
+	}
+};
+
+template struct InteractiveInputFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveNormalsInputFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveDepthInputFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveOutputFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveDepthOutputFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveGatherFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveScatterFunctor<Eigen::ThreadPoolDevice, float>;
+template struct InteractiveTensorStatsFunctor<Eigen::ThreadPoolDevice, float>;
@@ -0,0 +1,64 @@
+#ifdef __CUDACC__
+
+#include "../tf_resample.h"
+
+#define RESAMPLE_KERNEL_SIZE 16
+
+__global__ void DownsampleKernel(Resample_Params params, Resample_Surfaces surfaces) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x >= params.low_width || y >= params.low_height) return;
+
+	downsample_pixel(params, surfaces, x, y);
+}
+
+__global__ void UpsampleKernel(Resample_Params params, Resample_Surfaces surfaces) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x >= params.width || y >= params.height) return;
+
+	upsample_pixel(params, surfaces, x, y);
+}
+
+__global__ void ConvertKernel(Resample_Params params, Convert_Surfaces surfaces) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x >= params.width || y >= params.height) return;
+
+	convert_pixel(surfaces, x, y);
+}
+
+namespace PLUGIN_NAMESPACE
+{
+	cudaError_t TFResample::downsample(const Resample_Params &params, const Resample_Surfaces &surfaces, cudaStream_t stream)
+	{
+		dim3 threadSize = dim3(RESAMPLE_KERNEL_SIZE, RESAMPLE_KERNEL_SIZE);
+		dim3 blockSize = dim3((params.low_width + threadSize.x - 1) / threadSize.x, (params.low_height + threadSize.y - 1) / threadSize.y);
+		DownsampleKernel<<<blockSize, threadSize, 0, stream>>>(params, surfaces);
+		return cudaGetLastError();
+	}
+
+	cudaError_t TFResample::upsample(const Resample_Params &params, const Resample_Surfaces &surfaces, cudaStream_t stream)
+	{
+		dim3 threadSize = dim3(RESAMPLE_KERNEL_SIZE, RESAMPLE_KERNEL_SIZE);
+		dim3 blockSize = dim3((params.width + threadSize.x - 1) / threadSize.x, (params.height + threadSize.y - 1) / threadSize.y);
+		UpsampleKernel<<<blockSize, threadSize, 0, stream>>>(params, surfaces);
+		return cudaGetLastError();
+	}
+
+	cudaError_t TFResample::convert(const Resample_Params &params, const Convert_Surfaces &surfaces, cudaStream_t stream)
+	{
+		dim3 threadSize = dim3(RESAMPLE_KERNEL_SIZE, RESAMPLE_KERNEL_SIZE);
+		dim3 blockSize = dim3((params.width + threadSize.x - 1) / threadSize.x, (params.height + threadSize.y - 1) / threadSize.y);
+		ConvertKernel<<<blockSize, threadSize, 0, stream>>>(params, surfaces);
+		return cudaGetLastError();
+	}
+}
+
+#endif  // __CUDACC__
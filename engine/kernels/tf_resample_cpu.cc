@@ -0,0 +1,153 @@
+#include "../tf_resample.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESAMPLE_SSE2
+#endif
+
+// Cpu reference of the resample passes, every pixel gets the same result as the scalar functions of tf_resample.h up to
+// float rounding. The down pass handles four blocks at once for the half resolution mode, the up pass weighs the four
+// taps of a pixel at once.
+
+namespace {
+
+#ifdef RESAMPLE_SSE2
+	// Half resolution blocks of four network pixels, x has to be a multiple of four and all blocks inside the target
+	void downsample_half_blocks(const Resample_Params& params, const Resample_Surfaces& surfaces, int x, int y) {
+		const float* top = resample_row(surfaces.depth, surfaces.pitch, 2 * y) + 2 * x;
+		const float* bottom = resample_row(surfaces.depth, surfaces.pitch, 2 * y + 1) + 2 * x;
+		__m128 top_low = _mm_loadu_ps(top);
+		__m128 top_high = _mm_loadu_ps(top + 4);
+		__m128 bottom_low = _mm_loadu_ps(bottom);
+		__m128 bottom_high = _mm_loadu_ps(bottom + 4);
+
+		// Left and right pixel of every block
+		__m128 top_left = _mm_shuffle_ps(top_low, top_high, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 top_right = _mm_shuffle_ps(top_low, top_high, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 bottom_left = _mm_shuffle_ps(bottom_low, bottom_high, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 bottom_right = _mm_shuffle_ps(bottom_low, bottom_high, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 nearest = _mm_min_ps(_mm_min_ps(top_left, top_right), _mm_min_ps(bottom_left, bottom_right));
+		__m128 farthest = _mm_max_ps(_mm_max_ps(top_left, top_right), _mm_max_ps(bottom_left, bottom_right));
+
+		// x is even, so the odd lanes of even rows and the even lanes of odd rows take the farthest depth
+		__m128 mask = (y & 1) ? _mm_castsi128_ps(_mm_set_epi32(0, -1, 0, -1)) : _mm_castsi128_ps(_mm_set_epi32(-1, 0, -1, 0));
+		__m128 selected = _mm_or_ps(_mm_and_ps(mask, farthest), _mm_andnot_ps(mask, nearest));
+		_mm_storeu_ps(resample_row(surfaces.low_depth, surfaces.low_pitch, y) + x, selected);
+
+		if (surfaces.normals == nullptr || surfaces.low_normals == nullptr)
+			return;
+
+		// The normal comes from the first pixel of the block in row order which has the selected depth, like in the scalar pass
+		const int matches[4] = {
+			_mm_movemask_ps(_mm_cmpeq_ps(top_left, selected)),
+			_mm_movemask_ps(_mm_cmpeq_ps(top_right, selected)),
+			_mm_movemask_ps(_mm_cmpeq_ps(bottom_left, selected)),
+			_mm_movemask_ps(_mm_cmpeq_ps(bottom_right, selected)) };
+		unsigned char* dest = resample_row(surfaces.low_normals, surfaces.low_pitch, y) + 4 * x;
+		for (int lane = 0; lane < 4; ++lane) {
+			int candidate = 0;
+			while (candidate < 3 && !((matches[candidate] >> lane) & 1))
+				++candidate;
+			const unsigned char* src = resample_row(surfaces.normals, surfaces.pitch, 2 * y + (candidate >> 1)) + 4 * (2 * (x + lane) + (candidate & 1));
+			memcpy(dest + 4 * lane, src, 4);
+		}
+	}
+
+	inline float horizontal_sum(__m128 values) {
+		__m128 pairs = _mm_add_ps(values, _mm_shuffle_ps(values, values, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(2, 3, 0, 1))));
+	}
+
+	// The four taps live in the lanes in the order (x0, y0), (x1, y0), (x0, y1), (x1, y1)
+	void upsample_pixel_sse(const Resample_Params& params, const Resample_Surfaces& surfaces, int x, int y) {
+		int tap_x[2], tap_y[2];
+		float fraction_x, fraction_y;
+		upsample_taps(params, x, y, tap_x, tap_y, fraction_x, fraction_y);
+
+		const float* low_depth[2] = { resample_row(surfaces.low_depth, surfaces.low_pitch, tap_y[0]), resample_row(surfaces.low_depth, surfaces.low_pitch, tap_y[1]) };
+		const unsigned char* low_output[2] = { resample_row(surfaces.low_output, surfaces.low_output_pitch, tap_y[0]), resample_row(surfaces.low_output, surfaces.low_output_pitch, tap_y[1]) };
+		const int size = pixel_size(surfaces.output_format);
+
+		const float depth = resample_row(surfaces.depth, surfaces.pitch, y)[x];
+		__m128 taps = _mm_set_ps(low_depth[1][tap_x[1]], low_depth[1][tap_x[0]], low_depth[0][tap_x[1]], low_depth[0][tap_x[0]]);
+		__m128 difference = _mm_div_ps(_mm_sub_ps(_mm_set1_ps(depth), taps), _mm_set1_ps((depth > 0.0f ? depth : -depth) * UPSAMPLE_DEPTH_SIGMA + 1e-6f));
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 weight = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(difference, difference)));
+
+		if (surfaces.normals && surfaces.low_normals) {
+			const unsigned char* normal = resample_row(surfaces.normals, surfaces.pitch, y) + 4 * x;
+			const unsigned char* tap_normals[4] = {
+				resample_row(surfaces.low_normals, surfaces.low_pitch, tap_y[0]) + 4 * tap_x[0],
+				resample_row(surfaces.low_normals, surfaces.low_pitch, tap_y[0]) + 4 * tap_x[1],
+				resample_row(surfaces.low_normals, surfaces.low_pitch, tap_y[1]) + 4 * tap_x[0],
+				resample_row(surfaces.low_normals, surfaces.low_pitch, tap_y[1]) + 4 * tap_x[1] };
+			__m128 dot = _mm_setzero_ps();
+			for (int channel = 0; channel < 3; ++channel) {
+				__m128 component = _mm_set_ps(tap_normals[3][channel], tap_normals[2][channel], tap_normals[1][channel], tap_normals[0][channel]);
+				component = _mm_sub_ps(_mm_div_ps(component, _mm_set1_ps(127.5f)), one);
+				dot = _mm_add_ps(dot, _mm_mul_ps(component, _mm_set1_ps(normal[channel] / 127.5f - 1.0f)));
+			}
+			dot = _mm_max_ps(dot, _mm_setzero_ps());
+			dot = _mm_mul_ps(dot, dot);
+			dot = _mm_mul_ps(dot, dot);
+			weight = _mm_mul_ps(weight, _mm_mul_ps(dot, dot));
+		}
+
+		__m128 bilinear = _mm_set_ps(fraction_x * fraction_y, (1.0f - fraction_x) * fraction_y, fraction_x * (1.0f - fraction_y), (1.0f - fraction_x) * (1.0f - fraction_y));
+		weight = _mm_mul_ps(bilinear, _mm_add_ps(weight, _mm_set1_ps(UPSAMPLE_MIN_WEIGHT)));
+
+		__m128 values = _mm_set_ps(
+			decode_output(surfaces.output_format, low_output[1] + size * tap_x[1]),
+			decode_output(surfaces.output_format, low_output[1] + size * tap_x[0]),
+			decode_output(surfaces.output_format, low_output[0] + size * tap_x[1]),
+			decode_output(surfaces.output_format, low_output[0] + size * tap_x[0]));
+		float result = horizontal_sum(_mm_mul_ps(weight, values)) / horizontal_sum(weight);
+		encode_output(surfaces.output_format, result, resample_row(surfaces.output, surfaces.output_pitch, y) + size * x);
+	}
+#endif
+
+} // anonymous namespace
+
+namespace PLUGIN_NAMESPACE
+{
+	void TFResample::downsample_cpu(const Resample_Params &params, const Resample_Surfaces &surfaces)
+	{
+		for (int y = 0; y < params.low_height; ++y)
+		{
+			int x = 0;
+#ifdef RESAMPLE_SSE2
+			if (params.factor == 2 && 2 * y + 1 < params.height)
+			{
+				for (; 2 * (x + 4) <= params.width; x += 4)
+					downsample_half_blocks(params, surfaces, x, y);
+			}
+#endif
+			for (; x < params.low_width; ++x)
+				downsample_pixel(params, surfaces, x, y);
+		}
+	}
+
+	void TFResample::upsample_cpu(const Resample_Params &params, const Resample_Surfaces &surfaces)
+	{
+		for (int y = 0; y < params.height; ++y)
+		{
+			for (int x = 0; x < params.width; ++x)
+			{
+#ifdef RESAMPLE_SSE2
+				upsample_pixel_sse(params, surfaces, x, y);
+#else
+				upsample_pixel(params, surfaces, x, y);
+#endif
+			}
+		}
+	}
+
+	void TFResample::convert_cpu(const Resample_Params &params, const Convert_Surfaces &surfaces)
+	{
+		for (int y = 0; y < params.height; ++y)
+		{
+			for (int x = 0; x < params.width; ++x)
+				convert_pixel(surfaces, x, y);
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#ifdef __CUDACC__
+
+#include "../tf_temporal.h"
+
+#define TEMPORAL_KERNEL_SIZE 16
+
+// Threads outside of the target take part in the block count, so the whole block reaches the barrier
+__global__ void ReprojectKernel(Reproject_Params params, Temporal_Surfaces surfaces, unsigned* invalid_count) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	bool invalid = x < params.width && y < params.height && !reproject_pixel(params, surfaces, x, y);
+	int block_invalid = __syncthreads_count(invalid);
+	if (threadIdx.x == 0 && threadIdx.y == 0 && block_invalid > 0)
+		atomicAdd(invalid_count, (unsigned)block_invalid);
+}
+
+__global__ void ResolveKernel(Reproject_Params params, Temporal_Surfaces surfaces) {
+
+	int x = blockIdx.x*blockDim.x + threadIdx.x;
+	int y = blockIdx.y*blockDim.y + threadIdx.y;
+
+	if (x >= params.width || y >= params.height) return;
+
+	resolve_pixel(params, surfaces, x, y);
+}
+
+namespace PLUGIN_NAMESPACE
+{
+	cudaError_t TFTemporal::reproject(const Reproject_Params &params, const Temporal_Surfaces &surfaces, unsigned *invalid_count, cudaStream_t stream)
+	{
+		dim3 threadSize = dim3(TEMPORAL_KERNEL_SIZE, TEMPORAL_KERNEL_SIZE);
+		dim3 blockSize = dim3((params.width + threadSize.x - 1) / threadSize.x, (params.height + threadSize.y - 1) / threadSize.y);
+		ReprojectKernel<<<blockSize, threadSize, 0, stream>>>(params, surfaces, invalid_count);
+		return cudaGetLastError();
+	}
+
+	cudaError_t TFTemporal::resolve(const Reproject_Params &params, const Temporal_Surfaces &surfaces, cudaStream_t stream)
+	{
+		dim3 threadSize = dim3(TEMPORAL_KERNEL_SIZE, TEMPORAL_KERNEL_SIZE);
+		dim3 blockSize = dim3((params.width + threadSize.x - 1) / threadSize.x, (params.height + threadSize.y - 1) / threadSize.y);
+		ResolveKernel<<<blockSize, threadSize, 0, stream>>>(params, surfaces);
+		return cudaGetLastError();
+	}
+}
+
+#endif  // __CUDACC__
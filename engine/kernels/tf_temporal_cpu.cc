@@ -0,0 +1,147 @@
+#include "../tf_temporal.h"
+
+// Host side of the temporal reuse, the matrices are set up in double precision since the reprojection combines the
+// inverse of one view projection with another one and the difference between two frames is tiny.
+
+namespace {
+
+	void multiply(const double a[16], const double b[16], double result[16]) {
+		for (int row = 0; row < 4; ++row)
+			for (int column = 0; column < 4; ++column)
+				result[4 * row + column] = a[4 * row] * b[column] + a[4 * row + 1] * b[4 + column] + a[4 * row + 2] * b[8 + column] + a[4 * row + 3] * b[12 + column];
+	}
+
+	// Gauss-Jordan with partial pivoting, returns false for singular matrices
+	bool invert(const double matrix[16], double result[16]) {
+		double work[4][8];
+		for (int row = 0; row < 4; ++row) {
+			for (int column = 0; column < 4; ++column) {
+				work[row][column] = matrix[4 * row + column];
+				work[row][4 + column] = row == column ? 1.0 : 0.0;
+			}
+		}
+
+		for (int column = 0; column < 4; ++column) {
+			int pivot = column;
+			for (int row = column + 1; row < 4; ++row)
+				if (fabs(work[row][column]) > fabs(work[pivot][column]))
+					pivot = row;
+			if (fabs(work[pivot][column]) < 1e-12)
+				return false;
+			for (int i = 0; i < 8; ++i) {
+				double swap = work[column][i];
+				work[column][i] = work[pivot][i];
+				work[pivot][i] = swap;
+			}
+
+			const double scale = 1.0 / work[column][column];
+			for (int i = 0; i < 8; ++i)
+				work[column][i] *= scale;
+			for (int row = 0; row < 4; ++row) {
+				if (row == column)
+					continue;
+				const double factor = work[row][column];
+				for (int i = 0; i < 8; ++i)
+					work[row][i] -= factor * work[column][i];
+			}
+		}
+
+		for (int row = 0; row < 4; ++row)
+			for (int column = 0; column < 4; ++column)
+				result[4 * row + column] = work[row][4 + column];
+		return true;
+	}
+
+	void to_double(const float matrix[16], double result[16]) {
+		for (int i = 0; i < 16; ++i)
+			result[i] = matrix[i];
+	}
+
+} // anonymous namespace
+
+namespace PLUGIN_NAMESPACE
+{
+	// The view is the inverse of the camera pose
+	Temporal_Camera TFTemporal::camera(const float pose[16], const float projection[16])
+	{
+		Temporal_Camera camera;
+		double pose_matrix[16], projection_matrix[16], view[16], view_projection[16];
+		to_double(pose, pose_matrix);
+		to_double(projection, projection_matrix);
+		if (!invert(pose_matrix, view))
+			to_double(pose, view);
+		multiply(view, projection_matrix, view_projection);
+
+		for (int i = 0; i < 16; ++i)
+		{
+			camera.pose[i] = pose[i];
+			camera.view_projection[i] = (float)view_projection[i];
+		}
+		return camera;
+	}
+
+	// A view projection which can not be inverted or an orthographic one, where the clip w is no depth, gets no history
+	Reproject_Params TFTemporal::reproject_params(const Temporal_Camera &current, const Temporal_Camera &previous, int width, int height, bool has_history, float blend)
+	{
+		Reproject_Params params;
+		params.width = width;
+		params.height = height;
+		params.blend = blend;
+
+		double current_matrix[16], previous_matrix[16], inverse[16], reprojection[16];
+		to_double(current.view_projection, current_matrix);
+		to_double(previous.view_projection, previous_matrix);
+		params.has_history = has_history && invert(current_matrix, inverse) && fabs(inverse[11]) > 1e-12;
+		if (!params.has_history)
+		{
+			for (int i = 0; i < 16; ++i)
+				inverse[i] = i % 5 == 0 ? 1.0 : 0.0;
+		}
+		multiply(inverse, previous_matrix, reprojection);
+
+		// The clip position (ndc_x * depth, ndc_y * depth, z, depth) has to be a point with w one after the inverse, which
+		// makes z = (1 - depth * (ndc_x * h0 + ndc_y * h1 + h3)) / h2 with h the last column of the inverse
+		const double *h = inverse + 3;
+		const double rows[3][2] = { { 0, h[0] / h[8] }, { 1, h[4] / h[8] }, { 3, h[12] / h[8] } };
+		for (int row = 0; row < 3; ++row)
+			for (int column = 0; column < 4; ++column)
+				params.reprojection[4 * row + column] = params.has_history ? (float)(reprojection[4 * (int)rows[row][0] + column] - rows[row][1] * reprojection[8 + column]) : 0.0f;
+		for (int column = 0; column < 4; ++column)
+			params.reprojection[12 + column] = params.has_history ? (float)(reprojection[8 + column] / h[8]) : 0.0f;
+
+		// Current view to world is the rotation of the current pose, world to previous view the transposed previous one
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+			{
+				double value = 0.0;
+				for (int i = 0; i < 3; ++i)
+					value += (double)current.pose[4 * row + i] * previous.pose[4 * column + i];
+				params.rotation[3 * row + column] = (float)value;
+			}
+		}
+		return params;
+	}
+
+	// The network runs without history, once the interval is over and whenever too much of the frame got disoccluded
+	bool TFTemporal::needs_network(bool has_history, unsigned frames_since_run, unsigned interval, unsigned invalid, unsigned pixels, float invalid_fraction)
+	{
+		return !has_history || frames_since_run + 1 >= interval || invalid > invalid_fraction * pixels;
+	}
+
+	unsigned TFTemporal::reproject_cpu(const Reproject_Params &params, const Temporal_Surfaces &surfaces)
+	{
+		unsigned invalid = 0;
+		for (int y = 0; y < params.height; ++y)
+			for (int x = 0; x < params.width; ++x)
+				invalid += reproject_pixel(params, surfaces, x, y) ? 0 : 1;
+		return invalid;
+	}
+
+	void TFTemporal::resolve_cpu(const Reproject_Params &params, const Temporal_Surfaces &surfaces)
+	{
+		for (int y = 0; y < params.height; ++y)
+			for (int x = 0; x < params.width; ++x)
+				resolve_pixel(params, surfaces, x, y);
+	}
+}
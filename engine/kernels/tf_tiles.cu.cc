@@ -0,0 +1,37 @@
+#ifdef __CUDACC__
+
+#include "../tf_tiles.h"
+
+// A block per tile and a thread per lane, every thread walks the words of its lane through the normals and the depth of
+// each row in the order the host hash does
+__global__ void HashLanesKernel(Tile_Grid grid, const unsigned char* normals, const float* depth, size_t pitch, uint32_t* lanes) {
+
+	const unsigned tile = blockIdx.y*grid.columns + blockIdx.x;
+	const unsigned lane = threadIdx.x;
+	const Tile_Rect rect = grid_tile_rect(grid, tile);
+
+	uint32_t state = lane;
+	for (unsigned y = 0; y < rect.height; ++y) {
+		const size_t offset = (size_t)(rect.y + y) * pitch + (size_t)rect.x * 4;
+		if (normals) {
+			const uint32_t* row = (const uint32_t*)(normals + offset);
+			for (unsigned i = lane; i < rect.width; i += TILE_HASH_LANES)
+				state = tile_hash_step(state, row[i]);
+		}
+		const uint32_t* row = (const uint32_t*)((const unsigned char*)depth + offset);
+		for (unsigned i = lane; i < rect.width; i += TILE_HASH_LANES)
+			state = tile_hash_step(state, row[i]);
+	}
+	lanes[tile * TILE_HASH_LANES + lane] = state;
+}
+
+namespace PLUGIN_NAMESPACE
+{
+	cudaError_t TFTiles::hash_lanes(const Tile_Grid &grid, const unsigned char *normals, const float *depth, size_t pitch, uint32_t *lanes, cudaStream_t stream)
+	{
+		HashLanesKernel<<<dim3(grid.columns, grid.rows), TILE_HASH_LANES, 0, stream>>>(grid, normals, depth, pitch, lanes);
+		return cudaGetLastError();
+	}
+}
+
+#endif  // __CUDACC__
@@ -29,6 +29,7 @@ extern "C"
 				api.setup_data_compiler = &PLUGIN_NAMESPACE::TFPlugin::setup_data_compiler;
 				api.shutdown_data_compiler = &PLUGIN_NAMESPACE::TFPlugin::shutdown_data_compiler;
 				api.can_refresh = &PLUGIN_NAMESPACE::TFPlugin::can_refresh;
+				api.refresh = &PLUGIN_NAMESPACE::TFPlugin::refresh;
 				api.render = &PLUGIN_NAMESPACE::TFPlugin::render;
 				api.get_name = &PLUGIN_NAMESPACE::TFPlugin::get_name;
 				return &api;
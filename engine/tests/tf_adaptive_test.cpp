@@ -0,0 +1,65 @@
+#include "../tf_adaptive.h"
+#include <cstdio>
+
+// Replays synthetic network timings through the resolution controller, no network involved
+
+namespace {
+
+	// Network cost of a synthetic trace, the load scales the time of the full resolution network and a small part of
+	// every run does not depend on the resolution
+	struct Adaptive_Trace
+	{
+		const char* name;
+		unsigned frames;
+		float full_ms;
+		float (*load)(unsigned frame, unsigned frames);
+		unsigned final_factor;
+		uint64_t max_switches;
+		unsigned max_over_runs;
+	};
+
+	float steady_load(unsigned, unsigned) { return 1.0f; }
+	float spike_load(unsigned frame, unsigned frames) { return frame >= frames / 4 && frame < frames / 2 ? 3.0f : 1.0f; }
+	float ramp_load(unsigned frame, unsigned frames) { return 0.5f + 5.0f * (frame < frames / 2 ? frame : frames - frame) / frames; }
+
+} // anonymous namespace
+
+// Every trace runs with a 10 ms budget and has to end at the expected rung, stay under a number of switches and only go
+// over the budget for a few runs
+int main() {
+	const float budget_ms = 10.0f;
+	const float fixed_ms = 0.5f;
+	const Adaptive_Trace traces[] = {
+		{ "light", 1000, 6.0f, steady_load, 1, 0, 0 },
+		{ "border", 2000, 9.8f, steady_load, 2, 1, 10 },
+		{ "spike", 2000, 6.0f, spike_load, 1, 2, 10 },
+		{ "heavy", 1000, 60.0f, steady_load, 4, 2, 10 },
+		{ "ramp", 4000, 6.0f, ramp_load, 1, 4, 40 },
+	};
+
+	bool passed = true;
+	for (const Adaptive_Trace& trace : traces) {
+		const Adaptive_Settings settings = PLUGIN_NAMESPACE::TFAdaptive::settings(budget_ms);
+		Adaptive_State state = PLUGIN_NAMESPACE::TFAdaptive::start(1);
+		unsigned seed = 11;
+		unsigned over_runs = 0;
+		double total_ms = 0.0;
+		for (unsigned frame = 0; frame < trace.frames; ++frame) {
+			seed = seed * 1664525u + 1013904223u;
+			const float jitter = 0.9f + 0.2f * (seed >> 8) / 16777216.0f;
+			const float factor = (float)state.factors[state.rung];
+			const float run_ms = (fixed_ms + trace.full_ms * trace.load(frame, trace.frames) / (factor * factor)) * jitter;
+			over_runs += run_ms > budget_ms ? 1 : 0;
+			total_ms += run_ms;
+			PLUGIN_NAMESPACE::TFAdaptive::update(settings, state, run_ms);
+		}
+
+		const bool trace_passed = state.factors[state.rung] == trace.final_factor && state.switches <= trace.max_switches && over_runs <= trace.max_over_runs;
+		fprintf(stderr, "Adaptive %-6s %4u runs: ends at 1/%u, %llu switches, %3u runs over the budget, %.2f ms average %s\n",
+			trace.name, trace.frames, state.factors[state.rung], (unsigned long long)state.switches, over_runs, total_ms / trace.frames, trace_passed ? "" : "FAILED");
+		passed = trace_passed && passed;
+	}
+
+	fprintf(stderr, "Adaptive check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
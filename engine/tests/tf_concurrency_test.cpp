@@ -0,0 +1,77 @@
+#include "tf_test_support.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+// Two sessions with their own bindings round trip their depth buffer through InteractiveDepthInput and
+// InteractiveDepthOutput on two threads at the same time. The depth buffers are far enough apart that an output holding
+// the depth of the other session cannot pass.
+
+using namespace tests;
+
+int main(int argc, char** argv) {
+	Test_Options options;
+	std::vector<std::string> rest;
+	parse_test_options(argc, argv, options, rest);
+	setup();
+
+	const Resolution resolution = RESOLUTIONS[0];
+	TF::GraphDef graph;
+	TF::Status status = TF::NodeDefBuilder("image_data", "Placeholder").Attr("dtype", TF::DT_FLOAT).Finalize(graph.add_node());
+	if (status.ok())
+		status = TF::NodeDefBuilder("input", "InteractiveDepthInput").Input("image_data", 0, TF::DT_FLOAT).Finalize(graph.add_node());
+	if (status.ok())
+		status = TF::NodeDefBuilder("output", "InteractiveDepthOutput").Input("input", 0, TF::DT_FLOAT).Finalize(graph.add_node());
+	if (!status.ok()) {
+		fprintf(stderr, "%s\n", status.ToString().c_str());
+		return 1;
+	}
+
+	Host_Surfaces first(resolution, 0.0f);
+	Host_Surfaces second(resolution, 5000.0f);
+	TF::Status statuses[2];
+	int mismatches[2] = { 0, 0 };
+
+	auto run_session = [&](Host_Surfaces& surfaces, TF::Status& session_status, int& session_mismatches) {
+		std::unique_ptr<TF::Session> session;
+		PLUGIN_NAMESPACE::TFBinding* binding = nullptr;
+		session_status = create_session(graph, options, session, &binding);
+		if (!session_status.ok())
+			return;
+
+		{
+			PLUGIN_NAMESPACE::Binding_Scope scope(binding, &surfaces.data);
+			std::vector<std::pair<std::string, TF::Tensor>> inputs = { { "image_data", input_tensor(resolution, 4) } };
+			std::vector<TF::Tensor> outputs;
+			for (int run = 0; run < options.runs && session_status.ok(); ++run) {
+				std::fill(surfaces.output.begin(), surfaces.output.end(), 0.0f);
+				session_status = session->Run(inputs, { "output" }, {}, &outputs);
+				for (size_t i = 0; i < surfaces.depth.size() && session_status.ok(); ++i) {
+					if (std::abs(surfaces.output[i] - surfaces.depth[i]) > 1e-2f) {
+						++session_mismatches;
+						break;
+					}
+				}
+			}
+		}
+		binding->Unref();
+		session->Close();
+	};
+
+	std::thread first_thread(run_session, std::ref(first), std::ref(statuses[0]), std::ref(mismatches[0]));
+	std::thread second_thread(run_session, std::ref(second), std::ref(statuses[1]), std::ref(mismatches[1]));
+	first_thread.join();
+	second_thread.join();
+
+	bool passed = true;
+	for (int i = 0; i < 2; ++i) {
+		if (!statuses[i].ok())
+			fprintf(stderr, "Session %d failed: %s\n", i, statuses[i].ToString().c_str());
+		else if (mismatches[i] > 0)
+			fprintf(stderr, "Session %d saw foreign buffers in %d of %d runs\n", i, mismatches[i], options.runs);
+		passed = passed && statuses[i].ok() && mismatches[i] == 0;
+	}
+	fprintf(stderr, "Concurrency check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+#include "tf_exr.h"
+#include "../tf_interactive_io.h"
+#include "tensorflow/core/lib/io/inputstream_interface.h"
+#include "tensorflow/core/lib/io/zlib_compression_options.h"
+#include "tensorflow/core/lib/io/zlib_inputstream.h"
+#include "tensorflow/core/platform/env.h"
+#include <algorithm>
+#include <cstring>
+
+namespace TF = tensorflow;
+
+namespace tests {
+
+	namespace {
+
+		// Decompressed bytes of a zip chunk, the compressed data lives in memory already
+		class Memory_Input_Stream : public TF::io::InputStreamInterface
+		{
+		public:
+			explicit Memory_Input_Stream(TF::StringPiece data) : data(data) {}
+
+			TF::Status ReadNBytes(TF::int64 bytes_to_read, TF::string* result) override {
+				const size_t count = std::min((size_t)bytes_to_read, data.size() - position);
+				result->assign(data.data() + position, count);
+				position += count;
+				return (TF::int64)count < bytes_to_read ? TF::errors::OutOfRange("End of chunk") : TF::Status::OK();
+			}
+
+			TF::int64 Tell() const override { return (TF::int64)position; }
+
+			TF::Status Reset() override {
+				position = 0;
+				return TF::Status::OK();
+			}
+
+		private:
+			TF::StringPiece data;
+			size_t position = 0;
+		};
+
+		// Undoes the byte predictor and the split into even and odd bytes the zip compression of OpenEXR applies
+		TF::Status inflate_exr_chunk(TF::StringPiece compressed, size_t size, std::string& raw) {
+			Memory_Input_Stream stream(compressed);
+			TF::io::ZlibInputStream zlib(&stream, compressed.size(), size, TF::io::ZlibCompressionOptions::DEFAULT());
+			std::string predicted;
+			TF_RETURN_IF_ERROR(zlib.ReadNBytes(size, &predicted));
+
+			for (size_t i = 1; i < predicted.size(); ++i)
+				predicted[i] = (char)((unsigned char)predicted[i - 1] + (unsigned char)predicted[i] - 128);
+
+			raw.resize(size);
+			const size_t half = (size + 1) / 2;
+			for (size_t i = 0; i < size; ++i)
+				raw[i] = predicted[i % 2 ? half + i / 2 : i / 2];
+			return TF::Status::OK();
+		}
+
+	} // anonymous namespace
+
+	TF::Status read_exr(const std::string& path, Exr_Image& image) {
+		std::string file;
+		TF_RETURN_IF_ERROR(TF::ReadFileToString(TF::Env::Default(), path, &file));
+
+		size_t position = 0;
+		auto read_int = [&](int& value) {
+			if (position + 4 > file.size())
+				return false;
+			memcpy(&value, file.data() + position, 4);
+			position += 4;
+			return true;
+		};
+		auto read_string = [&](std::string& value) {
+			size_t end = file.find('\0', position);
+			if (end == std::string::npos)
+				return false;
+			value = file.substr(position, end - position);
+			position = end + 1;
+			return true;
+		};
+
+		int magic = 0;
+		int version = 0;
+		if (!read_int(magic) || magic != 20000630 || !read_int(version))
+			return TF::errors::InvalidArgument(path, " is no OpenEXR file");
+		if (version & (0x200 | 0x800 | 0x1000))
+			return TF::errors::Unimplemented(path, " is tiled, deep or multi part");
+
+		std::vector<std::pair<std::string, int>> channels;
+		int compression = -1;
+		int window[4] = { 0, 0, -1, -1 };
+		for (;;) {
+			std::string name, type;
+			int size = 0;
+			if (!read_string(name))
+				return TF::errors::DataLoss(path, " has a broken header");
+			if (name.empty())
+				break;
+			if (!read_string(type) || !read_int(size) || size < 0 || position + size > file.size())
+				return TF::errors::DataLoss(path, " has a broken header");
+
+			const char* value = file.data() + position;
+			if (name == "channels") {
+				for (size_t offset = 0; offset < (size_t)size && value[offset] != '\0';) {
+					std::string channel(value + offset);
+					offset += channel.size() + 1;
+					int pixel_type = 0;
+					int sampling[2] = { 0, 0 };
+					memcpy(&pixel_type, value + offset, 4);
+					memcpy(sampling, value + offset + 8, 8);
+					offset += 16;
+					if (sampling[0] != 1 || sampling[1] != 1)
+						return TF::errors::Unimplemented(path, " has subsampled channels");
+					channels.push_back({ channel, pixel_type });
+				}
+			}
+			else if (name == "compression")
+				compression = (unsigned char)value[0];
+			else if (name == "dataWindow")
+				memcpy(window, value, sizeof(window));
+			position += size;
+		}
+
+		// No compression, zip compression of single lines and of blocks of 16 lines
+		const int lines_per_chunk = compression == 3 ? 16 : 1;
+		if (compression != 0 && compression != 2 && compression != 3)
+			return TF::errors::Unimplemented(path, " uses compression ", compression);
+
+		image.width = window[2] - window[0] + 1;
+		image.height = window[3] - window[1] + 1;
+		if (image.width <= 0 || image.height <= 0 || channels.empty())
+			return TF::errors::DataLoss(path, " has no pixels");
+		for (const auto& channel : channels)
+			image.channels[channel.first].resize((size_t)image.width * image.height);
+
+		const int chunks = (image.height + lines_per_chunk - 1) / lines_per_chunk;
+		const size_t offsets = position;
+		if (offsets + 8 * (size_t)chunks > file.size())
+			return TF::errors::DataLoss(path, " has a broken offset table");
+		for (int chunk = 0; chunk < chunks; ++chunk) {
+			TF::uint64 offset = 0;
+			memcpy(&offset, file.data() + offsets + 8 * chunk, 8);
+			position = (size_t)offset;
+			int y = 0;
+			int size = 0;
+			if (!read_int(y) || !read_int(size) || size < 0 || position + size > file.size())
+				return TF::errors::DataLoss(path, " has a broken chunk");
+			y -= window[1];
+
+			const int lines = std::min(lines_per_chunk, image.height - y);
+			size_t raw_size = 0;
+			for (const auto& channel : channels)
+				raw_size += (size_t)image.width * lines * (channel.second == 1 ? 2 : 4);
+
+			// Chunks which do not get smaller are stored as they are
+			std::string raw;
+			TF::StringPiece data(file.data() + position, size);
+			if (compression != 0 && (size_t)size < raw_size)
+				TF_RETURN_IF_ERROR(inflate_exr_chunk(data, raw_size, raw));
+			else
+				raw.assign(data.data(), data.size());
+			if (raw.size() != raw_size || y < 0 || y >= image.height)
+				return TF::errors::DataLoss(path, " has a chunk of the wrong size");
+
+			// Every line holds the channels one after the other in the order of the header
+			const char* src = raw.data();
+			for (int line = 0; line < lines; ++line) {
+				for (const auto& channel : channels) {
+					float* dest = image.channels[channel.first].data() + (size_t)(y + line) * image.width;
+					for (int x = 0; x < image.width; ++x) {
+						if (channel.second == 1) {
+							uint16_t half;
+							memcpy(&half, src, 2);
+							dest[x] = half_to_float(half);
+							src += 2;
+						}
+						else if (channel.second == 2) {
+							memcpy(&dest[x], src, 4);
+							src += 4;
+						}
+						else {
+							uint32_t value;
+							memcpy(&value, src, 4);
+							dest[x] = (float)value;
+							src += 4;
+						}
+					}
+				}
+			}
+		}
+		return TF::Status::OK();
+	}
+
+} // namespace tests
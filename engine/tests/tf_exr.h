@@ -0,0 +1,22 @@
+#pragma once
+
+#include "tensorflow/core/lib/core/status.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Just enough of OpenEXR for the images the network was trained on, single part scanline files without compression or
+// with zip compression and channels without subsampling
+
+namespace tests {
+
+	struct Exr_Image
+	{
+		int width = 0;
+		int height = 0;
+		std::map<std::string, std::vector<float>> channels;
+	};
+
+	tensorflow::Status read_exr(const std::string& path, Exr_Image& image);
+
+} // namespace tests
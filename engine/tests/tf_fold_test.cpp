@@ -0,0 +1,78 @@
+#include "tf_test_support.h"
+#include <cstdio>
+
+// Runs the network with and without the folded transposes. Without folding the NWHC ops read and write the rows of the
+// surfaces densely into a (width, height) tensor, for non square sizes that is not the transposed image but its rows
+// laid out again. The unfolded run therefore gets the surfaces with the pixels stored column by column, which the NWHC
+// ops read as the transposed image, and its output comes back in the same order. Both runs then have to agree at every
+// size, square or not.
+
+using namespace tests;
+
+namespace {
+
+	// Stores the pixels of a width x height image column by column
+	template <typename T>
+	std::vector<T> columns_of(const std::vector<T>& image, unsigned width, unsigned height, unsigned channels) {
+		std::vector<T> result(image.size());
+		for (unsigned y = 0; y < height; ++y)
+			for (unsigned x = 0; x < width; ++x)
+				for (unsigned channel = 0; channel < channels; ++channel)
+					result[((size_t)x * height + y) * channels + channel] = image[((size_t)y * width + x) * channels + channel];
+		return result;
+	}
+
+	TF::Status run_folded(const TF::GraphDef& network, const Resolution& resolution, const Test_Options& options, bool fold, Synthetic_Frame& frame, std::vector<float>& output) {
+		Network_Session session;
+		TF_RETURN_IF_ERROR(create_network_session(network, resolution.width, resolution.height, 1, options, session, fold));
+		PLUGIN_NAMESPACE::CUDA_transfer_data data;
+		bind_host_surfaces(data, frame.normals.data(), frame.depth.data(), (size_t)resolution.width * 4, output.data(), (size_t)resolution.width * sizeof(float));
+		return run_session(session, data);
+	}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+	Test_Options options;
+	std::vector<std::string> rest;
+	parse_test_options(argc, argv, options, rest);
+	setup();
+
+	TF::GraphDef network;
+	TF::Status status = read_network(options.graph_path, network);
+
+	bool passed = true;
+	for (const Resolution& resolution : { RESOLUTIONS[0], RESOLUTIONS[1], RESOLUTIONS[2] }) {
+		if (!status.ok())
+			break;
+
+		const size_t pixels = (size_t)resolution.width * resolution.height;
+		Synthetic_Frame frame;
+		render_default(resolution.width, resolution.height, frame);
+		std::vector<float> folded(pixels);
+		status = run_folded(network, resolution, options, true, frame, folded);
+
+		Synthetic_Frame columns;
+		columns.normals = columns_of(frame.normals, resolution.width, resolution.height, 4);
+		columns.depth = columns_of(frame.depth, resolution.width, resolution.height, 1);
+		std::vector<float> unfolded(pixels);
+		if (status.ok())
+			status = run_folded(network, resolution, options, false, columns, unfolded);
+		if (!status.ok())
+			break;
+
+		// The folded result stored column by column is what the unfolded run wrote
+		const double error = max_absolute_error(columns_of(folded, resolution.width, resolution.height, 1), unfolded);
+		const bool fold_passed = error <= 1e-4;
+		fprintf(stderr, "Folded transposes at %ux%u, max error against the unfolded network %.6f %s\n",
+			resolution.width, resolution.height, error, fold_passed ? "" : "FAILED");
+		passed = fold_passed && passed;
+	}
+	if (!status.ok()) {
+		fprintf(stderr, "%s\n", status.ToString().c_str());
+		return 1;
+	}
+
+	fprintf(stderr, "Fold check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include "../tf_interactive_io.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Round trips normals all over the sphere and every normal the 8 bit target holds through the octahedral codec of the
+// three channel input. The encoded normal stays in float in the tensor, so only the float precision of the codec adds
+// to the error of the target.
+
+namespace {
+
+	// Angle between two vectors, the cross product keeps it precise for nearly equal ones
+	double angle_between(double x, double y, double z, double other_x, double other_y, double other_z) {
+		double cross_x = y * other_z - z * other_y;
+		double cross_y = z * other_x - x * other_z;
+		double cross_z = x * other_y - y * other_x;
+		return std::atan2(std::sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z), x * other_x + y * other_y + z * other_z);
+	}
+
+} // anonymous namespace
+
+int main() {
+	const double max_error = 1e-5;
+	bool passed = true;
+
+	// Fibonacci points cover the sphere evenly, the axes and diagonals are where the folding switches sides
+	const int points = 1 << 18;
+	double sphere_error = 0.0;
+	std::vector<std::vector<float>> normals;
+	for (int i = 0; i < points; ++i) {
+		double z = 1.0 - 2.0 * (i + 0.5) / points;
+		double radius = std::sqrt(1.0 - z * z);
+		double phi = i * 2.399963229728653;
+		normals.push_back({ (float)(radius * std::cos(phi)), (float)(radius * std::sin(phi)), (float)z });
+	}
+	const float diagonal = 0.57735027f;
+	for (float x : { -1.0f, 0.0f, 1.0f })
+		for (float y : { -1.0f, 0.0f, 1.0f })
+			for (float z : { -1.0f, 0.0f, 1.0f })
+				if (x != 0.0f || y != 0.0f || z != 0.0f)
+					normals.push_back({ x * diagonal, y * diagonal, z * diagonal });
+
+	for (const std::vector<float>& normal : normals) {
+		float u, v, x, y, z;
+		octahedral_encode(normal[0], normal[1], normal[2], u, v);
+		octahedral_decode(u, v, x, y, z);
+		sphere_error = std::max(sphere_error, angle_between(normal[0], normal[1], normal[2], x, y, z));
+		passed = passed && u >= -1.0f && u <= 1.0f && v >= -1.0f && v <= 1.0f;
+	}
+
+	// Every normal the target can hold, vectors far off unit length are no normals and skipped
+	double target_error = 0.0;
+	for (int r = 0; r < 256; ++r) {
+		for (int g = 0; g < 256; ++g) {
+			for (int b = 0; b < 256; ++b) {
+				const unsigned char pixel[4] = { (unsigned char)r, (unsigned char)g, (unsigned char)b, 255 };
+				double expected[3] = { r / 127.5 - 1.0, g / 127.5 - 1.0, b / 127.5 - 1.0 };
+				double length = std::sqrt(expected[0] * expected[0] + expected[1] * expected[1] + expected[2] * expected[2]);
+				if (length < 0.9 || length > 1.1)
+					continue;
+
+				float u, v, x, y, z;
+				octahedral_normal(pixel, u, v);
+				octahedral_decode(u * 2.0f - 1.0f, v * 2.0f - 1.0f, x, y, z);
+				target_error = std::max(target_error, angle_between(expected[0], expected[1], expected[2], x, y, z));
+				passed = passed && u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f;
+			}
+		}
+	}
+
+	passed = passed && sphere_error < max_error && target_error < max_error;
+	fprintf(stderr, "Octahedral round trip error %.3g rad on the sphere, %.3g rad for the 8 bit target\n", sphere_error, target_error);
+	fprintf(stderr, "Octahedral check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+#include "../tf_pipeline.h"
+#include <algorithm>
+#include <cstdio>
+
+// Drives the frame pipeline with a fake device that finishes work only when it is waited for. It checks that every result
+// belongs to the frame it is due in, that a slot is never staged while the device still works on it and that skipped or
+// flushed results get recycled instead of leaking slots.
+
+namespace {
+
+	struct Fake_Device
+	{
+		bool busy[PLUGIN_NAMESPACE::MAX_PIPELINE_SLOTS] = {};
+		uint64_t output[PLUGIN_NAMESPACE::MAX_PIPELINE_SLOTS] = {};
+		uint64_t pending[PLUGIN_NAMESPACE::MAX_PIPELINE_SLOTS] = {};
+		unsigned submits = 0;
+		unsigned waits = 0;
+		unsigned errors = 0;
+
+		void submit(unsigned slot, uint64_t frame) {
+			if (busy[slot]) {
+				fprintf(stderr, "frame %llu submitted to busy slot %u\n", (unsigned long long)frame, slot);
+				++errors;
+			}
+			busy[slot] = true;
+			pending[slot] = frame;
+			++submits;
+		}
+
+		// The output of a slot only changes once its work finished
+		void wait(unsigned slot) {
+			if (!busy[slot]) {
+				fprintf(stderr, "wait on idle slot %u\n", slot);
+				++errors;
+			}
+			busy[slot] = false;
+			output[slot] = pending[slot];
+			++waits;
+		}
+
+		unsigned busy_slots() const {
+			unsigned count = 0;
+			for (bool slot_busy : busy)
+				count += slot_busy ? 1 : 0;
+			return count;
+		}
+	};
+
+	typedef PLUGIN_NAMESPACE::FramePipeline<Fake_Device> Pipeline;
+
+	bool check(bool condition, const char* message, unsigned depth, uint64_t frame) {
+		if (!condition)
+			fprintf(stderr, "depth %u frame %llu: %s\n", depth, (unsigned long long)frame, message);
+		return condition;
+	}
+
+	// Every frame gets staged, submitted and consumed, the result of frame N - depth is due in frame N
+	bool check_ordering(unsigned depth) {
+		const uint64_t frames = 20;
+		Pipeline pipeline(depth);
+		bool passed = true;
+		for (uint64_t frame = 0; frame < frames; ++frame) {
+			const unsigned slot = pipeline.stage();
+			passed &= check(slot == frame % (depth + 1), "staged the wrong slot", depth, frame);
+			passed &= check(!pipeline.device.busy[slot], "staged a slot the device still works on", depth, frame);
+			pipeline.submit();
+
+			unsigned result_slot = 0;
+			uint64_t result_frame = 0;
+			const bool has_result = pipeline.consume(result_slot, result_frame);
+			passed &= check(has_result == (frame >= depth), "result due at the wrong frame", depth, frame);
+			if (has_result) {
+				passed &= check(result_frame == frame - depth, "consumed the wrong frame", depth, frame);
+				passed &= check(pipeline.device.output[result_slot] == result_frame, "output of the slot belongs to another frame", depth, frame);
+			}
+			passed &= check(pipeline.device.busy_slots() == std::min<uint64_t>(depth, frame + 1), "wrong number of frames in flight", depth, frame);
+		}
+		passed &= check(pipeline.frames_consumed() == frames - depth, "lost results", depth, frames);
+
+		pipeline.flush();
+		passed &= check(pipeline.device.busy_slots() == 0, "flush left work in flight", depth, frames);
+		passed &= check(pipeline.device.submits == pipeline.device.waits, "submits and waits differ", depth, frames);
+		passed &= check(pipeline.device.errors == 0, "device misused", depth, frames);
+		return passed;
+	}
+
+	// A frame that does not consume leaves its result in flight, the next stage of that slot waits for it and the stale
+	// result is never handed out
+	bool check_recycling(unsigned depth) {
+		Pipeline pipeline(depth);
+		bool passed = true;
+		unsigned slot = 0;
+		uint64_t result_frame = 0;
+		for (uint64_t frame = 0; frame < 12; ++frame) {
+			pipeline.stage();
+			pipeline.submit();
+			if (frame % 3 == 1)
+				continue;
+			if (pipeline.consume(slot, result_frame)) {
+				passed &= check(result_frame == frame - depth, "consumed the wrong frame", depth, frame);
+				passed &= check(pipeline.device.output[slot] == result_frame, "output of the slot belongs to another frame", depth, frame);
+			}
+		}
+		passed &= check(pipeline.frames_consumed() < pipeline.frames_submitted() - depth, "skipped results were consumed", depth, 12);
+
+		// Changing the depth drops the results in flight and starts over
+		pipeline.set_latency_depth(depth == 0 ? 1 : depth - 1);
+		passed &= check(pipeline.device.busy_slots() == 0, "depth change left work in flight", depth, 12);
+		passed &= check(pipeline.frames_submitted() == 0, "depth change kept the frame count", depth, 12);
+		passed &= check(!pipeline.consume(slot, result_frame), "result after a depth change", depth, 12);
+		pipeline.stage();
+		pipeline.submit();
+		pipeline.flush();
+
+		passed &= check(pipeline.device.submits == pipeline.device.waits, "submits and waits differ", depth, 12);
+		passed &= check(pipeline.device.errors == 0, "device misused", depth, 12);
+		return passed;
+	}
+
+} // anonymous namespace
+
+int main() {
+	bool passed = true;
+	for (unsigned depth = 0; depth <= PLUGIN_NAMESPACE::MAX_LATENCY_DEPTH; ++depth) {
+		const bool ordering = check_ordering(depth);
+		const bool recycling = check_recycling(depth);
+		printf("depth %u: ordering %s, recycling %s\n", depth, ordering ? "ok" : "FAILED", recycling ? "ok" : "FAILED");
+		passed &= ordering && recycling;
+	}
+
+	// Depths over the maximum are clamped, the ring never grows past the slots the plugin allocates
+	Pipeline clamped(PLUGIN_NAMESPACE::MAX_LATENCY_DEPTH + 5);
+	if (clamped.slot_count() != PLUGIN_NAMESPACE::MAX_PIPELINE_SLOTS) {
+		fprintf(stderr, "latency depth was not clamped\n");
+		passed = false;
+	}
+	return passed ? 0 : 1;
+}
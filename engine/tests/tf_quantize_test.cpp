@@ -0,0 +1,89 @@
+#include "../tf_kernel.h"
+#include "../tf_resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Writes a ramp through the cpu output functor in every output format and reads it back. Every format has to match the
+// scalar conversion of the gpu kernels byte for byte. R8 has to stay within half a step of the clamped value, R16F
+// within 2^-11 of the value and R32F exact. The R32F fallback of the copy-out has to give back what the quantized buffer holds.
+
+namespace {
+
+	// Wider than one chunk of the functor and not a multiple of the vector width, so the tails get converted too
+	const int WIDTH = 301;
+	const int HEIGHT = 5;
+
+	// Covers (0, 1) and goes a bit past both ends to check the R8 clamping
+	float ramp(int x, int y) {
+		return -0.05f + 1.1f * (float)(y * WIDTH + x) / (WIDTH * HEIGHT - 1);
+	}
+
+	double allowed_error(int format, float value) {
+		if (format == PixelR8)
+			return 0.5 / 255.0 + 1e-6;
+		if (format == PixelR16F)
+			return std::max(std::abs(value) / 2048.0, 6e-8);
+		return 0.0;
+	}
+
+	bool check_format(Eigen::ThreadPoolDevice& device, int format, const char* name) {
+		std::vector<float> tensor((size_t)WIDTH * HEIGHT);
+		for (int y = 0; y < HEIGHT; ++y)
+			for (int x = 0; x < WIDTH; ++x)
+				tensor[(size_t)y * WIDTH + x] = ramp(x, y);
+
+		// The output buffer has a pitch larger than a row like the buffers of the sessions
+		const size_t size = pixel_size(format);
+		const size_t pitch = WIDTH * size + 64;
+		std::vector<unsigned char> output(pitch * HEIGHT);
+		InteractiveOutputFunctor<Eigen::ThreadPoolDevice, float>()(device, WIDTH, HEIGHT, WIDTH, pitch, format, tensor.data(), output.data());
+
+		std::vector<float> widened((size_t)WIDTH * HEIGHT);
+		const Convert_Surfaces surfaces = { output.data(), pitch, format, (unsigned char*)widened.data(), WIDTH * sizeof(float), PixelR32F };
+		PLUGIN_NAMESPACE::TFResample::convert_cpu(resample_params(WIDTH, HEIGHT, 1), surfaces);
+
+		double error = 0.0;
+		unsigned failures = 0;
+		for (int y = 0; y < HEIGHT; ++y) {
+			for (int x = 0; x < WIDTH; ++x) {
+				const unsigned char* pixel = output.data() + y * pitch + x * size;
+				const float value = ramp(x, y);
+				const float expected = format == PixelR8 ? std::min(std::max(value, 0.0f), 1.0f) : value;
+				const float decoded = decode_output(format, pixel);
+				error = std::max(error, (double)std::abs(decoded - expected));
+
+				// The cpu functor shares the scalar conversions with the gpu kernels, every format has to match byte for byte
+				unsigned char scalar[4];
+				encode_output(format, value, scalar);
+				const bool same_bits = memcmp(scalar, pixel, size) == 0;
+				const bool in_range = std::abs(decoded - expected) <= allowed_error(format, expected);
+				const bool widened_back = widened[(size_t)y * WIDTH + x] == decoded;
+				if (!same_bits || !in_range || !widened_back) {
+					if (failures++ < 4)
+						fprintf(stderr, "%s pixel %d,%d: value %.7f read back %.7f, widened %.7f%s\n", name, x, y, value, decoded,
+							widened[(size_t)y * WIDTH + x], same_bits ? "" : ", differs from the scalar quantization");
+				}
+			}
+		}
+
+		fprintf(stderr, "%-4s max error %.7f %s\n", name, error, failures == 0 ? "" : "FAILED");
+		return failures == 0;
+	}
+
+} // anonymous namespace
+
+int main() {
+	Eigen::ThreadPool pool(2);
+	Eigen::ThreadPoolDevice device(&pool, 2);
+
+	bool passed = true;
+	passed = check_format(device, PixelR8, "R8") && passed;
+	passed = check_format(device, PixelR16F, "R16F") && passed;
+	passed = check_format(device, PixelR32F, "R32F") && passed;
+
+	fprintf(stderr, "Quantize check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include "tf_synthetic_scene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Moves the camera through the synthetic room, reprojects the occlusion of the first view into the second one and
+// compares it with the occlusion rendered from there
+
+using namespace tests;
+
+namespace {
+
+	// Resolves the first view with its occlusion as the network result and reprojects it into the second view, where the
+	// history has to match the occlusion rendered from there. Pixels next to a corner blend both surfaces, which only shows
+	// in the maximum error.
+	bool check_reprojection_case(const char* name, const Synthetic_Camera& first, const Synthetic_Camera& second, int width, int height,
+		double min_valid, double max_valid, double max_mean_error, double max_error) {
+		Synthetic_Frame first_frame, second_frame;
+		render_synthetic(first, width, height, first_frame);
+		render_synthetic(second, width, height, second_frame);
+
+		Temporal_History temporal(width, height);
+		Temporal_Camera first_camera = PLUGIN_NAMESPACE::TFTemporal::camera(first.pose, first.projection);
+		Temporal_Camera second_camera = PLUGIN_NAMESPACE::TFTemporal::camera(second.pose, second.projection);
+
+		Reproject_Params params = PLUGIN_NAMESPACE::TFTemporal::reproject_params(first_camera, first_camera, width, height, false, 1.0f);
+		Temporal_Surfaces surfaces = temporal.surfaces(first_frame, &first_frame.occlusion);
+		PLUGIN_NAMESPACE::TFTemporal::reproject_cpu(params, surfaces);
+		PLUGIN_NAMESPACE::TFTemporal::resolve_cpu(params, surfaces);
+		temporal.advance(first_frame, first_camera);
+
+		params = PLUGIN_NAMESPACE::TFTemporal::reproject_params(second_camera, temporal.previous_camera, width, height, true, 1.0f);
+		surfaces = temporal.surfaces(second_frame, nullptr);
+		const unsigned invalid = PLUGIN_NAMESPACE::TFTemporal::reproject_cpu(params, surfaces);
+
+		double error = 0.0;
+		double error_sum = 0.0;
+		size_t compared = 0;
+		const std::vector<float>& reprojected = temporal.history[1 - temporal.current];
+		for (size_t i = 0; i < reprojected.size(); ++i) {
+			if (reprojected[i] < 0.0f)
+				continue;
+			error = std::max(error, (double)std::abs(reprojected[i] - second_frame.occlusion[i]));
+			error_sum += std::abs(reprojected[i] - second_frame.occlusion[i]);
+			++compared;
+		}
+
+		const double valid = 1.0 - (double)invalid / ((size_t)width * height);
+		const double mean_error = error_sum / std::max<size_t>(compared, 1);
+		const bool passed = valid >= min_valid && valid <= max_valid && mean_error <= max_mean_error && error <= max_error && compared > 0;
+		fprintf(stderr, "%-10s valid %6.2f%%, mean error %.5f, max error %.5f over %zu pixels %s\n", name, 100.0 * valid, mean_error, error, compared, passed ? "" : "FAILED");
+		return passed;
+	}
+
+} // anonymous namespace
+
+int main() {
+	const int width = 640;
+	const int height = 368;
+	const float aspect = (float)width / height;
+	const float position[3] = { -1.0f, -8.0f, 2.0f };
+	const float moved[3] = { -0.8f, -7.9f, 2.05f };
+	const float beside[3] = { 4.0f, -8.0f, 2.0f };
+
+	Synthetic_Camera still = synthetic_camera(position, 0.1f, -0.15f, aspect);
+	bool passed = true;
+
+	// The same view has to give the history back, a small move keeps most of it, a large one uncovers a lot
+	passed = check_reprojection_case("still", still, still, width, height, 1.0, 1.0, 1e-5, 1e-4) && passed;
+	passed = check_reprojection_case("small", still, synthetic_camera(moved, 0.12f, -0.14f, aspect), width, height, 0.9, 1.0, 2e-3, 0.06) && passed;
+	passed = check_reprojection_case("rotate", still, synthetic_camera(position, 0.2f, -0.15f, aspect), width, height, 0.8, 0.99, 2e-3, 0.06) && passed;
+	passed = check_reprojection_case("large", still, synthetic_camera(beside, -0.4f, -0.15f, aspect), width, height, 0.0, 0.9, 2e-3, 0.06) && passed;
+
+	fprintf(stderr, "Reprojection check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+#include "tf_synthetic_scene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace tests {
+
+	const float DEFAULT_CAMERA_POSITION[3] = { -1.0f, -8.0f, 2.0f };
+
+	Synthetic_Camera synthetic_camera(const float position[3], float yaw, float pitch, float aspect) {
+		const float forward[3] = { std::sin(yaw) * std::cos(pitch), std::cos(yaw) * std::cos(pitch), std::sin(pitch) };
+		const float right[3] = { std::cos(yaw), -std::sin(yaw), 0.0f };
+		const float up[3] = { right[1] * forward[2] - right[2] * forward[1], right[2] * forward[0] - right[0] * forward[2], right[0] * forward[1] - right[1] * forward[0] };
+
+		Synthetic_Camera camera = {};
+		for (int i = 0; i < 3; ++i) {
+			camera.pose[i] = right[i];
+			camera.pose[4 + i] = forward[i];
+			camera.pose[8 + i] = up[i];
+			camera.pose[12 + i] = position[i];
+		}
+		camera.pose[15] = 1.0f;
+
+		// 60 degrees vertical field of view, clip w is the distance along the view direction
+		const float near_range = 0.1f;
+		const float far_range = 1000.0f;
+		const float scale_y = 1.0f / std::tan(0.5236f);
+		camera.projection[0] = scale_y / aspect;
+		camera.projection[6] = far_range / (far_range - near_range);
+		camera.projection[7] = 1.0f;
+		camera.projection[9] = scale_y;
+		camera.projection[14] = -near_range * far_range / (far_range - near_range);
+		return camera;
+	}
+
+	namespace {
+
+		float synthetic_occlusion(const float position[3]) {
+			return 0.5f + 0.25f * std::sin(1.3f * position[0]) * std::cos(1.7f * position[1]) + 0.2f * std::exp(-position[2]);
+		}
+
+	} // anonymous namespace
+
+	void render_synthetic(const Synthetic_Camera& camera, int width, int height, Synthetic_Frame& frame) {
+		const size_t pixels = (size_t)width * height;
+		frame.normals.assign(pixels * 4, 0);
+		frame.depth.assign(pixels, 1000.0f);
+		frame.occlusion.assign(pixels, 1.0f);
+
+		const float scale_x = camera.projection[0];
+		const float scale_y = camera.projection[9];
+		const float* origin = camera.pose + 12;
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				// The ray has a view y of one, so its parameter at a hit is the linear depth
+				const float view[3] = { ((x + 0.5f) / width * 2.0f - 1.0f) / scale_x, 1.0f, (1.0f - (y + 0.5f) / height * 2.0f) / scale_y };
+				float direction[3];
+				for (int i = 0; i < 3; ++i)
+					direction[i] = view[0] * camera.pose[i] + view[1] * camera.pose[4 + i] + view[2] * camera.pose[8 + i];
+
+				float depth = 1000.0f;
+				float normal[3] = { 0.0f, 0.0f, 1.0f };
+				// Floor and three walls of a room around the objects, the camera looks at the far wall so nothing shows the sky
+				const float planes[4][4] = { { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f, -6.0f }, { 1.0f, 0.0f, 0.0f, -6.0f }, { -1.0f, 0.0f, 0.0f, -6.0f } };
+				for (const float* plane : planes) {
+					const float facing = plane[0] * direction[0] + plane[1] * direction[1] + plane[2] * direction[2];
+					if (facing >= 0.0f)
+						continue;
+					const float t = (plane[3] - (plane[0] * origin[0] + plane[1] * origin[1] + plane[2] * origin[2])) / facing;
+					if (t > 0.0f && t < depth) {
+						depth = t;
+						for (int i = 0; i < 3; ++i)
+							normal[i] = plane[i];
+					}
+				}
+
+				const float center[3] = { 0.0f, 0.0f, 1.0f };
+				float offset[3] = { origin[0] - center[0], origin[1] - center[1], origin[2] - center[2] };
+				float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+				float b = offset[0] * direction[0] + offset[1] * direction[1] + offset[2] * direction[2];
+				float c = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] - 1.0f;
+				float discriminant = b * b - a * c;
+				if (discriminant > 0.0f) {
+					const float t = (-b - std::sqrt(discriminant)) / a;
+					if (t > 0.0f && t < depth) {
+						depth = t;
+						for (int i = 0; i < 3; ++i)
+							normal[i] = origin[i] + t * direction[i] - center[i];
+					}
+				}
+
+				// Axis aligned box from (2, 1, 0) to (3, 2, 1.5) with the slab test
+				const float box_min[3] = { 2.0f, 1.0f, 0.0f };
+				const float box_max[3] = { 3.0f, 2.0f, 1.5f };
+				float enter = 0.0f, leave = 1e30f;
+				int axis = -1;
+				float sign = 1.0f;
+				for (int i = 0; i < 3 && enter <= leave; ++i) {
+					if (std::abs(direction[i]) < 1e-12f) {
+						if (origin[i] < box_min[i] || origin[i] > box_max[i])
+							leave = -1.0f;
+						continue;
+					}
+					float near_t = (box_min[i] - origin[i]) / direction[i];
+					float far_t = (box_max[i] - origin[i]) / direction[i];
+					float near_sign = -1.0f;
+					if (near_t > far_t) {
+						std::swap(near_t, far_t);
+						near_sign = 1.0f;
+					}
+					if (near_t > enter) {
+						enter = near_t;
+						axis = i;
+						sign = near_sign;
+					}
+					leave = std::min(leave, far_t);
+				}
+				if (axis >= 0 && enter <= leave && enter < depth) {
+					depth = enter;
+					normal[0] = normal[1] = normal[2] = 0.0f;
+					normal[axis] = sign;
+				}
+
+				const size_t index = (size_t)y * width + x;
+				frame.depth[index] = depth;
+				if (depth < 1000.0f) {
+					float position[3];
+					for (int i = 0; i < 3; ++i)
+						position[i] = origin[i] + depth * direction[i];
+					frame.occlusion[index] = synthetic_occlusion(position);
+				}
+
+				// View space normal, the transposed rotation of the pose takes it from world space
+				const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				for (int i = 0; i < 3; ++i) {
+					const float component = (normal[0] * camera.pose[4 * i] + normal[1] * camera.pose[4 * i + 1] + normal[2] * camera.pose[4 * i + 2]) / length;
+					frame.normals[4 * index + i] = quantize_byte(component * 0.5f + 0.5f);
+				}
+				frame.normals[4 * index + 3] = 255;
+			}
+		}
+	}
+
+	void render_default(unsigned width, unsigned height, Synthetic_Frame& frame) {
+		render_synthetic(synthetic_camera(DEFAULT_CAMERA_POSITION, DEFAULT_CAMERA_YAW, DEFAULT_CAMERA_PITCH, (float)width / height), width, height, frame);
+	}
+
+	void disturb_frame(Synthetic_Frame& frame, unsigned frame_width, unsigned x, unsigned y, unsigned width, unsigned height) {
+		for (unsigned row = y; row < y + height; ++row) {
+			for (unsigned column = x; column < x + width; ++column) {
+				const size_t index = (size_t)row * frame_width + column;
+				frame.depth[index] *= 0.8f;
+				frame.normals[4 * index + 0] = 128;
+				frame.normals[4 * index + 1] = 128;
+				frame.normals[4 * index + 2] = 255;
+			}
+		}
+	}
+
+	std::vector<Camera_Path> builtin_camera_paths() {
+		const int frames = 120;
+		std::vector<Camera_Path> paths = { { "still", {} }, { "orbit", {} }, { "walk", {} }, { "pan", {} } };
+		for (int frame = 0; frame < frames; ++frame) {
+			const float time = (float)frame / frames;
+			const float angle = -0.3f + 0.6f * time;
+			paths[0].keys.push_back({ { -1.0f, -8.0f, 2.0f }, 0.1f, -0.15f });
+			paths[1].keys.push_back({ { 8.0f * std::sin(angle), -8.0f * std::cos(angle), 2.0f }, -angle, -0.15f });
+			paths[2].keys.push_back({ { -1.0f + time, -8.0f + 3.0f * time, 2.0f - 0.5f * time }, 0.1f + 0.1f * std::sin(6.2832f * time), -0.15f });
+			paths[3].keys.push_back({ { -1.0f, -8.0f, 2.0f }, -0.6f + 1.2f * time, -0.15f });
+		}
+		return paths;
+	}
+
+	bool read_camera_path(const std::string& path, Camera_Path& camera_path) {
+		std::ifstream file(path);
+		camera_path.name = path;
+		camera_path.keys.clear();
+
+		std::string line;
+		while (std::getline(file, line)) {
+			Camera_Key key;
+			if (sscanf(line.c_str(), "%f %f %f %f %f", &key.position[0], &key.position[1], &key.position[2], &key.yaw, &key.pitch) == 5)
+				camera_path.keys.push_back(key);
+		}
+		return !camera_path.keys.empty();
+	}
+
+	Temporal_History::Temporal_History(int width, int height) : width(width), height(height) {
+		const size_t pixels = (size_t)width * height;
+		previous_normals.assign(pixels * 4, 0);
+		previous_depth.assign(pixels, 0.0f);
+		history[0].assign(pixels, 0.0f);
+		history[1].assign(pixels, 0.0f);
+		output.assign(pixels, 0.0f);
+	}
+
+	Temporal_Surfaces Temporal_History::surfaces(const Synthetic_Frame& frame, const std::vector<float>* network) {
+		Temporal_Surfaces result;
+		result.normals = frame.normals.data();
+		result.depth = frame.depth.data();
+		result.pitch = (size_t)width * 4;
+		result.previous_normals = previous_normals.data();
+		result.previous_depth = previous_depth.data();
+		result.history = history[current].data();
+		result.reprojected = history[1 - current].data();
+		result.previous_pitch = (size_t)width * 4;
+		result.network = network ? (const unsigned char*)network->data() : nullptr;
+		result.network_pitch = (size_t)width * sizeof(float);
+		result.output = (unsigned char*)output.data();
+		result.output_pitch = (size_t)width * sizeof(float);
+		result.output_format = PixelR32F;
+		return result;
+	}
+
+	void Temporal_History::advance(const Synthetic_Frame& frame, const Temporal_Camera& camera) {
+		previous_normals = frame.normals;
+		previous_depth = frame.depth;
+		current = 1 - current;
+		has_history = true;
+		previous_camera = camera;
+	}
+
+} // namespace tests
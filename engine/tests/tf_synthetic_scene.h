@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../tf_temporal.h"
+#include <string>
+#include <vector>
+
+// Ray traced G-buffers of a small room with a sphere and a box standing on the floor. The occlusion is a smooth function
+// of the world position, so the reprojected history of one view can be compared with the frame rendered from another.
+
+namespace tests {
+
+	// A camera of the engine looks along y with z up, the pose has the axes in its rows and the position in the last one
+	struct Synthetic_Camera
+	{
+		float pose[16];
+		float projection[16];
+	};
+
+	struct Synthetic_Frame
+	{
+		std::vector<unsigned char> normals;
+		std::vector<float> depth;
+		std::vector<float> occlusion;
+	};
+
+	struct Camera_Key
+	{
+		float position[3];
+		float yaw;
+		float pitch;
+	};
+
+	struct Camera_Path
+	{
+		std::string name;
+		std::vector<Camera_Key> keys;
+	};
+
+	// The view the tests render their frames from
+	extern const float DEFAULT_CAMERA_POSITION[3];
+	const float DEFAULT_CAMERA_YAW = 0.1f;
+	const float DEFAULT_CAMERA_PITCH = -0.15f;
+
+	Synthetic_Camera synthetic_camera(const float position[3], float yaw, float pitch, float aspect);
+	void render_synthetic(const Synthetic_Camera& camera, int width, int height, Synthetic_Frame& frame);
+
+	// The frame of the default view
+	void render_default(unsigned width, unsigned height, Synthetic_Frame& frame);
+
+	// Something moved inside the rectangle, it got closer and faces the camera now
+	void disturb_frame(Synthetic_Frame& frame, unsigned frame_width, unsigned x, unsigned y, unsigned width, unsigned height);
+
+	// A still view, a slow orbit, a walk towards the objects and a fast pan, 120 frames each
+	std::vector<Camera_Path> builtin_camera_paths();
+
+	// Recorded paths have one frame per line, the position followed by yaw and pitch in radians
+	bool read_camera_path(const std::string& path, Camera_Path& camera_path);
+
+	// History buffers of the temporal reuse on the host, all of them have the same pitch like in the plugin
+	struct Temporal_History
+	{
+		int width;
+		int height;
+		std::vector<unsigned char> previous_normals;
+		std::vector<float> previous_depth;
+		std::vector<float> history[2];
+		std::vector<float> output;
+		unsigned current = 0;
+		bool has_history = false;
+		Temporal_Camera previous_camera;
+
+		Temporal_History(int width, int height);
+		Temporal_Surfaces surfaces(const Synthetic_Frame& frame, const std::vector<float>* network);
+
+		// The resolved frame becomes the history of the next one
+		void advance(const Synthetic_Frame& frame, const Temporal_Camera& camera);
+	};
+
+} // namespace tests
@@ -0,0 +1,211 @@
+#include "tf_test_support.h"
+#include "tensorflow/core/platform/env.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace tests {
+
+	const Resolution RESOLUTIONS[7] = { { 512, 256 }, { 512, 512 }, { 640, 368 }, { 768, 512 }, { 960, 512 }, { 1024, 1024 }, { 1920, 1072 } };
+
+	void parse_test_options(int argc, char** argv, Test_Options& options, std::vector<std::string>& rest) {
+		for (int i = 1; i < argc; ++i) {
+			const bool has_value = i + 1 < argc;
+			if (strcmp(argv[i], "--graph") == 0 && has_value)
+				options.graph_path = argv[++i];
+			else if (strcmp(argv[i], "--runs") == 0 && has_value)
+				options.runs = std::max(1, atoi(argv[++i]));
+			else if (strcmp(argv[i], "--warmup") == 0 && has_value)
+				options.warmup = std::max(0, atoi(argv[++i]));
+			else if (strcmp(argv[i], "--threads") == 0 && has_value)
+				options.threads = std::max(0, atoi(argv[++i]));
+			else
+				rest.push_back(argv[i]);
+		}
+	}
+
+	void setup() {
+		PLUGIN_NAMESPACE::setup_kernels();
+		TF::EnableCPUAllocatorStats(true);
+	}
+
+	TF::Status read_network(const std::string& path, TF::GraphDef& network) {
+		TF_RETURN_IF_ERROR(TF::ReadBinaryProto(TF::Env::Default(), path, &network));
+		for (TF::NodeDef& node : *network.mutable_node())
+			node.clear_device();
+		return TF::Status::OK();
+	}
+
+	double median_ms(std::vector<double> times) {
+		std::sort(times.begin(), times.end());
+		return times.empty() ? 0.0 : times[times.size() / 2];
+	}
+
+	double max_absolute_error(const std::vector<float>& values, const std::vector<float>& reference) {
+		double error = 0.0;
+		for (size_t i = 0; i < values.size(); ++i)
+			error = std::max(error, std::abs((double)values[i] - reference[i]));
+		return error;
+	}
+
+	double mean_absolute_error(const std::vector<float>& values, const std::vector<float>& reference) {
+		double sum = 0.0;
+		for (size_t i = 0; i < values.size(); ++i)
+			sum += std::abs((double)values[i] - reference[i]);
+		return values.empty() ? 0.0 : sum / values.size();
+	}
+
+	double mean_squared_error(const std::vector<float>& values, const std::vector<float>& reference) {
+		double sum = 0.0;
+		for (size_t i = 0; i < values.size(); ++i)
+			sum += ((double)values[i] - reference[i]) * ((double)values[i] - reference[i]);
+		return values.empty() ? 0.0 : sum / values.size();
+	}
+
+	double psnr(double mse) {
+		return mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : INFINITY;
+	}
+
+	std::string output_node(const TF::GraphDef& graph) {
+		for (const TF::NodeDef& node : graph.node()) {
+			if (node.op() == "InteractiveOutput" || node.op() == "InteractiveDepthOutput")
+				return node.name();
+			if (node.op() == "InteractiveIO" && node.attr().count("mode") && node.attr().at("mode").s() == "scatter")
+				return node.name();
+		}
+		return std::string();
+	}
+
+	TF::Tensor input_tensor(const Resolution& resolution, int channels) {
+		TF::Tensor tensor(TF::DT_FLOAT, TF::TensorShape({ 1, resolution.width, resolution.height, channels }));
+		auto values = tensor.flat<float>();
+		for (TF::int64 i = 0; i < values.size(); ++i)
+			values(i) = (float)(i % 251) / 251.0f;
+		return tensor;
+	}
+
+	TF::int64 cpu_allocations() {
+		TF::AllocatorStats stats;
+		TF::cpu_allocator()->GetStats(&stats);
+		return stats.num_allocs;
+	}
+
+	TF::Status create_session(const TF::GraphDef& graph, const Test_Options& options, std::unique_ptr<TF::Session>& session, PLUGIN_NAMESPACE::TFBinding** binding) {
+		TF::SessionOptions session_options;
+		(*session_options.config.mutable_device_count())["GPU"] = 0;
+		session_options.config.set_allow_soft_placement(true);
+		if (options.threads > 0)
+			session_options.config.set_intra_op_parallelism_threads(options.threads);
+
+		session.reset(TF::NewSession(session_options));
+		TF_RETURN_IF_ERROR(session->Create(graph));
+		return PLUGIN_NAMESPACE::TFBinding::create(session.get(), PLUGIN_NAMESPACE::DEFAULT_BINDING_NAME, binding);
+	}
+
+	void bind_host_surfaces(PLUGIN_NAMESPACE::CUDA_transfer_data& data, void* normals, void* depth, size_t pitch, void* output, size_t output_pitch) {
+		data._input_memory = normals;
+		data._depth_memory = depth;
+		data._output_memory = output;
+		data._pitch = pitch;
+		data._output_pitch = output_pitch;
+		data._near_range = 0.1f;
+		data._far_range = 1000.0f;
+		PLUGIN_NAMESPACE::TFCuda::bind_surface(data, "normals", data._input_memory, data._pitch);
+		PLUGIN_NAMESPACE::TFCuda::bind_surface(data, "depth", data._depth_memory, data._pitch);
+		PLUGIN_NAMESPACE::TFCuda::bind_surface(data, "output", data._output_memory, data._output_pitch);
+	}
+
+	Host_Surfaces::Host_Surfaces(const Resolution& resolution, float depth_offset) {
+		const size_t pixels = (size_t)resolution.width * resolution.height;
+		normals.resize(pixels * 4);
+		depth.resize(pixels);
+		output.resize(pixels);
+		for (size_t i = 0; i < pixels; ++i) {
+			normals[4 * i + 0] = (unsigned char)(i * 7);
+			normals[4 * i + 1] = (unsigned char)(i * 13);
+			normals[4 * i + 2] = (unsigned char)(i * 29);
+			normals[4 * i + 3] = 255;
+			depth[i] = 0.1f + depth_offset + (float)(i % 1000);
+		}
+
+		bind_host_surfaces(data, normals.data(), depth.data(), resolution.width * 4, output.data(), resolution.width * sizeof(float));
+		data._far_range = 10000.0f;
+	}
+
+	Network_Session::~Network_Session() {
+		if (binding)
+			binding->Unref();
+		if (session)
+			session->Close();
+	}
+
+	TF::Status create_network_session(const TF::GraphDef& network, unsigned width, unsigned height, unsigned batch, const Test_Options& options, Network_Session& result, bool fold) {
+		TF::GraphDef graph = network;
+		TF_RETURN_IF_ERROR(PLUGIN_NAMESPACE::TFGraph::specialize(graph, "image_data", width, height));
+		if (fold)
+			PLUGIN_NAMESPACE::TFGraph::fold_transposes(graph);
+		result.fetch = output_node(graph);
+		if (result.fetch.empty())
+			return TF::errors::NotFound("No interactive output op in the network");
+		if (PLUGIN_NAMESPACE::TFGraph::output_format(graph, result.fetch) != PixelR32F)
+			return TF::errors::InvalidArgument("The tests expect a network writing R32F");
+
+		const TF::int64 channels = PLUGIN_NAMESPACE::TFGraph::input_channels(graph, "image_data");
+		result.input = TF::Tensor(TF::DT_FLOAT, TF::TensorShape({ batch, width, height, channels }));
+		result.input.flat<float>().setZero();
+		return create_session(graph, options, result.session, &result.binding);
+	}
+
+	TF::Status run_session(Network_Session& network, PLUGIN_NAMESPACE::CUDA_transfer_data& data) {
+		std::vector<TF::Tensor> outputs;
+		PLUGIN_NAMESPACE::Binding_Scope scope(network.binding, &data);
+		return network.session->Run({ { "image_data", network.input } }, { network.fetch }, {}, &outputs);
+	}
+
+	TF::Status run_network(Network_Session& network, Synthetic_Frame& frame, unsigned frame_width, unsigned x, unsigned y, std::vector<float>& output, unsigned output_width) {
+		const size_t pitch = (size_t)frame_width * 4;
+		PLUGIN_NAMESPACE::CUDA_transfer_data data;
+		bind_host_surfaces(data, frame.normals.data() + y * pitch + 4 * x, frame.depth.data() + (size_t)y * frame_width + x, pitch,
+			output.data(), (size_t)output_width * sizeof(float));
+		return run_session(network, data);
+	}
+
+	TF::Status run_dirty_tiles(Network_Session& window_network, Synthetic_Frame& frame, const Tile_Grid& grid, const std::vector<Tile_Window>& windows, std::vector<float>& result) {
+		PLUGIN_NAMESPACE::CUDA_transfer_data data;
+		bind_host_surfaces(data, frame.normals.data(), frame.depth.data(), (size_t)grid.width * 4, result.data(), (size_t)grid.width * sizeof(float));
+
+		std::vector<TF::Tensor> outputs;
+		PLUGIN_NAMESPACE::Binding_Scope scope(window_network.binding, &data);
+		const unsigned batch = (unsigned)window_network.input.dim_size(0);
+		for (unsigned first = 0; first < windows.size(); first += batch) {
+			const unsigned count = PLUGIN_NAMESPACE::TFTiles::bind_windows(grid, windows, first, batch, PixelR32F, data);
+			const TF::Tensor input = count < batch ? window_network.input.Slice(0, count) : window_network.input;
+			TF_RETURN_IF_ERROR(window_network.session->Run({ { "image_data", input } }, { window_network.fetch }, {}, &outputs));
+		}
+		return TF::Status::OK();
+	}
+
+	TF::Status run_tiled(Network_Session& window_network, const Tile_Plan& plan, Synthetic_Frame& frame, std::vector<float>& output) {
+		PLUGIN_NAMESPACE::CUDA_transfer_data data;
+		bind_host_surfaces(data, frame.normals.data(), frame.depth.data(), (size_t)plan.grid.width * 4, output.data(), (size_t)plan.grid.width * sizeof(float));
+
+		std::vector<TF::Tensor> outputs;
+		PLUGIN_NAMESPACE::Binding_Scope scope(window_network.binding, &data);
+		for (unsigned run = 0; run < plan.runs; ++run) {
+			const unsigned count = PLUGIN_NAMESPACE::TFTiles::bind_tiles(plan, run, PixelR32F, data);
+			const TF::Tensor input = count < plan.batch ? window_network.input.Slice(0, count) : window_network.input;
+			TF_RETURN_IF_ERROR(window_network.session->Run({ { "image_data", input } }, { window_network.fetch }, {}, &outputs));
+		}
+		return TF::Status::OK();
+	}
+
+	TF::Status run_views(Network_Session& network, unsigned views, Synthetic_Frame& frame, unsigned frame_width, unsigned height, std::vector<float>& output) {
+		PLUGIN_NAMESPACE::CUDA_transfer_data data;
+		bind_host_surfaces(data, frame.normals.data(), frame.depth.data(), (size_t)frame_width * 4, output.data(), (size_t)frame_width * sizeof(float));
+		const unsigned window_width = (unsigned)network.input.dim_size(1);
+		if (!PLUGIN_NAMESPACE::TFCuda::bind_views(data, views, frame_width, height, window_width, frame_width, sizeof(float)))
+			return TF::errors::InvalidArgument("The views do not fit side by side into the frame");
+		return run_session(network, data);
+	}
+
+} // namespace tests
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "../tf_kernel.h"
+#include "../tf_graph.h"
+#include "../tf_binding.h"
+#include "../tf_tiles.h"
+#include "tf_synthetic_scene.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/public/session.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Helpers the tests and the benchmark share. Everything runs on the cpu device without the engine, the transfer data
+// points to host buffers the same way a session running on the cpu sets it up.
+
+namespace tests {
+
+	struct Resolution
+	{
+		unsigned width;
+		unsigned height;
+	};
+
+	// The sizes the frozen graphs were exported for
+	extern const Resolution RESOLUTIONS[7];
+
+	// Options every test and the benchmark understand, the network is only loaded by the ones that need it
+	struct Test_Options
+	{
+		std::string graph_path = "python/frozen_nnao.pb";
+		int runs = 50;
+		int warmup = 5;
+		int threads = 0;
+	};
+
+	// Takes --graph, --runs, --warmup and --threads out of the arguments and leaves the rest for the caller
+	void parse_test_options(int argc, char** argv, Test_Options& options, std::vector<std::string>& rest);
+
+	// Registers the ops and enables the allocator stats, has to run before the first session
+	void setup();
+
+	TF::Status read_network(const std::string& path, TF::GraphDef& network);
+
+	double median_ms(std::vector<double> times);
+
+	template <typename Function>
+	double time_ms(int runs, Function function) {
+		std::vector<double> times;
+		for (int i = 0; i < runs; ++i) {
+			auto start = std::chrono::steady_clock::now();
+			function();
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return median_ms(times);
+	}
+
+	double max_absolute_error(const std::vector<float>& values, const std::vector<float>& reference);
+	double mean_absolute_error(const std::vector<float>& values, const std::vector<float>& reference);
+	double mean_squared_error(const std::vector<float>& values, const std::vector<float>& reference);
+	double psnr(double mse);
+
+	// The node the plugin would fetch, the output op at the end of the network
+	std::string output_node(const TF::GraphDef& graph);
+
+	TF::Tensor input_tensor(const Resolution& resolution, int channels);
+
+	TF::int64 cpu_allocations();
+
+	// Peak of the cpu allocations while the function runs over what was allocated before it
+	template <typename Function>
+	TF::int64 peak_allocation(Function function) {
+		TF::AllocatorStats stats;
+		TF::cpu_allocator()->ClearStats();
+		TF::cpu_allocator()->GetStats(&stats);
+		const TF::int64 before = stats.bytes_in_use;
+		function();
+		TF::cpu_allocator()->GetStats(&stats);
+		return stats.max_bytes_in_use - before;
+	}
+
+	// Every session gets its own binding, like the sessions of the model cache
+	TF::Status create_session(const TF::GraphDef& graph, const Test_Options& options, std::unique_ptr<TF::Session>& session, PLUGIN_NAMESPACE::TFBinding** binding);
+
+	// Points the transfer data at host buffers and binds them as the normals, depth and output surfaces
+	void bind_host_surfaces(PLUGIN_NAMESPACE::CUDA_transfer_data& data, void* normals, void* depth, size_t pitch, void* output, size_t output_pitch);
+
+	// Host stand ins for the interop buffers, normals are RGBA8 and depth R32F with a shared pitch like in the plugin
+	struct Host_Surfaces
+	{
+		std::vector<unsigned char> normals;
+		std::vector<float> depth;
+		std::vector<float> output;
+		PLUGIN_NAMESPACE::CUDA_transfer_data data;
+
+		Host_Surfaces(const Resolution& resolution, float depth_offset);
+	};
+
+	// Network specialized to one size in its own session, the transfer data of a run points at the pixels to read
+	struct Network_Session
+	{
+		std::unique_ptr<TF::Session> session;
+		PLUGIN_NAMESPACE::TFBinding* binding = nullptr;
+		std::string fetch;
+		TF::Tensor input;
+
+		~Network_Session();
+	};
+
+	// Specializes the network the way the model cache does, the network has to write R32F. Without folding the transposes
+	// stay in the graph like with Tensorflow.set_fold_transposes(false).
+	TF::Status create_network_session(const TF::GraphDef& network, unsigned width, unsigned height, unsigned batch, const Test_Options& options, Network_Session& result, bool fold = true);
+
+	// Runs the session on the transfer data, the input only carries the shape like the zero input of a session
+	TF::Status run_session(Network_Session& network, PLUGIN_NAMESPACE::CUDA_transfer_data& data);
+
+	// The window at x, y of the frame surfaces, the output goes to a buffer of the window size
+	TF::Status run_network(Network_Session& network, Synthetic_Frame& frame, unsigned frame_width, unsigned x, unsigned y, std::vector<float>& output, unsigned output_width);
+
+	// Runs the windows of the dirty tiles of the current frame in batches of the network like a session does, every window
+	// writes its tile straight into the result of the last frame
+	TF::Status run_dirty_tiles(Network_Session& window_network, Synthetic_Frame& frame, const Tile_Grid& grid, const std::vector<Tile_Window>& windows, std::vector<float>& result);
+
+	// Runs the whole frame in the batches of windows of the plan on a network specialized to the window size, every
+	// window writes its tile straight into the frame output
+	TF::Status run_tiled(Network_Session& window_network, const Tile_Plan& plan, Synthetic_Frame& frame, std::vector<float>& output);
+
+	// Runs the views lying side by side in the frame as one batch, every view writes its part of the frame output
+	TF::Status run_views(Network_Session& network, unsigned views, Synthetic_Frame& frame, unsigned frame_width, unsigned height, std::vector<float>& output);
+
+} // namespace tests
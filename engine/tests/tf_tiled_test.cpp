@@ -0,0 +1,68 @@
+#include "tf_test_support.h"
+#include <cstdio>
+
+// Runs a frame tiled, once with the plan of a memory ceiling and once in batches of five windows with a short last run,
+// both have to match a run over the whole frame
+
+using namespace tests;
+
+int main(int argc, char** argv) {
+	Test_Options options;
+	std::vector<std::string> rest;
+	parse_test_options(argc, argv, options, rest);
+	setup();
+
+	TF::GraphDef network;
+	TF::Status status = read_network(options.graph_path, network);
+	if (!status.ok()) {
+		fprintf(stderr, "%s\n", status.ToString().c_str());
+		return 1;
+	}
+
+	const unsigned width = 960;
+	const unsigned height = 512;
+	Synthetic_Frame frame;
+	render_default(width, height, frame);
+
+	Tile_Plan planned;
+	const bool tiled = PLUGIN_NAMESPACE::TFTiles::plan_tiling(width, height, 40ull << 20, NETWORK_BYTES_PER_PIXEL, TILE_HALO, planned);
+	Tile_Plan batched;
+	batched.grid = PLUGIN_NAMESPACE::TFTiles::grid(width, height, 128);
+	batched.halo = TILE_HALO;
+	batched.window_size = PLUGIN_NAMESPACE::TFTiles::window_size(batched.grid, TILE_HALO);
+	batched.batch = 5;
+	batched.runs = (batched.grid.columns * batched.grid.rows + batched.batch - 1) / batched.batch;
+
+	Network_Session frame_network;
+	status = create_network_session(network, width, height, 1, options, frame_network);
+	std::vector<float> reference((size_t)width * height);
+	if (status.ok())
+		status = run_network(frame_network, frame, width, 0, 0, reference, width);
+	if (!status.ok() || !tiled) {
+		fprintf(stderr, "%s\n", status.ok() ? "A 40 MB ceiling does not tile the frame" : status.ToString().c_str());
+		return 1;
+	}
+
+	bool passed = true;
+	for (const Tile_Plan* plan : { &planned, &batched }) {
+		Network_Session window_network;
+		status = create_network_session(network, plan->window_size, plan->window_size, plan->batch, options, window_network);
+		std::vector<float> output((size_t)width * height, -1.0f);
+		if (status.ok())
+			status = run_tiled(window_network, *plan, frame, output);
+		if (!status.ok()) {
+			fprintf(stderr, "%s\n", status.ToString().c_str());
+			return 1;
+		}
+
+		const double error = max_absolute_error(output, reference);
+		const bool plan_passed = plan->runs > 1 && error <= 1e-3;
+		fprintf(stderr, "Tiled %u tiles of %u in windows of %ux%u, %u per run in %u runs, max error against the frame run %.6f %s\n",
+			plan->grid.columns * plan->grid.rows, plan->grid.tile_size, plan->window_size, plan->window_size, plan->batch, plan->runs,
+			error, plan_passed ? "" : "FAILED");
+		passed = plan_passed && passed;
+	}
+
+	fprintf(stderr, "Tiled check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
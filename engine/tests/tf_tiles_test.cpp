@@ -0,0 +1,143 @@
+#include "tf_test_support.h"
+#include <cstdio>
+
+// The sse2 tile hash and the lanes the sessions hash on the device have to match the scalar hash, and the windows of the
+// dirty tiles of a changed frame patched into the result of the frame before have to match running the network over the
+// changed frame
+
+using namespace tests;
+
+namespace {
+
+	// The sse2 hash and the lanes finished on the host have to match the scalar hash on every tile, flipping any bit of the normals or depth has to dirty
+	// exactly the tile holding it and the bytes behind the width in the pitch must not dirty anything
+	bool check_tile_hashes() {
+		const unsigned width = 1000;
+		const unsigned height = 600;
+		const size_t pitch = (size_t)width * 4 + 32;
+		std::vector<unsigned char> normals(pitch * height);
+		std::vector<unsigned char> depth(pitch * height);
+		unsigned seed = 1;
+		for (size_t i = 0; i < normals.size(); ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			normals[i] = (unsigned char)(seed >> 24);
+			depth[i] = (unsigned char)(seed >> 16);
+		}
+
+		const Tile_Grid grid = PLUGIN_NAMESPACE::TFTiles::grid(width, height, TILE_SIZE);
+		const unsigned tiles = grid.columns * grid.rows;
+		std::vector<uint64_t> hashes(tiles), previous(tiles);
+		PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, normals.data(), (const float*)depth.data(), pitch, previous.data());
+		std::vector<uint32_t> lanes((size_t)tiles * TILE_HASH_LANES);
+		PLUGIN_NAMESPACE::TFTiles::hash_lanes_cpu(grid, normals.data(), (const float*)depth.data(), pitch, lanes.data());
+		PLUGIN_NAMESPACE::TFTiles::finish_hashes(grid, lanes.data(), hashes.data());
+		unsigned mismatches = 0;
+		for (unsigned tile = 0; tile < tiles; ++tile) {
+			const uint64_t reference = PLUGIN_NAMESPACE::TFTiles::hash_tile_reference(grid, tile, normals.data(), (const float*)depth.data(), pitch);
+			mismatches += previous[tile] != reference || hashes[tile] != reference ||
+				PLUGIN_NAMESPACE::TFTiles::hash_tile(grid, tile, normals.data(), (const float*)depth.data(), pitch) != reference ? 1 : 0;
+		}
+
+		unsigned missed = 0;
+		std::vector<unsigned> dirty;
+		for (int flip = 0; flip < 500; ++flip) {
+			seed = seed * 1664525u + 1013904223u;
+			const unsigned x = (seed >> 8) % width;
+			const unsigned y = (seed >> 4) % height;
+			std::vector<unsigned char>& target = (seed & 1) ? depth : normals;
+			target[y * pitch + 4 * x + (seed >> 28) % 4] ^= (unsigned char)(1 << ((seed >> 24) % 8));
+
+			PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, normals.data(), (const float*)depth.data(), pitch, hashes.data());
+			PLUGIN_NAMESPACE::TFTiles::dirty_tiles(grid, hashes.data(), previous.data(), dirty);
+			if (dirty.size() != 1 || dirty[0] != y / TILE_SIZE * grid.columns + x / TILE_SIZE)
+				++missed;
+			previous.swap(hashes);
+		}
+
+		for (unsigned y = 0; y < height; ++y)
+			normals[y * pitch + (size_t)width * 4] ^= 0xff;
+		PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, normals.data(), (const float*)depth.data(), pitch, hashes.data());
+		const unsigned padding = PLUGIN_NAMESPACE::TFTiles::dirty_tiles(grid, hashes.data(), previous.data(), dirty);
+
+		const double hash_ms = time_ms(20, [&]() { PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, normals.data(), (const float*)depth.data(), pitch, hashes.data()); });
+		const double reference_ms = time_ms(20, [&]() {
+			for (unsigned tile = 0; tile < tiles; ++tile)
+				hashes[tile] = PLUGIN_NAMESPACE::TFTiles::hash_tile_reference(grid, tile, normals.data(), (const float*)depth.data(), pitch);
+		});
+
+		const bool passed = mismatches == 0 && missed == 0 && padding == 0;
+		fprintf(stderr, "Tile hashes %ux%u, %u tiles: %u differ from the reference, %u of 500 bit flips missed, %u dirty from the padding, %.2f ms against %.2f ms %s\n",
+			width, height, tiles, mismatches, missed, padding, hash_ms, reference_ms, passed ? "" : "FAILED");
+		return passed;
+	}
+
+	// A change inside one tile reruns it and the tiles within the halo around it, whose result depends on the change too.
+	// The patched result has to match a run over the frame.
+	bool check_dirty_tiles(const TF::GraphDef& network, const Test_Options& options) {
+		const unsigned width = 1920;
+		const unsigned height = 1088;
+		const unsigned batch = 5;
+		Synthetic_Frame frame;
+		render_default(width, height, frame);
+		Synthetic_Frame changed = frame;
+		disturb_frame(changed, width, 330, 200, 20, 24);
+
+		const Tile_Grid grid = PLUGIN_NAMESPACE::TFTiles::grid(width, height, TILE_SIZE);
+		std::vector<uint64_t> hashes(grid.columns * grid.rows), previous(grid.columns * grid.rows);
+		std::vector<unsigned> dirty;
+		std::vector<Tile_Window> windows;
+		PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, frame.normals.data(), frame.depth.data(), (size_t)width * 4, previous.data());
+		PLUGIN_NAMESPACE::TFTiles::hash_tiles(grid, changed.normals.data(), changed.depth.data(), (size_t)width * 4, hashes.data());
+		const unsigned changed_tiles = PLUGIN_NAMESPACE::TFTiles::dirty_tiles(grid, hashes.data(), previous.data(), dirty);
+		const unsigned reach = (TILE_HALO + TILE_SIZE - 1) / TILE_SIZE;
+		const unsigned grown_tiles = PLUGIN_NAMESPACE::TFTiles::grow_dirty(grid, TILE_HALO, dirty);
+		PLUGIN_NAMESPACE::TFTiles::plan_windows(grid, dirty, TILE_HALO, width, height, windows);
+
+		Network_Session frame_network, window_network;
+		const unsigned size = PLUGIN_NAMESPACE::TFTiles::window_size(grid, TILE_HALO);
+		TF::Status status = create_network_session(network, width, height, 1, options, frame_network);
+		if (status.ok())
+			status = create_network_session(network, size, size, batch, options, window_network);
+
+		std::vector<float> before((size_t)width * height), after((size_t)width * height);
+		if (status.ok())
+			status = run_network(frame_network, frame, width, 0, 0, before, width);
+		if (status.ok())
+			status = run_network(frame_network, changed, width, 0, 0, after, width);
+		std::vector<float> tiled = before;
+		if (status.ok())
+			status = run_dirty_tiles(window_network, changed, grid, windows, tiled);
+		if (!status.ok()) {
+			fprintf(stderr, "%s\n", status.ToString().c_str());
+			return false;
+		}
+
+		const double error = max_absolute_error(tiled, after);
+		const unsigned expected = (2 * reach + 1) * (2 * reach + 1);
+		const bool passed = changed_tiles == 1 && grown_tiles == expected && windows.size() == expected && error <= 1e-3;
+		fprintf(stderr, "Dirty tiles %u changed, %u with the halo in %zu windows of %ux%u, max error against the frame run %.6f %s\n",
+			changed_tiles, grown_tiles, windows.size(), size, size, error, passed ? "" : "FAILED");
+		return passed;
+	}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+	Test_Options options;
+	std::vector<std::string> rest;
+	parse_test_options(argc, argv, options, rest);
+	setup();
+
+	bool passed = check_tile_hashes();
+
+	TF::GraphDef network;
+	TF::Status status = read_network(options.graph_path, network);
+	if (!status.ok()) {
+		fprintf(stderr, "%s\n", status.ToString().c_str());
+		return 1;
+	}
+	passed = check_dirty_tiles(network, options) && passed;
+
+	fprintf(stderr, "Tile check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#include "tf_test_support.h"
+#include <cstdio>
+
+// Runs one to four views of 960x512 one after another and as one batch, the batch has to give every view the result of
+// its own run
+
+using namespace tests;
+
+int main(int argc, char** argv) {
+	Test_Options options;
+	std::vector<std::string> rest;
+	parse_test_options(argc, argv, options, rest);
+	setup();
+
+	TF::GraphDef network;
+	TF::Status status = read_network(options.graph_path, network);
+	const unsigned view_width = 960;
+	const unsigned height = 512;
+	Network_Session view_network;
+	if (status.ok())
+		status = create_network_session(network, view_width, height, 1, options, view_network);
+
+	bool passed = true;
+	for (unsigned views = 1; views <= 4 && status.ok(); ++views) {
+		const unsigned width = views * view_width;
+		Synthetic_Frame frame;
+		render_default(width, height, frame);
+
+		Network_Session batch_network;
+		status = create_network_session(network, view_width, height, views, options, batch_network);
+		std::vector<float> view_output((size_t)view_width * height), sequential((size_t)width * height), batched((size_t)width * height);
+		for (unsigned view = 0; view < views && status.ok(); ++view) {
+			status = run_network(view_network, frame, width, view * view_width, 0, view_output, view_width);
+			for (unsigned y = 0; y < height; ++y)
+				std::copy(view_output.begin() + (size_t)y * view_width, view_output.begin() + (size_t)(y + 1) * view_width, sequential.begin() + (size_t)y * width + view * view_width);
+		}
+		if (status.ok())
+			status = run_views(batch_network, views, frame, width, height, batched);
+		if (!status.ok())
+			break;
+
+		const double error = max_absolute_error(batched, sequential);
+		const bool views_passed = error <= 1e-3;
+		fprintf(stderr, "Views %u of %ux%u, max error of the batch against one view after another %.6f %s\n",
+			views, view_width, height, error, views_passed ? "" : "FAILED");
+		passed = views_passed && passed;
+	}
+	if (!status.ok()) {
+		fprintf(stderr, "%s\n", status.ToString().c_str());
+		return 1;
+	}
+
+	fprintf(stderr, "Views check %s\n", passed ? "passed" : "failed");
+	return passed ? 0 : 1;
+}
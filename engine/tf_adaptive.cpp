@@ -0,0 +1,81 @@
+#include "tf_adaptive.h"
+
+namespace PLUGIN_NAMESPACE
+{
+	Adaptive_Settings TFAdaptive::settings(float budget_ms)
+	{
+		Adaptive_Settings settings;
+		settings.budget_ms = budget_ms;
+		settings.smoothing = DEFAULT_ADAPTIVE_SMOOTHING;
+		settings.down_runs = DEFAULT_ADAPTIVE_DOWN_RUNS;
+		settings.up_runs = DEFAULT_ADAPTIVE_UP_RUNS;
+		settings.headroom = DEFAULT_ADAPTIVE_HEADROOM;
+		return settings;
+	}
+
+	// The ladder starts at the first factor which is not finer than the one of the session, the first rung runs first
+	Adaptive_State TFAdaptive::start(unsigned first_factor)
+	{
+		Adaptive_State state = {};
+		for (unsigned factor : ADAPTIVE_FACTORS)
+		{
+			if (factor < first_factor)
+				continue;
+			if (state.rungs > 0)
+			{
+				const float ratio = (float)factor / state.factors[state.rungs - 1];
+				state.cost_ratio[state.rungs] = ratio * ratio;
+			}
+			state.factors[state.rungs++] = factor;
+		}
+		return state;
+	}
+
+	float TFAdaptive::expected_up_ms(const Adaptive_State &state)
+	{
+		return state.rung > 0 ? state.average_ms * state.cost_ratio[state.rung] : state.average_ms;
+	}
+
+	unsigned TFAdaptive::update(const Adaptive_Settings &settings, Adaptive_State &state, float run_ms)
+	{
+		// The first run after a switch measures the cost ratio between the rung that was left and this one, a finer rung is
+		// never taken to be cheaper
+		if (state.samples == 0 && state.switches > 0 && state.previous_ms > 0.0f && run_ms > 0.0f)
+		{
+			if (state.rung == state.previous_rung + 1)
+				state.cost_ratio[state.rung] = state.previous_ms > run_ms ? state.previous_ms / run_ms : 1.0f;
+			else if (state.rung + 1 == state.previous_rung)
+				state.cost_ratio[state.previous_rung] = run_ms > state.previous_ms ? run_ms / state.previous_ms : 1.0f;
+		}
+		state.average_ms = state.samples == 0 ? run_ms : state.average_ms + settings.smoothing * (run_ms - state.average_ms);
+		++state.samples;
+
+		if (state.average_ms > settings.budget_ms)
+		{
+			++state.over_runs;
+			state.under_runs = 0;
+		}
+		else
+		{
+			state.over_runs = 0;
+			state.under_runs = state.rung > 0 && expected_up_ms(state) <= settings.headroom * settings.budget_ms ? state.under_runs + 1 : 0;
+		}
+
+		unsigned next = state.rung;
+		if (state.over_runs >= settings.down_runs && state.rung + 1 < state.rungs)
+			next = state.rung + 1;
+		else if (state.under_runs >= settings.up_runs)
+			next = state.rung - 1;
+		if (next != state.rung)
+		{
+			state.previous_rung = state.rung;
+			state.previous_ms = state.average_ms;
+			state.rung = next;
+			state.samples = 0;
+			state.over_runs = 0;
+			state.under_runs = 0;
+			++state.switches;
+		}
+		return state.rung;
+	}
+}
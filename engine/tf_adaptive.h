@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+// Adaptive resolution of a session holding a time budget for the network. The session runs one rung of a ladder of
+// resolution factors, every rung has its own session loaded up front so a switch only changes which one runs. The time
+// of every network run goes into a moving average of the active rung. The controller steps down once the average stayed
+// over the budget for a few runs and steps up once the rung above is expected to fit into the budget with headroom for
+// many runs in a row. The different thresholds and run counts keep it from switching back and forth at the border.
+//
+// The expected time of the rung above is the average of the active rung times the cost ratio between the two rungs. The
+// ratio starts at the ratio of their pixels and is measured whenever the controller switches between them.
+
+// Rungs are the resolution factors the resample passes support, starting from the factor of the session
+const unsigned MAX_ADAPTIVE_RUNGS = 3;
+const unsigned ADAPTIVE_FACTORS[MAX_ADAPTIVE_RUNGS] = { 1, 2, 4 };
+
+// Weight of a new run in the average, runs over the budget before stepping down, runs with headroom before stepping up
+// and the share of the budget the rung above has to fit into
+const float DEFAULT_ADAPTIVE_SMOOTHING = 0.2f;
+const unsigned DEFAULT_ADAPTIVE_DOWN_RUNS = 3;
+const unsigned DEFAULT_ADAPTIVE_UP_RUNS = 30;
+const float DEFAULT_ADAPTIVE_HEADROOM = 0.8f;
+
+struct Adaptive_Settings
+{
+	float budget_ms;
+	float smoothing;
+	unsigned down_runs;
+	unsigned up_runs;
+	float headroom;
+};
+
+// Cost ratios are kept per rung against the rung above it, the one of the first rung is unused
+struct Adaptive_State
+{
+	unsigned rungs;
+	unsigned rung;
+	unsigned factors[MAX_ADAPTIVE_RUNGS];
+	float cost_ratio[MAX_ADAPTIVE_RUNGS];
+	float average_ms;
+	unsigned samples;
+	unsigned over_runs;
+	unsigned under_runs;
+	unsigned previous_rung;
+	float previous_ms;
+	uint64_t switches;
+};
+
+namespace PLUGIN_NAMESPACE
+{
+	// Decisions only depend on the run times passed in, the benchmark replays synthetic traces through them
+	class TFAdaptive
+	{
+	public:
+		static Adaptive_Settings settings(float budget_ms);
+		static Adaptive_State start(unsigned first_factor);
+		static float expected_up_ms(const Adaptive_State &state);
+		static unsigned update(const Adaptive_Settings &settings, Adaptive_State &state, float run_ms);
+	};
+}
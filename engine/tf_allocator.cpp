@@ -0,0 +1,200 @@
+#include "tf_allocator.h"
+#include "tf_plugin.h"
+
+namespace PLUGIN_NAMESPACE
+{
+	// Tensorflow expects 64 byte aligned tensors, the header sits in front of the returned pointer
+	const size_t BLOCK_HEADER_SIZE = 64;
+	const unsigned DIRECT_BLOCK = ~0u;
+
+	struct Allocator_Block
+	{
+		void *base;
+		size_t requested;
+		size_t capacity;
+		unsigned size_class;
+		Allocator_Block *next;
+	};
+
+	// The user pointer is always BLOCK_HEADER_SIZE or more behind the base, so the header fits right in front of it
+	Allocator_Block *header_of(const void *ptr)
+	{
+		return (Allocator_Block*)((char*)ptr - BLOCK_HEADER_SIZE);
+	}
+
+	unsigned size_class_of(size_t num_bytes)
+	{
+		unsigned size_class = 0;
+		size_t size = ALLOCATOR_MIN_CLASS_SIZE;
+		while (size < num_bytes && size_class < ALLOCATOR_SIZE_CLASSES)
+		{
+			size <<= 1;
+			++size_class;
+		}
+		return size_class < ALLOCATOR_SIZE_CLASSES ? size_class : DIRECT_BLOCK;
+	}
+
+	TFAllocator::TFAllocator(const std::string &name, uint64_t budget) : _name(name)
+	{
+		static_assert(sizeof(Allocator_Block) <= BLOCK_HEADER_SIZE, "Block header does not fit in front of the tensor");
+		_stats.budget = budget;
+
+		ApiInterface &api = TFPlugin::get_api();
+		if (api._thread)
+			_lock = api._thread->create_critical_section(api._allocator_object);
+	}
+
+	TFAllocator::~TFAllocator()
+	{
+		trim();
+
+		ApiInterface &api = TFPlugin::get_api();
+		if (_lock)
+			api._thread->destroy_critical_section(_lock, api._allocator_object);
+	}
+
+	std::string TFAllocator::Name()
+	{
+		return _name;
+	}
+
+	void *TFAllocator::AllocateRaw(size_t alignment, size_t num_bytes)
+	{
+		size_t offset = alignment > BLOCK_HEADER_SIZE ? alignment : BLOCK_HEADER_SIZE;
+		unsigned size_class = alignment <= BLOCK_HEADER_SIZE ? size_class_of(num_bytes) : DIRECT_BLOCK;
+		size_t capacity = size_class == DIRECT_BLOCK ? num_bytes : ALLOCATOR_MIN_CLASS_SIZE << size_class;
+
+		ThreadApi *thread = TFPlugin::get_api()._thread;
+		if (_lock)
+			thread->enter_critical_section(_lock);
+
+		Allocator_Block *header = nullptr;
+		if (size_class != DIRECT_BLOCK && _free_lists[size_class])
+		{
+			header = _free_lists[size_class];
+			_free_lists[size_class] = header->next;
+			_stats.pooled_bytes -= header->capacity;
+		}
+		else
+		{
+			// Pooled blocks count against the budget too, dropping them may leave enough room
+			if (_stats.budget > 0 && _stats.live_bytes + _stats.pooled_bytes + capacity > _stats.budget && _stats.pooled_bytes > 0)
+			{
+				if (_lock)
+					thread->leave_critical_section(_lock);
+				trim();
+				if (_lock)
+					thread->enter_critical_section(_lock);
+			}
+
+			if (_stats.budget > 0 && _stats.live_bytes + _stats.pooled_bytes + capacity > _stats.budget)
+			{
+				++_stats.failed_allocations;
+				if (_lock)
+					thread->leave_critical_section(_lock);
+				return nullptr;
+			}
+
+			void *base = TFPlugin::get_allocator().allocate(offset + capacity, (unsigned)offset);
+			if (base == nullptr)
+			{
+				++_stats.failed_allocations;
+				if (_lock)
+					thread->leave_critical_section(_lock);
+				return nullptr;
+			}
+
+			header = header_of((char*)base + offset);
+			header->base = base;
+			header->capacity = capacity;
+			header->size_class = size_class;
+		}
+
+		header->requested = num_bytes;
+		header->next = nullptr;
+		_stats.live_bytes += header->capacity;
+		_stats.peak_bytes = _stats.live_bytes > _stats.peak_bytes ? _stats.live_bytes : _stats.peak_bytes;
+		++_stats.allocations;
+
+		if (_lock)
+			thread->leave_critical_section(_lock);
+		return (char*)header + BLOCK_HEADER_SIZE;
+	}
+
+	void TFAllocator::DeallocateRaw(void *ptr)
+	{
+		if (ptr == nullptr)
+			return;
+
+		Allocator_Block *header = header_of(ptr);
+		ThreadApi *thread = TFPlugin::get_api()._thread;
+		if (_lock)
+			thread->enter_critical_section(_lock);
+
+		_stats.live_bytes -= header->capacity;
+		if (header->size_class != DIRECT_BLOCK)
+		{
+			header->next = _free_lists[header->size_class];
+			_free_lists[header->size_class] = header;
+			_stats.pooled_bytes += header->capacity;
+		}
+		else
+			TFPlugin::get_allocator().deallocate(header->base);
+
+		if (_lock)
+			thread->leave_critical_section(_lock);
+	}
+
+	bool TFAllocator::TracksAllocationSizes()
+	{
+		return true;
+	}
+
+	size_t TFAllocator::RequestedSize(const void *ptr)
+	{
+		return header_of(ptr)->requested;
+	}
+
+	size_t TFAllocator::AllocatedSize(const void *ptr)
+	{
+		return header_of(ptr)->capacity;
+	}
+
+	void TFAllocator::set_budget(uint64_t budget)
+	{
+		_stats.budget = budget;
+	}
+
+	Allocator_Stats TFAllocator::stats()
+	{
+		ThreadApi *thread = TFPlugin::get_api()._thread;
+		if (_lock)
+			thread->enter_critical_section(_lock);
+		Allocator_Stats result = _stats;
+		if (_lock)
+			thread->leave_critical_section(_lock);
+		return result;
+	}
+
+	// Returns all pooled blocks to the engine allocator
+	void TFAllocator::trim()
+	{
+		ThreadApi *thread = TFPlugin::get_api()._thread;
+		if (_lock)
+			thread->enter_critical_section(_lock);
+
+		for (Allocator_Block *&free_list : _free_lists)
+		{
+			while (free_list)
+			{
+				Allocator_Block *header = free_list;
+				free_list = header->next;
+				TFPlugin::get_allocator().deallocate(header->base);
+			}
+		}
+		_stats.pooled_bytes = 0;
+
+		if (_lock)
+			thread->leave_critical_section(_lock);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "tf_settings.h"
+#pragma warning(push, 0)
+#include "tensorflow/core/framework/allocator.h"
+#pragma warning(pop)
+#include <engine_plugin_api/plugin_api.h>
+#include <stdint.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	namespace TF = tensorflow;
+
+	// Pooled size classes run from 256 bytes to 8 MB, bigger blocks go straight to the engine allocator
+	const unsigned ALLOCATOR_SIZE_CLASSES = 16;
+	const size_t ALLOCATOR_MIN_CLASS_SIZE = 256;
+
+	struct Allocator_Stats
+	{
+		uint64_t live_bytes = 0;
+		uint64_t peak_bytes = 0;
+		uint64_t pooled_bytes = 0;
+		uint64_t budget = 0;
+		uint64_t allocations = 0;
+		uint64_t failed_allocations = 0;
+	};
+
+	struct Allocator_Block;
+
+	// Host tensor allocator of a session, routes every block through the plugin allocator of the engine so the memory
+	// shows up in the engine memory tracker. Freed blocks are kept per size class and reused, the pools count
+	// against the budget as well, a budget of zero means unlimited.
+	class TFAllocator : public TF::Allocator
+	{
+	public:
+		TFAllocator(const std::string &name, uint64_t budget);
+		~TFAllocator() override;
+
+		std::string Name() override;
+		void *AllocateRaw(size_t alignment, size_t num_bytes) override;
+		void DeallocateRaw(void *ptr) override;
+		bool TracksAllocationSizes() override;
+		size_t RequestedSize(const void *ptr) override;
+		size_t AllocatedSize(const void *ptr) override;
+
+		void set_budget(uint64_t budget);
+		Allocator_Stats stats();
+		void trim();
+
+	private:
+		std::string _name;
+		ThreadCriticalSection *_lock = nullptr;
+		Allocator_Block *_free_lists[ALLOCATOR_SIZE_CLASSES] = {};
+		Allocator_Stats _stats;
+	};
+}
@@ -0,0 +1,86 @@
+#include "tf_binding.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include <vector>
+
+namespace PLUGIN_NAMESPACE
+{
+	std::string TFBinding::DebugString()
+	{
+		return "Interactive transfer data binding";
+	}
+
+	// Every device gets the same binding, each resource manager holds a reference and the caller keeps the one it gets back
+	TF::Status TFBinding::create(TF::Session *session, const std::string &name, TFBinding **binding)
+	{
+		const TF::DeviceMgr *device_manager = nullptr;
+		TF_RETURN_IF_ERROR(session->LocalDeviceManager(&device_manager));
+
+		TFBinding *created = new TFBinding();
+		std::vector<TF::ResourceMgr*> registered;
+		for (TF::Device *device : device_manager->ListDevices())
+		{
+			// The resource manager takes over this reference, it drops it itself when the name is taken already
+			TF::ResourceMgr *resources = device->resource_manager();
+			created->Ref();
+			TF::Status status = resources->Create(resources->default_container(), name, created);
+			if (!status.ok())
+			{
+				// The devices which took the binding give it back and the reference meant for the caller goes as well
+				for (TF::ResourceMgr *other : registered)
+					other->Delete<TFBinding>(other->default_container(), name);
+				created->Unref();
+				return status;
+			}
+			registered.push_back(resources);
+		}
+
+		*binding = created;
+		return TF::Status::OK();
+	}
+
+	// Every graph runs inside a Binding_Scope, an op running without one has no transfer data to read or write
+	TF::Status TFBinding::lookup(TF::OpKernelContext *context, const std::string &name, CUDA_transfer_data **data)
+	{
+		TF::ResourceMgr *resources = context->resource_manager();
+		TFBinding *binding = nullptr;
+		if (resources == nullptr || !resources->Lookup(resources->default_container(), name, &binding).ok())
+			return TF::errors::NotFound("No interactive binding `", name, "` was registered for the session");
+
+		*data = binding->data();
+		binding->Unref();
+		if (*data == nullptr)
+			return TF::errors::NotFound("The interactive binding `", name, "` is not bound to the transfer data of a run");
+		return TF::Status::OK();
+	}
+
+	// Identifies the tensorflow session building an op, the resource managers keep the binding for as long as the op lives.
+	// Returns null for sessions without a binding.
+	const TFBinding *TFBinding::find(TF::OpKernelConstruction *context, const std::string &name)
+	{
+		TF::ResourceMgr *resources = context->resource_manager();
+		TFBinding *binding = nullptr;
+		if (resources == nullptr || !resources->Lookup(resources->default_container(), name, &binding).ok())
+			return nullptr;
+
+		binding->Unref();
+		return binding;
+	}
+
+	Binding_Scope::Binding_Scope(TFBinding *binding, CUDA_transfer_data *data) : _binding(binding)
+	{
+		if (_binding == nullptr)
+			return;
+		_binding->_run_lock.lock();
+		_binding->_data.store(data, std::memory_order_release);
+	}
+
+	Binding_Scope::~Binding_Scope()
+	{
+		if (_binding == nullptr)
+			return;
+		_binding->_data.store(nullptr, std::memory_order_release);
+		_binding->_run_lock.unlock();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "tf_cuda.h"
+#pragma warning(push, 0)
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#pragma warning(pop)
+#include <atomic>
+
+namespace tensorflow { class Session; }
+
+namespace PLUGIN_NAMESPACE
+{
+	namespace TF = tensorflow;
+
+	// Binding the interactive ops look up unless the graph names another one in their binding attribute
+	const char *const DEFAULT_BINDING_NAME = "interactive";
+
+	// Resource in the resource manager of every device of a tensorflow session, it points the interactive ops of that session
+	// at the transfer data of the run in flight. Every tensorflow session has its own resource managers, so sessions running
+	// on separate threads never see each others buffers. Execution sessions sharing a cached model take turns instead.
+	class TFBinding : public TF::ResourceBase
+	{
+	public:
+		std::string DebugString() override;
+		CUDA_transfer_data *data() const { return _data.load(std::memory_order_acquire); }
+
+		static TF::Status create(TF::Session *session, const std::string &name, TFBinding **binding);
+		static TF::Status lookup(TF::OpKernelContext *context, const std::string &name, CUDA_transfer_data **data);
+		static const TFBinding *find(TF::OpKernelConstruction *context, const std::string &name);
+
+	private:
+		friend class Binding_Scope;
+		TF::mutex _run_lock;
+		std::atomic<CUDA_transfer_data*> _data = { nullptr };
+	};
+
+	// Points the binding at the transfer data of one run for the lifetime of the scope
+	class Binding_Scope
+	{
+	public:
+		Binding_Scope(TFBinding *binding, CUDA_transfer_data *data);
+		~Binding_Scope();
+
+	private:
+		TFBinding *_binding;
+	};
+}
@@ -2,65 +2,70 @@
 
 namespace PLUGIN_NAMESPACE
 {
-	static CUDA_transfer_data instance_data;
-
-	void *TFCuda::get_input_memory_pointer()
-	{
-		return instance_data._input_memory;
-	}
-
-	void TFCuda::set_input_memory_pointer(void *pointer)
-	{
-		instance_data._input_memory = pointer;
-	}
-
-	void *TFCuda::get_depth_memory_pointer()
-	{
-		return instance_data._depth_memory;
-	}
-
-	void TFCuda::set_depth_memory_pointer(void *pointer)
-	{
-		instance_data._depth_memory = pointer;
-	}
-
-	void *TFCuda::get_output_memory_pointer()
+	// Input ops may be split over several kernels, the begin event stays at the first one
+	void TFCuda::record_stage_event(CUDA_transfer_data &data, StageEvent event, cudaStream_t stream)
 	{
-		return instance_data._output_memory;
-	}
+		// Cpu kernels have no stream, their time shows up in the network stage
+		if (stream == nullptr || !data._record_stages || data._stage_events[event] == nullptr)
+			return;
+		if ((event == InputOpBegin || event == OutputOpBegin) && data._stage_recorded[event])
+			return;
 
-	void TFCuda::set_output_memory_pointer(void *pointer)
-	{
-		instance_data._output_memory = pointer;
+		cudaEventRecord(data._stage_events[event], stream);
+		data._stage_recorded[event] = true;
 	}
 
-	size_t TFCuda::get_pitch()
+	// Binding a name again replaces the buffer
+	bool TFCuda::bind_surface(CUDA_transfer_data &data, const char *name, void *memory, size_t pitch)
 	{
-		return instance_data._pitch;
-	}
+		unsigned index = 0;
+		while (index < data._surface_count && data._surfaces[index].name != name)
+			++index;
+		if (index == MAX_SURFACE_BINDINGS)
+			return false;
 
-	void TFCuda::set_pitch(size_t pitch)
-	{
-		instance_data._pitch = pitch;
+		data._surfaces[index].name = name;
+		data._surfaces[index].memory = memory;
+		data._surfaces[index].pitch = pitch;
+		if (index == data._surface_count)
+			++data._surface_count;
+		return true;
 	}
 
-	float TFCuda::get_near_range()
+	const Surface_Binding *TFCuda::find_surface(const CUDA_transfer_data &data, const std::string &name)
 	{
-		return instance_data._near_range;
+		for (unsigned i = 0; i < data._surface_count; ++i)
+		{
+			if (data._surfaces[i].name == name)
+				return &data._surfaces[i];
+		}
+		return nullptr;
 	}
 
-	void TFCuda::set_near_range(float near_range)
+	// Views lie side by side in the first width pixels of the surfaces. Every entry reads a window of the graph width
+	// from the start of its view, which runs into the next view on the right, and writes only its own view back. Returns
+	// false and binds nothing when the views do not fit a batch, a view is empty or wider than the window, or the window of
+	// the last view runs past the surfaces.
+	bool TFCuda::bind_views(CUDA_transfer_data &data, unsigned views, unsigned width, unsigned height, unsigned window_width, unsigned surface_width, unsigned output_pixel_size)
 	{
-		instance_data._near_range = near_range;
-	}
+		if (views == 0 || views > MAX_BATCH_ENTRIES || width < views || surface_width < width)
+			return false;
+		if ((width + views - 1) / views > window_width || (views - 1) * width / views + window_width > surface_width)
+			return false;
 
-	float TFCuda::get_far_range()
-	{
-		return instance_data._far_range;
-	}
-
-	void TFCuda::set_far_range(float far_range)
-	{
-		instance_data._far_range = far_range;
+		for (unsigned view = 0; view < views; ++view)
+		{
+			const unsigned x = view * width / views;
+			Batch_Entry &entry = data._batch[view];
+			entry.input_memory = data._input_memory ? (unsigned char*)data._input_memory + x * NORMALS_PIXEL_SIZE : nullptr;
+			entry.depth_memory = (unsigned char*)data._depth_memory + x * sizeof(float);
+			entry.output_memory = (unsigned char*)data._output_memory + x * output_pixel_size;
+			entry.output_x = 0;
+			entry.output_y = 0;
+			entry.output_width = (view + 1) * width / views - x;
+			entry.output_height = height;
+		}
+		data._batch_count = views;
+		return true;
 	}
 }
@@ -1,33 +1,70 @@
 #pragma once
+#ifdef _WIN32
 #include <cuda_d3d11_interop.h>
+#endif
 #include <cuda_runtime_api.h>
+#include <string>
 
 namespace PLUGIN_NAMESPACE
 {
+	// Events the interactive ops record around their kernels, the gaps between them give the gpu time of each stage
+	enum StageEvent { InputOpBegin, InputOpEnd, OutputOpBegin, OutputOpEnd, STAGE_EVENT_COUNT };
+
+	// Bytes per pixel of the R8G8B8A8 normals target
+	const unsigned NORMALS_PIXEL_SIZE = 4;
+
+	// Buffers the InteractiveIO op finds by name, every transfer data binds its normals, depth and output buffers
+	const unsigned MAX_SURFACE_BINDINGS = 8;
+
+	struct Surface_Binding
+	{
+		std::string name;
+		void *memory = nullptr;
+		size_t pitch = 0;
+	};
+
+	// Batched runs give every batch entry its own window of the surfaces, the tiles of a frame or the views of a frame.
+	// The input ops read the window at the normals and depth memory of an entry with the pitch of the transfer data.
+	// The output ops write the part of the window starting at output_x, output_y to the output memory of the entry, an
+	// output width of zero writes the whole window.
+	const unsigned MAX_BATCH_ENTRIES = 16;
+
+	struct Batch_Entry
+	{
+		void *input_memory = nullptr;
+		void *depth_memory = nullptr;
+		void *output_memory = nullptr;
+		unsigned output_x = 0;
+		unsigned output_y = 0;
+		unsigned output_width = 0;
+		unsigned output_height = 0;
+	};
+
 	struct CUDA_transfer_data
 	{
-		void *_input_memory;
-		void *_depth_memory;
-		void *_output_memory;
-		size_t _pitch;
+		void *_input_memory = nullptr;
+		void *_depth_memory = nullptr;
+		void *_output_memory = nullptr;
+		size_t _pitch = 0;
+		size_t _output_pitch = 0;
 		float _near_range = 0.1f;
 		float _far_range = 1000.0f;
+		bool _record_stages = false;
+		cudaEvent_t _stage_events[STAGE_EVENT_COUNT] = {};
+		bool _stage_recorded[STAGE_EVENT_COUNT] = {};
+		Surface_Binding _surfaces[MAX_SURFACE_BINDINGS];
+		unsigned _surface_count = 0;
+		Batch_Entry _batch[MAX_BATCH_ENTRIES];
+		unsigned _batch_count = 0;
 	};
 
+	// The transfer data is owned by the graph execution session, the ops get the one of their run through a TFBinding
 	class TFCuda
 	{
 	public:
-		static void *get_input_memory_pointer();
-		static void set_input_memory_pointer(void *pointer);
-		static void *get_depth_memory_pointer();
-		static void set_depth_memory_pointer(void *pointer);
-		static void *get_output_memory_pointer();
-		static void set_output_memory_pointer(void *pointer);
-		static size_t get_pitch();
-		static void set_pitch(size_t pitch);
-		static float get_near_range();
-		static void set_near_range(float near_range);
-		static float get_far_range();
-		static void set_far_range(float far_range);
+		static void record_stage_event(CUDA_transfer_data &data, StageEvent event, cudaStream_t stream);
+		static bool bind_surface(CUDA_transfer_data &data, const char *name, void *memory, size_t pitch);
+		static const Surface_Binding *find_surface(const CUDA_transfer_data &data, const std::string &name);
+		static bool bind_views(CUDA_transfer_data &data, unsigned views, unsigned width, unsigned height, unsigned window_width, unsigned surface_width, unsigned output_pixel_size);
 	};
 }
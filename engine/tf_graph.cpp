@@ -0,0 +1,326 @@
+#include "tf_graph.h"
+#include "tf_interactive_io.h"
+#include <algorithm>
+
+namespace PLUGIN_NAMESPACE
+{
+	unsigned TFGraph::align_network_size(unsigned size)
+	{
+		return (size + NETWORK_SIZE_ALIGNMENT - 1) / NETWORK_SIZE_ALIGNMENT * NETWORK_SIZE_ALIGNMENT;
+	}
+
+	TF::NodeDef *TFGraph::find_node(TF::GraphDef &graph, const std::string &name)
+	{
+		return const_cast<TF::NodeDef*>(find_node(static_cast<const TF::GraphDef&>(graph), name));
+	}
+
+	// Inputs can reference a specific output with "node:1" or be control inputs with "^node"
+	std::string base_name(const std::string &input)
+	{
+		std::string node_name = input;
+		if (!node_name.empty() && node_name[0] == '^')
+			node_name = node_name.substr(1);
+		size_t colon = node_name.find(':');
+		if (colon != std::string::npos)
+			node_name = node_name.substr(0, colon);
+		return node_name;
+	}
+
+	const TF::NodeDef *TFGraph::find_node(const TF::GraphDef &graph, const std::string &name)
+	{
+		std::string node_name = base_name(name);
+		for (const TF::NodeDef &node : graph.node())
+		{
+			if (node.name() == node_name)
+				return &node;
+		}
+		return nullptr;
+	}
+
+	// Returns the level of a transposed convolution from names like "deconvolution_3_up"
+	int level_from_name(const std::string &name)
+	{
+		const std::string prefix = "deconvolution_";
+		if (name.compare(0, prefix.size(), prefix) != 0 || name.size() <= prefix.size())
+			return -1;
+		char level = name[prefix.size()];
+		return level >= '0' && level <= '9' ? level - '0' : -1;
+	}
+
+	TF::Status set_scalar_const(TF::NodeDef *node, int value)
+	{
+		if (node == nullptr || node->op() != "Const")
+			return TF::errors::InvalidArgument("Expected a constant for the output shape of a transposed convolution");
+
+		TF::TensorProto *tensor = (*node->mutable_attr())["value"].mutable_tensor();
+		tensor->clear_int_val();
+		tensor->clear_tensor_content();
+		tensor->add_int_val(value);
+		return TF::Status::OK();
+	}
+
+	// Rewrites the placeholder and the output shapes of the transposed convolutions so one exported graph runs at any size.
+	// The graph may already be specialized to another size, the levels are then recovered from the old sizes.
+	TF::Status TFGraph::specialize(TF::GraphDef &graph, const std::string &input_name, unsigned width, unsigned height)
+	{
+		if (width % NETWORK_SIZE_ALIGNMENT != 0 || height % NETWORK_SIZE_ALIGNMENT != 0)
+			return TF::errors::InvalidArgument("Network size has to be a multiple of ", NETWORK_SIZE_ALIGNMENT);
+
+		TF::NodeDef *input = find_node(graph, input_name);
+		if (input == nullptr || input->op() != "Placeholder")
+			return TF::errors::NotFound("Could not find the placeholder ", input_name);
+
+		// Placeholder layout is (batch, width, height, channels)
+		TF::TensorShapeProto *shape = (*input->mutable_attr())["shape"].mutable_shape();
+		if (shape->dim_size() != 4)
+			return TF::errors::InvalidArgument("Placeholder ", input_name, " has to have 4 dimensions");
+
+		TF::int64 old_height = shape->dim(2).size();
+		shape->mutable_dim(1)->set_size(width);
+		shape->mutable_dim(2)->set_size(height);
+
+		for (int i = 0; i < graph.node_size(); ++i)
+		{
+			const TF::NodeDef &deconvolution = graph.node(i);
+			if (deconvolution.op() != "Conv2DBackpropInput" || deconvolution.input_size() < 1)
+				continue;
+
+			TF::NodeDef *pack = find_node(graph, deconvolution.input(0));
+			if (pack == nullptr || pack->op() != "Pack" || pack->input_size() != 4)
+				continue;
+
+			// The network runs transposed, so the packed shape is (batch, height, width, features)
+			TF::NodeDef *height_node = find_node(graph, pack->input(1));
+			TF::NodeDef *width_node = find_node(graph, pack->input(2));
+			if (height_node == nullptr || width_node == nullptr)
+				return TF::errors::InvalidArgument("Unexpected output shape of ", deconvolution.name());
+
+			int level = level_from_name(deconvolution.name());
+			if (old_height > 0 && height_node->attr().count("value"))
+			{
+				const TF::TensorProto &value = height_node->attr().at("value").tensor();
+				if (value.int_val_size() == 1 && value.int_val(0) > 0)
+				{
+					TF::int64 factor = old_height / value.int_val(0);
+					level = 0;
+					while ((1ll << level) < factor)
+						++level;
+				}
+			}
+
+			if (level < 0)
+				return TF::errors::InvalidArgument("Could not determine the level of ", deconvolution.name());
+
+			TF::Status status = set_scalar_const(height_node, (int)(height >> level));
+			if (!status.ok())
+				return status;
+			status = set_scalar_const(width_node, (int)(width >> level));
+			if (!status.ok())
+				return status;
+		}
+
+		return TF::Status::OK();
+	}
+
+	// True if both graphs take the same input placeholder and produce the output with the same op, which is all the
+	// buffers and callables bound to a session depend on
+	bool TFGraph::same_interface(TF::GraphDef &graph, TF::GraphDef &other, const std::string &input_name, const std::string &output_name)
+	{
+		TF::NodeDef *input = find_node(graph, input_name);
+		TF::NodeDef *other_input = find_node(other, input_name);
+		if (input == nullptr || other_input == nullptr || input->op() != other_input->op())
+			return false;
+
+		if (input->attr().count("dtype") != other_input->attr().count("dtype") ||
+			(input->attr().count("dtype") && input->attr().at("dtype").type() != other_input->attr().at("dtype").type()))
+			return false;
+
+		if (input->attr().count("shape") && other_input->attr().count("shape"))
+		{
+			const TF::TensorShapeProto &shape = input->attr().at("shape").shape();
+			const TF::TensorShapeProto &other_shape = other_input->attr().at("shape").shape();
+			if (shape.dim_size() != other_shape.dim_size())
+				return false;
+			for (int i = 0; i < shape.dim_size(); ++i)
+			{
+				if (shape.dim(i).size() != other_shape.dim(i).size())
+					return false;
+			}
+		}
+
+		TF::NodeDef *output = find_node(graph, output_name);
+		TF::NodeDef *other_output = find_node(other, output_name);
+		return output != nullptr && other_output != nullptr && output->op() == other_output->op() &&
+			output_format(graph, output_name) == output_format(other, output_name);
+	}
+
+	// Pixel format the output op writes into the output buffer, graphs without the format attribute write R32F
+	int TFGraph::output_format(const TF::GraphDef &graph, const std::string &output_name)
+	{
+		const TF::NodeDef *output = find_node(graph, output_name);
+		if (output == nullptr || !output->attr().count("format"))
+			return PixelR32F;
+		int format = pixel_format_from_name(output->attr().at("format").s().c_str());
+		return format < PIXEL_FORMAT_COUNT ? format : PixelR32F;
+	}
+
+	bool is_scatter(const TF::NodeDef &node)
+	{
+		return node.attr().count("mode") && node.attr().at("mode").s() == "scatter";
+	}
+
+	// Placeholder layout is (batch, width, height, channels), unknown channels count as the full network
+	unsigned TFGraph::input_channels(const TF::GraphDef &graph, const std::string &input_name)
+	{
+		const TF::NodeDef *input = find_node(graph, input_name);
+		if (input == nullptr || !input->attr().count("shape"))
+			return DEFAULT_INPUT_CHANNELS;
+		const TF::TensorShapeProto &shape = input->attr().at("shape").shape();
+		if (shape.unknown_rank() || shape.dim_size() != 4 || shape.dim(3).size() <= 0)
+			return DEFAULT_INPUT_CHANNELS;
+		return (unsigned)shape.dim(3).size();
+	}
+
+	// True if any op of the graph reads the normals buffer. The InteractiveInput op packs depth only for a single channel
+	// input, graphs fed by InteractiveDepthInput alone never need the normals either.
+	bool TFGraph::reads_normals(const TF::GraphDef &graph, const std::string &input_name)
+	{
+		for (const TF::NodeDef &node : graph.node())
+		{
+			if (node.op() == "InteractiveNormalsInput")
+				return true;
+			if (node.op() == "InteractiveInput" && input_channels(graph, input_name) != 1)
+				return true;
+			if (node.op() == "InteractiveIO" && !is_scatter(node) && node.attr().count("bindings"))
+			{
+				for (const std::string &binding : node.attr().at("bindings").list().s())
+				{
+					if (binding == "normals")
+						return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool is_interactive_input(const TF::NodeDef &node)
+	{
+		return node.op() == "InteractiveInput" || node.op() == "InteractiveNormalsInput" || node.op() == "InteractiveDepthInput" ||
+			(node.op() == "InteractiveIO" && !is_scatter(node));
+	}
+
+	bool is_interactive_output(const TF::NodeDef &node)
+	{
+		return node.op() == "InteractiveOutput" || node.op() == "InteractiveDepthOutput" || (node.op() == "InteractiveIO" && is_scatter(node));
+	}
+
+	bool has_nhwc_layout(const TF::NodeDef &node)
+	{
+		return node.attr().count("layout") && node.attr().at("layout").s() == "NHWC";
+	}
+
+	// Matches the transposes swapping width and height, tf.transpose(x, [0, 2, 1, 3])
+	bool is_layout_transpose(const TF::GraphDef &graph, const TF::NodeDef *node)
+	{
+		if (node == nullptr || node->op() != "Transpose" || node->input_size() != 2)
+			return false;
+
+		const TF::NodeDef *perm = TFGraph::find_node(graph, node->input(1));
+		if (perm == nullptr || perm->op() != "Const" || !perm->attr().count("value"))
+			return false;
+
+		TF::Tensor value;
+		if (!value.FromProto(perm->attr().at("value").tensor()) || value.dtype() != TF::DT_INT32 || value.NumElements() != 4)
+			return false;
+
+		auto dims = value.flat<TF::int32>();
+		return dims(0) == 0 && dims(1) == 2 && dims(2) == 1 && dims(3) == 3;
+	}
+
+	std::vector<TF::NodeDef*> consumers_of(TF::GraphDef &graph, const std::string &name)
+	{
+		std::vector<TF::NodeDef*> consumers;
+		for (TF::NodeDef &node : *graph.mutable_node())
+		{
+			for (const std::string &input : node.input())
+			{
+				if (base_name(input) == name)
+				{
+					consumers.push_back(&node);
+					break;
+				}
+			}
+		}
+		return consumers;
+	}
+
+	// Points every input reading the node to the first input of the node
+	void bypass_node(TF::GraphDef &graph, const TF::NodeDef &node)
+	{
+		const std::string source = node.input(0);
+		for (TF::NodeDef &consumer : *graph.mutable_node())
+		{
+			for (std::string &input : *consumer.mutable_input())
+			{
+				if (input == node.name() || input == node.name() + ":0")
+					input = source;
+				else if (input == "^" + node.name())
+					input = "^" + base_name(source);
+			}
+		}
+	}
+
+	// The interactive ops can read and write (batch, height, width, channels) directly, which is the order the network runs in.
+	// Switches them to that layout and drops the start and end transposes around the network, returns the removed transposes.
+	// The NWHC ops lay the rows of the surfaces out densely as (width, height), which only is the transposed image for square
+	// sizes. For other sizes the folded network sees the image itself where the unfolded one saw its rows laid out again.
+	unsigned TFGraph::fold_transposes(TF::GraphDef &graph)
+	{
+		std::vector<std::string> removed;
+		for (TF::NodeDef &node : *graph.mutable_node())
+		{
+			if (has_nhwc_layout(node))
+				continue;
+
+			TF::NodeDef *transpose = nullptr;
+			if (is_interactive_input(node))
+			{
+				std::vector<TF::NodeDef*> consumers = consumers_of(graph, node.name());
+				if (consumers.size() == 1 && is_layout_transpose(graph, consumers[0]) && base_name(consumers[0]->input(0)) == node.name())
+					transpose = consumers[0];
+			}
+			else if (is_interactive_output(node) && node.input_size() > 0)
+			{
+				TF::NodeDef *input = find_node(graph, node.input(0));
+				if (is_layout_transpose(graph, input) && consumers_of(graph, input->name()).size() == 1)
+					transpose = input;
+			}
+
+			if (transpose == nullptr)
+				continue;
+
+			(*node.mutable_attr())["layout"].set_s("NHWC");
+			bypass_node(graph, *transpose);
+			removed.push_back(transpose->name());
+		}
+
+		// The permutation constants go as well once nothing else reads them
+		unsigned transposes = (unsigned)removed.size();
+		for (unsigned i = 0; i < transposes; ++i)
+		{
+			const std::string name = removed[i];
+			const TF::NodeDef *transpose = find_node(graph, name);
+			std::string perm = base_name(transpose->input(1));
+			if (consumers_of(graph, perm).size() == 1)
+				removed.push_back(perm);
+		}
+
+		for (int i = graph.node_size() - 1; i >= 0; --i)
+		{
+			if (std::find(removed.begin(), removed.end(), graph.node(i).name()) != removed.end())
+				graph.mutable_node()->DeleteSubrange(i, 1);
+		}
+
+		return transposes;
+	}
+}
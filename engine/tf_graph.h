@@ -0,0 +1,29 @@
+#pragma once
+
+#include "tf_settings.h"
+
+namespace PLUGIN_NAMESPACE
+{
+	namespace TF = tensorflow;
+
+	// The NNAO network pools four times, every network dimension has to be a multiple of this
+	const unsigned NETWORK_SIZE_ALIGNMENT = 16;
+
+	// Channels of the input placeholder when the graph does not say, normals and depth of the full NNAO network
+	const unsigned DEFAULT_INPUT_CHANNELS = 4;
+
+	// Rewrites of loaded graphs before a session gets created from them
+	class TFGraph
+	{
+	public:
+		static unsigned align_network_size(unsigned size);
+		static TF::NodeDef *find_node(TF::GraphDef &graph, const std::string &name);
+		static const TF::NodeDef *find_node(const TF::GraphDef &graph, const std::string &name);
+		static TF::Status specialize(TF::GraphDef &graph, const std::string &input_name, unsigned width, unsigned height);
+		static bool same_interface(TF::GraphDef &graph, TF::GraphDef &other, const std::string &input_name, const std::string &output_name);
+		static unsigned fold_transposes(TF::GraphDef &graph);
+		static int output_format(const TF::GraphDef &graph, const std::string &output_name);
+		static unsigned input_channels(const TF::GraphDef &graph, const std::string &input_name);
+		static bool reads_normals(const TF::GraphDef &graph, const std::string &input_name);
+	};
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Pixel conversions shared by the cpu and the cuda kernels of the InteractiveIO op
+#ifdef __CUDACC__
+#define IO_FUNC __host__ __device__ inline
+#else
+#define IO_FUNC inline
+#endif
+
+enum Pixel_Format { PixelR8G8B8A8, PixelR16F, PixelR32F, PixelR11G11B10, PixelR8, PIXEL_FORMAT_COUNT };
+
+// One op gathers from or scatters to at most this many surfaces, each with up to four channels
+const int MAX_IO_BINDINGS = 4;
+
+// Swizzle entries that do not read a surface channel
+const int SWIZZLE_ZERO = -1;
+const int SWIZZLE_ONE = -2;
+
+// A surface and how its channels map to a consecutive block of tensor channels. Gathering writes the surface channel
+// swizzle[i] to tensor channel i of the block, scattering writes tensor channel i to surface channel swizzle[i].
+// Values are normalized with value * scale + offset on the way.
+struct IO_Binding
+{
+	void *memory;
+	size_t pitch;
+	int format;
+	int channels;
+	int swizzle[4];
+	float scale;
+	float offset;
+};
+
+struct IO_Params
+{
+	IO_Binding bindings[MAX_IO_BINDINGS];
+	int binding_count;
+	int tensor_channels;
+};
+
+// Names used by the format attributes of the ops, unknown names give PIXEL_FORMAT_COUNT
+inline int pixel_format_from_name(const char *name)
+{
+	static const char *format_names[PIXEL_FORMAT_COUNT] = { "R8G8B8A8", "R16F", "R32F", "R11G11B10", "R8" };
+	int format = 0;
+	while (format < PIXEL_FORMAT_COUNT && strcmp(format_names[format], name) != 0)
+		++format;
+	return format;
+}
+
+IO_FUNC float io_bits_to_float(uint32_t bits)
+{
+#ifdef __CUDA_ARCH__
+	return __uint_as_float(bits);
+#else
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+#endif
+}
+
+IO_FUNC uint32_t io_float_to_bits(float value)
+{
+#ifdef __CUDA_ARCH__
+	return __float_as_uint(value);
+#else
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+#endif
+}
+
+IO_FUNC float half_to_float(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+	if (exponent == 0)
+	{
+		float value = mantissa * 5.9604644775390625e-8f;
+		return sign ? -value : value;
+	}
+	if (exponent == 31)
+		return io_bits_to_float(sign | 0x7f800000 | (mantissa << 13));
+	return io_bits_to_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// Rounds to nearest even, too large values become infinity
+IO_FUNC uint16_t float_to_half(float value)
+{
+	uint32_t bits = io_float_to_bits(value);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t mantissa = bits & 0x7fffff;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+
+	if ((bits & 0x7fffffff) >= 0x7f800000)
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7c00);
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t result = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (result & 1)))
+			++result;
+		return (uint16_t)(sign | result);
+	}
+
+	uint32_t result = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+		++result;
+	return (uint16_t)result;
+}
+
+// The packed float channels are halfs without a sign and with 6 or 5 mantissa bits
+IO_FUNC float small_float_to_float(uint32_t bits, int mantissa_bits)
+{
+	return half_to_float((uint16_t)(bits << (10 - mantissa_bits)));
+}
+
+IO_FUNC uint32_t float_to_small_float(float value, int mantissa_bits)
+{
+	const uint32_t max_finite = (30u << mantissa_bits) | ((1u << mantissa_bits) - 1);
+	if (!(value > 0.0f))
+		return 0;
+	uint32_t half = float_to_half(value);
+	if (half >= 0x7c00)
+		return max_finite;
+	uint32_t drop = 10 - mantissa_bits;
+	uint32_t result = (half + (1u << (drop - 1))) >> drop;
+	return result > max_finite ? max_finite : result;
+}
+
+IO_FUNC int pixel_size(int format)
+{
+	return format == PixelR8 ? 1 : format == PixelR16F ? 2 : 4;
+}
+
+IO_FUNC int pixel_channels(int format)
+{
+	return format == PixelR8G8B8A8 ? 4 : format == PixelR11G11B10 ? 3 : 1;
+}
+
+IO_FUNC void decode_pixel(int format, const unsigned char *src, float value[4])
+{
+	value[0] = value[1] = value[2] = value[3] = 0.0f;
+	if (format == PixelR8G8B8A8)
+	{
+		value[0] = (float)src[0];
+		value[1] = (float)src[1];
+		value[2] = (float)src[2];
+		value[3] = (float)src[3];
+	}
+	else if (format == PixelR8)
+		value[0] = (float)src[0];
+	else if (format == PixelR16F)
+		value[0] = half_to_float(*(const uint16_t*)src);
+	else if (format == PixelR32F)
+		value[0] = *(const float*)src;
+	else if (format == PixelR11G11B10)
+	{
+		uint32_t packed = *(const uint32_t*)src;
+		value[0] = small_float_to_float(packed & 0x7ff, 6);
+		value[1] = small_float_to_float((packed >> 11) & 0x7ff, 6);
+		value[2] = small_float_to_float(packed >> 22, 5);
+	}
+}
+
+IO_FUNC unsigned char quantize_byte(float value)
+{
+	float clamped = value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : value;
+	return (unsigned char)(clamped + 0.5f);
+}
+
+IO_FUNC void encode_pixel(int format, const float value[4], unsigned char *dest)
+{
+	if (format == PixelR8G8B8A8)
+	{
+		for (int channel = 0; channel < 4; ++channel)
+			dest[channel] = quantize_byte(value[channel]);
+	}
+	else if (format == PixelR8)
+		dest[0] = quantize_byte(value[0]);
+	else if (format == PixelR16F)
+		*(uint16_t*)dest = float_to_half(value[0]);
+	else if (format == PixelR32F)
+		*(float*)dest = value[0];
+	else if (format == PixelR11G11B10)
+	{
+		*(uint32_t*)dest = float_to_small_float(value[0], 6) | (float_to_small_float(value[1], 6) << 11) |
+			(float_to_small_float(value[2], 5) << 22);
+	}
+}
+
+// Single channel result of the output ops, R8 is a unorm format so the value gets mapped from (0, 1). The quantization error
+// stays below 0.5 / 255 for R8 and below 2^-11 relative to the value for R16F.
+IO_FUNC void encode_output(int format, float value, unsigned char *dest)
+{
+	if (format == PixelR8)
+		dest[0] = quantize_byte(value * 255.0f);
+	else if (format == PixelR16F)
+		*(uint16_t*)dest = float_to_half(value);
+	else
+		*(float*)dest = value;
+}
+
+// Reads a single channel result back, the inverse of encode_output
+IO_FUNC float decode_output(int format, const unsigned char *src)
+{
+	if (format == PixelR8)
+		return src[0] / 255.0f;
+	if (format == PixelR16F)
+		return half_to_float(*(const uint16_t*)src);
+	return *(const float*)src;
+}
+
+template <typename T>
+IO_FUNC void gather_pixel(const IO_Params &params, int x, int y, T *dest)
+{
+	int channel = 0;
+	for (int b = 0; b < params.binding_count; ++b)
+	{
+		const IO_Binding &binding = params.bindings[b];
+		float value[4];
+		decode_pixel(binding.format, (const unsigned char*)binding.memory + y * binding.pitch + x * pixel_size(binding.format), value);
+		for (int i = 0; i < binding.channels; ++i, ++channel)
+		{
+			int source = binding.swizzle[i];
+			if (source >= 0)
+				dest[channel] = (T)(value[source] * binding.scale + binding.offset);
+			else
+				dest[channel] = (T)(source == SWIZZLE_ONE ? 1.0f : 0.0f);
+		}
+	}
+}
+
+template <typename T>
+IO_FUNC void scatter_pixel(const IO_Params &params, int x, int y, const T *src)
+{
+	int channel = 0;
+	for (int b = 0; b < params.binding_count; ++b)
+	{
+		const IO_Binding &binding = params.bindings[b];
+		float value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < binding.channels; ++i, ++channel)
+			value[binding.swizzle[i]] = (float)src[channel] * binding.scale + binding.offset;
+		encode_pixel(binding.format, value, (unsigned char*)binding.memory + y * binding.pitch + x * pixel_size(binding.format));
+	}
+}
+
+// Octahedral normals, the unit normal is projected onto the octahedron |x| + |y| + |z| = 1 and the lower half gets folded
+// over the diagonals. Two values in (-1, 1) hold a normal with a round trip error far below the 8 bits of the normals
+// target, a zero vector encodes as (0, 0).
+IO_FUNC float octahedral_sign(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+IO_FUNC void octahedral_encode(float x, float y, float z, float &u, float &v)
+{
+	float length = fabsf(x) + fabsf(y) + fabsf(z);
+	if (!(length > 0.0f))
+	{
+		u = v = 0.0f;
+		return;
+	}
+
+	u = x / length;
+	v = y / length;
+	if (z < 0.0f)
+	{
+		float folded_u = (1.0f - fabsf(v)) * octahedral_sign(u);
+		v = (1.0f - fabsf(u)) * octahedral_sign(v);
+		u = folded_u;
+	}
+}
+
+IO_FUNC void octahedral_decode(float u, float v, float &x, float &y, float &z)
+{
+	x = u;
+	y = v;
+	z = 1.0f - fabsf(u) - fabsf(v);
+	if (z < 0.0f)
+	{
+		x = (1.0f - fabsf(v)) * octahedral_sign(u);
+		y = (1.0f - fabsf(u)) * octahedral_sign(v);
+	}
+
+	float length = sqrtf(x * x + y * y + z * z);
+	x /= length;
+	y /= length;
+	z /= length;
+}
+
+// Input packing of a pixel of the R8G8B8A8 normals target, the bytes hold normal * 0.5 + 0.5 and the encoded normal is
+// mapped the same way so every input channel stays within (0, 1)
+IO_FUNC void octahedral_normal(const unsigned char *src, float &u, float &v)
+{
+	octahedral_encode(src[0] / 127.5f - 1.0f, src[1] / 127.5f - 1.0f, src[2] / 127.5f - 1.0f, u, v);
+	u = u * 0.5f + 0.5f;
+	v = v * 0.5f + 0.5f;
+}
@@ -7,30 +7,30 @@ namespace PLUGIN_NAMESPACE {
 		REGISTER_OP("InteractiveInput")
 			.Input("interactive_input: float")
 			.Output("from_interactive: float")
-			.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
-			c->set_output(0, c->input(0));
-			return TF::Status::OK();
-		});
+			.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+			.Attr("binding: string = 'interactive'")
+			.SetShapeFn(interactive_input_shape);
 
 		REGISTER_OP("InteractiveNormalsInput")
 			.Input("interactive_input: float")
 			.Output("from_interactive: float")
-			.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
-			c->set_output(0, c->input(0));
-			return TF::Status::OK();
-		});
+			.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+			.Attr("binding: string = 'interactive'")
+			.SetShapeFn(interactive_input_shape);
 
 		REGISTER_OP("InteractiveDepthInput")
 			.Input("interactive_input: float")
 			.Output("from_interactive: float")
-			.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
-			c->set_output(0, c->input(0));
-			return TF::Status::OK();
-		});
+			.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+			.Attr("binding: string = 'interactive'")
+			.SetShapeFn(interactive_input_shape);
 
 		REGISTER_OP("InteractiveOutput")
 			.Input("to_interactive: float")
 			.Output("interactive_output: float")
+			.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+			.Attr("binding: string = 'interactive'")
+			.Attr("format: {'R32F', 'R16F', 'R8'} = 'R32F'")
 			.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
 			c->set_output(0, c->input(0));
 			return TF::Status::OK();
@@ -39,11 +39,34 @@ namespace PLUGIN_NAMESPACE {
 		REGISTER_OP("InteractiveDepthOutput")
 			.Input("to_interactive: float")
 			.Output("interactive_output: float")
+			.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+			.Attr("binding: string = 'interactive'")
+			.Attr("format: {'R32F', 'R16F', 'R8'} = 'R32F'")
 			.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
 			c->set_output(0, c->input(0));
 			return TF::Status::OK();
 		});
 
+		REGISTER_OP("InteractiveIO")
+			.Input("interactive_input: float")
+			.Output("interactive_output: float")
+			.Attr("mode: {'gather', 'scatter'} = 'gather'")
+			.Attr("bindings: list(string)")
+			.Attr("formats: list(string)")
+			.Attr("swizzles: list(string)")
+			.Attr("ranges: list(float) = []")
+			.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+			.Attr("binding: string = 'interactive'")
+			.SetShapeFn(interactive_io_shape);
+
+		REGISTER_OP("InteractiveTensorStats")
+			.Input("to_check: float")
+			.Output("checked: float")
+			.Attr("interval: int = 30")
+			.Attr("histogram_min: float = 0.0")
+			.Attr("histogram_max: float = 1.0")
+			.SetShapeFn(TF::shape_inference::UnchangedShape);
+
 		REGISTER_OP("InteractiveDebugPrint")
 			.Input("to_print: float")
 			.Output("printed: float")
@@ -52,11 +75,23 @@ namespace PLUGIN_NAMESPACE {
 			return TF::Status::OK();
 		});
 
+#ifndef INTERACTIVE_CPU_ONLY
 		REGISTER_KERNEL_BUILDER(Name("InteractiveInput").Device(TF::DEVICE_GPU), InteractiveInputOp<Eigen::GpuDevice, float>);
 		REGISTER_KERNEL_BUILDER(Name("InteractiveNormalsInput").Device(TF::DEVICE_GPU), InteractiveNormalsInputOp<Eigen::GpuDevice, float>);
 		REGISTER_KERNEL_BUILDER(Name("InteractiveDepthInput").Device(TF::DEVICE_GPU), InteractiveDepthInputOp<Eigen::GpuDevice, float>);
 		REGISTER_KERNEL_BUILDER(Name("InteractiveOutput").Device(TF::DEVICE_GPU), InteractiveOutputOp<Eigen::GpuDevice, float>);
 		REGISTER_KERNEL_BUILDER(Name("InteractiveDepthOutput").Device(TF::DEVICE_GPU), InteractiveDepthOutputOp<Eigen::GpuDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveIO").Device(TF::DEVICE_GPU), InteractiveIOOp<Eigen::GpuDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveTensorStats").Device(TF::DEVICE_GPU), InteractiveTensorStatsOp<Eigen::GpuDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveDebugPrint").Device(TF::DEVICE_GPU), InteractiveDebugPrintOp<Eigen::GpuDevice, float>);
+#endif
+		REGISTER_KERNEL_BUILDER(Name("InteractiveInput").Device(TF::DEVICE_CPU), InteractiveInputOp<Eigen::ThreadPoolDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveNormalsInput").Device(TF::DEVICE_CPU), InteractiveNormalsInputOp<Eigen::ThreadPoolDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveDepthInput").Device(TF::DEVICE_CPU), InteractiveDepthInputOp<Eigen::ThreadPoolDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveOutput").Device(TF::DEVICE_CPU), InteractiveOutputOp<Eigen::ThreadPoolDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveDepthOutput").Device(TF::DEVICE_CPU), InteractiveDepthOutputOp<Eigen::ThreadPoolDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveIO").Device(TF::DEVICE_CPU), InteractiveIOOp<Eigen::ThreadPoolDevice, float>);
+		REGISTER_KERNEL_BUILDER(Name("InteractiveTensorStats").Device(TF::DEVICE_CPU), InteractiveTensorStatsOp<Eigen::ThreadPoolDevice, float>);
 		REGISTER_KERNEL_BUILDER(Name("InteractiveDebugPrint").Device(TF::DEVICE_CPU), InteractiveDebugPrintOp<Eigen::ThreadPoolDevice, float>);
 	}
 } // PLUGIN_NAMESPACE
@@ -66,30 +101,30 @@ namespace PLUGIN_NAMESPACE {
 REGISTER_OP("InteractiveInput")
 .Input("interactive_input: float")
 .Output("from_interactive: float")
-.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
-	c->set_output(0, c->input(0));
-	return TF::Status::OK();
-});
+.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+.Attr("binding: string = 'interactive'")
+.SetShapeFn(interactive_input_shape);
 
 REGISTER_OP("InteractiveNormalsInput")
 .Input("interactive_input: float")
 .Output("from_interactive: float")
-.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
-	c->set_output(0, c->input(0));
-	return TF::Status::OK();
-});
+.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+.Attr("binding: string = 'interactive'")
+.SetShapeFn(interactive_input_shape);
 
 REGISTER_OP("InteractiveDepthInput")
 .Input("interactive_input: float")
 .Output("from_interactive: float")
-.SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
-	c->set_output(0, c->input(0));
-	return TF::Status::OK();
-});
+.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+.Attr("binding: string = 'interactive'")
+.SetShapeFn(interactive_input_shape);
 
 REGISTER_OP("InteractiveOutput")
 .Input("to_interactive: float")
 .Output("interactive_output: float")
+.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+.Attr("binding: string = 'interactive'")
+.Attr("format: {'R32F', 'R16F', 'R8'} = 'R32F'")
 .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
 	c->set_output(0, c->input(0));
 	return TF::Status::OK();
@@ -98,11 +133,34 @@ REGISTER_OP("InteractiveOutput")
 REGISTER_OP("InteractiveDepthOutput")
 .Input("to_interactive: float")
 .Output("interactive_output: float")
+.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+.Attr("binding: string = 'interactive'")
+.Attr("format: {'R32F', 'R16F', 'R8'} = 'R32F'")
 .SetShapeFn([](::tensorflow::shape_inference::InferenceContext* c) {
 	c->set_output(0, c->input(0));
 	return TF::Status::OK();
 });
 
+REGISTER_OP("InteractiveIO")
+.Input("interactive_input: float")
+.Output("interactive_output: float")
+.Attr("mode: {'gather', 'scatter'} = 'gather'")
+.Attr("bindings: list(string)")
+.Attr("formats: list(string)")
+.Attr("swizzles: list(string)")
+.Attr("ranges: list(float) = []")
+.Attr("layout: {'NWHC', 'NHWC'} = 'NWHC'")
+.Attr("binding: string = 'interactive'")
+.SetShapeFn(interactive_io_shape);
+
+REGISTER_OP("InteractiveTensorStats")
+.Input("to_check: float")
+.Output("checked: float")
+.Attr("interval: int = 30")
+.Attr("histogram_min: float = 0.0")
+.Attr("histogram_max: float = 1.0")
+.SetShapeFn(TF::shape_inference::UnchangedShape);
+
 REGISTER_OP("InteractiveDebugPrint")
 .Input("to_print: float")
 .Output("printed: float")
@@ -116,6 +174,16 @@ REGISTER_KERNEL_BUILDER(Name("InteractiveNormalsInput").Device(TF::DEVICE_GPU),
 REGISTER_KERNEL_BUILDER(Name("InteractiveDepthInput").Device(TF::DEVICE_GPU), InteractiveDepthInputOp<Eigen::GpuDevice, float>);
 REGISTER_KERNEL_BUILDER(Name("InteractiveOutput").Device(TF::DEVICE_GPU), InteractiveOutputOp<Eigen::GpuDevice, float>);
 REGISTER_KERNEL_BUILDER(Name("InteractiveDepthOutput").Device(TF::DEVICE_GPU), InteractiveDepthOutputOp<Eigen::GpuDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveInput").Device(TF::DEVICE_CPU), InteractiveInputOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveNormalsInput").Device(TF::DEVICE_CPU), InteractiveNormalsInputOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveDepthInput").Device(TF::DEVICE_CPU), InteractiveDepthInputOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveOutput").Device(TF::DEVICE_CPU), InteractiveOutputOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveDepthOutput").Device(TF::DEVICE_CPU), InteractiveDepthOutputOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveIO").Device(TF::DEVICE_GPU), InteractiveIOOp<Eigen::GpuDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveIO").Device(TF::DEVICE_CPU), InteractiveIOOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveTensorStats").Device(TF::DEVICE_GPU), InteractiveTensorStatsOp<Eigen::GpuDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveTensorStats").Device(TF::DEVICE_CPU), InteractiveTensorStatsOp<Eigen::ThreadPoolDevice, float>);
+REGISTER_KERNEL_BUILDER(Name("InteractiveDebugPrint").Device(TF::DEVICE_GPU), InteractiveDebugPrintOp<Eigen::GpuDevice, float>);
 REGISTER_KERNEL_BUILDER(Name("InteractiveDebugPrint").Device(TF::DEVICE_CPU), InteractiveDebugPrintOp<Eigen::ThreadPoolDevice, float>);
 
 #endif  // GOOGLE_CUDA
\ No newline at end of file
@@ -2,17 +2,24 @@
 #define INTERACTIVE_KERNEL_H_
 
 // Tensorflow Dependent Defines
+#ifdef _MSC_VER
 #define COMPILER_MSVC
 #define NOMINMAX
 #define PROTOBUF_USE_DLLS
+#endif
 #define EIGEN_USE_GPU
 #define EIGEN_USE_THREADS
 
 #include "tf_cuda.h"
+#include "tf_binding.h"
+#include "tf_interactive_io.h"
+#include "tf_tensor_stats.h"
 #pragma warning(push, 0)
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/common_shape_fns.h"
 #pragma warning(pop)
+#include <atomic>
+#include <vector>
 
 namespace TF = tensorflow;
 
@@ -22,9 +29,97 @@ namespace PLUGIN_NAMESPACE {
 
 } // PLUGIN_NAMESPACE
 
+// Input ops emit (batch, width, height, channels) by default, with the NHWC layout they emit (batch, height, width, channels)
+// which is the order the network runs in. The pixels are written row by row either way, only the reported shape changes.
+inline TF::Status interactive_input_shape(TF::shape_inference::InferenceContext* c) {
+	std::string layout;
+	TF_RETURN_IF_ERROR(c->GetAttr("layout", &layout));
+	if (layout != "NHWC") {
+		c->set_output(0, c->input(0));
+		return TF::Status::OK();
+	}
+
+	TF::shape_inference::ShapeHandle input;
+	TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 4, &input));
+	c->set_output(0, c->MakeShape({ c->Dim(input, 0), c->Dim(input, 2), c->Dim(input, 1), c->Dim(input, 3) }));
+	return TF::Status::OK();
+}
+
+inline bool read_nhwc_layout(TF::OpKernelConstruction* context) {
+	std::string layout;
+	return context->GetAttr("layout", &layout).ok() && layout == "NHWC";
+}
+
+// Channels of the gathered tensor, the sum of the swizzle lengths of all bindings
+inline TF::Status interactive_io_shape(TF::shape_inference::InferenceContext* c) {
+	std::string mode;
+	TF_RETURN_IF_ERROR(c->GetAttr("mode", &mode));
+	if (mode == "scatter") {
+		c->set_output(0, c->input(0));
+		return TF::Status::OK();
+	}
+
+	std::vector<std::string> swizzles;
+	TF_RETURN_IF_ERROR(c->GetAttr("swizzles", &swizzles));
+	TF::int64 channels = 0;
+	for (const std::string& swizzle : swizzles)
+		channels += swizzle.size();
+
+	TF_RETURN_IF_ERROR(interactive_input_shape(c));
+	TF::shape_inference::ShapeHandle output;
+	TF_RETURN_IF_ERROR(c->ReplaceDim(c->output(0), 3, c->MakeDim(channels), &output));
+	c->set_output(0, output);
+	return TF::Status::OK();
+}
+
+// Graphs exported before the attribute existed use the binding every session registers
+inline std::string read_binding_name(TF::OpKernelConstruction* context) {
+	std::string binding;
+	if (!context->GetAttr("binding", &binding).ok() || binding.empty())
+		return PLUGIN_NAMESPACE::DEFAULT_BINDING_NAME;
+	return binding;
+}
+
+// Output ops write R32F, R16F or R8 unorm results, graphs exported before the attribute existed write R32F
+inline int read_output_format(TF::OpKernelConstruction* context) {
+	std::string format;
+	if (!context->GetAttr("format", &format).ok())
+		return PixelR32F;
+	return pixel_format_from_name(format.c_str());
+}
+
+inline TF::TensorShape nhwc_shape(const TF::TensorShape& shape, bool nhwc) {
+	if (!nhwc)
+		return shape;
+	return TF::TensorShape({ shape.dim_size(0), shape.dim_size(2), shape.dim_size(1), shape.dim_size(3) });
+}
+
+// Entry b of a batched run, a run without batch entries is a batch of one on the surfaces of the transfer data
+inline PLUGIN_NAMESPACE::Batch_Entry batch_entry(const PLUGIN_NAMESPACE::CUDA_transfer_data& data, TF::int64 b) {
+	if (data._batch_count > 0)
+		return data._batch[b];
+	PLUGIN_NAMESPACE::Batch_Entry entry;
+	entry.input_memory = data._input_memory;
+	entry.depth_memory = data._depth_memory;
+	entry.output_memory = data._output_memory;
+	return entry;
+}
+
+inline TF::Status check_batch(const TF::TensorShape& shape, const PLUGIN_NAMESPACE::CUDA_transfer_data& data) {
+	const TF::int64 entries = data._batch_count > 0 ? data._batch_count : 1;
+	if (shape.dim_size(0) > entries)
+		return TF::errors::InvalidArgument("Interactive op got a batch of ", shape.dim_size(0), " with ", entries, " batch entries bound");
+	return TF::Status::OK();
+}
+
+// Only gpu devices have a stream the stage events can be recorded on
+inline cudaStream_t device_stream(const Eigen::GpuDevice& d) { return d.stream(); }
+template <typename Device>
+cudaStream_t device_stream(const Device& d) { return nullptr; }
+
 template <typename Device, typename T>
 struct InteractiveInputFunctor {
-	cudaError_t operator()(const Device& d, int width, int height, size_t pitch, float min, float max, const void* normals, const void* depth, T* out);
+	cudaError_t operator()(const Device& d, int width, int height, size_t pitch, int channels, float min, float max, const void* normals, const void* depth, T* out);
 };
 
 template <typename Device, typename T>
@@ -34,322 +129,453 @@ struct InteractiveNormalsInputFunctor {
 
 template <typename Device, typename T>
 struct InteractiveDepthInputFunctor {
-	cudaError_t operator()(const Device& d, int width, int height, size_t pitch, float min, float max, const void* in, T* out);
+	cudaError_t operator()(const Device& d, int width, int height, size_t pitch, int channels, float min, float max, const void* in, T* out);
 };
 
 template <typename Device, typename T>
 struct InteractiveOutputFunctor {
-	cudaError_t operator()(const Device& d, int width, int height, size_t pitch, const T* in, void* out);
+	cudaError_t operator()(const Device& d, int width, int height, int stride, size_t pitch, int format, const T* in, void* out);
 };
 
 template <typename Device, typename T>
 struct InteractiveDepthOutputFunctor {
-	cudaError_t operator()(const Device& d, int width, int height, size_t pitch, float min, float max, const T* in, void* out);
+	cudaError_t operator()(const Device& d, int width, int height, int stride, size_t pitch, int format, float min, float max, const T* in, void* out);
+};
+
+template <typename Device, typename T>
+struct InteractiveGatherFunctor {
+	cudaError_t operator()(const Device& d, int width, int height, const IO_Params& params, T* out);
+};
+
+template <typename Device, typename T>
+struct InteractiveScatterFunctor {
+	cudaError_t operator()(const Device& d, int width, int height, const IO_Params& params, const T* in);
+};
+
+// Where a stats op publishes to. The gpu functor keeps its reduction buffers here between samples, the stream callback
+// reads the slot and the host copy from it once the reduction finished.
+struct Tensor_Stats_Target {
+	int slot = -1;
+	uint64_t run = 0;
+	PLUGIN_NAMESPACE::Tensor_Stats* device = nullptr;
+	PLUGIN_NAMESPACE::Tensor_Stats* host = nullptr;
+};
+
+template <typename Device, typename T>
+struct InteractiveTensorStatsFunctor {
+	cudaError_t operator()(const Device& d, TF::int64 count, float histogram_min, float histogram_max, const T* in, Tensor_Stats_Target& target);
 };
 
+// Shared part of the ops moving pixels between the bound surfaces and a tensor. They read the layout and the binding
+// name, check the tensor they get against the bound transfer data and run their functor per batch entry between the
+// stage events of the op.
 template <typename Device, typename T>
-class InteractiveInputOp : public TF::OpKernel {
+class InteractiveSurfaceOp : public TF::OpKernel {
 public:
-	explicit InteractiveInputOp(TF::OpKernelConstruction* context) : TF::OpKernel(context) {}
+	explicit InteractiveSurfaceOp(TF::OpKernelConstruction* context) : TF::OpKernel(context), _nhwc(read_nhwc_layout(context)), _binding(read_binding_name(context)) {}
 
-	void Compute(TF::OpKernelContext* context) override {
-		// Grab the input tensor
+protected:
+	// Looks up the transfer data of the running session and checks the shape of the tensor the op reads
+	TF::Status prepare(TF::OpKernelContext* context, const char* op_name, PLUGIN_NAMESPACE::CUDA_transfer_data*& data) {
 		const TF::Tensor& input_tensor = context->input(0);
+		if (input_tensor.shape().dims() != 4)
+			return TF::errors::Unavailable(op_name, " expects 4 dimensions (batch, width, height, channels)");
+		if (input_tensor.NumElements() > tensorflow::kint32max)
+			return TF::errors::InvalidArgument("Too many elements in tensor");
 
-		// Set the allocated memory to be GPU based
+		TF_RETURN_IF_ERROR(PLUGIN_NAMESPACE::TFBinding::lookup(context, _binding, &data));
+		return check_batch(input_tensor.shape(), *data);
+	}
+
+	// The output stays on the device, the functors write it directly
+	TF::Status allocate_device_output(TF::OpKernelContext* context, const TF::TensorShape& shape, TF::Tensor** output_tensor) {
 		TF::AllocatorAttributes attributes;
 		attributes.set_on_host(false);
 		attributes.set_nic_compatible(false);
 		attributes.set_gpu_compatible(true);
+		return context->allocate_output(0, shape, output_tensor, attributes);
+	}
 
-		_normals = PLUGIN_NAMESPACE::TFCuda::get_input_memory_pointer();
-		_depth = PLUGIN_NAMESPACE::TFCuda::get_depth_memory_pointer();
-		_pitch = PLUGIN_NAMESPACE::TFCuda::get_pitch();
-		_near_range = PLUGIN_NAMESPACE::TFCuda::get_near_range();
-		_far_range = PLUGIN_NAMESPACE::TFCuda::get_far_range();
+	// Width and height of a tensor the op reads, in the layout of the op
+	int tensor_width(const TF::Tensor& tensor) const { return static_cast<int>(tensor.shape().dim_size(_nhwc ? 2 : 1)); }
+	int tensor_height(const TF::Tensor& tensor) const { return static_cast<int>(tensor.shape().dim_size(_nhwc ? 1 : 2)); }
+
+	// Calls the body with every batch entry, or once for the whole surfaces, between the stage events of the op
+	template <typename Body>
+	TF::Status run_entries(TF::OpKernelContext* context, PLUGIN_NAMESPACE::CUDA_transfer_data& data, TF::int64 entries,
+		PLUGIN_NAMESPACE::StageEvent begin, PLUGIN_NAMESPACE::StageEvent end, Body body) {
+		const cudaStream_t stream = device_stream(context->eigen_device<Device>());
+		cudaError_t result = cudaSuccess;
+		PLUGIN_NAMESPACE::TFCuda::record_stage_event(data, begin, stream);
+		for (TF::int64 b = 0; b < entries && result == cudaSuccess; ++b)
+			result = body(b, batch_entry(data, b));
+		PLUGIN_NAMESPACE::TFCuda::record_stage_event(data, end, stream);
+		return result == cudaSuccess ? TF::Status::OK() : TF::errors::Internal("CUDA Error occured!");
+	}
 
-		// Create an output tensor and condition checking
-		TF::Tensor* output_tensor = NULL;
-		OP_REQUIRES_OK(context, context->allocate_output(0, input_tensor.shape(),
-			&output_tensor, attributes));
+	bool _nhwc = false;
+	std::string _binding;
+};
 
-		OP_REQUIRES(context, output_tensor->shape().dims() == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 dimensions (batch, width, height, channels)"));
+template <typename Device, typename T>
+class InteractiveInputOp : public InteractiveSurfaceOp<Device, T> {
+public:
+	explicit InteractiveInputOp(TF::OpKernelConstruction* context) : InteractiveSurfaceOp<Device, T>(context) {}
 
-		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 channels"));
+	void Compute(TF::OpKernelContext* context) override {
+		const TF::Tensor& input_tensor = context->input(0);
+		PLUGIN_NAMESPACE::CUDA_transfer_data* data = nullptr;
+		OP_REQUIRES_OK(context, this->prepare(context, "Interactive Input", data));
 
-		OP_REQUIRES(context, _normals != nullptr,
-			TF::errors::Unavailable("Could not get normals memory"));
+		TF::Tensor* output_tensor = NULL;
+		OP_REQUIRES_OK(context, this->allocate_device_output(context, nhwc_shape(input_tensor.shape(), this->_nhwc), &output_tensor));
 
-		OP_REQUIRES(context, _depth != nullptr,
-			TF::errors::Unavailable("Could not get depth memory"));
+		// Four channels are the normals and the depth, three the octahedral normals and the depth. Depth only networks take
+		// a single channel, the normals are not read at all then.
+		const int channels = static_cast<int>(output_tensor->shape().dim_size(3));
+		OP_REQUIRES(context, channels == 4 || channels == 3 || channels == 1,
+			TF::errors::Unavailable("Interactive Input expects 4, 3 or 1 channels"));
 
-		OP_REQUIRES(context, input_tensor.NumElements() <= tensorflow::kint32max,
-			TF::errors::InvalidArgument("Too many elements in tensor"));
+		OP_REQUIRES(context, channels == 1 || data->_input_memory != nullptr,
+			TF::errors::Unavailable("Could not get normals memory"));
 
-		// Do the computation.
-		cudaError_t result = InteractiveInputFunctor<Device, T>()(
-			context->eigen_device<Device>(),
-			static_cast<int>(input_tensor.shape().dim_size(1)),
-			static_cast<int>(input_tensor.shape().dim_size(2)),
-			_pitch,
-			_near_range,
-			_far_range,
-			_normals,
-			_depth,
-			output_tensor->flat<T>().data());
+		OP_REQUIRES(context, data->_depth_memory != nullptr,
+			TF::errors::Unavailable("Could not get depth memory"));
 
-		OP_REQUIRES(context, result == cudaSuccess, TF::errors::Internal("CUDA Error occured!"));
+		// The pixels are written row by row, one window per batch entry
+		const int width = static_cast<int>(input_tensor.shape().dim_size(1));
+		const int height = static_cast<int>(input_tensor.shape().dim_size(2));
+		OP_REQUIRES_OK(context, this->run_entries(context, *data, input_tensor.shape().dim_size(0), PLUGIN_NAMESPACE::InputOpBegin, PLUGIN_NAMESPACE::InputOpEnd,
+			[&](TF::int64 b, const PLUGIN_NAMESPACE::Batch_Entry& entry) {
+			T* out = output_tensor->flat<T>().data() + b * width * height * channels;
+			if (channels == 1)
+				return InteractiveDepthInputFunctor<Device, T>()(context->eigen_device<Device>(), width, height, data->_pitch, channels,
+					data->_near_range, data->_far_range, entry.depth_memory, out);
+			return InteractiveInputFunctor<Device, T>()(context->eigen_device<Device>(), width, height, data->_pitch, channels,
+				data->_near_range, data->_far_range, entry.input_memory, entry.depth_memory, out);
+		}));
 	}
-
-private:
-	size_t _pitch = 0;
-	void *_normals = nullptr;
-	void *_depth = nullptr;
-	float _near_range = 0.1f;
-	float _far_range = 1000.0f;
 };
 
 template <typename Device, typename T>
-class InteractiveNormalsInputOp : public TF::OpKernel {
+class InteractiveNormalsInputOp : public InteractiveSurfaceOp<Device, T> {
 public:
-	explicit InteractiveNormalsInputOp(TF::OpKernelConstruction* context) : TF::OpKernel(context) {}
+	explicit InteractiveNormalsInputOp(TF::OpKernelConstruction* context) : InteractiveSurfaceOp<Device, T>(context) {}
 
 	void Compute(TF::OpKernelContext* context) override {
-		// Grab the input tensor
 		const TF::Tensor& input_tensor = context->input(0);
+		PLUGIN_NAMESPACE::CUDA_transfer_data* data = nullptr;
+		OP_REQUIRES_OK(context, this->prepare(context, "Interactive Normals Input", data));
 
-		// Set the allocated memory to be GPU based
-		TF::AllocatorAttributes attributes;
-		attributes.set_on_host(false);
-		attributes.set_nic_compatible(false);
-		attributes.set_gpu_compatible(true);
-
-		_memory = PLUGIN_NAMESPACE::TFCuda::get_input_memory_pointer();
-		_pitch = PLUGIN_NAMESPACE::TFCuda::get_pitch();
-
-		// Create an output tensor and condition checking
 		TF::Tensor* output_tensor = NULL;
-		OP_REQUIRES_OK(context, context->allocate_output(0, input_tensor.shape(),
-			&output_tensor, attributes));
-
-		OP_REQUIRES(context, output_tensor->shape().dims() == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 dimensions (batch, width, height, channels)"));
+		OP_REQUIRES_OK(context, this->allocate_device_output(context, nhwc_shape(input_tensor.shape(), this->_nhwc), &output_tensor));
 
 		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 channels"));
+			TF::errors::Unavailable("Interactive Normals Input expects 4 channels"));
 
-		OP_REQUIRES(context, _memory != nullptr,
+		OP_REQUIRES(context, data->_input_memory != nullptr,
 			TF::errors::Unavailable("Could not get normals memory"));
 
-		OP_REQUIRES(context, input_tensor.NumElements() <= tensorflow::kint32max,
-			TF::errors::InvalidArgument("Too many elements in tensor"));
-
-		// Do the computation.
-		cudaError_t result = InteractiveNormalsInputFunctor<Device, T>()(
-			context->eigen_device<Device>(),
-			static_cast<int>(input_tensor.shape().dim_size(1)),
-			static_cast<int>(input_tensor.shape().dim_size(2)),
-			_pitch,
-			_memory,
-			output_tensor->flat<T>().data());
-
-		OP_REQUIRES(context, result == cudaSuccess, TF::errors::Internal("CUDA Error occured!"));
+		const int width = static_cast<int>(input_tensor.shape().dim_size(1));
+		const int height = static_cast<int>(input_tensor.shape().dim_size(2));
+		OP_REQUIRES_OK(context, this->run_entries(context, *data, input_tensor.shape().dim_size(0), PLUGIN_NAMESPACE::InputOpBegin, PLUGIN_NAMESPACE::InputOpEnd,
+			[&](TF::int64 b, const PLUGIN_NAMESPACE::Batch_Entry& entry) {
+			return InteractiveNormalsInputFunctor<Device, T>()(context->eigen_device<Device>(), width, height, data->_pitch,
+				entry.input_memory, output_tensor->flat<T>().data() + b * width * height * 4);
+		}));
 	}
-
-private:
-	size_t _pitch = 0;
-	void *_memory = nullptr;
 };
 
 template <typename Device, typename T>
-class InteractiveDepthInputOp : public TF::OpKernel {
+class InteractiveDepthInputOp : public InteractiveSurfaceOp<Device, T> {
 public:
-	explicit InteractiveDepthInputOp(TF::OpKernelConstruction* context) : TF::OpKernel(context) {}
+	explicit InteractiveDepthInputOp(TF::OpKernelConstruction* context) : InteractiveSurfaceOp<Device, T>(context) {}
 
 	void Compute(TF::OpKernelContext* context) override {
-		// Grab the input tensor
 		const TF::Tensor& input_tensor = context->input(0);
+		PLUGIN_NAMESPACE::CUDA_transfer_data* data = nullptr;
+		OP_REQUIRES_OK(context, this->prepare(context, "Interactive Depth Input", data));
 
-		// Set the allocated memory to be GPU based
-		TF::AllocatorAttributes attributes;
-		attributes.set_on_host(false);
-		attributes.set_nic_compatible(false);
-		attributes.set_gpu_compatible(true);
+		TF::Tensor* output_tensor = NULL;
+		OP_REQUIRES_OK(context, this->allocate_device_output(context, nhwc_shape(input_tensor.shape(), this->_nhwc), &output_tensor));
 
-		_near_range = PLUGIN_NAMESPACE::TFCuda::get_near_range();
-		_far_range = PLUGIN_NAMESPACE::TFCuda::get_far_range();
-		_memory = PLUGIN_NAMESPACE::TFCuda::get_depth_memory_pointer();
-		_pitch = PLUGIN_NAMESPACE::TFCuda::get_pitch();
+		const int channels = static_cast<int>(output_tensor->shape().dim_size(3));
+		OP_REQUIRES(context, channels == 4 || channels == 1,
+			TF::errors::Unavailable("Interactive Depth Input expects 4 or 1 channels"));
 
-		// Create an output tensor and condition checking
-		TF::Tensor* output_tensor = NULL;
-		OP_REQUIRES_OK(context, context->allocate_output(0, input_tensor.shape(),
-			&output_tensor, attributes));
+		OP_REQUIRES(context, data->_depth_memory != nullptr,
+			TF::errors::Unavailable("Could not get depth memory"));
 
-		OP_REQUIRES(context, output_tensor->shape().dims() == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 dimensions (batch, width, height, channels)"));
+		const int width = static_cast<int>(input_tensor.shape().dim_size(1));
+		const int height = static_cast<int>(input_tensor.shape().dim_size(2));
+		OP_REQUIRES_OK(context, this->run_entries(context, *data, input_tensor.shape().dim_size(0), PLUGIN_NAMESPACE::InputOpBegin, PLUGIN_NAMESPACE::InputOpEnd,
+			[&](TF::int64 b, const PLUGIN_NAMESPACE::Batch_Entry& entry) {
+			return InteractiveDepthInputFunctor<Device, T>()(context->eigen_device<Device>(), width, height, data->_pitch, channels,
+				data->_near_range, data->_far_range, entry.depth_memory, output_tensor->flat<T>().data() + b * width * height * channels);
+		}));
+	}
+};
 
-		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 channels"));
+template <typename Device, typename T>
+class InteractiveOutputOp : public InteractiveSurfaceOp<Device, T> {
+public:
+	explicit InteractiveOutputOp(TF::OpKernelConstruction* context) : InteractiveSurfaceOp<Device, T>(context), _format(read_output_format(context)) {}
 
-		OP_REQUIRES(context, _memory != nullptr,
-			TF::errors::Unavailable("Could not get depth memory"));
+	void Compute(TF::OpKernelContext* context) override {
+		const TF::Tensor& input_tensor = context->input(0);
+		PLUGIN_NAMESPACE::CUDA_transfer_data* data = nullptr;
+		OP_REQUIRES_OK(context, this->prepare(context, "Interactive Output", data));
 
-		OP_REQUIRES(context, input_tensor.NumElements() <= tensorflow::kint32max,
-			TF::errors::InvalidArgument("Too many elements in tensor"));
+		TF::Tensor* output_tensor = NULL;
+		OP_REQUIRES_OK(context, this->allocate_device_output(context, input_tensor.shape(), &output_tensor));
 
-		// Do the computation.
-		cudaError_t result = InteractiveDepthInputFunctor<Device, T>()(
-			context->eigen_device<Device>(),
-			static_cast<int>(input_tensor.shape().dim_size(1)),
-			static_cast<int>(input_tensor.shape().dim_size(2)),
-			_pitch,
-			_near_range,
-			_far_range,
-			_memory,
-			output_tensor->flat<T>().data());
+		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 1,
+			TF::errors::Unavailable("Interactive Output expects 1 channel"));
 
-		OP_REQUIRES(context, result == cudaSuccess, TF::errors::Internal("CUDA Error occured!"));
+		OP_REQUIRES(context, data->_output_memory != nullptr,
+			TF::errors::Unavailable("Could not get texture memory"));
+
+		// Every batch entry writes its part of the window
+		const int width = this->tensor_width(input_tensor);
+		const int height = this->tensor_height(input_tensor);
+		OP_REQUIRES_OK(context, this->run_entries(context, *data, input_tensor.shape().dim_size(0), PLUGIN_NAMESPACE::OutputOpBegin, PLUGIN_NAMESPACE::OutputOpEnd,
+			[&](TF::int64 b, const PLUGIN_NAMESPACE::Batch_Entry& entry) {
+			return InteractiveOutputFunctor<Device, T>()(
+				context->eigen_device<Device>(),
+				entry.output_width > 0 ? static_cast<int>(entry.output_width) : width,
+				entry.output_height > 0 ? static_cast<int>(entry.output_height) : height,
+				width,
+				data->_output_pitch,
+				_format,
+				input_tensor.flat<T>().data() + (b * height + entry.output_y) * width + entry.output_x,
+				entry.output_memory);
+		}));
 	}
 
 private:
-	float _near_range = 0.1f;
-	float _far_range = 1000.0f;
-	size_t _pitch = 0;
-	void *_memory = nullptr;
+	int _format = PixelR32F;
 };
 
 template <typename Device, typename T>
-class InteractiveOutputOp : public TF::OpKernel {
+class InteractiveDepthOutputOp : public InteractiveSurfaceOp<Device, T> {
 public:
-	explicit InteractiveOutputOp(TF::OpKernelConstruction* context) : TF::OpKernel(context) {}
+	explicit InteractiveDepthOutputOp(TF::OpKernelConstruction* context) : InteractiveSurfaceOp<Device, T>(context), _format(read_output_format(context)) {}
 
 	void Compute(TF::OpKernelContext* context) override {
-		// Grab the input tensor
 		const TF::Tensor& input_tensor = context->input(0);
+		PLUGIN_NAMESPACE::CUDA_transfer_data* data = nullptr;
+		OP_REQUIRES_OK(context, this->prepare(context, "Interactive Depth Output", data));
 
-		// Set the allocated memory to be GPU based
-		TF::AllocatorAttributes attributes;
-		attributes.set_on_host(false);
-		attributes.set_nic_compatible(false);
-		attributes.set_gpu_compatible(true);
-
-		_memory = PLUGIN_NAMESPACE::TFCuda::get_output_memory_pointer();
-		_pitch = PLUGIN_NAMESPACE::TFCuda::get_pitch();
-
-		// Create an output tensor and condition checking
 		TF::Tensor* output_tensor = NULL;
-		OP_REQUIRES_OK(context, context->allocate_output(0, input_tensor.shape(),
-			&output_tensor, attributes));
-
-		OP_REQUIRES(context, input_tensor.shape().dims() == 4,
-			TF::errors::Unavailable("Interactive Output expects 4 dimensions (batch, width, height, channels)"));
+		OP_REQUIRES_OK(context, this->allocate_device_output(context, input_tensor.shape(), &output_tensor));
 
-		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 1,
-			TF::errors::Unavailable("Interactive Output expects 1 channel"));
+		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 4,
+			TF::errors::Unavailable("Interactive Depth Output expects 4 channels"));
 
-		OP_REQUIRES(context, _memory != nullptr,
+		OP_REQUIRES(context, data->_output_memory != nullptr,
 			TF::errors::Unavailable("Could not get texture memory"));
 
-		OP_REQUIRES(context, input_tensor.NumElements() <= tensorflow::kint32max,
-			TF::errors::InvalidArgument("Too many elements in tensor"));
-
-		// Do the computation.
-		cudaError_t result = InteractiveOutputFunctor<Device, T>()(
-			context->eigen_device<Device>(),
-			static_cast<int>(input_tensor.shape().dim_size(1)),
-			static_cast<int>(input_tensor.shape().dim_size(2)),
-			_pitch,
-			input_tensor.flat<T>().data(),
-			_memory);
-
-		OP_REQUIRES(context, result == cudaSuccess, TF::errors::Internal("CUDA Error occured!"));
+		// Every batch entry writes its part of the window
+		const int width = this->tensor_width(input_tensor);
+		const int height = this->tensor_height(input_tensor);
+		OP_REQUIRES_OK(context, this->run_entries(context, *data, input_tensor.shape().dim_size(0), PLUGIN_NAMESPACE::OutputOpBegin, PLUGIN_NAMESPACE::OutputOpEnd,
+			[&](TF::int64 b, const PLUGIN_NAMESPACE::Batch_Entry& entry) {
+			return InteractiveDepthOutputFunctor<Device, T>()(
+				context->eigen_device<Device>(),
+				entry.output_width > 0 ? static_cast<int>(entry.output_width) : width,
+				entry.output_height > 0 ? static_cast<int>(entry.output_height) : height,
+				width,
+				data->_output_pitch,
+				_format,
+				data->_near_range,
+				data->_far_range,
+				input_tensor.flat<T>().data() + ((b * height + entry.output_y) * width + entry.output_x) * 4,
+				entry.output_memory);
+		}));
 	}
 
 private:
-	void *_memory = nullptr;
-	size_t _pitch = 0;
+	int _format = PixelR32F;
 };
 
+// Gathers any number of bound surfaces into the channels of one tensor, or scatters the channels of a tensor to them,
+// in a single kernel. Ranges hold a (min, max) pair per binding mapped to (0, 1), an empty pair takes the camera range.
 template <typename Device, typename T>
-class InteractiveDepthOutputOp : public TF::OpKernel {
+class InteractiveIOOp : public InteractiveSurfaceOp<Device, T> {
 public:
-	explicit InteractiveDepthOutputOp(TF::OpKernelConstruction* context) : TF::OpKernel(context) {}
+	explicit InteractiveIOOp(TF::OpKernelConstruction* context) : InteractiveSurfaceOp<Device, T>(context) {
+		std::string mode;
+		std::vector<std::string> formats;
+		std::vector<std::string> swizzles;
+		std::vector<float> ranges;
+		OP_REQUIRES_OK(context, context->GetAttr("mode", &mode));
+		OP_REQUIRES_OK(context, context->GetAttr("bindings", &_names));
+		OP_REQUIRES_OK(context, context->GetAttr("formats", &formats));
+		OP_REQUIRES_OK(context, context->GetAttr("swizzles", &swizzles));
+		OP_REQUIRES_OK(context, context->GetAttr("ranges", &ranges));
+		_scatter = mode == "scatter";
+
+		const int count = static_cast<int>(_names.size());
+		OP_REQUIRES(context, count > 0 && count <= MAX_IO_BINDINGS,
+			TF::errors::InvalidArgument("Interactive IO expects between 1 and ", MAX_IO_BINDINGS, " bindings"));
+		OP_REQUIRES(context, static_cast<int>(formats.size()) == count && static_cast<int>(swizzles.size()) == count,
+			TF::errors::InvalidArgument("Interactive IO expects a format and a swizzle per binding"));
+		OP_REQUIRES(context, ranges.empty() || static_cast<int>(ranges.size()) == 2 * count,
+			TF::errors::InvalidArgument("Interactive IO expects a (min, max) range per binding"));
+
+		_params = IO_Params();
+		_params.binding_count = count;
+		for (int b = 0; b < count; ++b) {
+			IO_Binding& binding = _params.bindings[b];
+			binding.format = pixel_format_from_name(formats[b].c_str());
+			OP_REQUIRES(context, binding.format < PIXEL_FORMAT_COUNT, TF::errors::InvalidArgument("Unknown pixel format ", formats[b]));
+
+			binding.channels = static_cast<int>(swizzles[b].size());
+			OP_REQUIRES(context, binding.channels > 0 && binding.channels <= 4,
+				TF::errors::InvalidArgument("Swizzle of ", _names[b], " has to name between 1 and 4 channels"));
+			for (int i = 0; i < binding.channels; ++i) {
+				const char c = swizzles[b][i];
+				int channel = c == 'r' ? 0 : c == 'g' ? 1 : c == 'b' ? 2 : c == 'a' ? 3 : c == '0' ? SWIZZLE_ZERO : c == '1' ? SWIZZLE_ONE : 4;
+				OP_REQUIRES(context, channel < pixel_channels(binding.format) && (channel >= 0 || !_scatter),
+					TF::errors::InvalidArgument("Swizzle ", swizzles[b], " does not fit the format of ", _names[b]));
+				binding.swizzle[i] = channel;
+			}
+			_params.tensor_channels += binding.channels;
+
+			_min[b] = ranges.empty() ? 0.0f : ranges[2 * b];
+			_max[b] = ranges.empty() ? 1.0f : ranges[2 * b + 1];
+		}
+	}
 
 	void Compute(TF::OpKernelContext* context) override {
-		// Grab the input tensor
 		const TF::Tensor& input_tensor = context->input(0);
+		PLUGIN_NAMESPACE::CUDA_transfer_data* data = nullptr;
+		OP_REQUIRES_OK(context, this->prepare(context, "Interactive IO", data));
+
+		// Named surfaces have no batch entries
+		OP_REQUIRES(context, input_tensor.shape().dim_size(0) == 1,
+			TF::errors::InvalidArgument("Interactive IO expects a batch of one"));
+
+		// The surfaces and the camera range belong to the transfer data of the running session
+		IO_Params params = _params;
+		for (int b = 0; b < params.binding_count; ++b) {
+			const PLUGIN_NAMESPACE::Surface_Binding* surface = PLUGIN_NAMESPACE::TFCuda::find_surface(*data, _names[b]);
+			OP_REQUIRES(context, surface != nullptr && surface->memory != nullptr,
+				TF::errors::Unavailable("Could not get the memory of binding ", _names[b]));
+
+			float min = _min[b];
+			float max = _max[b];
+			if (min == max) {
+				min = data->_near_range;
+				max = data->_far_range;
+			}
+
+			IO_Binding& binding = params.bindings[b];
+			binding.memory = surface->memory;
+			binding.pitch = surface->pitch;
+			binding.scale = _scatter ? max - min : 1.0f / (max - min);
+			binding.offset = _scatter ? min : -min / (max - min);
+		}
 
-		// Set the allocated memory to be GPU based
-		TF::AllocatorAttributes attributes;
-		attributes.set_on_host(false);
-		attributes.set_nic_compatible(false);
-		attributes.set_gpu_compatible(true);
+		if (_scatter) {
+			OP_REQUIRES(context, input_tensor.shape().dim_size(3) == params.tensor_channels,
+				TF::errors::Unavailable("Interactive IO expects ", params.tensor_channels, " channels to scatter"));
+
+			// The tensor passes through, the surfaces are the actual result
+			context->set_output(0, input_tensor);
+			OP_REQUIRES_OK(context, this->run_entries(context, *data, 1, PLUGIN_NAMESPACE::OutputOpBegin, PLUGIN_NAMESPACE::OutputOpEnd,
+				[&](TF::int64, const PLUGIN_NAMESPACE::Batch_Entry&) {
+				return InteractiveScatterFunctor<Device, T>()(context->eigen_device<Device>(), this->tensor_width(input_tensor), this->tensor_height(input_tensor),
+					params, input_tensor.flat<T>().data());
+			}));
+			return;
+		}
 
-		_near_range = PLUGIN_NAMESPACE::TFCuda::get_near_range();
-		_far_range = PLUGIN_NAMESPACE::TFCuda::get_far_range();
-		_memory = PLUGIN_NAMESPACE::TFCuda::get_output_memory_pointer();
-		_pitch = PLUGIN_NAMESPACE::TFCuda::get_pitch();
+		TF::TensorShape shape = nhwc_shape(input_tensor.shape(), this->_nhwc);
+		shape.set_dim(3, params.tensor_channels);
 
-		// Create an output tensor and condition checking
 		TF::Tensor* output_tensor = NULL;
-		OP_REQUIRES_OK(context, context->allocate_output(0, input_tensor.shape(),
-			&output_tensor, attributes));
+		OP_REQUIRES_OK(context, this->allocate_device_output(context, shape, &output_tensor));
+		OP_REQUIRES_OK(context, this->run_entries(context, *data, 1, PLUGIN_NAMESPACE::InputOpBegin, PLUGIN_NAMESPACE::InputOpEnd,
+			[&](TF::int64, const PLUGIN_NAMESPACE::Batch_Entry&) {
+			return InteractiveGatherFunctor<Device, T>()(context->eigen_device<Device>(), static_cast<int>(input_tensor.shape().dim_size(1)),
+				static_cast<int>(input_tensor.shape().dim_size(2)), params, output_tensor->flat<T>().data());
+		}));
+	}
+
+private:
+	bool _scatter = false;
+	std::vector<std::string> _names;
+	IO_Params _params;
+	float _min[MAX_IO_BINDINGS] = {};
+	float _max[MAX_IO_BINDINGS] = {};
+};
 
-		OP_REQUIRES(context, input_tensor.shape().dims() == 4,
-			TF::errors::Unavailable("Interactive Output expects 4 dimensions (batch, width, height, channels)"));
+// Passes the tensor through and samples min, max, mean, NaN count and a histogram of it every interval runs. The
+// reduction runs on the device of the op and publishes to TFTensorStats without waiting for the result.
+template <typename Device, typename T>
+class InteractiveTensorStatsOp : public TF::OpKernel {
+public:
+	explicit InteractiveTensorStatsOp(TF::OpKernelConstruction* context) : TF::OpKernel(context) {
+		OP_REQUIRES_OK(context, context->GetAttr("interval", &_interval));
+		OP_REQUIRES_OK(context, context->GetAttr("histogram_min", &_histogram_min));
+		OP_REQUIRES_OK(context, context->GetAttr("histogram_max", &_histogram_max));
+		OP_REQUIRES(context, _interval > 0, TF::errors::InvalidArgument("Interactive tensor stats expects a positive interval"));
+		OP_REQUIRES(context, _histogram_max > _histogram_min,
+			TF::errors::InvalidArgument("Interactive tensor stats expects histogram_max above histogram_min"));
+		_target.slot = PLUGIN_NAMESPACE::TFTensorStats::register_slot(PLUGIN_NAMESPACE::TFBinding::find(context, read_binding_name(context)), name());
+	}
 
-		OP_REQUIRES(context, output_tensor->shape().dim_size(3) == 4,
-			TF::errors::Unavailable("Interactive Input expects 4 channels"));
+	~InteractiveTensorStatsOp() override {
+		// Pending callbacks still read the target and publish into the slot, they have to finish before both go away
+		if (_target.device != nullptr || _target.host != nullptr)
+			cudaDeviceSynchronize();
+		if (_target.device != nullptr)
+			cudaFree(_target.device);
+		if (_target.host != nullptr)
+			cudaFreeHost(_target.host);
+		PLUGIN_NAMESPACE::TFTensorStats::release_slot(_target.slot);
+	}
 
-		OP_REQUIRES(context, _memory != nullptr,
-			TF::errors::Unavailable("Could not get texture memory"));
+	void Compute(TF::OpKernelContext* context) override {
+		const TF::Tensor& input_tensor = context->input(0);
+		context->set_output(0, input_tensor);
 
-		OP_REQUIRES(context, input_tensor.NumElements() <= tensorflow::kint32max,
-			TF::errors::InvalidArgument("Too many elements in tensor"));
+		// Sessions sharing the graph run the op concurrently, every run still gets its own number
+		if (_target.slot < 0)
+			return;
+		const uint64_t run = _runs.fetch_add(1, std::memory_order_relaxed);
+		if (run % _interval != 0)
+			return;
 
-		// Do the computation.
-		cudaError_t result = InteractiveDepthOutputFunctor<Device, T>()(
+		_target.run = run + 1;
+		cudaError_t result = InteractiveTensorStatsFunctor<Device, T>()(
 			context->eigen_device<Device>(),
-			static_cast<int>(input_tensor.shape().dim_size(1)),
-			static_cast<int>(input_tensor.shape().dim_size(2)),
-			_pitch,
-			_near_range,
-			_far_range,
+			input_tensor.NumElements(),
+			_histogram_min,
+			_histogram_max,
 			input_tensor.flat<T>().data(),
-			_memory);
+			_target);
 
 		OP_REQUIRES(context, result == cudaSuccess, TF::errors::Internal("CUDA Error occured!"));
 	}
 
 private:
-	float _near_range = 0.1f;
-	float _far_range = 1000.0f;
-	void *_memory = nullptr;
-	size_t _pitch = 0;
+	int _interval = 1;
+	float _histogram_min = 0.0f;
+	float _histogram_max = 1.0f;
+	std::atomic<uint64_t> _runs = { 0 };
+	Tensor_Stats_Target _target;
 };
 
+// Kept for graphs that still reference it, the tensor passes through without a copy
 template <typename Device, typename T>
 class InteractiveDebugPrintOp : public TF::OpKernel {
 public:
 	explicit InteractiveDebugPrintOp(TF::OpKernelConstruction* context) : OpKernel(context) {}
 
 	void Compute(TF::OpKernelContext* context) override {
-		// Grab the input tensor
-		const TF::Tensor& input_tensor = context->input(0);
-		auto input = input_tensor.flat<T>();
-
-		// Create an output tensor
-		TF::Tensor* output_tensor = NULL;
-		OP_REQUIRES_OK(context, context->allocate_output(0, input_tensor.shape(), &output_tensor));
-		auto output = output_tensor->flat<T>();
-
-		auto N = input.size();
-		for (auto i = 0; i < N; i++) {
-			output(i) = input(i);
-		}
+		context->set_output(0, context->input(0));
 	}
 };
 
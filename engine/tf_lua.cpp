@@ -1,4 +1,6 @@
 #include "tf_lua.h"
+#include "tf_trace.h"
+#include "tf_tensor_stats.h"
 
 namespace PLUGIN_NAMESPACE {
 
@@ -15,15 +17,421 @@ namespace {
 		unsigned iterations = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 3);
 		if (iterations == 0)
 			endless = true;
-		TFPlugin::run_tf_graph(graph_path, node_name, iterations, endless);
+
+		// The session name is optional, graphs started without one or with nil replace each other like before
+		const char *session_name = "default";
+		if (TFPlugin::get_api()._lua->gettop(L) >= 4 && !TFPlugin::get_api()._lua->isnil(L, 4))
+			session_name = TFPlugin::get_api()._lua->tolstring(L, 4, nullptr);
+
+		SessionHandle handle = TFPlugin::run_tf_graph(session_name, graph_path, node_name, iterations, endless);
+		if (handle == INVALID_SESSION_HANDLE)
+			TFPlugin::get_api()._lua->pushnil(L);
+		else
+			TFPlugin::get_api()._lua->pushinteger(L, handle);
+		return 1;
+	}
+
+	int end_graph(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		TFPlugin::end_tf_execution(handle);
+		return 0;
+	}
+
+	int end_all_graphs(struct lua_State *L)
+	{
+		TFPlugin::end_all_tf_executions();
+		return 0;
+	}
+
+	int find_graph(struct lua_State *L)
+	{
+		const char *session_name = TFPlugin::get_api()._lua->tolstring(L, 1, nullptr);
+		Session_Registry_Scope registry;
+		Graph_Execution_Session *session = TFSession::find(session_name);
+		if (session == nullptr)
+			TFPlugin::get_api()._lua->pushnil(L);
+		else
+			TFPlugin::get_api()._lua->pushinteger(L, session->handle);
+		return 1;
+	}
+
+	int is_graph_ready(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		Session_Registry_Scope registry;
+		Graph_Execution_Session *session = TFSession::get(handle);
+		TFPlugin::get_api()._lua->pushboolean(L, session != nullptr && session->state == SessionReady);
+		return 1;
+	}
+
+	// Returns the state of a graph followed by its loading, warm-up and time to first result in milliseconds
+	int graph_status(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		Session_Registry_Scope registry;
+		Graph_Execution_Session *session = TFSession::get(handle);
+		if (session == nullptr)
+			return 0;
+
+		static const char *state_names[] = { "pending", "ready", "failed" };
+		TFPlugin::get_api()._lua->pushstring(L, state_names[session->state]);
+		TFPlugin::get_api()._lua->pushnumber(L, session->load_ms);
+		TFPlugin::get_api()._lua->pushnumber(L, session->warmup_ms);
+		TFPlugin::get_api()._lua->pushnumber(L, session->first_result_ms);
+		return 4;
+	}
+
+	int set_warmup_runs(struct lua_State *L)
+	{
+		unsigned runs = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 1);
+		TFSession::set_warmup_runs(runs);
+		return 0;
+	}
+
+	// Reloads the graph file of a session in the background, the buffers stay bound if the inputs and outputs did not change
+	int reload_graph(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		Session_Registry_Scope registry;
+		TFPlugin::get_api()._lua->pushboolean(L, TFSession::request_reload(TFSession::get(handle)));
+		return 1;
+	}
+
+	int set_graph_watch_interval(struct lua_State *L)
+	{
+		double seconds = TFPlugin::get_api()._lua->tonumber(L, 1);
+		TFPlugin::set_graph_watch_interval(seconds);
 		return 0;
 	}
 
+	// Has to be called every frame for the temporal reuse, the aspect ratio defaults to the one of the render targets
 	int set_camera(struct lua_State *L)
 	{
 		CApiCamera* camera = (CApiCamera*) TFPlugin::get_api()._lua->topointer(L, 1);
-		TFCuda::set_near_range(TFPlugin::get_api()._c->Camera->near_range(camera));
-		TFCuda::set_far_range(TFPlugin::get_api()._c->Camera->far_range(camera));
+		float aspect = (float) TFPlugin::get_api()._lua->lib_optnumber(L, 2, TFPlugin::aspect_ratio());
+		float near_range = TFPlugin::get_api()._c->Camera->near_range(camera);
+		float far_range = TFPlugin::get_api()._c->Camera->far_range(camera);
+		TFSession::set_camera_range(near_range, far_range);
+
+		ConstMatrix4x4Ptr pose = TFPlugin::get_api()._c->Camera->world_pose(camera);
+		CApiMatrix4x4 projection = TFPlugin::get_api()._c->Camera->projection(camera, aspect);
+		TFSession::set_camera(pose->v, projection.v);
+		return 0;
+	}
+
+	int set_latency_depth(struct lua_State *L)
+	{
+		unsigned latency_depth = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 1);
+		TFSession::set_default_latency_depth(latency_depth);
+		return 0;
+	}
+
+	// Applies to sessions started afterwards, the network runs at the render target size divided by 1, 2 or 4
+	int set_resolution_factor(struct lua_State *L)
+	{
+		unsigned factor = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 1);
+		TFSession::set_default_resolution_factor(factor);
+		return 0;
+	}
+
+	// Applies to sessions started afterwards, the network runs every interval frames or when more than the invalid fraction
+	// of the pixels got disoccluded, an interval of 0 turns the temporal reuse off
+	int set_temporal(struct lua_State *L)
+	{
+		unsigned interval = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 1);
+		float invalid_fraction = (float) TFPlugin::get_api()._lua->lib_optnumber(L, 2, DEFAULT_TEMPORAL_INVALID_FRACTION);
+		float blend = (float) TFPlugin::get_api()._lua->lib_optnumber(L, 3, DEFAULT_TEMPORAL_BLEND);
+		TFSession::set_default_temporal(interval, invalid_fraction, blend);
+		return 0;
+	}
+
+	// Returns the milliseconds per run of the callable and of Session::Run followed by the allocations per run of both
+	int benchmark_graph(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		unsigned runs = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 2);
+		Benchmark_Result result;
+
+		// The reference keeps the session alive if the render thread ends it during the benchmark
+		Graph_Execution_Session *session;
+		{
+			Session_Registry_Scope registry;
+			session = TFSession::get(handle);
+			if (session != nullptr)
+				++session->references;
+		}
+		if (session == nullptr)
+			return 0;
+		const bool measured = TFSession::benchmark(session, runs, result);
+		TFSession::release(session);
+		if (!measured)
+			return 0;
+
+		TFPlugin::get_api()._logging->info(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Callable run: `%.3f` ms, `%.1f` allocations, Session::Run: `%.3f` ms, `%.1f` allocations.",
+			result.callable_ms, result.callable_allocations, result.run_ms, result.run_allocations));
+		TFPlugin::get_api()._lua->pushnumber(L, result.callable_ms);
+		TFPlugin::get_api()._lua->pushnumber(L, result.run_ms);
+		TFPlugin::get_api()._lua->pushnumber(L, result.callable_allocations);
+		TFPlugin::get_api()._lua->pushnumber(L, result.run_allocations);
+		return 4;
+	}
+
+	int set_model_cache_limit(struct lua_State *L)
+	{
+		double megabytes = TFPlugin::get_api()._lua->tonumber(L, 1);
+		TFModelCache::set_memory_limit((uint64_t)(megabytes * 1024.0 * 1024.0));
+		return 0;
+	}
+
+	int model_cache_stats(struct lua_State *L)
+	{
+		Model_Cache_Stats stats = TFModelCache::stats();
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)stats.hits);
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)stats.misses);
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)stats.models);
+		TFPlugin::get_api()._lua->pushnumber(L, stats.memory_size / (1024.0 * 1024.0));
+		return 4;
+	}
+
+	// Graphs loaded afterwards keep or drop the transposes around the network, turning it off allows comparing both
+	int set_fold_transposes(struct lua_State *L)
+	{
+		TFModelCache::set_fold_transposes(TFPlugin::get_api()._lua->toboolean(L, 1) != 0);
+		return 0;
+	}
+
+	// Host memory budget of every session in megabytes, zero means unlimited
+	int set_memory_budget(struct lua_State *L)
+	{
+		double megabytes = TFPlugin::get_api()._lua->tonumber(L, 1);
+		TFSession::set_memory_budget((uint64_t)(megabytes * 1024.0 * 1024.0));
+		return 0;
+	}
+
+	// Activation memory ceiling in megabytes for sessions started afterwards, larger frames run in batches of tiles. Zero
+	// runs every frame at once.
+	int set_memory_ceiling(struct lua_State *L)
+	{
+		double megabytes = TFPlugin::get_api()._lua->tonumber(L, 1);
+		TFSession::set_default_memory_ceiling((uint64_t)(megabytes * 1024.0 * 1024.0));
+		return 0;
+	}
+
+	// Views side by side in the render targets for sessions started afterwards, both eyes in vr or the viewports of a
+	// split screen. All views run through the network as one batch, which holds up to 16 views.
+	int set_views(struct lua_State *L)
+	{
+		unsigned views = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 1);
+		TFSession::set_default_views(views);
+		return 0;
+	}
+
+	// Sessions started afterwards rerun the network only around the 64x64 tiles whose normals or depth changed and keep the
+	// result of the other tiles
+	int set_dirty_tiles(struct lua_State *L)
+	{
+		TFSession::set_default_dirty_tiles(TFPlugin::get_api()._lua->toboolean(L, 1) != 0);
+		return 0;
+	}
+
+	// Returns the frames a dirty tile session ran, the ones without any dirty tile and the batches of windows it ran
+	int dirty_tile_stats(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		Session_Registry_Scope registry;
+		Graph_Execution_Session *session = TFSession::get(handle);
+		if (session == nullptr || !session->dirty_tiles)
+			return 0;
+
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)session->dirty.frames);
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)session->dirty.clean_frames);
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)session->dirty.window_runs);
+		return 3;
+	}
+
+	// Network time budget in milliseconds for sessions started afterwards, the session moves between the render target
+	// size divided by 1, 2 and 4 to hold it. Zero keeps the resolution factor fixed.
+	int set_time_budget(struct lua_State *L)
+	{
+		double budget_ms = TFPlugin::get_api()._lua->tonumber(L, 1);
+		TFSession::set_default_time_budget((float)budget_ms);
+		return 0;
+	}
+
+	// Returns the resolution factor the session runs at, the average network milliseconds at it and the number of switches
+	int adaptive_stats(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		Session_Registry_Scope registry;
+		Graph_Execution_Session *session = TFSession::get(handle);
+		if (session == nullptr || session->adaptive.rungs == 0)
+			return 0;
+
+		TFPlugin::get_api()._lua->pushinteger(L, session->rungs[session->active_rung]->resolution_factor);
+		TFPlugin::get_api()._lua->pushnumber(L, session->adaptive.average_ms);
+		TFPlugin::get_api()._lua->pushinteger(L, (lua_Integer)session->adaptive.switches);
+		return 3;
+	}
+
+	// Returns the live, peak and budget host megabytes of a session followed by the in use and peak megabytes of its device
+	int memory_stats(struct lua_State *L)
+	{
+		SessionHandle handle = (SessionHandle) TFPlugin::get_api()._lua->tointeger(L, 1);
+		Allocator_Stats host;
+		TF::AllocatorStats device;
+		Session_Registry_Scope registry;
+		if (!TFSession::memory_stats(TFSession::get(handle), host, device))
+			return 0;
+
+		const double megabyte = 1024.0 * 1024.0;
+		TFPlugin::get_api()._lua->pushnumber(L, host.live_bytes / megabyte);
+		TFPlugin::get_api()._lua->pushnumber(L, host.peak_bytes / megabyte);
+		TFPlugin::get_api()._lua->pushnumber(L, host.budget / megabyte);
+		TFPlugin::get_api()._lua->pushnumber(L, device.bytes_in_use / megabyte);
+		TFPlugin::get_api()._lua->pushnumber(L, device.max_bytes_in_use / megabyte);
+		return 5;
+	}
+
+	int set_stats_enabled(struct lua_State *L)
+	{
+		TFStats::set_enabled(TFPlugin::get_api()._lua->toboolean(L, 1) != 0);
+		return 0;
+	}
+
+	// Returns a table with the p50, p95 and p99 milliseconds of every frame stage, e.g. stats.network.p95
+	int stats(struct lua_State *L)
+	{
+		static const char *stage_keys[FRAME_STAGE_COUNT] = { "copy_in", "input_op", "network", "output_op", "copy_out", "sync" };
+		LuaApi *lua = TFPlugin::get_api()._lua;
+		lua->createtable(L, 0, FRAME_STAGE_COUNT);
+		for (unsigned stage = 0; stage < FRAME_STAGE_COUNT; ++stage)
+		{
+			Stage_Percentiles percentiles = TFStats::percentiles((FrameStage)stage);
+			lua->createtable(L, 0, 4);
+			lua->pushnumber(L, percentiles.p50);
+			lua->setfield(L, -2, "p50");
+			lua->pushnumber(L, percentiles.p95);
+			lua->setfield(L, -2, "p95");
+			lua->pushnumber(L, percentiles.p99);
+			lua->setfield(L, -2, "p99");
+			lua->pushinteger(L, percentiles.samples);
+			lua->setfield(L, -2, "samples");
+			lua->setfield(L, -2, stage_keys[stage]);
+		}
+		return 1;
+	}
+
+	int reset_stats(struct lua_State *L)
+	{
+		TFStats::reset();
+		return 0;
+	}
+
+	// Returns the last sample of the InteractiveTensorStats op with the given node name, or nil before the first one.
+	// With a session handle the sample comes from the graph the session runs at the moment, otherwise from any session.
+	// The table has min, max, mean, nan_count, elements, run and the histogram counts as an array.
+	int tensor_stats(struct lua_State *L)
+	{
+		LuaApi *lua = TFPlugin::get_api()._lua;
+		const char *name = lua->tolstring(L, 1, nullptr);
+		const void *binding = nullptr;
+		bool found = name != nullptr;
+		if (found && lua->gettop(L) >= 2 && !lua->isnil(L, 2))
+		{
+			// The render thread swaps the model of a session during its frame, the frame lock keeps it still
+			Graph_Execution_Session *session;
+			{
+				Session_Registry_Scope registry;
+				session = TFSession::get((SessionHandle)lua->tointeger(L, 2));
+				if (session != nullptr)
+					++session->references;
+			}
+			if (session != nullptr)
+			{
+				{
+					TF::mutex_lock frame(session->frame_lock);
+					const Graph_Execution_Session *rung = session->adaptive.rungs > 0 ? session->rungs[session->active_rung] : session;
+					if (rung->state == SessionReady && rung->model != nullptr)
+						binding = rung->model->binding;
+				}
+				TFSession::release(session);
+			}
+			found = binding != nullptr;
+		}
+
+		Tensor_Stats sample;
+		if (!found || !TFTensorStats::read(binding, name, sample))
+		{
+			lua->pushnil(L);
+			return 1;
+		}
+
+		lua->createtable(L, 0, 7);
+		lua->pushnumber(L, sample.min);
+		lua->setfield(L, -2, "min");
+		lua->pushnumber(L, sample.max);
+		lua->setfield(L, -2, "max");
+		lua->pushnumber(L, tensor_stats_mean(sample));
+		lua->setfield(L, -2, "mean");
+		lua->pushinteger(L, (lua_Integer)sample.nan_count);
+		lua->setfield(L, -2, "nan_count");
+		lua->pushinteger(L, (lua_Integer)sample.elements);
+		lua->setfield(L, -2, "elements");
+		lua->pushinteger(L, (lua_Integer)sample.run);
+		lua->setfield(L, -2, "run");
+		lua->createtable(L, TENSOR_STATS_BINS, 0);
+		for (int bin = 0; bin < TENSOR_STATS_BINS; ++bin)
+		{
+			lua->pushinteger(L, sample.histogram[bin]);
+			lua->rawseti(L, -2, bin + 1);
+		}
+		lua->setfield(L, -2, "histogram");
+		return 1;
+	}
+
+	// Names of all stats ops instantiated so far, as an array
+	int tensor_stats_names(struct lua_State *L)
+	{
+		LuaApi *lua = TFPlugin::get_api()._lua;
+		std::vector<std::string> names = TFTensorStats::names();
+		lua->createtable(L, (int)names.size(), 0);
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			lua->pushstring(L, names[i].c_str());
+			lua->rawseti(L, -2, (int)i + 1);
+		}
+		return 1;
+	}
+
+	int reset_tensor_stats(struct lua_State *L)
+	{
+		TFTensorStats::reset();
+		return 0;
+	}
+
+	// Every n-th run of a session gets a full trace, zero turns tracing off
+	int set_trace_interval(struct lua_State *L)
+	{
+		unsigned frames = (unsigned) TFPlugin::get_api()._lua->tointeger(L, 1);
+		TFTrace::set_interval(frames);
+		return 0;
+	}
+
+	// Writes the per node table to <prefix>.txt and a chrome trace to <prefix>.json
+	int dump_trace(struct lua_State *L)
+	{
+		const char *path_prefix = TFPlugin::get_api()._lua->tolstring(L, 1, nullptr);
+		TF::Status status = TFTrace::dump(path_prefix ? path_prefix : "tensorflow_trace");
+		if (!status.ok())
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+		TFPlugin::get_api()._lua->pushboolean(L, status.ok());
+		return 1;
+	}
+
+	int reset_trace(struct lua_State *L)
+	{
+		TFTrace::reset();
 		return 0;
 	}
 
@@ -49,7 +457,39 @@ void setup_lua()
 {
 	ApiInterface api = TFPlugin::get_api();
 	api._lua->add_module_function("Tensorflow", "run_graph", run_graph);
+	api._lua->add_module_function("Tensorflow", "end_graph", end_graph);
+	api._lua->add_module_function("Tensorflow", "end_all_graphs", end_all_graphs);
+	api._lua->add_module_function("Tensorflow", "find_graph", find_graph);
+	api._lua->add_module_function("Tensorflow", "is_graph_ready", is_graph_ready);
+	api._lua->add_module_function("Tensorflow", "graph_status", graph_status);
+	api._lua->add_module_function("Tensorflow", "set_warmup_runs", set_warmup_runs);
+	api._lua->add_module_function("Tensorflow", "reload_graph", reload_graph);
+	api._lua->add_module_function("Tensorflow", "set_graph_watch_interval", set_graph_watch_interval);
 	api._lua->add_module_function("Tensorflow", "set_camera", set_camera);
+	api._lua->add_module_function("Tensorflow", "set_latency_depth", set_latency_depth);
+	api._lua->add_module_function("Tensorflow", "set_resolution_factor", set_resolution_factor);
+	api._lua->add_module_function("Tensorflow", "set_temporal", set_temporal);
+	api._lua->add_module_function("Tensorflow", "benchmark_graph", benchmark_graph);
+	api._lua->add_module_function("Tensorflow", "set_model_cache_limit", set_model_cache_limit);
+	api._lua->add_module_function("Tensorflow", "model_cache_stats", model_cache_stats);
+	api._lua->add_module_function("Tensorflow", "set_fold_transposes", set_fold_transposes);
+	api._lua->add_module_function("Tensorflow", "set_memory_budget", set_memory_budget);
+	api._lua->add_module_function("Tensorflow", "set_memory_ceiling", set_memory_ceiling);
+	api._lua->add_module_function("Tensorflow", "set_views", set_views);
+	api._lua->add_module_function("Tensorflow", "set_dirty_tiles", set_dirty_tiles);
+	api._lua->add_module_function("Tensorflow", "dirty_tile_stats", dirty_tile_stats);
+	api._lua->add_module_function("Tensorflow", "set_time_budget", set_time_budget);
+	api._lua->add_module_function("Tensorflow", "adaptive_stats", adaptive_stats);
+	api._lua->add_module_function("Tensorflow", "memory_stats", memory_stats);
+	api._lua->add_module_function("Tensorflow", "set_stats_enabled", set_stats_enabled);
+	api._lua->add_module_function("Tensorflow", "stats", stats);
+	api._lua->add_module_function("Tensorflow", "reset_stats", reset_stats);
+	api._lua->add_module_function("Tensorflow", "tensor_stats", tensor_stats);
+	api._lua->add_module_function("Tensorflow", "tensor_stats_names", tensor_stats_names);
+	api._lua->add_module_function("Tensorflow", "reset_tensor_stats", reset_tensor_stats);
+	api._lua->add_module_function("Tensorflow", "set_trace_interval", set_trace_interval);
+	api._lua->add_module_function("Tensorflow", "dump_trace", dump_trace);
+	api._lua->add_module_function("Tensorflow", "reset_trace", reset_trace);
 	api._lua->add_module_function("Tensorflow", "toogle_nnao_preview", toogle_nnao_preview);
 	api._lua->add_module_function("Tensorflow", "toogle_nnao_multiply", toogle_nnao_multiply);
 }
@@ -0,0 +1,261 @@
+#include "tf_model_cache.h"
+#include "tf_plugin.h"
+#include "tf_graph.h"
+#include "tf_binding.h"
+#include <plugin_foundation/hash_function.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	// Default memory limit, room for a handful of the NNAO graphs
+	const uint64_t DEFAULT_MODEL_CACHE_LIMIT = 64ull * 1024ull * 1024ull;
+
+	static std::vector<Graph_Model*> cached_models;
+	static Model_Cache_Stats cache_stats = { 0, 0, 0, 0, DEFAULT_MODEL_CACHE_LIMIT, 0 };
+	static uint64_t use_counter = 0;
+	static bool fold_transposes = true;
+	static ThreadCriticalSection *cache_lock = nullptr;
+
+	// Models get acquired on the worker thread while LUA and the render thread release them and read the stats
+	struct Cache_Lock
+	{
+		Cache_Lock() { if (cache_lock) TFPlugin::get_api()._thread->enter_critical_section(cache_lock); }
+		~Cache_Lock() { if (cache_lock) TFPlugin::get_api()._thread->leave_critical_section(cache_lock); }
+	};
+
+	void destroy_model(Graph_Model *model)
+	{
+		cache_stats.memory_size -= model->memory_size;
+		cached_models.erase(std::find(cached_models.begin(), cached_models.end(), model));
+		if (model->tf_session)
+		{
+			model->tf_session->Close();
+			delete model->tf_session;
+		}
+		if (model->binding)
+			model->binding->Unref();
+		MAKE_DELETE(TFPlugin::get_allocator(), model);
+	}
+
+	// Drops the least recently used unreferenced models until the cache fits into its limit again
+	void evict_models()
+	{
+		while (cache_stats.memory_size > cache_stats.memory_limit)
+		{
+			Graph_Model *oldest = nullptr;
+			for (Graph_Model *model : cached_models)
+			{
+				if (model->references == 0 && (oldest == nullptr || model->last_used < oldest->last_used))
+					oldest = model;
+			}
+
+			if (oldest == nullptr)
+				return;
+
+			destroy_model(oldest);
+			++cache_stats.evictions;
+		}
+	}
+
+	Graph_Model *create_model(const std::string &graph_name, const std::string &contents, uint64_t content_hash, unsigned network_width, unsigned network_height)
+	{
+		Graph_Model *model = MAKE_NEW(TFPlugin::get_allocator(), Graph_Model);
+		model->tf_graph_name = graph_name;
+		model->content_hash = content_hash;
+		model->network_width = network_width;
+		model->network_height = network_height;
+		model->folded_transposes = fold_transposes;
+
+		// Another size of the same graph saves parsing it again
+		const Graph_Model *parsed = nullptr;
+		for (const Graph_Model *cached : cached_models)
+		{
+			if (cached->tf_graph_name == graph_name && cached->content_hash == content_hash && cached->folded_transposes == fold_transposes)
+				parsed = cached;
+		}
+
+		if (parsed)
+			model->tf_graph = parsed->tf_graph;
+		else if (!model->tf_graph.ParseFromString(contents)) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Could not parse the graph `%s`.", graph_name.c_str()));
+			MAKE_DELETE(TFPlugin::get_allocator(), model);
+			return nullptr;
+		}
+
+		TF::Status status = TFGraph::specialize(model->tf_graph, "image_data", network_width, network_height);
+		if (!status.ok()) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+			MAKE_DELETE(TFPlugin::get_allocator(), model);
+			return nullptr;
+		}
+
+		if (fold_transposes)
+			TFGraph::fold_transposes(model->tf_graph);
+
+		// Create a new Tensorflow Session
+		TF::SessionOptions options = TF::SessionOptions();
+		options.config.mutable_gpu_options()->set_allow_growth(true);
+
+		model->tf_session = TF::NewSession(options);
+		status = model->tf_session->Create(model->tf_graph);
+		if (!status.ok()) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+			model->tf_session->Close();
+			delete model->tf_session;
+			MAKE_DELETE(TFPlugin::get_allocator(), model);
+			return nullptr;
+		}
+
+		// The interactive ops of this session find the transfer data of their run through the binding
+		status = TFBinding::create(model->tf_session, DEFAULT_BINDING_NAME, &model->binding);
+		if (!status.ok()) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+			model->tf_session->Close();
+			delete model->tf_session;
+			MAKE_DELETE(TFPlugin::get_allocator(), model);
+			return nullptr;
+		}
+
+		// Fetched tensors stay on the device the graph runs on, the output op already wrote the result into the cuda buffers
+		model->device_name = "/device:CPU:0";
+		std::vector<TF::DeviceAttributes> devices;
+		if (model->tf_session->ListDevices(&devices).ok())
+		{
+			for (const TF::DeviceAttributes &device : devices)
+			{
+				if (device.device_type() == TF::DEVICE_GPU)
+				{
+					model->device_name = device.name();
+					break;
+				}
+			}
+		}
+
+		// The parsed graph and the constants copied into the session both hold the weights
+		model->memory_size = 2 * contents.size();
+		return model;
+	}
+
+	Graph_Model *TFModelCache::acquire(const std::string &graph_name, unsigned network_width, unsigned network_height)
+	{
+		Cache_Lock lock;
+		TF::Env *env = TF::Env::Default();
+		TF::FileStatistics file_stats;
+		TF::Status status = env->Stat(graph_name, &file_stats);
+		if (!status.ok()) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+			return nullptr;
+		}
+
+		// An untouched file is a hit without reading it again
+		Graph_Model *found = nullptr;
+		for (Graph_Model *model : cached_models)
+		{
+			if (model->tf_graph_name == graph_name && model->network_width == network_width && model->network_height == network_height &&
+				model->file_length == (uint64_t)file_stats.length && model->file_mtime == file_stats.mtime_nsec && model->folded_transposes == fold_transposes)
+			{
+				found = model;
+				break;
+			}
+		}
+
+		if (found == nullptr)
+		{
+			std::string contents;
+			status = TF::ReadFileToString(env, graph_name, &contents);
+			if (!status.ok()) {
+				TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+				return nullptr;
+			}
+			uint64_t content_hash = stingray_plugin_foundation::murmur_hash_64(contents.data(), (int)contents.size(), 0);
+
+			for (Graph_Model *model : cached_models)
+			{
+				if (model->tf_graph_name == graph_name && model->content_hash == content_hash && model->folded_transposes == fold_transposes &&
+					model->network_width == network_width && model->network_height == network_height)
+				{
+					found = model;
+					break;
+				}
+			}
+
+			if (found == nullptr)
+			{
+				++cache_stats.misses;
+				found = create_model(graph_name, contents, content_hash, network_width, network_height);
+				if (found == nullptr)
+					return nullptr;
+
+				cached_models.push_back(found);
+				cache_stats.memory_size += found->memory_size;
+			}
+			else
+				++cache_stats.hits;
+
+			found->file_length = file_stats.length;
+			found->file_mtime = file_stats.mtime_nsec;
+		}
+		else
+			++cache_stats.hits;
+
+		++found->references;
+		found->last_used = ++use_counter;
+		evict_models();
+		return found;
+	}
+
+	void TFModelCache::release(Graph_Model *model)
+	{
+		if (model == nullptr)
+			return;
+
+		Cache_Lock lock;
+		--model->references;
+		model->last_used = ++use_counter;
+		evict_models();
+	}
+
+	void TFModelCache::set_memory_limit(uint64_t bytes)
+	{
+		Cache_Lock lock;
+		cache_stats.memory_limit = bytes;
+		evict_models();
+	}
+
+	// Only affects graphs loaded afterwards, models loaded the other way stay cached side by side
+	void TFModelCache::set_fold_transposes(bool fold)
+	{
+		Cache_Lock lock;
+		fold_transposes = fold;
+	}
+
+	Model_Cache_Stats TFModelCache::stats()
+	{
+		Cache_Lock lock;
+		Model_Cache_Stats result = cache_stats;
+		result.models = (unsigned)cached_models.size();
+		return result;
+	}
+
+	void TFModelCache::init()
+	{
+		ApiInterface &api = TFPlugin::get_api();
+		if (cache_lock == nullptr && api._thread)
+			cache_lock = api._thread->create_critical_section(api._allocator_object);
+	}
+
+	void TFModelCache::clear()
+	{
+		{
+			Cache_Lock lock;
+			while (!cached_models.empty())
+				destroy_model(cached_models.back());
+		}
+
+		ApiInterface &api = TFPlugin::get_api();
+		if (cache_lock)
+		{
+			api._thread->destroy_critical_section(cache_lock, api._allocator_object);
+			cache_lock = nullptr;
+		}
+	}
+}
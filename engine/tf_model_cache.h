@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tf_settings.h"
+#include <vector>
+#include <stdint.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	namespace TF = tensorflow;
+
+	class TFBinding;
+
+	// A loaded graph and the tensorflow session holding its weights, shared by all execution sessions using the same graph file
+	struct Graph_Model
+	{
+		std::string tf_graph_name;
+		uint64_t content_hash = 0;
+		unsigned network_width = 0;
+		unsigned network_height = 0;
+		uint64_t file_length = 0;
+		int64_t file_mtime = 0;
+		uint64_t memory_size = 0;
+		uint64_t last_used = 0;
+		unsigned references = 0;
+		bool folded_transposes = false;
+		std::string device_name;
+		TF::GraphDef tf_graph;
+		TF::Session *tf_session = nullptr;
+		TFBinding *binding = nullptr;
+	};
+
+	struct Model_Cache_Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		uint64_t memory_size = 0;
+		uint64_t memory_limit = 0;
+		unsigned models = 0;
+	};
+
+	// LRU cache of parsed graphs and created sessions, keyed by the graph path, a murmur hash of the file contents and the
+	// network size the graph got specialized to. Models nobody references any more stay cached until the memory limit forces them out.
+	class TFModelCache
+	{
+	public:
+		static void init();
+		static Graph_Model *acquire(const std::string &graph_name, unsigned network_width, unsigned network_height);
+		static void release(Graph_Model *model);
+		static void set_memory_limit(uint64_t bytes);
+		static void set_fold_transposes(bool fold);
+		static Model_Cache_Stats stats();
+		static void clear();
+	};
+}
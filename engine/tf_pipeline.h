@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	// Maximum number of frames an inference result is allowed to lag behind the frame it was submitted in
+	const unsigned MAX_LATENCY_DEPTH = 3;
+	const unsigned MAX_PIPELINE_SLOTS = MAX_LATENCY_DEPTH + 1;
+
+	// Schedules frames over a ring of staging slots so that frame N is submitted while the result of frame N - depth is consumed.
+	// The scheduling does not know anything about the device doing the work, the Device only needs to provide:
+	//   void submit(unsigned slot, uint64_t frame) - starts the asynchronous work for a staged slot
+	//   void wait(unsigned slot)                   - blocks until the work of a submitted slot has finished
+	// A latency depth of zero waits for every frame right after submitting it, which is the old blocking behaviour.
+	template <typename Device>
+	class FramePipeline
+	{
+	public:
+		Device device;
+
+		explicit FramePipeline(unsigned latency_depth = 0)
+		{
+			set_latency_depth(latency_depth);
+		}
+
+		// Waits for all in flight frames and drops their results, the slots can be reallocated afterwards
+		void set_latency_depth(unsigned latency_depth)
+		{
+			flush();
+			_latency_depth = latency_depth < MAX_LATENCY_DEPTH ? latency_depth : MAX_LATENCY_DEPTH;
+		}
+
+		unsigned latency_depth() const { return _latency_depth; }
+		unsigned slot_count() const { return _latency_depth + 1; }
+		uint64_t frames_submitted() const { return _frames_submitted; }
+		uint64_t frames_consumed() const { return _frames_consumed; }
+		bool in_flight(unsigned slot) const { return _in_flight[slot]; }
+		uint64_t slot_frame(unsigned slot) const { return _slot_frame[slot]; }
+
+		// Returns the slot the next frame has to be staged into. The slot is normally free already since its previous
+		// frame got consumed one frame ago, if the caller skipped a consume the old result is recycled here.
+		unsigned stage()
+		{
+			unsigned slot = (unsigned)(_frames_submitted % slot_count());
+			if (_in_flight[slot])
+			{
+				device.wait(slot);
+				_in_flight[slot] = false;
+			}
+			return slot;
+		}
+
+		// Hands the staged slot over to the device
+		void submit()
+		{
+			unsigned slot = (unsigned)(_frames_submitted % slot_count());
+			_in_flight[slot] = true;
+			_slot_frame[slot] = _frames_submitted;
+			device.submit(slot, _frames_submitted);
+			++_frames_submitted;
+		}
+
+		// Waits for the result which is due this frame. Returns false while the pipeline is still filling up or the result
+		// has been recycled. The output of the returned slot stays valid until the slot gets staged again.
+		bool consume(unsigned &slot, uint64_t &result_frame)
+		{
+			if (_frames_submitted <= _latency_depth)
+				return false;
+
+			result_frame = _frames_submitted - 1 - _latency_depth;
+			slot = (unsigned)(result_frame % slot_count());
+			if (!_in_flight[slot] || _slot_frame[slot] != result_frame)
+				return false;
+
+			device.wait(slot);
+			_in_flight[slot] = false;
+			_frames_consumed++;
+			return true;
+		}
+
+		// Waits for every in flight slot, the pending results are dropped
+		void flush()
+		{
+			for (unsigned slot = 0; slot < MAX_PIPELINE_SLOTS; ++slot)
+			{
+				if (_in_flight[slot])
+				{
+					device.wait(slot);
+					_in_flight[slot] = false;
+				}
+			}
+			_frames_submitted = 0;
+			_frames_consumed = 0;
+		}
+
+	private:
+		unsigned _latency_depth = 0;
+		uint64_t _frames_submitted = 0;
+		uint64_t _frames_consumed = 0;
+		bool _in_flight[MAX_PIPELINE_SLOTS] = {};
+		uint64_t _slot_frame[MAX_PIPELINE_SLOTS] = {};
+	};
+}
@@ -1,11 +1,10 @@
 #include "tf_plugin.h"
+#include "tf_trace.h"
 
 namespace PLUGIN_NAMESPACE
 {
 	//#define WAITFORDEBUGGER
-	#define checkCUDAError(msg) if(getLastCudaError (msg, __FILE__, __LINE__)) return
-	#define MEASURE_TIME
-	//#define PRINT_RESULTS
+	#define checkCUDAError(msg) if(TFPlugin::getLastCudaError (msg, __FILE__, __LINE__)) return false
 
 	namespace SPF = stingray_plugin_foundation;
 	namespace TF = tensorflow;
@@ -20,9 +19,6 @@ namespace PLUGIN_NAMESPACE
 	bool _compiler_api_initialized = false;
 	bool _game_api_initialized = false;
 
-	// This is actually bad, should find a more flexible solution at some point
-	const unsigned NUMBER_OF_CHANNELS = 4;
-
 	// pointers to the render resources we are flushing through the network
 	enum RenderTargetStep { ReceivingNormals, ReceivingDepth, ReceivingNNAO, ReceivedEverything };
 	static RenderResource *normals_resource = nullptr;
@@ -33,32 +29,10 @@ namespace PLUGIN_NAMESPACE
 	static ID3D11Texture2D *nnao_render_target = nullptr;
 	static RenderTargetStep step_identifier = ReceivingNormals;
 
-	// Structure to define a tensorflow session, only one is supported right now
-	struct Graph_Execution_Session
-	{
-		bool initialized = false;
-		bool endless = false;
-		unsigned texture_width;
-		unsigned texture_height;
-		unsigned iterations_done;
-		unsigned iterations_max;
-		std::string output_node_name;
-		std::string tf_graph_name;
-		cudaArray *input_array = nullptr;
-		cudaArray *depth_array = nullptr;
-		cudaArray *output_array = nullptr;
-		cudaGraphicsResource *input_resource = nullptr;
-		ID3D11Texture2D *input_texture = nullptr;
-		cudaGraphicsResource *depth_resource = nullptr;
-		ID3D11Texture2D *depth_texture = nullptr;
-		cudaGraphicsResource *output_resource = nullptr;
-		ID3D11Texture2D *output_texture = nullptr;
-		TF::Tensor *zero_input = nullptr;
-		TF::Session *tf_session = nullptr;
-		TF::GraphDef tf_graph;
-	};
-
-	static Graph_Execution_Session *session = nullptr;
+	// Graph files are checked for changes at this interval, zero disables the watching
+	static double graph_watch_interval_ms = 500.0;
+	static double last_graph_watch_ms = 0.0;
+	static volatile bool graph_refresh_requested = false;
 
 	void wait_for_debugger()
 	{
@@ -106,6 +80,8 @@ namespace PLUGIN_NAMESPACE
 		_api._resource_manager = static_cast<ResourceManagerApi*>(get_engine_api(RESOURCE_MANAGER_API_ID));
 		_api._options = static_cast<ApplicationOptionsApi*>(get_engine_api(APPLICATION_OPTIONS_API_ID));
 		_api._c = static_cast<CApi*>(get_engine_api(C_API_ID));
+		_api._thread = static_cast<ThreadApi*>(get_engine_api(THREAD_API_ID));
+		_api._profiler = static_cast<ProfilerApi*>(get_engine_api(PROFILER_API_ID));
 		_api._allocator = static_cast<AllocatorApi*>(get_engine_api(ALLOCATOR_API_ID));
 		_api._allocator_object = _api._allocator->make_plugin_allocator(TFPlugin::get_name());
 		_tensorflow_allocator = SPF::ApiAllocator(_api._allocator, _api._allocator_object);
@@ -129,6 +105,8 @@ namespace PLUGIN_NAMESPACE
 		_api._resource_manager = nullptr;
 		_api._options = nullptr;
 		_api._c = nullptr;
+		_api._thread = nullptr;
+		_api._profiler = nullptr;
 		_game_api_initialized = false;
 	}
 
@@ -156,152 +134,45 @@ namespace PLUGIN_NAMESPACE
 	}
 
 	// Exposed to LUA
-	void TFPlugin::run_tf_graph(const char *graph_name, const char *node, unsigned iterations, bool endless)
+	SessionHandle TFPlugin::run_tf_graph(const char *session_name, const char *graph_name, const char *node, unsigned iterations, bool endless)
 	{
 		if (normals_render_target == nullptr || depth_render_target == nullptr || nnao_render_target == nullptr)
 		{
 			_api._logging->error(get_name(), "Could not initialize Tensorflow Graph Session, Render Targets are missing.");
-			return;
+			return INVALID_SESSION_HANDLE;
 		}
 
-		session = MAKE_NEW(get_allocator(), Graph_Execution_Session);
-		session->output_node_name = node;
-		session->tf_graph_name = graph_name;
-		session->iterations_done = 0;
-		session->iterations_max = iterations;
-		session->endless = endless;
+		// The graph gets specialized to the size of the render targets
+		D3D11_TEXTURE2D_DESC desc;
+		normals_render_target->GetDesc(&desc);
 
-		ID3D11Device* device = reinterpret_cast<ID3D11Device*>(_api._render_interface->device());
-		ID3D11DeviceContext *immediate_context;
-		device->GetImmediateContext(&immediate_context);
+		// The session loads in the background, until then it reports itself as pending
+		Graph_Execution_Session *session = TFSession::create(session_name, graph_name, node, iterations, endless, desc.Width, desc.Height);
+		return session->handle;
+	}
+
+	// The projection of the camera is set up for the render targets the graphs read, before those are known a wide screen
+	// is assumed
+	float TFPlugin::aspect_ratio()
+	{
+		if (normals_render_target == nullptr)
+			return 16.0f / 9.0f;
 
 		D3D11_TEXTURE2D_DESC desc;
 		normals_render_target->GetDesc(&desc);
-		session->texture_width = desc.Width;
-		session->texture_height = desc.Height;
-		RtlZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
-		desc.Width = session->texture_width;
-		desc.Height = session->texture_height;
-		desc.MipLevels = 1;
-		desc.ArraySize = 1;
-		desc.SampleDesc.Count = 1;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-
-		desc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
-		device->CreateTexture2D(&desc, nullptr, &session->input_texture);
-
-		desc.Format = DXGI_FORMAT_R32_FLOAT;
-		device->CreateTexture2D(&desc, nullptr, &session->depth_texture);
-		device->CreateTexture2D(&desc, nullptr, &session->output_texture);
-
-		cudaGraphicsD3D11RegisterResource(&session->input_resource, session->input_texture, cudaGraphicsRegisterFlagsNone);
-		checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
-		cudaGraphicsD3D11RegisterResource(&session->depth_resource, session->depth_texture, cudaGraphicsRegisterFlagsNone);
-		checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
-		cudaGraphicsD3D11RegisterResource(&session->output_resource, session->output_texture, cudaGraphicsRegisterFlagsNone);
-		checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
-
-		size_t memorySize = session->texture_width * sizeof(unsigned char) * NUMBER_OF_CHANNELS;
-		void* inputLinearMemory = nullptr;
-		void* depthLinearMemory = nullptr;
-		void* outputLinearMemory = nullptr;
-		size_t pitchSize = 0;
-
-		cudaMallocPitch(&inputLinearMemory, &pitchSize, memorySize, session->texture_height);
-		checkCUDAError("cudaMallocPitch() failed");
-		cudaMallocPitch(&depthLinearMemory, &pitchSize, memorySize, session->texture_height);
-		checkCUDAError("cudaMallocPitch() failed");
-		cudaMallocPitch(&outputLinearMemory, &pitchSize, memorySize, session->texture_height);
-		checkCUDAError("cudaMallocPitch() failed");
-
-		cudaMemset(inputLinearMemory, 0, pitchSize * session->texture_height);
-		checkCUDAError("cudaMemset() failed");
-		cudaMemset(depthLinearMemory, 0, pitchSize * session->texture_height);
-		checkCUDAError("cudaMemset() failed");
-		cudaMemset(outputLinearMemory, 0, pitchSize * session->texture_height);
-		checkCUDAError("cudaMemset() failed");
-
-		cudaGraphicsResourceSetMapFlags(session->input_resource, cudaGraphicsMapFlagsNone);
-		checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
-		cudaGraphicsResourceSetMapFlags(session->depth_resource, cudaGraphicsMapFlagsNone);
-		checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
-		cudaGraphicsResourceSetMapFlags(session->output_resource, cudaGraphicsMapFlagsNone);
-
-		checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
-		cudaGraphicsMapResources(1, &session->input_resource);
-		checkCUDAError("cudaGraphicsMapResources() failed");
-		cudaGraphicsMapResources(1, &session->depth_resource);
-		checkCUDAError("cudaGraphicsMapResources() failed");
-		cudaGraphicsMapResources(1, &session->output_resource);
-		checkCUDAError("cudaGraphicsMapResources() failed");
-
-		cudaGraphicsSubResourceGetMappedArray(&session->input_array, session->input_resource, 0, 0);
-		checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
-		cudaGraphicsSubResourceGetMappedArray(&session->depth_array, session->depth_resource, 0, 0);
-		checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
-		cudaGraphicsSubResourceGetMappedArray(&session->output_array, session->output_resource, 0, 0);
-		checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
-
-		TFCuda::set_input_memory_pointer(inputLinearMemory);
-		TFCuda::set_depth_memory_pointer(depthLinearMemory);
-		TFCuda::set_output_memory_pointer(outputLinearMemory);
-		TFCuda::set_pitch(pitchSize);
-		
-		// Create tensor input data to fulfill graph conditions, could maybe refactored later
-		session->zero_input = new TF::Tensor(TF::DT_FLOAT, TF::TensorShape({ 1, session->texture_width, session->texture_height, 4 }));
-
-		// Create a new Tensorflow Session
-		TF::SessionOptions options = TF::SessionOptions();
-		options.config.mutable_gpu_options()->set_allow_growth(true);
-
-		session->tf_session = TF::NewSession(options);
-		TF::Status status = read_tf_graph(session->tf_graph_name, 0, &session->tf_graph);
-		if (!status.ok()) {
-			_api._logging->error(get_name(), status.ToString().c_str());
-			return;
-		}
-
-		status = session->tf_session->Create(session->tf_graph);
-		if (!status.ok()) {
-			_api._logging->error(get_name(), status.ToString().c_str());
-			return;
-		}
+		return desc.Height > 0 ? (float)desc.Width / desc.Height : 16.0f / 9.0f;
+	}
 
-		session->initialized = true;
+	// The sessions only get marked, the render thread destroys them before its next frame
+	void TFPlugin::end_tf_execution(SessionHandle handle)
+	{
+		Session_Registry_Scope registry;
+		TFSession::end(TFSession::get(handle));
 	}
 
-	void TFPlugin::end_tf_execution()
+	void TFPlugin::end_all_tf_executions()
 	{
-		if (session)
-		{
-			cudaGraphicsUnmapResources(1, &session->depth_resource);
-			checkCUDAError("cudaGraphicsUnmapResources() failed");
-			cudaGraphicsUnregisterResource(session->depth_resource);
-			checkCUDAError("cudaGraphicsUnregisterResource() failed");
-			cudaFree(TFCuda::get_depth_memory_pointer());
-			checkCUDAError("cudaFree() failed");
-			session->depth_texture->Release();
-
-			cudaGraphicsUnmapResources(1, &session->input_resource);
-			checkCUDAError("cudaGraphicsUnmapResources() failed");
-			cudaGraphicsUnregisterResource(session->input_resource);
-			checkCUDAError("cudaGraphicsUnregisterResource() failed");
-			cudaFree(TFCuda::get_input_memory_pointer());
-			checkCUDAError("cudaFree() failed");
-			session->input_texture->Release();
-
-			cudaGraphicsUnmapResources(1, &session->output_resource);
-			checkCUDAError("cudaGraphicsUnmapResources() failed");
-			cudaGraphicsUnregisterResource(session->output_resource);
-			checkCUDAError("cudaGraphicsUnregisterResource() failed");
-			cudaFree(TFCuda::get_output_memory_pointer());
-			checkCUDAError("cudaFree() failed");
-			session->output_texture->Release();
-
-			MAKE_DELETE(get_allocator(), session);
-			session = nullptr;
-		}
+		TFSession::end_all();
 	}
 
 	void TFPlugin::setup_plugin(GetApiFunction get_engine_api)
@@ -319,6 +190,11 @@ namespace PLUGIN_NAMESPACE
 
 		setup_lua();
 		setup_kernels();
+
+		TFModelCache::init();
+		TFTrace::init();
+		if (!TFWorker::start())
+			_api._logging->warning(get_name(), "Could not start the Tensorflow worker thread, graphs get loaded and run on the calling thread.");
 	}
 
 	void TFPlugin::update_plugin(float dt)
@@ -329,6 +205,208 @@ namespace PLUGIN_NAMESPACE
 		step_identifier = ReceivingNormals;
 	}
 
+	// Stages the current render targets for the graph of a single session and picks up the result which is due this frame,
+	// returns false if the session should be ended
+	bool run_session(Graph_Execution_Session *session, ID3D11DeviceContext *immediate_context)
+	{
+		unsigned slot = session->pipeline.stage();
+		CUDA_transfer_data &data = session->transfer_data[slot];
+
+		// A network running at a lower resolution gets the render targets through the full resolution buffers of the slot
+		const bool resample = session->resolution_factor > 1;
+		const bool temporal = session->temporal_interval > 0;
+		const Reproject_Params temporal_params = temporal ? TFSession::temporal_params(session) : Reproject_Params();
+		void *normals_memory = resample ? session->full_resolution[slot].normals : data._input_memory;
+		void *depth_memory = resample ? session->full_resolution[slot].depth : data._depth_memory;
+		size_t pitch = resample ? session->full_resolution[slot].pitch : data._pitch;
+
+		{
+			Stage_Scope scope(StageCopyIn);
+
+			// Copy the normals texture data (R8G8B8A8) into CUDA memory, depth only graphs skip it
+			if (session->reads_normals)
+			{
+				immediate_context->CopySubresourceRegion(session->input_texture, 0, 0, 0, 0, normals_render_target, 0, nullptr);
+				cudaMemcpy2DFromArrayAsync(normals_memory, pitch, session->input_array, 0, 0, session->texture_width * NORMALS_PIXEL_SIZE, session->texture_height, cudaMemcpyDeviceToDevice, session->copy_stream);
+				checkCUDAError("cudaMemcpy2DFromArrayAsync() failed");
+			}
+
+			// Copy the depth texture data (R32F) into CUDA memory
+			immediate_context->CopySubresourceRegion(session->depth_texture, 0, 0, 0, 0, depth_render_target, 0, nullptr);
+			cudaMemcpy2DFromArrayAsync(depth_memory, pitch, session->depth_array, 0, 0, session->texture_width * sizeof(float), session->texture_height, cudaMemcpyDeviceToDevice, session->copy_stream);
+			checkCUDAError("cudaMemcpy2DFromArrayAsync() failed");
+
+			// The lanes of the tile hashes come back with the copies, the worker finishes them when it runs the slot
+			if (session->dirty_tiles)
+			{
+				Dirty_Tiles &dirty = session->dirty;
+				TFTiles::hash_lanes(dirty.grid, (const unsigned char*)normals_memory, (const float*)depth_memory, pitch, dirty.lanes[slot], session->copy_stream);
+				checkCUDAError("TFTiles::hash_lanes() failed");
+				cudaMemcpyAsync(dirty.host_lanes[slot], dirty.lanes[slot], dirty.grid.columns * dirty.grid.rows * TILE_HASH_LANES * sizeof(uint32_t), cudaMemcpyDeviceToHost, session->copy_stream);
+				checkCUDAError("cudaMemcpyAsync() failed");
+			}
+
+			if (resample)
+			{
+				TFResample::downsample(TFSession::resample_params(session), TFSession::resample_surfaces(session, slot), session->copy_stream);
+				checkCUDAError("TFResample::downsample() failed");
+			}
+
+			// The last result is reprojected into this frame right behind the copies, the disoccluded pixels decide below
+			// whether the network has to run
+			if (temporal)
+			{
+				cudaMemsetAsync(session->temporal.invalid_count, 0, sizeof(unsigned), session->copy_stream);
+				TFTemporal::reproject(temporal_params, TFSession::temporal_surfaces(session, slot, false), session->temporal.invalid_count, session->copy_stream);
+				checkCUDAError("TFTemporal::reproject() failed");
+				cudaMemcpyAsync(session->temporal.host_invalid_count, session->temporal.invalid_count, sizeof(unsigned), cudaMemcpyDeviceToHost, session->copy_stream);
+				checkCUDAError("cudaMemcpyAsync() failed");
+			}
+
+			// Only waits for the copies, the network of earlier frames keeps running
+			cudaStreamSynchronize(session->copy_stream);
+			checkCUDAError("cudaStreamSynchronize() failed");
+		}
+
+		// A slot which is not submitted gets staged again next frame
+		const bool run_network = !temporal || TFTemporal::needs_network(temporal_params.has_history, session->temporal.frames_since_run, session->temporal_interval,
+			*session->temporal.host_invalid_count, session->texture_width * session->texture_height, session->temporal_invalid_fraction);
+		if (run_network)
+			session->pipeline.submit();
+
+		unsigned result_slot = slot;
+		uint64_t result_frame = 0;
+		const bool has_result = run_network && session->pipeline.consume(result_slot, result_frame);
+		if (!has_result && !temporal)
+			return true;
+
+		const TF::Status &status = session->slot_status[result_slot];
+		if (has_result && !status.ok()) {
+			_api._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+			return false;
+		}
+
+		// The result is copied as is when the nnao_map render target has the format the graph writes, any other target gets
+		// it converted to R32F
+		if (session->converted_output == nullptr)
+		{
+			D3D11_TEXTURE2D_DESC target_desc;
+			nnao_render_target->GetDesc(&target_desc);
+			if (target_desc.Format != TFSession::output_texture_format(session->output_format)) {
+				_api._logging->warning(TFPlugin::get_name(), _api._error->eprintf("The nnao_map render target does not have the output format of graph `%s`, falling back to R32F.", session->name.c_str()));
+				if (!TFSession::fall_back_to_r32f(session)) {
+					_api._logging->error(TFPlugin::get_name(), _api._error->eprintf("Could not create the R32F output of graph `%s`.", session->name.c_str()));
+					return false;
+				}
+			}
+		}
+
+		{
+			Stage_Scope scope(StageCopyOut);
+			CUDA_transfer_data &result = session->transfer_data[result_slot];
+			const void *output_memory = result._output_memory;
+			size_t output_pitch = result._output_pitch;
+
+			// The up pass is guided by the full resolution normals and depth of the frame the result belongs to
+			if (has_result && resample)
+			{
+				TFResample::upsample(TFSession::resample_params(session), TFSession::resample_surfaces(session, result_slot), session->copy_stream);
+				checkCUDAError("TFResample::upsample() failed");
+				output_memory = session->full_resolution[result_slot].output;
+				output_pitch = session->full_resolution[result_slot].output_pitch;
+			}
+
+			// The network result is blended into the reprojected history, the normals and depth of this frame are kept to
+			// reproject the next one
+			if (temporal)
+			{
+				Temporal_Buffers &buffers = session->temporal;
+				const Temporal_Surfaces surfaces = TFSession::temporal_surfaces(session, slot, has_result);
+				TFTemporal::resolve(temporal_params, surfaces, session->copy_stream);
+				checkCUDAError("TFTemporal::resolve() failed");
+				if (surfaces.previous_normals)
+				{
+					cudaMemcpy2DAsync(buffers.previous_normals, buffers.pitch, surfaces.normals, surfaces.pitch, session->texture_width * NORMALS_PIXEL_SIZE, session->texture_height, cudaMemcpyDeviceToDevice, session->copy_stream);
+					checkCUDAError("cudaMemcpy2DAsync() failed");
+				}
+				cudaMemcpy2DAsync(buffers.previous_depth, buffers.pitch, surfaces.depth, surfaces.pitch, session->texture_width * sizeof(float), session->texture_height, cudaMemcpyDeviceToDevice, session->copy_stream);
+				checkCUDAError("cudaMemcpy2DAsync() failed");
+				TFSession::advance_temporal(session, has_result);
+				output_memory = buffers.output;
+				output_pitch = buffers.output_pitch;
+			}
+
+			int output_format = session->output_format;
+			if (session->converted_output)
+			{
+				const Convert_Surfaces surfaces = { (const unsigned char*)output_memory, output_pitch, output_format, (unsigned char*)session->converted_output, session->converted_output_pitch, PixelR32F };
+				TFResample::convert(resample_params(session->texture_width, session->texture_height, 1), surfaces, session->copy_stream);
+				checkCUDAError("TFResample::convert() failed");
+				output_memory = session->converted_output;
+				output_pitch = session->converted_output_pitch;
+				output_format = PixelR32F;
+			}
+
+			cudaMemcpy2DToArrayAsync(session->output_array, 0, 0, output_memory, output_pitch, session->texture_width * pixel_size(output_format), session->texture_height, cudaMemcpyDeviceToDevice, session->copy_stream);
+			checkCUDAError("cudaMemcpy2DToArrayAsync failed");
+
+			cudaStreamSynchronize(session->copy_stream);
+			checkCUDAError("cudaStreamSynchronize failed");
+
+			immediate_context->CopySubresourceRegion(nnao_render_target, 0, 0, 0, 0, session->output_texture, 0, nullptr);
+		}
+
+		// Frames which only reused the history do not count as iterations of the graph, the rungs of an adaptive session
+		// count them for the session
+		if (!has_result)
+			return true;
+
+		TFSession::adapt(session, result_slot);
+		Graph_Execution_Session *owner = session->adaptive_owner ? session->adaptive_owner : session;
+		if (owner->iterations_done++ == 0)
+		{
+			owner->first_result_ms = TFSession::now_ms() - owner->created_time;
+			_api._logging->info(TFPlugin::get_name(), _api._error->eprintf("Graph `%s` delivered its first result after `%.1f` ms (loading `%.1f` ms, warm-up `%.1f` ms).",
+				owner->name.c_str(), owner->first_result_ms, owner->load_ms, owner->warmup_ms));
+		}
+
+		return owner->endless || owner->iterations_done < owner->iterations_max;
+	}
+
+	// Runs the frame of a registered session, returns false if the session should be ended. A graph with different inputs
+	// or outputs needs new buffers, the session is started again with its handle and settings and the old one ends.
+	bool render_session(Graph_Execution_Session *session, bool watch_graphs, ID3D11DeviceContext *immediate_context)
+	{
+		if (session->state == SessionFailed)
+			return false;
+		if (session->state != SessionReady)
+			return true;
+
+		if (session->reload_state == ReloadRebuild)
+		{
+			// A session with no iterations left would still run one more frame after the rebuild, it ends here instead
+			if (session->endless || session->iterations_done < session->iterations_max)
+			{
+				D3D11_TEXTURE2D_DESC desc;
+				normals_render_target->GetDesc(&desc);
+				TFSession::rebuild(session, desc.Width, desc.Height);
+			}
+			return false;
+		}
+
+		// The rungs of an adaptive session are started again with it instead of reloading one after another
+		TFSession::apply_reload(session);
+		if (watch_graphs && TFSession::graph_changed(session))
+		{
+			if (session->adaptive.rungs > 1)
+				session->reload_state = ReloadRebuild;
+			else
+				TFSession::request_reload(session);
+		}
+
+		return run_session(TFSession::active_rung(session), immediate_context);
+	}
+
 	void TFPlugin::render(RenderDevicePluginArguments *arguments)
 	{
 		RenderResource *target = static_cast<RenderResource*>(arguments->engine_data.render_target);
@@ -356,73 +434,38 @@ namespace PLUGIN_NAMESPACE
 				return;
 		}
 
-		if (step_identifier == ReceivedEverything && session && session->initialized)
-		{
-			ID3D11Device* device = reinterpret_cast<ID3D11Device*>(_api._render_interface->device());
-			ID3D11DeviceContext *immediate_context;
-			device->GetImmediateContext(&immediate_context);
-
-			cudaMemset(TFCuda::get_input_memory_pointer(), 0, TFCuda::get_pitch() * session->texture_height);
-			checkCUDAError("cudaMemset() failed");
-			cudaMemset(TFCuda::get_depth_memory_pointer(), 0, TFCuda::get_pitch() * session->texture_height);
-			checkCUDAError("cudaMemset() failed");
-			cudaMemset(TFCuda::get_output_memory_pointer(), 0, TFCuda::get_pitch() * session->texture_height);
-			checkCUDAError("cudaMemset() failed");
-
-			// Copy the normals texture data (R8G8B8A8) into CUDA memory
-			immediate_context->CopySubresourceRegion(session->input_texture, 0, 0, 0, 0, normals_render_target, 0, nullptr);
-			cudaMemcpy2DFromArray(TFCuda::get_input_memory_pointer(), TFCuda::get_pitch(), session->input_array, 0, 0, session->texture_width * sizeof(unsigned char) * NUMBER_OF_CHANNELS, session->texture_height, cudaMemcpyDeviceToDevice);
-			checkCUDAError("cudaMemcpy2DFromArray() failed");
-
-			// Copy the depth texture data (R32F) into CUDA memory
-			immediate_context->CopySubresourceRegion(session->depth_texture, 0, 0, 0, 0, depth_render_target, 0, nullptr);
-			cudaMemcpy2DFromArray(TFCuda::get_depth_memory_pointer(), TFCuda::get_pitch(), session->depth_array, 0, 0, session->texture_width * sizeof(float), session->texture_height, cudaMemcpyDeviceToDevice);
-			checkCUDAError("cudaMemcpy2DFromArray() failed");
-
-			std::vector<std::pair<std::string, tensorflow::Tensor>> inputs = { { "image_data", *session->zero_input } };
-			std::vector<TF::Tensor> out_tensors;
-
-#ifdef MEASURE_TIME
-			auto t1 = std::chrono::system_clock::now();
-#endif
-			TF::Status status = session->tf_session->Run({ inputs }, { session->output_node_name }, {}, &out_tensors);
-#ifdef MEASURE_TIME
-			auto t2 = std::chrono::system_clock::now();
-			auto time_amount = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
-			_api._logging->warning(get_name(), _api._error->eprintf("Running the Tensorflow Graph took: `%lld` milliseconds.", time_amount.count()));
-#endif
-			if (!status.ok()) {
-				_api._logging->error(get_name(), status.ToString().c_str());
-				end_tf_execution();
-				return;
-			}
-
-#ifdef PRINT_RESULTS
-			// Prints the first 500 tensor values, this requires the output operator to run on the host
-			if (session->iterations_done == 1)
-			{
-				TF::Tensor result = out_tensors.at(0);
-				auto output_flat = result.flat<float>();
+		if (step_identifier != ReceivedEverything)
+			return;
 
-				for (auto i = 0; i < 500; i++) {
-					float value = output_flat(i);
-					_api._logging->info(get_name(), _api._error->eprintf("Tensor Value at Position %i is: %f", i, value));
-				}
-			}
-#endif
-			cudaMemcpy2DToArray(session->output_array, 0, 0, TFCuda::get_output_memory_pointer(), TFCuda::get_pitch(), session->texture_width * sizeof(float), session->texture_height, cudaMemcpyDeviceToDevice);
-			checkCUDAError("cudaMemcpy2DToArray failed");
+		step_identifier = ReceivingNormals;
 
-			cudaDeviceSynchronize();
-			checkCUDAError("cudaDeviceSynchronize failed");
+		ID3D11Device* device = reinterpret_cast<ID3D11Device*>(_api._render_interface->device());
+		ID3D11DeviceContext *immediate_context;
+		device->GetImmediateContext(&immediate_context);
 
-			immediate_context->CopySubresourceRegion(nnao_render_target, 0, 0, 0, 0, session->output_texture, 0, nullptr);
-			++session->iterations_done;
-			
-			if (!session->endless && session->iterations_done >= session->iterations_max)
-				end_tf_execution();
+		double now = TFSession::now_ms();
+		bool watch_graphs = graph_refresh_requested || (graph_watch_interval_ms > 0.0 && now - last_graph_watch_ms >= graph_watch_interval_ms);
+		if (watch_graphs)
+		{
+			last_graph_watch_ms = now;
+			graph_refresh_requested = false;
+		}
 
-			step_identifier = ReceivingNormals;
+		// Sessions ended from LUA go away between frames, the copy of the registry is only changed by this thread
+		TFSession::destroy_ended();
+		std::vector<Graph_Execution_Session*> running_sessions;
+		TFSession::sessions(running_sessions);
+		for (Graph_Execution_Session *session : running_sessions)
+		{
+			// A benchmark from LUA holds the session, it neither runs nor ends until the benchmark is done
+			if (!session->frame_lock.try_lock())
+				continue;
+			const bool ended = !render_session(session, watch_graphs, immediate_context);
+			if (ended)
+				session->ending = true;
+			session->frame_lock.unlock();
+			if (ended)
+				TFSession::destroy(session);
 		}
 	}
 
@@ -433,28 +476,6 @@ namespace PLUGIN_NAMESPACE
 		if (cudaSuccess != err)
 		{
 			_api._logging->error(get_name(), _api._error->eprintf("%s(%i) : getLastCudaError() CUDA error : %s : (%d) %s.\n", file, line, errorMessage, static_cast<int>(err), cudaGetErrorString(err)));
-
-			if (session)
-			{
-				cudaGraphicsUnmapResources(1, &session->depth_resource);
-				cudaGraphicsUnregisterResource(session->depth_resource);
-				cudaFree(TFCuda::get_depth_memory_pointer());
-				session->depth_texture->Release();
-
-				cudaGraphicsUnmapResources(1, &session->input_resource);
-				cudaGraphicsUnregisterResource(session->input_resource);
-				cudaFree(TFCuda::get_input_memory_pointer());
-				session->input_texture->Release();
-
-				cudaGraphicsUnmapResources(1, &session->output_resource);
-				cudaGraphicsUnregisterResource(session->output_resource);
-				cudaFree(TFCuda::get_output_memory_pointer());
-				session->output_texture->Release();
-
-				MAKE_DELETE(get_allocator(), session);
-				session = nullptr;
-			}
-
 			return true;
 		}
 		return false;
@@ -462,7 +483,10 @@ namespace PLUGIN_NAMESPACE
 
 	void TFPlugin::shutdown_plugin()
 	{
-		end_tf_execution();
+		TFSession::destroy_all();
+		TFWorker::stop();
+		TFModelCache::clear();
+		TFTrace::shutdown();
 		deinit_game_api();
 	}
 
@@ -482,9 +506,20 @@ namespace PLUGIN_NAMESPACE
 		return "TensorflowPlugin";
 	}
 
+	// Graphs are read by path, the engine refresh of graph files only makes the watcher look at them right away
 	int TFPlugin::can_refresh(uint64_t type)
 	{
-		return false;
+		return type == SPF::IdString64("pb").id();
+	}
+
+	void TFPlugin::refresh(uint64_t type, uint64_t name)
+	{
+		graph_refresh_requested = true;
+	}
+
+	void TFPlugin::set_graph_watch_interval(double seconds)
+	{
+		graph_watch_interval_ms = seconds > 0.0 ? seconds * 1000.0 : 0.0;
 	}
 
 	void* TFPlugin::get_render_env()
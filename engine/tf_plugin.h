@@ -4,9 +4,13 @@
 #include "tf_lua.h"
 #include "tf_kernel.h"
 #include "tf_cuda.h"
+#include "tf_session.h"
+#include "tf_worker.h"
+#include "tf_stats.h"
 #include <engine_plugin_api/plugin_api.h>
 #include <plugin_foundation/vector2.h>
 #include <plugin_foundation/string.h>
+#include <plugin_foundation/id_string.h>
 
 // D3D11 and CUDA Headers
 #include <d3d11.h>
@@ -37,6 +41,8 @@ namespace PLUGIN_NAMESPACE
 		ApplicationApi *_application;
 		ApplicationOptionsApi *_options;
 		CApi *_c;
+		ThreadApi *_thread;
+		ProfilerApi *_profiler;
 	};
 
 	class TFPlugin
@@ -51,10 +57,14 @@ namespace PLUGIN_NAMESPACE
 		static void shutdown_data_compiler();
 		static const char *get_name();
 		static int can_refresh(uint64_t type);
+		static void refresh(uint64_t type, uint64_t name);
+		static void set_graph_watch_interval(double seconds);
 		static TF::Status read_tf_graph(const std::string &path, unsigned mode, TF::GraphDef *def);
-		static void end_tf_execution();
-		static void run_tf_graph(const char *graph_name, const char *node_name, unsigned iterations, bool endless);
+		static void end_tf_execution(SessionHandle handle);
+		static void end_all_tf_executions();
+		static SessionHandle run_tf_graph(const char *session_name, const char *graph_name, const char *node_name, unsigned iterations, bool endless);
 		static bool getLastCudaError(const char *errorMessage, const char *file, const int line);
+		static float aspect_ratio();
 		static void render(RenderDevicePluginArguments *arguments);
 		static void end_frame();
 		static void* get_render_env();
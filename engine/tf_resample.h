@@ -0,0 +1,186 @@
+#pragma once
+
+#include "tf_interactive_io.h"
+#include <cuda_runtime_api.h>
+
+// Depth aware resampling around a network running at a fraction of the render target size. The down pass picks one pixel
+// of every block, the nearest one on even and the farthest one on odd pixels of a checkerboard so both sides of an edge
+// survive. The up pass is a joint bilateral filter over the four nearest network pixels, guided by the full resolution
+// depth and normals.
+
+// Resolution factors the sessions support, the network runs at the render target size divided by the factor
+const int MAX_RESOLUTION_FACTOR = 4;
+
+// Relative depth difference at which a network pixel counts half
+const float UPSAMPLE_DEPTH_SIGMA = 0.02f;
+
+// Floor of the bilateral weight relative to the bilinear one, pixels without any matching neighbour fall back to bilinear
+const float UPSAMPLE_MIN_WEIGHT = 1e-3f;
+
+struct Resample_Params
+{
+	int width;
+	int height;
+	int low_width;
+	int low_height;
+	int factor;
+};
+
+// The full resolution normals and depth share a pitch, so do the low resolution ones. Normals may be missing on both sides
+// when the graph does not read them, the up pass is guided by the depth alone then.
+struct Resample_Surfaces
+{
+	const unsigned char *normals;
+	const float *depth;
+	size_t pitch;
+	unsigned char *low_normals;
+	float *low_depth;
+	size_t low_pitch;
+	const unsigned char *low_output;
+	size_t low_output_pitch;
+	unsigned char *output;
+	size_t output_pitch;
+	int output_format;
+};
+
+// Result of a session converted to the format of a render target which does not have the format the graph writes
+struct Convert_Surfaces
+{
+	const unsigned char *output;
+	size_t output_pitch;
+	int output_format;
+	unsigned char *target;
+	size_t target_pitch;
+	int target_format;
+};
+
+IO_FUNC Resample_Params resample_params(int width, int height, int factor)
+{
+	Resample_Params params;
+	params.width = width;
+	params.height = height;
+	params.factor = factor;
+	params.low_width = (width + factor - 1) / factor;
+	params.low_height = (height + factor - 1) / factor;
+	return params;
+}
+
+template <typename T>
+IO_FUNC T *resample_row(T *base, size_t pitch, int y)
+{
+	return (T*)((unsigned char*)base + (size_t)y * pitch);
+}
+
+IO_FUNC void downsample_pixel(const Resample_Params &params, const Resample_Surfaces &surfaces, int x, int y)
+{
+	const bool farthest = ((x + y) & 1) != 0;
+	int selected_x = x * params.factor;
+	int selected_y = y * params.factor;
+	float selected = resample_row(surfaces.depth, surfaces.pitch, selected_y)[selected_x];
+
+	for (int block_y = y * params.factor; block_y < (y + 1) * params.factor && block_y < params.height; ++block_y)
+	{
+		const float *depth = resample_row(surfaces.depth, surfaces.pitch, block_y);
+		for (int block_x = x * params.factor; block_x < (x + 1) * params.factor && block_x < params.width; ++block_x)
+		{
+			if (farthest ? depth[block_x] > selected : depth[block_x] < selected)
+			{
+				selected = depth[block_x];
+				selected_x = block_x;
+				selected_y = block_y;
+			}
+		}
+	}
+
+	resample_row(surfaces.low_depth, surfaces.low_pitch, y)[x] = selected;
+	if (surfaces.normals && surfaces.low_normals)
+	{
+		const unsigned char *src = resample_row(surfaces.normals, surfaces.pitch, selected_y) + 4 * selected_x;
+		unsigned char *dest = resample_row(surfaces.low_normals, surfaces.low_pitch, y) + 4 * x;
+		for (int channel = 0; channel < 4; ++channel)
+			dest[channel] = src[channel];
+	}
+}
+
+IO_FUNC float upsample_normal_weight(const unsigned char *normal, const unsigned char *other)
+{
+	float dot = 0.0f;
+	for (int channel = 0; channel < 3; ++channel)
+		dot += (normal[channel] / 127.5f - 1.0f) * (other[channel] / 127.5f - 1.0f);
+	dot = dot > 0.0f ? dot : 0.0f;
+	dot *= dot;
+	dot *= dot;
+	return dot * dot;
+}
+
+IO_FUNC float upsample_depth_weight(float depth, float other)
+{
+	float difference = (depth - other) / ((depth > 0.0f ? depth : -depth) * UPSAMPLE_DEPTH_SIGMA + 1e-6f);
+	return 1.0f / (1.0f + difference * difference);
+}
+
+// The four taps are the bilinear neighbours of the pixel center in the network image
+IO_FUNC void upsample_taps(const Resample_Params &params, int x, int y, int tap_x[2], int tap_y[2], float &fraction_x, float &fraction_y)
+{
+	float low_x = (x + 0.5f) / params.factor - 0.5f;
+	float low_y = (y + 0.5f) / params.factor - 0.5f;
+	low_x = low_x > 0.0f ? low_x : 0.0f;
+	low_y = low_y > 0.0f ? low_y : 0.0f;
+	tap_x[0] = (int)low_x;
+	tap_y[0] = (int)low_y;
+	fraction_x = low_x - tap_x[0];
+	fraction_y = low_y - tap_y[0];
+	tap_x[1] = tap_x[0] + 1 < params.low_width ? tap_x[0] + 1 : tap_x[0];
+	tap_y[1] = tap_y[0] + 1 < params.low_height ? tap_y[0] + 1 : tap_y[0];
+}
+
+IO_FUNC void upsample_pixel(const Resample_Params &params, const Resample_Surfaces &surfaces, int x, int y)
+{
+	int tap_x[2], tap_y[2];
+	float fraction_x, fraction_y;
+	upsample_taps(params, x, y, tap_x, tap_y, fraction_x, fraction_y);
+
+	const float depth = resample_row(surfaces.depth, surfaces.pitch, y)[x];
+	const unsigned char *normal = surfaces.normals && surfaces.low_normals ? resample_row(surfaces.normals, surfaces.pitch, y) + 4 * x : nullptr;
+	const int size = pixel_size(surfaces.output_format);
+
+	float sum = 0.0f;
+	float weights = 0.0f;
+	for (int j = 0; j < 2; ++j)
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			float bilinear = (i ? fraction_x : 1.0f - fraction_x) * (j ? fraction_y : 1.0f - fraction_y);
+			float weight = upsample_depth_weight(depth, resample_row(surfaces.low_depth, surfaces.low_pitch, tap_y[j])[tap_x[i]]);
+			if (normal)
+				weight *= upsample_normal_weight(normal, resample_row(surfaces.low_normals, surfaces.low_pitch, tap_y[j]) + 4 * tap_x[i]);
+			weight = bilinear * (weight + UPSAMPLE_MIN_WEIGHT);
+
+			sum += weight * decode_output(surfaces.output_format, resample_row(surfaces.low_output, surfaces.low_output_pitch, tap_y[j]) + size * tap_x[i]);
+			weights += weight;
+		}
+	}
+
+	encode_output(surfaces.output_format, sum / weights, resample_row(surfaces.output, surfaces.output_pitch, y) + size * x);
+}
+
+IO_FUNC void convert_pixel(const Convert_Surfaces &surfaces, int x, int y)
+{
+	const float value = decode_output(surfaces.output_format, resample_row(surfaces.output, surfaces.output_pitch, y) + pixel_size(surfaces.output_format) * x);
+	encode_output(surfaces.target_format, value, resample_row(surfaces.target, surfaces.target_pitch, y) + pixel_size(surfaces.target_format) * x);
+}
+
+namespace PLUGIN_NAMESPACE
+{
+	// The gpu passes run on the given stream, the cpu passes are the reference the benchmark measures quality with
+	class TFResample
+	{
+	public:
+		static cudaError_t downsample(const Resample_Params &params, const Resample_Surfaces &surfaces, cudaStream_t stream);
+		static cudaError_t upsample(const Resample_Params &params, const Resample_Surfaces &surfaces, cudaStream_t stream);
+		static void downsample_cpu(const Resample_Params &params, const Resample_Surfaces &surfaces);
+		static void upsample_cpu(const Resample_Params &params, const Resample_Surfaces &surfaces);
+		static cudaError_t convert(const Resample_Params &params, const Convert_Surfaces &surfaces, cudaStream_t stream);
+		static void convert_cpu(const Resample_Params &params, const Convert_Surfaces &surfaces);
+	};
+}
@@ -0,0 +1,1485 @@
+#include "tf_session.h"
+#include "tf_plugin.h"
+#include "tf_worker.h"
+#include "tf_graph.h"
+#include "tf_trace.h"
+#include "tf_binding.h"
+
+namespace PLUGIN_NAMESPACE
+{
+	#define checkCUDAError(msg) if(TFPlugin::getLastCudaError (msg, __FILE__, __LINE__)) return false
+	// LUA starts, looks up and ends sessions while the render thread runs them
+	static TF::mutex registry_lock;
+	static std::vector<Graph_Execution_Session*> execution_sessions;
+	static SessionHandle next_handle = 1;
+	static float camera_near_range = 0.1f;
+	static float camera_far_range = 1000.0f;
+	static unsigned default_latency_depth = 0;
+	static unsigned default_resolution_factor = 1;
+	static unsigned default_temporal_interval = 0;
+	static float default_temporal_invalid_fraction = DEFAULT_TEMPORAL_INVALID_FRACTION;
+	static float default_temporal_blend = DEFAULT_TEMPORAL_BLEND;
+	static Temporal_Camera current_camera = {};
+	static bool has_camera = false;
+	static unsigned warmup_runs = 1;
+	static uint64_t default_memory_budget = 0;
+	static uint64_t default_memory_ceiling = 0;
+	static unsigned default_views = 1;
+	static bool default_dirty_tiles = false;
+	static float default_time_budget_ms = 0.0f;
+
+	void Session_Pipeline_Device::submit(unsigned slot, uint64_t frame)
+	{
+		// Without a worker thread the slot is executed right away, which makes any latency depth behave like zero
+		if (!TFWorker::push(session, slot))
+		{
+			TFSession::run_slot(session, slot);
+			TFPlugin::get_api()._thread->set_event(session->slot_events[slot]);
+		}
+	}
+
+	void Session_Pipeline_Device::wait(unsigned slot)
+	{
+		TFPlugin::get_api()._thread->wait_for_event(session->slot_events[slot]);
+	}
+
+	// The cuda buffers have the network size, the part outside of the render target stays zero. The output buffer has the
+	// format the output op of the graph writes, so it gets its own pitch. Normals and depth rows have the same size and
+	// share the pitch, graphs which never read the normals get no normals buffer at all.
+	bool allocate_transfer_data(CUDA_transfer_data &data, unsigned network_width, unsigned network_height, int output_format, bool normals)
+	{
+		size_t pitchSize = 0;
+
+		if (normals)
+		{
+			cudaMallocPitch(&data._input_memory, &pitchSize, network_width * NORMALS_PIXEL_SIZE, network_height);
+			checkCUDAError("cudaMallocPitch() failed");
+		}
+		cudaMallocPitch(&data._depth_memory, &pitchSize, network_width * sizeof(float), network_height);
+		checkCUDAError("cudaMallocPitch() failed");
+		cudaMallocPitch(&data._output_memory, &data._output_pitch, network_width * pixel_size(output_format), network_height);
+		checkCUDAError("cudaMallocPitch() failed");
+		data._pitch = pitchSize;
+
+		if (normals)
+		{
+			cudaMemset(data._input_memory, 0, pitchSize * network_height);
+			checkCUDAError("cudaMemset() failed");
+			TFCuda::bind_surface(data, "normals", data._input_memory, data._pitch);
+		}
+		cudaMemset(data._depth_memory, 0, pitchSize * network_height);
+		checkCUDAError("cudaMemset() failed");
+		cudaMemset(data._output_memory, 0, data._output_pitch * network_height);
+		checkCUDAError("cudaMemset() failed");
+
+		TFCuda::bind_surface(data, "depth", data._depth_memory, data._pitch);
+		TFCuda::bind_surface(data, "output", data._output_memory, data._output_pitch);
+
+		for (cudaEvent_t &event : data._stage_events)
+		{
+			cudaEventCreate(&event);
+			checkCUDAError("cudaEventCreate() failed");
+		}
+		return true;
+	}
+
+	void free_transfer_data(CUDA_transfer_data &data)
+	{
+		if (data._input_memory)
+			cudaFree(data._input_memory);
+		if (data._depth_memory)
+			cudaFree(data._depth_memory);
+		if (data._output_memory)
+			cudaFree(data._output_memory);
+		data._input_memory = nullptr;
+		data._depth_memory = nullptr;
+		data._output_memory = nullptr;
+		data._surface_count = 0;
+
+		for (cudaEvent_t &event : data._stage_events)
+		{
+			if (event)
+				cudaEventDestroy(event);
+			event = nullptr;
+		}
+	}
+
+	// The render targets get copied here as they are and resampled into the network buffers of the slot
+	bool allocate_full_resolution(Full_Resolution_Buffers &buffers, unsigned width, unsigned height, int output_format, bool normals)
+	{
+		size_t pitchSize = 0;
+
+		if (normals)
+		{
+			cudaMallocPitch(&buffers.normals, &pitchSize, width * NORMALS_PIXEL_SIZE, height);
+			checkCUDAError("cudaMallocPitch() failed");
+		}
+		cudaMallocPitch(&buffers.depth, &pitchSize, width * sizeof(float), height);
+		checkCUDAError("cudaMallocPitch() failed");
+		cudaMallocPitch(&buffers.output, &buffers.output_pitch, width * pixel_size(output_format), height);
+		checkCUDAError("cudaMallocPitch() failed");
+		buffers.pitch = pitchSize;
+		return true;
+	}
+
+	void free_full_resolution(Full_Resolution_Buffers &buffers)
+	{
+		if (buffers.normals)
+			cudaFree(buffers.normals);
+		if (buffers.depth)
+			cudaFree(buffers.depth);
+		if (buffers.output)
+			cudaFree(buffers.output);
+		buffers = Full_Resolution_Buffers();
+	}
+
+	// The history, the normals and depth of the last frame and the blended output all have the size of the render targets
+	bool allocate_temporal(Temporal_Buffers &buffers, unsigned width, unsigned height, int output_format, bool normals)
+	{
+		size_t pitchSize = 0;
+
+		for (float *&history : buffers.history)
+		{
+			cudaMallocPitch((void**)&history, &pitchSize, width * sizeof(float), height);
+			checkCUDAError("cudaMallocPitch() failed");
+		}
+		if (normals)
+		{
+			cudaMallocPitch(&buffers.previous_normals, &pitchSize, width * NORMALS_PIXEL_SIZE, height);
+			checkCUDAError("cudaMallocPitch() failed");
+		}
+		cudaMallocPitch((void**)&buffers.previous_depth, &pitchSize, width * sizeof(float), height);
+		checkCUDAError("cudaMallocPitch() failed");
+		cudaMallocPitch(&buffers.output, &buffers.output_pitch, width * pixel_size(output_format), height);
+		checkCUDAError("cudaMallocPitch() failed");
+		buffers.pitch = pitchSize;
+
+		cudaMalloc((void**)&buffers.invalid_count, sizeof(unsigned));
+		checkCUDAError("cudaMalloc() failed");
+		cudaMallocHost((void**)&buffers.host_invalid_count, sizeof(unsigned));
+		checkCUDAError("cudaMallocHost() failed");
+		return true;
+	}
+
+	void free_temporal(Temporal_Buffers &buffers)
+	{
+		for (float *history : buffers.history)
+			if (history)
+				cudaFree(history);
+		if (buffers.previous_normals)
+			cudaFree(buffers.previous_normals);
+		if (buffers.previous_depth)
+			cudaFree(buffers.previous_depth);
+		if (buffers.output)
+			cudaFree(buffers.output);
+		if (buffers.invalid_count)
+			cudaFree(buffers.invalid_count);
+		if (buffers.host_invalid_count)
+			cudaFreeHost(buffers.host_invalid_count);
+		buffers = Temporal_Buffers();
+	}
+
+	// Lanes of every slot on the device and pinned for the copy back, and the result of the network size the dirty windows
+	// patch
+	bool allocate_dirty_tiles(Dirty_Tiles &dirty, unsigned slots, unsigned network_width, unsigned network_height, int output_format)
+	{
+		const unsigned tiles = dirty.grid.columns * dirty.grid.rows;
+		for (unsigned slot = 0; slot < slots; ++slot)
+		{
+			cudaMalloc((void**)&dirty.lanes[slot], tiles * TILE_HASH_LANES * sizeof(uint32_t));
+			checkCUDAError("cudaMalloc() failed");
+			cudaMallocHost((void**)&dirty.host_lanes[slot], tiles * TILE_HASH_LANES * sizeof(uint32_t));
+			checkCUDAError("cudaMallocHost() failed");
+		}
+		cudaMallocPitch(&dirty.output, &dirty.output_pitch, network_width * pixel_size(output_format), network_height);
+		checkCUDAError("cudaMallocPitch() failed");
+
+		dirty.hashes.assign(tiles, 0);
+		dirty.previous.assign(tiles, 0);
+		dirty.dirty.reserve(tiles);
+		dirty.windows.reserve(tiles);
+		dirty.has_output = false;
+		return true;
+	}
+
+	// The window model stays, it is released with the model of the session
+	void free_dirty_tiles(Dirty_Tiles &dirty)
+	{
+		for (unsigned slot = 0; slot < MAX_PIPELINE_SLOTS; ++slot)
+		{
+			if (dirty.lanes[slot])
+				cudaFree(dirty.lanes[slot]);
+			if (dirty.host_lanes[slot])
+				cudaFreeHost(dirty.host_lanes[slot]);
+			dirty.lanes[slot] = nullptr;
+			dirty.host_lanes[slot] = nullptr;
+		}
+		if (dirty.output)
+			cudaFree(dirty.output);
+		dirty.output = nullptr;
+		dirty.has_output = false;
+		dirty.feeds.clear();
+		delete dirty.window_input;
+		dirty.window_input = nullptr;
+	}
+
+	// The windows of the dirty tiles run on a model of the window size, its callable is made like the one of the frame
+	bool load_windows(Graph_Execution_Session *session, Graph_Model *&model, bool &has_callable, TF::Session::CallableHandle &callable)
+	{
+		const unsigned size = TFTiles::window_size(session->dirty.grid, TILE_HALO);
+		model = TFModelCache::acquire(session->graph_name, size, size);
+		if (model == nullptr)
+			return false;
+		has_callable = TFSession::make_callable(session, model, callable);
+		return true;
+	}
+
+	void release_windows(Graph_Model *model, bool has_callable, TF::Session::CallableHandle callable)
+	{
+		if (model && has_callable)
+			model->tf_session->ReleaseCallable(callable);
+		TFModelCache::release(model);
+	}
+
+	DXGI_FORMAT TFSession::output_texture_format(int output_format)
+	{
+		if (output_format == PixelR8)
+			return DXGI_FORMAT_R8_UNORM;
+		if (output_format == PixelR16F)
+			return DXGI_FORMAT_R16_FLOAT;
+		return DXGI_FORMAT_R32_FLOAT;
+	}
+
+	// A render target which does not have the format the graph writes gets the result widened to R32F, the format the plugin
+	// always wrote. The output texture becomes R32F and the copy-out converts into a buffer of the render target size.
+	bool TFSession::fall_back_to_r32f(Graph_Execution_Session *session)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		session->output_texture->GetDesc(&desc);
+		ID3D11Device *device = nullptr;
+		session->output_texture->GetDevice(&device);
+
+		cudaGraphicsUnmapResources(1, &session->output_resource);
+		cudaGraphicsUnregisterResource(session->output_resource);
+		session->output_resource = nullptr;
+		session->output_array = nullptr;
+		session->output_texture->Release();
+		session->output_texture = nullptr;
+
+		desc.Format = DXGI_FORMAT_R32_FLOAT;
+		const HRESULT result = device->CreateTexture2D(&desc, nullptr, &session->output_texture);
+		device->Release();
+		if (FAILED(result))
+			return false;
+
+		cudaGraphicsD3D11RegisterResource(&session->output_resource, session->output_texture, cudaGraphicsRegisterFlagsNone);
+		checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
+		cudaGraphicsResourceSetMapFlags(session->output_resource, cudaGraphicsMapFlagsNone);
+		checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
+		cudaGraphicsMapResources(1, &session->output_resource);
+		checkCUDAError("cudaGraphicsMapResources() failed");
+		cudaGraphicsSubResourceGetMappedArray(&session->output_array, session->output_resource, 0, 0);
+		checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
+
+		cudaMallocPitch(&session->converted_output, &session->converted_output_pitch, session->texture_width * sizeof(float), session->texture_height);
+		checkCUDAError("cudaMallocPitch() failed");
+		return true;
+	}
+
+	// Every view of a multi-view session reads and writes its own part of the slot, the entries stay the same for every run.
+	// The views have to lie side by side in one render target, a layout the batch cannot hold fails the session.
+	bool bind_views(const Graph_Execution_Session *session, CUDA_transfer_data &data)
+	{
+		if (session->views <= 1)
+			return true;
+
+		const unsigned content_width = (session->texture_width + session->resolution_factor - 1) / session->resolution_factor;
+		if (!TFCuda::bind_views(data, session->views, content_width, session->network_height, session->graph_width, session->network_width, pixel_size(session->output_format))) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Session `%s` cannot run %u views side by side in %u pixels, a batch holds 1 to %u views of at most %u pixels each.",
+				session->name.c_str(), session->views, content_width, MAX_BATCH_ENTRIES, session->graph_width));
+			return false;
+		}
+		return true;
+	}
+
+	bool TFSession::create_buffers(Graph_Execution_Session *session, ID3D11Device *device)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		RtlZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+		desc.Width = session->texture_width;
+		desc.Height = session->texture_height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		// A depth only graph gets neither the normals texture nor the copy of the normals target every frame
+		session->input_channels = TFGraph::input_channels(session->model->tf_graph, "image_data");
+		session->reads_normals = TFGraph::reads_normals(session->model->tf_graph, "image_data");
+		if (session->reads_normals)
+		{
+			desc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
+			device->CreateTexture2D(&desc, nullptr, &session->input_texture);
+			cudaGraphicsD3D11RegisterResource(&session->input_resource, session->input_texture, cudaGraphicsRegisterFlagsNone);
+			checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
+		}
+
+		desc.Format = DXGI_FORMAT_R32_FLOAT;
+		device->CreateTexture2D(&desc, nullptr, &session->depth_texture);
+
+		session->output_format = TFGraph::output_format(session->model->tf_graph, session->output_node_name);
+		desc.Format = output_texture_format(session->output_format);
+		device->CreateTexture2D(&desc, nullptr, &session->output_texture);
+
+		cudaGraphicsD3D11RegisterResource(&session->depth_resource, session->depth_texture, cudaGraphicsRegisterFlagsNone);
+		checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
+		cudaGraphicsD3D11RegisterResource(&session->output_resource, session->output_texture, cudaGraphicsRegisterFlagsNone);
+		checkCUDAError("cudaGraphicsD3D11RegisterResource() failed");
+
+		// Every in flight frame gets its own staging buffers so the render thread never writes into memory the network reads
+		ApiInterface &api = TFPlugin::get_api();
+		for (unsigned slot = 0; slot < session->pipeline.slot_count(); ++slot)
+		{
+			if (!allocate_transfer_data(session->transfer_data[slot], session->network_width, session->network_height, session->output_format, session->reads_normals) ||
+				!bind_views(session, session->transfer_data[slot]))
+				return false;
+			if (session->resolution_factor > 1 &&
+				!allocate_full_resolution(session->full_resolution[slot], session->texture_width, session->texture_height, session->output_format, session->reads_normals))
+				return false;
+			session->slot_events[slot] = api._thread->create_event(api._allocator_object, false, false, "TensorflowSlotEvent");
+		}
+		if (session->temporal_interval > 0 &&
+			!allocate_temporal(session->temporal, session->texture_width, session->texture_height, session->output_format, session->reads_normals))
+			return false;
+		if (session->dirty_tiles &&
+			!allocate_dirty_tiles(session->dirty, session->pipeline.slot_count(), session->network_width, session->network_height, session->output_format))
+			return false;
+
+		cudaStreamCreateWithFlags(&session->copy_stream, cudaStreamNonBlocking);
+		checkCUDAError("cudaStreamCreateWithFlags() failed");
+
+		if (session->input_resource)
+		{
+			cudaGraphicsResourceSetMapFlags(session->input_resource, cudaGraphicsMapFlagsNone);
+			checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
+			cudaGraphicsMapResources(1, &session->input_resource);
+			checkCUDAError("cudaGraphicsMapResources() failed");
+			cudaGraphicsSubResourceGetMappedArray(&session->input_array, session->input_resource, 0, 0);
+			checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
+		}
+
+		cudaGraphicsResourceSetMapFlags(session->depth_resource, cudaGraphicsMapFlagsNone);
+		checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
+		cudaGraphicsResourceSetMapFlags(session->output_resource, cudaGraphicsMapFlagsNone);
+		checkCUDAError("cudaGraphicsResourceSetMapFlags() failed");
+
+		cudaGraphicsMapResources(1, &session->depth_resource);
+		checkCUDAError("cudaGraphicsMapResources() failed");
+		cudaGraphicsMapResources(1, &session->output_resource);
+		checkCUDAError("cudaGraphicsMapResources() failed");
+
+		cudaGraphicsSubResourceGetMappedArray(&session->depth_array, session->depth_resource, 0, 0);
+		checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
+		cudaGraphicsSubResourceGetMappedArray(&session->output_array, session->output_resource, 0, 0);
+		checkCUDAError("cudaGraphicsSubResourceGetMappedArray() failed");
+
+		// Create tensor input data to fulfill graph conditions, could maybe refactored later
+		session->allocator = MAKE_NEW(TFPlugin::get_allocator(), TFAllocator, "Tensorflow " + session->name, default_memory_budget);
+		const TF::int64 batch = session->tiling.batch > 0 ? session->tiling.batch : session->views;
+		session->zero_input = new TF::Tensor(session->allocator, TF::DT_FLOAT, TF::TensorShape({ batch, session->graph_width, session->graph_height, session->input_channels }));
+		if (!session->zero_input->IsInitialized()) {
+			TFPlugin::get_api()._logging->error(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("The input of session `%s` does not fit into its memory budget.", session->name.c_str()));
+			return false;
+		}
+		session->feeds = { *session->zero_input };
+		for (std::vector<TF::Tensor> &fetches : session->fetches)
+			fetches.reserve(1);
+
+		if (session->dirty_tiles)
+		{
+			const TF::int64 size = TFTiles::window_size(session->dirty.grid, TILE_HALO);
+			session->dirty.batch = MAX_BATCH_ENTRIES;
+			session->dirty.window_input = new TF::Tensor(session->allocator, TF::DT_FLOAT, TF::TensorShape({ session->dirty.batch, size, size, session->input_channels }));
+			if (!session->dirty.window_input->IsInitialized()) {
+				TFPlugin::get_api()._logging->error(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("The window input of session `%s` does not fit into its memory budget.", session->name.c_str()));
+				return false;
+			}
+			session->dirty.feeds = { *session->dirty.window_input };
+		}
+
+		session->has_callable = make_callable(session, session->model, session->callable);
+		if (!session->has_callable)
+			TFPlugin::get_api()._logging->warning(TFPlugin::get_name(), "Could not create a callable for the graph, falling back to Session::Run.");
+		return true;
+	}
+
+	// Binds the feed and fetch once so a frame does not need any node name lookups
+	bool TFSession::make_callable(Graph_Execution_Session *session, Graph_Model *model, TF::Session::CallableHandle &callable)
+	{
+		TF::CallableOptions options;
+		options.add_feed("image_data");
+		options.add_fetch(session->output_node_name);
+		(*options.mutable_fetch_devices())[session->output_node_name] = model->device_name;
+		options.set_fetch_skip_sync(true);
+
+		TF::Status status = model->tf_session->MakeCallable(options, &callable);
+		if (!status.ok())
+			TFPlugin::get_api()._logging->warning(TFPlugin::get_name(), status.ToString().c_str());
+		return status.ok();
+	}
+
+	TF::Status TFSession::execute(Graph_Execution_Session *session, std::vector<TF::Tensor> &outputs, bool use_callable)
+	{
+		return execute(session, session->model, use_callable && session->has_callable, session->callable, outputs);
+	}
+
+	TF::Status execute_feeds(Graph_Execution_Session *session, Graph_Model *model, bool has_callable, TF::Session::CallableHandle callable, const std::vector<TF::Tensor> &feeds, std::vector<TF::Tensor> &outputs)
+	{
+		// Clearing keeps the capacity, so the steady state does not allocate on the host
+		outputs.clear();
+		if (has_callable)
+			return model->tf_session->RunCallable(callable, feeds, &outputs, nullptr);
+
+		std::vector<std::pair<std::string, tensorflow::Tensor>> inputs = { { "image_data", feeds[0] } };
+		return model->tf_session->Run({ inputs }, { session->output_node_name }, {}, &outputs);
+	}
+
+	TF::Status TFSession::execute(Graph_Execution_Session *session, Graph_Model *model, bool has_callable, TF::Session::CallableHandle callable, std::vector<TF::Tensor> &outputs)
+	{
+		return execute_feeds(session, model, has_callable, callable, session->feeds, outputs);
+	}
+
+	// Warm-up and benchmark runs of a tiled session go over the first batch of tiles, which the batch entries have to cover
+	void bind_first_tiles(const Graph_Execution_Session *session, CUDA_transfer_data &data)
+	{
+		if (session->tiling.batch > 0)
+			TFTiles::bind_tiles(session->tiling, 0, session->output_format, data);
+	}
+
+	// Runs the batches of tiles one after another, every run writes its tiles into the output of the slot. The last run
+	// can hold fewer tiles and feeds the front of the input.
+	TF::Status execute_tiles(Graph_Execution_Session *session, unsigned slot)
+	{
+		CUDA_transfer_data &data = session->transfer_data[slot];
+		TF::Status status;
+		for (unsigned run = 0; run < session->tiling.runs && status.ok(); ++run)
+		{
+			const unsigned count = TFTiles::bind_tiles(session->tiling, run, session->output_format, data);
+			session->feeds[0] = count < session->tiling.batch ? session->zero_input->Slice(0, count) : *session->zero_input;
+			status = TFSession::execute(session, session->fetches[slot], true);
+		}
+		session->feeds[0] = *session->zero_input;
+		data._batch_count = 0;
+		return status;
+	}
+
+	// Runs the windows in batches on the window model. They read the normals and depth of the slot and write their tiles
+	// into the result of the dirty tiles.
+	TF::Status execute_windows(Graph_Execution_Session *session, const CUDA_transfer_data &data, std::vector<TF::Tensor> &outputs)
+	{
+		Dirty_Tiles &dirty = session->dirty;
+		CUDA_transfer_data &window_data = dirty.window_data;
+		window_data._input_memory = data._input_memory;
+		window_data._depth_memory = data._depth_memory;
+		window_data._pitch = data._pitch;
+		window_data._output_memory = dirty.output;
+		window_data._output_pitch = dirty.output_pitch;
+		window_data._near_range = data._near_range;
+		window_data._far_range = data._far_range;
+
+		Binding_Scope binding(dirty.model->binding, &window_data);
+		TF::Status status;
+		for (unsigned first = 0; first < dirty.windows.size() && status.ok(); first += dirty.batch)
+		{
+			const unsigned count = TFTiles::bind_windows(dirty.grid, dirty.windows, first, dirty.batch, session->output_format, window_data);
+			dirty.feeds[0] = count < dirty.batch ? dirty.window_input->Slice(0, count) : *dirty.window_input;
+			status = execute_feeds(session, dirty.model, dirty.has_callable, dirty.callable, dirty.feeds, outputs);
+			++dirty.window_runs;
+		}
+		dirty.feeds[0] = *dirty.window_input;
+		window_data._batch_count = 0;
+		return status;
+	}
+
+	// Waits for the network and copies a result of the network size between the slot and the dirty tiles
+	TF::Status copy_network_output(const Graph_Execution_Session *session, void *output, size_t output_pitch, const void *source, size_t source_pitch)
+	{
+		if (cudaDeviceSynchronize() != cudaSuccess ||
+			cudaMemcpy2D(output, output_pitch, source, source_pitch, session->network_width * pixel_size(session->output_format), session->network_height, cudaMemcpyDeviceToDevice) != cudaSuccess)
+			return TF::errors::Internal(cudaGetErrorString(cudaGetLastError()));
+		return TF::Status::OK();
+	}
+
+	// Runs the network only on the tiles whose hash changed since the last run and the tiles within the halo around them.
+	// The first frame, and frames where the windows of the dirty tiles cover more than the frame, run the whole frame,
+	// which becomes the result of the dirty tiles. A frame without dirty tiles hands out that result again.
+	TF::Status execute_dirty_tiles(Graph_Execution_Session *session, unsigned slot)
+	{
+		Dirty_Tiles &dirty = session->dirty;
+		CUDA_transfer_data &data = session->transfer_data[slot];
+		TFTiles::finish_hashes(dirty.grid, dirty.host_lanes[slot], dirty.hashes.data());
+		TFTiles::dirty_tiles(dirty.grid, dirty.hashes.data(), dirty.previous.data(), dirty.dirty);
+		TFTiles::grow_dirty(dirty.grid, TILE_HALO, dirty.dirty);
+		++dirty.frames;
+
+		TF::Status status;
+		if (!dirty.has_output || !TFTiles::plan_windows(dirty.grid, dirty.dirty, TILE_HALO, session->network_width, session->network_height, dirty.windows))
+		{
+			status = TFSession::execute(session, session->fetches[slot], true);
+			if (status.ok())
+				status = copy_network_output(session, dirty.output, dirty.output_pitch, data._output_memory, data._output_pitch);
+		}
+		else
+		{
+			if (dirty.windows.empty())
+				++dirty.clean_frames;
+			else
+				status = execute_windows(session, data, session->fetches[slot]);
+			if (status.ok())
+				status = copy_network_output(session, data._output_memory, data._output_pitch, dirty.output, dirty.output_pitch);
+		}
+
+		// A failed run leaves the tiles dirty for the next frame
+		if (status.ok())
+		{
+			dirty.previous.swap(dirty.hashes);
+			dirty.has_output = true;
+		}
+		return status;
+	}
+
+	void TFSession::release_buffers(Graph_Execution_Session *session)
+	{
+		// Nothing may still be running on the staging buffers
+		session->pipeline.flush();
+
+		// Teardown continues on errors so that every resource gets a chance to be released
+		if (session->depth_resource)
+		{
+			cudaGraphicsUnmapResources(1, &session->depth_resource);
+			cudaGraphicsUnregisterResource(session->depth_resource);
+			session->depth_resource = nullptr;
+		}
+		if (session->depth_texture)
+			session->depth_texture->Release();
+
+		if (session->input_resource)
+		{
+			cudaGraphicsUnmapResources(1, &session->input_resource);
+			cudaGraphicsUnregisterResource(session->input_resource);
+			session->input_resource = nullptr;
+		}
+		if (session->input_texture)
+			session->input_texture->Release();
+
+		if (session->output_resource)
+		{
+			cudaGraphicsUnmapResources(1, &session->output_resource);
+			cudaGraphicsUnregisterResource(session->output_resource);
+			session->output_resource = nullptr;
+		}
+		if (session->output_texture)
+			session->output_texture->Release();
+		if (session->converted_output)
+			cudaFree(session->converted_output);
+		session->converted_output = nullptr;
+
+		ApiInterface &api = TFPlugin::get_api();
+		for (unsigned slot = 0; slot < MAX_PIPELINE_SLOTS; ++slot)
+		{
+			free_transfer_data(session->transfer_data[slot]);
+			free_full_resolution(session->full_resolution[slot]);
+
+			if (session->slot_events[slot])
+				api._thread->destroy_event(session->slot_events[slot], api._allocator_object);
+			session->slot_events[slot] = nullptr;
+		}
+		free_temporal(session->temporal);
+		free_dirty_tiles(session->dirty);
+
+		if (session->copy_stream)
+			cudaStreamDestroy(session->copy_stream);
+		session->copy_stream = nullptr;
+
+		TFPlugin::getLastCudaError("Releasing session buffers failed", __FILE__, __LINE__);
+
+		session->input_texture = nullptr;
+		session->depth_texture = nullptr;
+		session->output_texture = nullptr;
+
+		// The allocator has to outlive every tensor it handed out
+		session->feeds.clear();
+		for (std::vector<TF::Tensor> &fetches : session->fetches)
+			fetches.clear();
+		delete session->zero_input;
+		session->zero_input = nullptr;
+		if (session->allocator)
+			MAKE_DELETE(TFPlugin::get_allocator(), session->allocator);
+		session->allocator = nullptr;
+	}
+
+	// The events are complete after the device synchronize, the network is everything between the input and the output op
+	void record_gpu_stages(const CUDA_transfer_data &data)
+	{
+		float ms = 0.0f;
+		if (data._stage_recorded[InputOpBegin] && data._stage_recorded[InputOpEnd] &&
+			cudaEventElapsedTime(&ms, data._stage_events[InputOpBegin], data._stage_events[InputOpEnd]) == cudaSuccess)
+			TFStats::record_ms(StageInputOp, ms);
+		if (data._stage_recorded[InputOpEnd] && data._stage_recorded[OutputOpBegin] &&
+			cudaEventElapsedTime(&ms, data._stage_events[InputOpEnd], data._stage_events[OutputOpBegin]) == cudaSuccess)
+			TFStats::record_ms(StageNetwork, ms);
+		if (data._stage_recorded[OutputOpBegin] && data._stage_recorded[OutputOpEnd] &&
+			cudaEventElapsedTime(&ms, data._stage_events[OutputOpBegin], data._stage_events[OutputOpEnd]) == cudaSuccess)
+			TFStats::record_ms(StageOutputOp, ms);
+	}
+
+	// Runs the graph on the staged buffers of a slot, called from the worker thread
+	void TFSession::run_slot(Graph_Execution_Session *session, unsigned slot)
+	{
+		CUDA_transfer_data &data = session->transfer_data[slot];
+		data._record_stages = TFStats::enabled();
+		for (bool &recorded : data._stage_recorded)
+			recorded = false;
+		Binding_Scope binding(session->model->binding, &data);
+		const double start = now_ms();
+
+		// Traced runs go through Session::Run since the callable was made without trace options, tiled runs and dirty tile
+		// runs are not traced
+		TF::Status status;
+		if (session->tiling.batch > 0)
+			status = execute_tiles(session, slot);
+		else if (session->dirty_tiles)
+			status = execute_dirty_tiles(session, slot);
+		else if (TFTrace::due(session->runs++))
+		{
+			std::string label = TF::strings::Printf("%s %ux%u", session->graph_name.c_str(), session->network_width, session->network_height);
+			std::vector<std::pair<std::string, TF::Tensor>> inputs = { { "image_data", *session->zero_input } };
+			status = TFTrace::traced_run(session->model->tf_session, label, session->model->tf_graph, inputs, session->output_node_name, session->fetches[slot]);
+		}
+		else
+			status = execute(session, session->fetches[slot], true);
+
+		// Waiting here only blocks the worker, the render thread picks the result up latency depth frames later
+		{
+			Stage_Scope scope(StageSync);
+			if (status.ok() && cudaDeviceSynchronize() != cudaSuccess)
+				status = TF::errors::Internal(cudaGetErrorString(cudaGetLastError()));
+		}
+		session->slot_ms[slot] = now_ms() - start;
+		if (status.ok() && data._record_stages)
+			record_gpu_stages(data);
+
+		session->slot_status[slot] = status;
+	}
+
+	// The allocator of the device a model runs on, shared by all sessions on that device
+	TF::Allocator *device_allocator(Graph_Model *model)
+	{
+		const TF::DeviceMgr *device_manager = nullptr;
+		TF::Device *tf_device = nullptr;
+		if (!model->tf_session->LocalDeviceManager(&device_manager).ok() ||
+			!device_manager->LookupDevice(model->device_name, &tf_device).ok())
+			return nullptr;
+		return tf_device->GetAllocator(TF::AllocatorAttributes());
+	}
+
+	// Peak device memory per pixel of the graph, measured on a run of the probe window after a first run paid for the lazy
+	// allocations. Runs of other sessions on the device at the same time can only make it larger. Falls back to the
+	// estimate when the probe fails or the allocator keeps no stats.
+	unsigned measure_bytes_per_pixel(Graph_Execution_Session *session)
+	{
+		const unsigned size = TFTiles::probe_size(TILE_HALO);
+		Graph_Model *model = TFModelCache::acquire(session->graph_name, size, size);
+		if (model == nullptr)
+			return NETWORK_BYTES_PER_PIXEL;
+
+		uint64_t peak = 0;
+		CUDA_transfer_data scratch;
+		TF::Allocator *allocator = device_allocator(model);
+		if (allocator && allocate_transfer_data(scratch, size, size, TFGraph::output_format(model->tf_graph, session->output_node_name), TFGraph::reads_normals(model->tf_graph, "image_data")))
+		{
+			const TF::int64 channels = TFGraph::input_channels(model->tf_graph, "image_data");
+			const TF::Tensor input(TF::DT_FLOAT, TF::TensorShape({ 1, size, size, channels }));
+			std::vector<TF::Tensor> outputs;
+			Binding_Scope binding(model->binding, &scratch);
+			TF::Status status = model->tf_session->Run({ { "image_data", input } }, { session->output_node_name }, {}, &outputs);
+			cudaDeviceSynchronize();
+
+			TF::AllocatorStats before, after;
+			allocator->ClearStats();
+			allocator->GetStats(&before);
+			if (status.ok())
+				status = model->tf_session->Run({ { "image_data", input } }, { session->output_node_name }, {}, &outputs);
+			cudaDeviceSynchronize();
+			allocator->GetStats(&after);
+			if (status.ok() && after.max_bytes_in_use > before.bytes_in_use)
+				peak = after.max_bytes_in_use - before.bytes_in_use;
+		}
+		free_transfer_data(scratch);
+		TFModelCache::release(model);
+		return TFTiles::bytes_per_pixel(peak, size, size);
+	}
+
+	// Blocks handed out so far by the tensorflow cpu allocator, the session allocator and the device allocator
+	uint64_t allocation_count(Graph_Execution_Session *session)
+	{
+		TF::AllocatorStats stats;
+		TF::cpu_allocator()->GetStats(&stats);
+		uint64_t count = stats.num_allocs + session->allocator->stats().allocations;
+		if (TF::Allocator *allocator = device_allocator(session->model))
+		{
+			allocator->GetStats(&stats);
+			count += stats.num_allocs;
+		}
+		return count;
+	}
+
+	// Times the steady state of the callable against the name based Session::Run on the calling thread, which holds a
+	// reference on the session
+	bool TFSession::benchmark(Graph_Execution_Session *session, unsigned runs, Benchmark_Result &result)
+	{
+		if (session == nullptr || runs == 0)
+			return false;
+
+		// The render thread stages no frames while the session is measured and the worker finishes the ones staged before.
+		// A session that ended meanwhile is left alone.
+		TF::mutex_lock frame(session->frame_lock);
+		if (session->ending || session->state != SessionReady)
+			return false;
+		session->pipeline.flush();
+		bind_first_tiles(session, session->transfer_data[0]);
+		Binding_Scope binding(session->model->binding, &session->transfer_data[0]);
+
+		// The cpu allocator only counts once its stats are enabled
+		TF::EnableCPUAllocatorStats(true);
+
+		std::vector<TF::Tensor> outputs;
+		double measured_ms[2] = { 0.0, 0.0 };
+		double allocations[2] = { 0.0, 0.0 };
+		for (unsigned mode = 0; mode < 2; ++mode)
+		{
+			bool use_callable = mode == 0;
+
+			// The first run of each path is warm-up and not measured
+			TF::Status status = execute(session, outputs, use_callable);
+			const uint64_t allocations_before = allocation_count(session);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			for (unsigned i = 0; i < runs && status.ok(); ++i)
+				status = execute(session, outputs, use_callable);
+			cudaDeviceSynchronize();
+			auto t2 = std::chrono::high_resolution_clock::now();
+
+			if (!status.ok()) {
+				TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+				return false;
+			}
+			measured_ms[mode] = std::chrono::duration<double, std::milli>(t2 - t1).count() / runs;
+			allocations[mode] = (double)(allocation_count(session) - allocations_before) / runs;
+		}
+
+		result.callable_ms = measured_ms[0];
+		result.run_ms = measured_ms[1];
+		result.callable_allocations = allocations[0];
+		result.run_allocations = allocations[1];
+		return true;
+	}
+
+	Session_Settings default_settings()
+	{
+		Session_Settings settings;
+		settings.resolution_factor = default_resolution_factor;
+		settings.latency_depth = default_latency_depth;
+		settings.temporal_interval = default_temporal_interval;
+		settings.temporal_invalid_fraction = default_temporal_invalid_fraction;
+		settings.temporal_blend = default_temporal_blend;
+		settings.memory_ceiling = default_memory_ceiling;
+		settings.views = default_views;
+		settings.dirty_tiles = default_dirty_tiles;
+		settings.time_budget_ms = default_time_budget_ms;
+		return settings;
+	}
+
+	// Sets a session up for the render target size and the settings, it still has to be loaded. The rungs of an adaptive
+	// session differ from it only in the resolution factor.
+	Graph_Execution_Session *new_session(const char *name, const char *graph_name, const char *node_name, unsigned iterations, bool endless, unsigned width, unsigned height, const Session_Settings &settings, unsigned resolution_factor)
+	{
+		Graph_Execution_Session *session = MAKE_NEW(TFPlugin::get_allocator(), Graph_Execution_Session);
+		session->settings = settings;
+		session->name = name;
+		session->output_node_name = node_name;
+		session->iterations_done = 0;
+		session->iterations_max = iterations;
+		session->endless = endless;
+		session->texture_width = width;
+		session->texture_height = height;
+		session->resolution_factor = resolution_factor;
+		session->network_width = TFGraph::align_network_size((width + session->resolution_factor - 1) / session->resolution_factor);
+		session->network_height = TFGraph::align_network_size((height + session->resolution_factor - 1) / session->resolution_factor);
+		session->memory_ceiling = settings.memory_ceiling;
+		session->views = std::max(settings.views, 1u);
+		session->graph_width = session->network_width;
+		session->graph_height = session->network_height;
+
+		// Views side by side run as one batch on a graph of the view size. The window of the last view reaches past the
+		// render target up to the alignment, the network buffers grow by that much.
+		if (session->views > 1)
+		{
+			const unsigned content_width = (width + session->resolution_factor - 1) / session->resolution_factor;
+			session->graph_width = TFGraph::align_network_size((content_width + session->views - 1) / session->views);
+			session->network_width = (session->views - 1) * content_width / session->views + session->graph_width;
+		}
+
+		// The reprojection knows a single camera, the views of a multi-view session run the network every frame
+		session->temporal_interval = session->views > 1 ? 0 : settings.temporal_interval;
+		session->temporal_invalid_fraction = settings.temporal_invalid_fraction;
+		session->temporal_blend = settings.temporal_blend;
+
+		// Dirty tiles patch the network result of the render target as it is. A frame not larger than a window never runs
+		// windows and would share its model with them.
+		const unsigned window_size = TFTiles::window_size(TFTiles::grid(session->network_width, session->network_height, TILE_SIZE), TILE_HALO);
+		session->dirty_tiles = settings.dirty_tiles && session->views == 1 && session->resolution_factor == 1 &&
+			session->temporal_interval == 0 && session->network_width > window_size && session->network_height > window_size;
+		if (session->dirty_tiles)
+			session->dirty.grid = TFTiles::grid(session->network_width, session->network_height, TILE_SIZE);
+
+		session->pipeline.device.session = session;
+
+		// The temporal reuse blends the network result into the frame it was staged in, which needs the result right away
+		session->pipeline.set_latency_depth(session->temporal_interval > 0 ? 0 : settings.latency_depth);
+		for (CUDA_transfer_data &data : session->transfer_data)
+		{
+			data._near_range = camera_near_range;
+			data._far_range = camera_far_range;
+		}
+		session->graph_name = graph_name;
+		session->created_time = TFSession::now_ms();
+		return session;
+	}
+
+	// Loading and warming up happens on the worker, LUA only gets to see a pending session until then
+	void start_load(Graph_Execution_Session *session)
+	{
+		if (!TFWorker::push_load(session))
+			TFSession::load(session);
+	}
+
+	// Sets up a session and the coarser rungs of an adaptive one and starts loading them. The rungs load right away as
+	// well, so a switch never waits for a load. They are not registered and only run in place of the session.
+	Graph_Execution_Session *start_session(const char *name, const char *graph_name, const char *node_name, unsigned iterations, bool endless, unsigned width, unsigned height, const Session_Settings &settings)
+	{
+		Graph_Execution_Session *session = new_session(name, graph_name, node_name, iterations, endless, width, height, settings, settings.resolution_factor);
+		if (settings.time_budget_ms > 0.0f)
+		{
+			session->adaptive_settings = TFAdaptive::settings(settings.time_budget_ms);
+			session->adaptive = TFAdaptive::start(session->resolution_factor);
+			session->rungs[0] = session;
+			for (unsigned rung = 1; rung < session->adaptive.rungs; ++rung)
+			{
+				const unsigned factor = session->adaptive.factors[rung];
+				std::string rung_name = TF::strings::Printf("%s/%u", name, factor);
+				session->rungs[rung] = new_session(rung_name.c_str(), graph_name, node_name, iterations, endless, width, height, settings, factor);
+				session->rungs[rung]->adaptive_owner = session;
+			}
+		}
+
+		start_load(session);
+		for (unsigned rung = 1; rung < MAX_ADAPTIVE_RUNGS && session->rungs[rung]; ++rung)
+			start_load(session->rungs[rung]);
+		return session;
+	}
+
+	Graph_Execution_Session *TFSession::create(const char *name, const char *graph_name, const char *node_name, unsigned iterations, bool endless, unsigned width, unsigned height)
+	{
+		Graph_Execution_Session *session = start_session(name, graph_name, node_name, iterations, endless, width, height, default_settings());
+
+		// Starting a session with a name already in use replaces the old one instead of leaking it, the render thread
+		// destroys the old one before its next frame
+		TF::mutex_lock lock(registry_lock);
+		if (Graph_Execution_Session *existing = find(name))
+			existing->ending = true;
+		session->handle = next_handle++;
+		execution_sessions.push_back(session);
+		return session;
+	}
+
+	// Starts a session again with the graph as it is now and the settings it got started with, for a graph whose inputs
+	// or outputs changed. The new session takes over the handle and the place of the old one in the registry, the render
+	// thread calling it destroys the old one afterwards.
+	Graph_Execution_Session *TFSession::rebuild(Graph_Execution_Session *session, unsigned width, unsigned height)
+	{
+		const unsigned iterations = session->endless ? 0 : session->iterations_max - session->iterations_done;
+		Graph_Execution_Session *rebuilt = start_session(session->name.c_str(), session->graph_name.c_str(), session->output_node_name.c_str(),
+			iterations, session->endless, width, height, session->settings);
+		rebuilt->reloads = session->reloads + 1;
+		{
+			TF::mutex_lock lock(registry_lock);
+			rebuilt->handle = session->handle;
+			rebuilt->ending = session->ending.load();
+			auto it = std::find(execution_sessions.begin(), execution_sessions.end(), session);
+			if (it != execution_sessions.end())
+				*it = rebuilt;
+		}
+		return rebuilt;
+	}
+
+	// Creates the model, buffers and callable of a session and runs the warm-up, called from the worker thread
+	void TFSession::load(Graph_Execution_Session *session)
+	{
+		double start = now_ms();
+
+		// A session under a memory ceiling measures the memory of its graph first, frames going over the ceiling with it
+		// run tiled and get a graph of the window size. Tiled sessions do not track dirty tiles.
+		if (session->views == 1 && session->memory_ceiling > 0)
+		{
+			session->bytes_per_pixel = measure_bytes_per_pixel(session);
+			if (TFTiles::plan_tiling(session->network_width, session->network_height, session->memory_ceiling, session->bytes_per_pixel, TILE_HALO, session->tiling))
+			{
+				session->graph_width = session->graph_height = session->tiling.window_size;
+				session->dirty_tiles = false;
+			}
+		}
+
+		session->model = TFModelCache::acquire(session->graph_name, session->graph_width, session->graph_height);
+		if (session->model == nullptr) {
+			session->state = SessionFailed;
+			return;
+		}
+
+		ID3D11Device* device = reinterpret_cast<ID3D11Device*>(TFPlugin::get_api()._render_interface->device());
+		if (!create_buffers(session, device)) {
+			session->state = SessionFailed;
+			return;
+		}
+		if (session->dirty_tiles && !load_windows(session, session->dirty.model, session->dirty.has_callable, session->dirty.callable)) {
+			session->state = SessionFailed;
+			return;
+		}
+		session->load_ms = now_ms() - start;
+
+		if (session->views > 1)
+			TFPlugin::get_api()._logging->info(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Session `%s` runs %u views of %ux%u in one batch.",
+				session->name.c_str(), session->views, session->graph_width, session->graph_height));
+		if (session->tiling.batch > 0)
+		{
+			const Tile_Plan &tiling = session->tiling;
+			TFPlugin::get_api()._logging->info(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Session `%s` runs %u tiles in windows of %ux%u, %u per run, at %u bytes per pixel.",
+				session->name.c_str(), tiling.grid.columns * tiling.grid.rows, tiling.window_size, tiling.window_size, tiling.batch, session->bytes_per_pixel));
+		}
+		if (session->dirty_tiles)
+		{
+			const unsigned size = TFTiles::window_size(session->dirty.grid, TILE_HALO);
+			TFPlugin::get_api()._logging->info(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Session `%s` reruns only the dirty ones of %u tiles in windows of %ux%u.",
+				session->name.c_str(), session->dirty.grid.columns * session->dirty.grid.rows, size, size));
+		}
+
+		// The first runs pay for the lazy allocations and autotuning of tensorflow, they should not happen in a frame
+		start = now_ms();
+		{
+			bind_first_tiles(session, session->transfer_data[0]);
+			Binding_Scope binding(session->model->binding, &session->transfer_data[0]);
+
+			// The window model warms up on a full batch of windows from the top left
+			Dirty_Tiles &dirty = session->dirty;
+			if (session->dirty_tiles)
+				for (unsigned tile = 0; tile < dirty.batch && tile < dirty.grid.columns * dirty.grid.rows; ++tile)
+					dirty.windows.push_back(TFTiles::window(dirty.grid, tile, TILE_HALO, session->network_width, session->network_height));
+			for (unsigned i = 0; i < warmup_runs; ++i)
+			{
+				TF::Status status = execute(session, session->fetches[0], true);
+				if (status.ok() && session->dirty_tiles)
+					status = execute_windows(session, session->transfer_data[0], session->fetches[0]);
+				if (!status.ok()) {
+					TFPlugin::get_api()._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+					session->state = SessionFailed;
+					return;
+				}
+			}
+			cudaDeviceSynchronize();
+			dirty.windows.clear();
+			dirty.window_runs = 0;
+		}
+		session->warmup_ms = now_ms() - start;
+
+		session->state = SessionReady;
+	}
+
+	// Compares the graph file against the one the running model was loaded from
+	bool TFSession::graph_changed(Graph_Execution_Session *session)
+	{
+		if (session->state != SessionReady || session->reload_state != ReloadIdle || session->model == nullptr)
+			return false;
+
+		TF::FileStatistics file_stats;
+		if (!TF::Env::Default()->Stat(session->graph_name, &file_stats).ok())
+			return false;
+
+		return session->model->file_length != (uint64_t)file_stats.length || session->model->file_mtime != file_stats.mtime_nsec;
+	}
+
+	bool TFSession::request_reload(Graph_Execution_Session *session)
+	{
+		// LUA and the graph watcher of the render thread may both ask for a reload
+		ReloadState idle = ReloadIdle;
+		if (session == nullptr || session->state != SessionReady || !session->reload_state.compare_exchange_strong(idle, ReloadPending))
+			return false;
+
+		if (!TFWorker::push_reload(session))
+			reload(session);
+		return true;
+	}
+
+	// Builds the tensorflow session of the changed graph next to the running one, called from the worker thread.
+	// The buffers of the session stay untouched, the warm-up runs on scratch buffers since frames keep going meanwhile.
+	void TFSession::reload(Graph_Execution_Session *session)
+	{
+		ApiInterface &api = TFPlugin::get_api();
+		Graph_Model *model = TFModelCache::acquire(session->graph_name, session->graph_width, session->graph_height);
+		if (model == nullptr) {
+			session->reload_state = ReloadIdle;
+			return;
+		}
+
+		// Only the timestamp changed, the cache handed out the running model again
+		if (model == session->model) {
+			TFModelCache::release(model);
+			session->reload_state = ReloadIdle;
+			return;
+		}
+
+		if (!TFGraph::same_interface(session->model->tf_graph, model->tf_graph, "image_data", session->output_node_name)) {
+			api._logging->warning(TFPlugin::get_name(), api._error->eprintf("Graph `%s` changed its inputs or outputs, the session `%s` gets rebuilt.", session->graph_name.c_str(), session->name.c_str()));
+			TFModelCache::release(model);
+			session->reload_state = ReloadRebuild;
+			return;
+		}
+
+		// The session skipped the normals buffers for the running graph
+		if (!session->reads_normals && TFGraph::reads_normals(model->tf_graph, "image_data")) {
+			api._logging->warning(TFPlugin::get_name(), api._error->eprintf("Graph `%s` reads the normals now, the session `%s` gets rebuilt.", session->graph_name.c_str(), session->name.c_str()));
+			TFModelCache::release(model);
+			session->reload_state = ReloadRebuild;
+			return;
+		}
+
+		TF::Session::CallableHandle callable = 0;
+		bool has_callable = make_callable(session, model, callable);
+
+		// The window model is swapped in together with the frame model. It is not warmed up here since the worker runs the
+		// windows of the running model meanwhile.
+		Graph_Model *window_model = nullptr;
+		bool window_has_callable = false;
+		TF::Session::CallableHandle window_callable = 0;
+		if (session->dirty_tiles && !load_windows(session, window_model, window_has_callable, window_callable)) {
+			if (has_callable)
+				model->tf_session->ReleaseCallable(callable);
+			TFModelCache::release(model);
+			session->reload_state = ReloadIdle;
+			return;
+		}
+
+		CUDA_transfer_data scratch;
+		if (!allocate_transfer_data(scratch, session->network_width, session->network_height, session->output_format, session->reads_normals)) {
+			free_transfer_data(scratch);
+			release_windows(window_model, window_has_callable, window_callable);
+			if (has_callable)
+				model->tf_session->ReleaseCallable(callable);
+			TFModelCache::release(model);
+			session->reload_state = ReloadIdle;
+			return;
+		}
+
+		TF::Status status;
+		std::vector<TF::Tensor> outputs;
+		{
+			// The layout of the views was checked when the buffers of the session were created
+			bind_views(session, scratch);
+			bind_first_tiles(session, scratch);
+			Binding_Scope binding(model->binding, &scratch);
+			for (unsigned i = 0; i < warmup_runs && status.ok(); ++i)
+				status = execute(session, model, has_callable, callable, outputs);
+			cudaDeviceSynchronize();
+		}
+		free_transfer_data(scratch);
+
+		if (!status.ok()) {
+			api._logging->error(TFPlugin::get_name(), status.ToString().c_str());
+			release_windows(window_model, window_has_callable, window_callable);
+			if (has_callable)
+				model->tf_session->ReleaseCallable(callable);
+			TFModelCache::release(model);
+			session->reload_state = ReloadIdle;
+			return;
+		}
+
+		session->reload_model = model;
+		session->reload_has_callable = has_callable;
+		session->reload_callable = callable;
+		session->dirty.reload_model = window_model;
+		session->dirty.reload_has_callable = window_has_callable;
+		session->dirty.reload_callable = window_callable;
+		session->reload_state = ReloadReady;
+	}
+
+	// Swaps a reloaded model in, called from the render thread before the session stages its next frame
+	void TFSession::apply_reload(Graph_Execution_Session *session)
+	{
+		if (session->reload_state != ReloadReady)
+			return;
+
+		// Frames in flight still run on the old callable, their results are dropped
+		session->pipeline.flush();
+
+		if (session->has_callable)
+			session->model->tf_session->ReleaseCallable(session->callable);
+		TFModelCache::release(session->model);
+
+		session->model = session->reload_model;
+		session->has_callable = session->reload_has_callable;
+		session->callable = session->reload_callable;
+		session->reload_model = nullptr;
+		session->reload_has_callable = false;
+		session->reload_callable = 0;
+		for (std::vector<TF::Tensor> &fetches : session->fetches)
+			fetches.clear();
+
+		// The tiles kept from the old graph would be patched with windows of the new one
+		if (session->dirty_tiles)
+		{
+			Dirty_Tiles &dirty = session->dirty;
+			release_windows(dirty.model, dirty.has_callable, dirty.callable);
+			dirty.model = dirty.reload_model;
+			dirty.has_callable = dirty.reload_has_callable;
+			dirty.callable = dirty.reload_callable;
+			dirty.reload_model = nullptr;
+			dirty.reload_has_callable = false;
+			dirty.reload_callable = 0;
+			dirty.has_output = false;
+		}
+		++session->reloads;
+		session->reload_state = ReloadIdle;
+
+		TFPlugin::get_api()._logging->info(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Reloaded graph `%s` of session `%s`.", session->graph_name.c_str(), session->name.c_str()));
+	}
+
+	void TFSession::destroy(Graph_Execution_Session *session)
+	{
+		if (session == nullptr)
+			return;
+
+		{
+			TF::mutex_lock lock(registry_lock);
+			auto it = std::find(execution_sessions.begin(), execution_sessions.end(), session);
+			if (it != execution_sessions.end())
+				execution_sessions.erase(it);
+		}
+
+		for (unsigned rung = 1; rung < MAX_ADAPTIVE_RUNGS; ++rung)
+			destroy(session->rungs[rung]);
+
+		// A session still loading or reloading is left to the loader thread, which frees it once the load finished
+		session->pipeline.flush();
+		release(session);
+	}
+
+	void TFSession::release(Graph_Execution_Session *session)
+	{
+		if (--session->references > 0)
+			return;
+
+		if (session->reload_has_callable)
+			session->reload_model->tf_session->ReleaseCallable(session->reload_callable);
+		TFModelCache::release(session->reload_model);
+		release_windows(session->dirty.reload_model, session->dirty.reload_has_callable, session->dirty.reload_callable);
+
+		release_buffers(session);
+		release_windows(session->dirty.model, session->dirty.has_callable, session->dirty.callable);
+		if (session->has_callable)
+			session->model->tf_session->ReleaseCallable(session->callable);
+		TFModelCache::release(session->model);
+		MAKE_DELETE(TFPlugin::get_allocator(), session);
+	}
+
+	// Only once no frame runs anymore, sessions still running are destroyed with TFSession::end
+	void TFSession::destroy_all()
+	{
+		std::vector<Graph_Execution_Session*> sessions;
+		TFSession::sessions(sessions);
+		for (Graph_Execution_Session *session : sessions)
+			destroy(session);
+	}
+
+	// Called from LUA, which may look at the session while the render thread runs it
+	void TFSession::end(Graph_Execution_Session *session)
+	{
+		if (session != nullptr)
+			session->ending = true;
+	}
+
+	void TFSession::end_all()
+	{
+		TF::mutex_lock lock(registry_lock);
+		for (Graph_Execution_Session *session : execution_sessions)
+			session->ending = true;
+	}
+
+	// Called by the render thread between frames
+	void TFSession::destroy_ended()
+	{
+		std::vector<Graph_Execution_Session*> ended;
+		{
+			TF::mutex_lock lock(registry_lock);
+			for (Graph_Execution_Session *session : execution_sessions)
+			{
+				if (session->ending)
+					ended.push_back(session);
+			}
+		}
+		for (Graph_Execution_Session *session : ended)
+		{
+			// A benchmark still holding the session started before it ended, it goes away with a later frame
+			if (!session->frame_lock.try_lock())
+				continue;
+			session->frame_lock.unlock();
+			destroy(session);
+		}
+	}
+
+	// Ended sessions are not found anymore, the caller holds a Session_Registry_Scope
+	Graph_Execution_Session *TFSession::get(SessionHandle handle)
+	{
+		for (Graph_Execution_Session *session : execution_sessions)
+		{
+			if (session->handle == handle && !session->ending)
+				return session;
+		}
+		return nullptr;
+	}
+
+	Graph_Execution_Session *TFSession::find(const char *name)
+	{
+		for (Graph_Execution_Session *session : execution_sessions)
+		{
+			if (session->name == name && !session->ending)
+				return session;
+		}
+		return nullptr;
+	}
+
+	// Copies the registry, only the render thread destroys sessions so the copy stays valid on it
+	void TFSession::sessions(std::vector<Graph_Execution_Session*> &sessions)
+	{
+		TF::mutex_lock lock(registry_lock);
+		sessions = execution_sessions;
+	}
+
+	Session_Registry_Scope::Session_Registry_Scope()
+	{
+		registry_lock.lock();
+	}
+
+	Session_Registry_Scope::~Session_Registry_Scope()
+	{
+		registry_lock.unlock();
+	}
+
+	void TFSession::set_camera_range(float near_range, float far_range)
+	{
+		camera_near_range = near_range;
+		camera_far_range = far_range;
+		TF::mutex_lock lock(registry_lock);
+		for (Graph_Execution_Session *session : execution_sessions)
+		{
+			for (CUDA_transfer_data &data : session->transfer_data)
+			{
+				data._near_range = near_range;
+				data._far_range = far_range;
+			}
+		}
+	}
+
+	// Applies to all sessions, the camera of the last frame is kept per session
+	void TFSession::set_camera(const float pose[16], const float projection[16])
+	{
+		current_camera = TFTemporal::camera(pose, projection);
+		has_camera = true;
+	}
+
+	void TFSession::set_memory_budget(uint64_t bytes)
+	{
+		default_memory_budget = bytes;
+		TF::mutex_lock lock(registry_lock);
+		for (Graph_Execution_Session *session : execution_sessions)
+		{
+			if (session->allocator)
+				session->allocator->set_budget(bytes);
+		}
+	}
+
+	// Applies to sessions started afterwards, sessions whose network frame needs more activation memory run tiled
+	void TFSession::set_default_memory_ceiling(uint64_t bytes)
+	{
+		default_memory_ceiling = bytes;
+	}
+
+	void TFSession::set_default_views(unsigned views)
+	{
+		default_views = views;
+	}
+
+	// Applies to sessions started afterwards that run the whole render target at once, see new_session
+	void TFSession::set_default_dirty_tiles(bool enabled)
+	{
+		default_dirty_tiles = enabled;
+	}
+
+	void TFSession::set_default_time_budget(float budget_ms)
+	{
+		default_time_budget_ms = budget_ms > 0.0f ? budget_ms : 0.0f;
+	}
+
+	// Moves to the rung the controller picked once its session is ready. The rung that is left drops the results still in
+	// flight and the new one starts without a temporal history, which would be from the last time it ran.
+	Graph_Execution_Session *TFSession::active_rung(Graph_Execution_Session *session)
+	{
+		if (session->adaptive.rungs == 0)
+			return session;
+
+		Graph_Execution_Session *wanted = session->rungs[session->adaptive.rung];
+		if (session->adaptive.rung != session->active_rung && wanted->state == SessionReady)
+		{
+			Graph_Execution_Session *active = session->rungs[session->active_rung];
+			active->pipeline.flush();
+			wanted->temporal.has_history = false;
+			wanted->temporal.frames_since_run = 0;
+			wanted->dirty.has_output = false;
+			session->active_rung = session->adaptive.rung;
+			TFPlugin::get_api()._logging->info(TFPlugin::get_name(), TFPlugin::get_api()._error->eprintf("Session `%s` runs the network at 1/%u of the render target, it took %.2f ms against a budget of %.2f ms.",
+				session->name.c_str(), wanted->resolution_factor, session->adaptive.previous_ms, session->adaptive_settings.budget_ms));
+		}
+		return session->rungs[session->active_rung];
+	}
+
+	// Runs of a rung the controller already left do not count for the new one
+	void TFSession::adapt(Graph_Execution_Session *rung, unsigned slot)
+	{
+		Graph_Execution_Session *session = rung->adaptive_owner ? rung->adaptive_owner : rung;
+		if (session->adaptive.rungs == 0 || session->rungs[session->adaptive.rung] != rung)
+			return;
+		TFAdaptive::update(session->adaptive_settings, session->adaptive, (float)rung->slot_ms[slot]);
+	}
+
+	// Host memory goes through the session allocator, the device memory is shared by all sessions on the same device
+	bool TFSession::memory_stats(Graph_Execution_Session *session, Allocator_Stats &host, TF::AllocatorStats &device)
+	{
+		if (session == nullptr || session->state != SessionReady || session->allocator == nullptr)
+			return false;
+
+		host = session->allocator->stats();
+		if (TF::Allocator *allocator = device_allocator(session->model))
+			allocator->GetStats(&device);
+		return true;
+	}
+
+	void TFSession::set_warmup_runs(unsigned runs)
+	{
+		warmup_runs = runs;
+	}
+
+	double TFSession::now_ms()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	}
+
+	void TFSession::set_default_latency_depth(unsigned latency_depth)
+	{
+		default_latency_depth = latency_depth < MAX_LATENCY_DEPTH ? latency_depth : MAX_LATENCY_DEPTH;
+	}
+
+	// Only factors which divide the network alignment are supported, anything else falls back to the next smaller one
+	void TFSession::set_default_resolution_factor(unsigned factor)
+	{
+		default_resolution_factor = factor >= 4 ? MAX_RESOLUTION_FACTOR : factor >= 2 ? 2 : 1;
+	}
+
+	Resample_Params TFSession::resample_params(const Graph_Execution_Session *session)
+	{
+		return ::resample_params(session->texture_width, session->texture_height, session->resolution_factor);
+	}
+
+	// The network reads the low resolution normals and depth from the slot and writes its output there
+	Resample_Surfaces TFSession::resample_surfaces(const Graph_Execution_Session *session, unsigned slot)
+	{
+		const Full_Resolution_Buffers &full = session->full_resolution[slot];
+		const CUDA_transfer_data &data = session->transfer_data[slot];
+		Resample_Surfaces surfaces;
+		surfaces.normals = (const unsigned char*)full.normals;
+		surfaces.depth = (const float*)full.depth;
+		surfaces.pitch = full.pitch;
+		surfaces.low_normals = (unsigned char*)data._input_memory;
+		surfaces.low_depth = (float*)data._depth_memory;
+		surfaces.low_pitch = data._pitch;
+		surfaces.low_output = (const unsigned char*)data._output_memory;
+		surfaces.low_output_pitch = data._output_pitch;
+		surfaces.output = (unsigned char*)full.output;
+		surfaces.output_pitch = full.output_pitch;
+		surfaces.output_format = session->output_format;
+		return surfaces;
+	}
+
+	// Applies to sessions started afterwards, an interval of 0 runs the network every frame
+	void TFSession::set_default_temporal(unsigned interval, float invalid_fraction, float blend)
+	{
+		default_temporal_interval = interval;
+		default_temporal_invalid_fraction = std::min(std::max(invalid_fraction, 0.0f), 1.0f);
+		default_temporal_blend = std::min(std::max(blend, 0.0f), 1.0f);
+	}
+
+	// Without a camera there is nothing to reproject with, the network then runs every frame
+	Reproject_Params TFSession::temporal_params(const Graph_Execution_Session *session)
+	{
+		const Temporal_Buffers &temporal = session->temporal;
+		return TFTemporal::reproject_params(current_camera, temporal.previous_camera, session->texture_width, session->texture_height,
+			temporal.has_history && has_camera, session->temporal_blend);
+	}
+
+	// The current normals and depth are the render target copies of the slot, which are the full resolution buffers when
+	// the network runs at a lower resolution
+	Temporal_Surfaces TFSession::temporal_surfaces(const Graph_Execution_Session *session, unsigned slot, bool network)
+	{
+		const Temporal_Buffers &temporal = session->temporal;
+		const Full_Resolution_Buffers &full = session->full_resolution[slot];
+		const CUDA_transfer_data &data = session->transfer_data[slot];
+		const bool resample = session->resolution_factor > 1;
+		const bool normals = session->reads_normals && temporal.previous_normals;
+
+		Temporal_Surfaces surfaces;
+		surfaces.normals = normals ? (const unsigned char*)(resample ? full.normals : data._input_memory) : nullptr;
+		surfaces.depth = (const float*)(resample ? full.depth : data._depth_memory);
+		surfaces.pitch = resample ? full.pitch : data._pitch;
+		surfaces.previous_normals = normals ? (const unsigned char*)temporal.previous_normals : nullptr;
+		surfaces.previous_depth = temporal.previous_depth;
+		surfaces.history = temporal.history[temporal.current];
+		surfaces.reprojected = temporal.history[1 - temporal.current];
+		surfaces.previous_pitch = temporal.pitch;
+		surfaces.network = network ? (const unsigned char*)(resample ? full.output : data._output_memory) : nullptr;
+		surfaces.network_pitch = resample ? full.output_pitch : data._output_pitch;
+		surfaces.output = (unsigned char*)temporal.output;
+		surfaces.output_pitch = temporal.output_pitch;
+		surfaces.output_format = session->output_format;
+		return surfaces;
+	}
+
+	// The reprojected history of this frame becomes the history of the next one
+	void TFSession::advance_temporal(Graph_Execution_Session *session, bool network)
+	{
+		Temporal_Buffers &temporal = session->temporal;
+		temporal.current = 1 - temporal.current;
+		temporal.has_history = true;
+		temporal.frames_since_run = network ? 0 : temporal.frames_since_run + 1;
+		temporal.previous_camera = current_camera;
+		temporal.frames++;
+		if (network)
+			temporal.network_runs++;
+	}
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "tf_settings.h"
+#include "tf_cuda.h"
+#include "tf_interactive_io.h"
+#include "tf_resample.h"
+#include "tf_temporal.h"
+#include "tf_tiles.h"
+#include "tf_adaptive.h"
+#include "tf_pipeline.h"
+#include "tf_model_cache.h"
+#include "tf_allocator.h"
+#include <engine_plugin_api/plugin_api.h>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+// D3D11 and CUDA Headers
+#include <d3d11.h>
+#include <cuda_runtime_api.h>
+#include <cuda_d3d11_interop.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	namespace TF = tensorflow;
+
+	// Handle returned to LUA to identify a running graph session, 0 is never a valid handle
+	typedef unsigned SessionHandle;
+	const SessionHandle INVALID_SESSION_HANDLE = 0;
+
+	// Sessions are loaded on the worker thread, only ready sessions get rendered
+	enum SessionState { SessionPending, SessionReady, SessionFailed };
+
+	// A changed graph file is rebuilt on the worker and swapped in by the render thread between two frames
+	enum ReloadState { ReloadIdle, ReloadPending, ReloadReady, ReloadRebuild };
+
+	// Steady state cost of the callable and of the name based Session::Run, allocations count host and device blocks
+	struct Benchmark_Result
+	{
+		double callable_ms = 0.0;
+		double run_ms = 0.0;
+		double callable_allocations = 0.0;
+		double run_allocations = 0.0;
+	};
+
+	// Render target sized copies of a slot when the network runs at a lower resolution, the normals and depth guide the up
+	// pass of the frame the slot belongs to
+	struct Full_Resolution_Buffers
+	{
+		void *normals = nullptr;
+		void *depth = nullptr;
+		void *output = nullptr;
+		size_t pitch = 0;
+		size_t output_pitch = 0;
+	};
+
+	// Render target sized history of the temporal reuse, the result of the last frame is reprojected from one history
+	// buffer into the other one. The normals and depth of the last frame are kept to detect disocclusions.
+	struct Temporal_Buffers
+	{
+		float *history[2] = {};
+		void *previous_normals = nullptr;
+		float *previous_depth = nullptr;
+		void *output = nullptr;
+		size_t pitch = 0;
+		size_t output_pitch = 0;
+		unsigned *invalid_count = nullptr;
+		unsigned *host_invalid_count = nullptr;
+		unsigned current = 0;
+		bool has_history = false;
+		unsigned frames_since_run = 0;
+		Temporal_Camera previous_camera = {};
+		uint64_t frames = 0;
+		uint64_t network_runs = 0;
+	};
+
+	// Tile hashes of the frames in flight and the result of the earlier frames, which keeps the output of clean tiles. The
+	// lanes of a slot are hashed on the device in the copy-in, the worker finishes them and runs only the windows of the
+	// dirty tiles on a model of the window size, every window writes its tile into the output.
+	struct Dirty_Tiles
+	{
+		Tile_Grid grid = {};
+		uint32_t *lanes[MAX_PIPELINE_SLOTS] = {};
+		uint32_t *host_lanes[MAX_PIPELINE_SLOTS] = {};
+		std::vector<uint64_t> hashes;
+		std::vector<uint64_t> previous;
+		std::vector<unsigned> dirty;
+		std::vector<Tile_Window> windows;
+		void *output = nullptr;
+		size_t output_pitch = 0;
+		bool has_output = false;
+		CUDA_transfer_data window_data;
+		unsigned batch = 0;
+		TF::Tensor *window_input = nullptr;
+		std::vector<TF::Tensor> feeds;
+		Graph_Model *model = nullptr;
+		bool has_callable = false;
+		TF::Session::CallableHandle callable = 0;
+		Graph_Model *reload_model = nullptr;
+		bool reload_has_callable = false;
+		TF::Session::CallableHandle reload_callable = 0;
+		// Counted on the worker and read by the render thread
+		std::atomic<uint64_t> frames = { 0 };
+		std::atomic<uint64_t> clean_frames = { 0 };
+		std::atomic<uint64_t> window_runs = { 0 };
+	};
+
+	struct Graph_Execution_Session;
+
+	// Pipeline device running the staged slots of a session on the tensorflow worker thread
+	struct Session_Pipeline_Device
+	{
+		Graph_Execution_Session *session = nullptr;
+		void submit(unsigned slot, uint64_t frame);
+		void wait(unsigned slot);
+	};
+
+	// The defaults a session got started with, rebuilding the session for a changed graph starts it again with them
+	struct Session_Settings
+	{
+		unsigned resolution_factor = 1;
+		unsigned latency_depth = 0;
+		unsigned temporal_interval = 0;
+		float temporal_invalid_fraction = DEFAULT_TEMPORAL_INVALID_FRACTION;
+		float temporal_blend = DEFAULT_TEMPORAL_BLEND;
+		uint64_t memory_ceiling = 0;
+		unsigned views = 1;
+		bool dirty_tiles = false;
+		float time_budget_ms = 0.0f;
+	};
+
+	// Structure to define a single graph execution with its own buffers and cuda transfer data. An adaptive session owns a
+	// session for every coarser rung of its ladder, rungs[0] is the session itself and the others point back to it.
+	struct Graph_Execution_Session
+	{
+		SessionHandle handle = INVALID_SESSION_HANDLE;
+		std::atomic<SessionState> state = { SessionPending };
+		// The render thread holds one reference and a load or reload on the loader thread another one, the last to let go
+		// frees the session
+		std::atomic<unsigned> references = { 1 };
+		// Set by LUA to end the session, the render thread destroys it before its next frame
+		std::atomic<bool> ending = { false };
+		// Held by the render thread while it runs a frame of the session and by a benchmark from LUA, the render thread
+		// skips the session while a benchmark holds it
+		TF::mutex frame_lock;
+		std::string graph_name;
+		double created_time = 0.0;
+		double load_ms = 0.0;
+		double warmup_ms = 0.0;
+		double first_result_ms = 0.0;
+		bool endless = false;
+		Session_Settings settings;
+		unsigned texture_width;
+		unsigned texture_height;
+		unsigned network_width;
+		unsigned network_height;
+		unsigned graph_width;
+		unsigned graph_height;
+		uint64_t memory_ceiling = 0;
+		unsigned bytes_per_pixel = NETWORK_BYTES_PER_PIXEL;
+		Tile_Plan tiling = {};
+		unsigned views = 1;
+		bool dirty_tiles = false;
+		Dirty_Tiles dirty;
+		Adaptive_Settings adaptive_settings = {};
+		Adaptive_State adaptive = {};
+		unsigned active_rung = 0;
+		Graph_Execution_Session *rungs[MAX_ADAPTIVE_RUNGS] = {};
+		Graph_Execution_Session *adaptive_owner = nullptr;
+		unsigned resolution_factor = 1;
+		unsigned temporal_interval = 0;
+		float temporal_invalid_fraction = DEFAULT_TEMPORAL_INVALID_FRACTION;
+		float temporal_blend = DEFAULT_TEMPORAL_BLEND;
+		unsigned iterations_done;
+		unsigned iterations_max;
+		std::string name;
+		std::string output_node_name;
+		int output_format = PixelR32F;
+		unsigned input_channels = 4;
+		bool reads_normals = true;
+		cudaArray *input_array = nullptr;
+		cudaArray *depth_array = nullptr;
+		cudaArray *output_array = nullptr;
+		cudaGraphicsResource *input_resource = nullptr;
+		ID3D11Texture2D *input_texture = nullptr;
+		cudaGraphicsResource *depth_resource = nullptr;
+		ID3D11Texture2D *depth_texture = nullptr;
+		cudaGraphicsResource *output_resource = nullptr;
+		ID3D11Texture2D *output_texture = nullptr;
+		void *converted_output = nullptr;
+		size_t converted_output_pitch = 0;
+		CUDA_transfer_data transfer_data[MAX_PIPELINE_SLOTS];
+		Full_Resolution_Buffers full_resolution[MAX_PIPELINE_SLOTS];
+		Temporal_Buffers temporal;
+		ThreadEvent *slot_events[MAX_PIPELINE_SLOTS] = {};
+		TF::Status slot_status[MAX_PIPELINE_SLOTS];
+		double slot_ms[MAX_PIPELINE_SLOTS] = {};
+		cudaStream_t copy_stream = nullptr;
+		FramePipeline<Session_Pipeline_Device> pipeline;
+		TFAllocator *allocator = nullptr;
+		TF::Tensor *zero_input = nullptr;
+		Graph_Model *model = nullptr;
+		bool has_callable = false;
+		TF::Session::CallableHandle callable = 0;
+		std::vector<TF::Tensor> feeds;
+		std::vector<TF::Tensor> fetches[MAX_PIPELINE_SLOTS];
+		std::atomic<ReloadState> reload_state = { ReloadIdle };
+		Graph_Model *reload_model = nullptr;
+		bool reload_has_callable = false;
+		TF::Session::CallableHandle reload_callable = 0;
+		unsigned reloads = 0;
+		uint64_t runs = 0;
+	};
+
+	// Holds the session registry, sessions looked up with TFSession::get or find inside the scope are not destroyed before
+	// it ends
+	class Session_Registry_Scope
+	{
+	public:
+		Session_Registry_Scope();
+		~Session_Registry_Scope();
+	};
+
+	class TFSession
+	{
+	public:
+		static Graph_Execution_Session *create(const char *name, const char *graph_name, const char *node_name, unsigned iterations, bool endless, unsigned width, unsigned height);
+		static Graph_Execution_Session *rebuild(Graph_Execution_Session *session, unsigned width, unsigned height);
+		static void destroy(Graph_Execution_Session *session);
+		static void release(Graph_Execution_Session *session);
+		static void destroy_all();
+		static void end(Graph_Execution_Session *session);
+		static void end_all();
+		static void destroy_ended();
+		static Graph_Execution_Session *get(SessionHandle handle);
+		static Graph_Execution_Session *find(const char *name);
+		static void sessions(std::vector<Graph_Execution_Session*> &sessions);
+		static void load(Graph_Execution_Session *session);
+		static DXGI_FORMAT output_texture_format(int output_format);
+		static bool fall_back_to_r32f(Graph_Execution_Session *session);
+		static bool create_buffers(Graph_Execution_Session *session, ID3D11Device *device);
+		static void release_buffers(Graph_Execution_Session *session);
+		static bool make_callable(Graph_Execution_Session *session, Graph_Model *model, TF::Session::CallableHandle &callable);
+		static TF::Status execute(Graph_Execution_Session *session, std::vector<TF::Tensor> &outputs, bool use_callable);
+		static TF::Status execute(Graph_Execution_Session *session, Graph_Model *model, bool has_callable, TF::Session::CallableHandle callable, std::vector<TF::Tensor> &outputs);
+		static bool graph_changed(Graph_Execution_Session *session);
+		static bool request_reload(Graph_Execution_Session *session);
+		static void reload(Graph_Execution_Session *session);
+		static void apply_reload(Graph_Execution_Session *session);
+		static void run_slot(Graph_Execution_Session *session, unsigned slot);
+		static bool benchmark(Graph_Execution_Session *session, unsigned runs, Benchmark_Result &result);
+		static void set_camera_range(float near_range, float far_range);
+		static void set_camera(const float pose[16], const float projection[16]);
+		static void set_default_latency_depth(unsigned latency_depth);
+		static void set_default_resolution_factor(unsigned factor);
+		static Resample_Params resample_params(const Graph_Execution_Session *session);
+		static Resample_Surfaces resample_surfaces(const Graph_Execution_Session *session, unsigned slot);
+		static void set_default_temporal(unsigned interval, float invalid_fraction, float blend);
+		static Reproject_Params temporal_params(const Graph_Execution_Session *session);
+		static Temporal_Surfaces temporal_surfaces(const Graph_Execution_Session *session, unsigned slot, bool network);
+		static void advance_temporal(Graph_Execution_Session *session, bool network);
+		static void set_warmup_runs(unsigned runs);
+		static void set_memory_budget(uint64_t bytes);
+		static void set_default_memory_ceiling(uint64_t bytes);
+		static void set_default_views(unsigned views);
+		static void set_default_dirty_tiles(bool enabled);
+		static void set_default_time_budget(float budget_ms);
+		static Graph_Execution_Session *active_rung(Graph_Execution_Session *session);
+		static void adapt(Graph_Execution_Session *rung, unsigned slot);
+		static bool memory_stats(Graph_Execution_Session *session, Allocator_Stats &host, TF::AllocatorStats &device);
+		static double now_ms();
+	};
+}
@@ -1,9 +1,11 @@
 #pragma once
 
 // Tensorflow Dependent Defines
+#ifdef _MSC_VER
 #define COMPILER_MSVC
 #define NOMINMAX
 #define PROTOBUF_USE_DLLS
+#endif
 #define EIGEN_USE_THREADS
 
 // Disabling all the warnings from Tensorflow
@@ -18,6 +20,8 @@
 #include "tensorflow/cc/ops/image_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/c/c_api.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device.h"
 #pragma warning(pop)
 
 #pragma warning( disable : 4700 )
\ No newline at end of file
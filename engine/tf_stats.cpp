@@ -0,0 +1,108 @@
+#include "tf_stats.h"
+#include "tf_plugin.h"
+#include <chrono>
+#include <algorithm>
+
+namespace PLUGIN_NAMESPACE
+{
+	typedef std::chrono::high_resolution_clock Stats_Clock;
+
+	struct Stage_Ring
+	{
+		float samples_ms[FRAME_STATS_HISTORY];
+		std::atomic<uint32_t> written;
+	};
+
+	static Stage_Ring stage_rings[FRAME_STAGE_COUNT];
+	static const char *stage_names[FRAME_STAGE_COUNT] = {
+		"Tensorflow Copy In", "Tensorflow Input Op", "Tensorflow Network", "Tensorflow Output Op", "Tensorflow Copy Out", "Tensorflow Sync"
+	};
+
+	std::atomic<bool> TFStats::_enabled = { false };
+
+	void TFStats::set_enabled(bool enabled)
+	{
+		_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	uint64_t TFStats::now_ticks()
+	{
+		return (uint64_t)Stats_Clock::now().time_since_epoch().count();
+	}
+
+	double TFStats::ticks_to_ms(uint64_t ticks)
+	{
+		return (double)ticks * 1000.0 * Stats_Clock::period::num / Stats_Clock::period::den;
+	}
+
+	void TFStats::record(FrameStage stage, uint64_t ticks)
+	{
+		record_ms(stage, (float)ticks_to_ms(ticks));
+	}
+
+	void TFStats::record_ms(FrameStage stage, float ms)
+	{
+		Stage_Ring &ring = stage_rings[stage];
+		uint32_t written = ring.written.load(std::memory_order_relaxed);
+		ring.samples_ms[written % FRAME_STATS_HISTORY] = ms;
+		ring.written.store(written + 1, std::memory_order_release);
+	}
+
+	// Nearest rank percentiles over the last FRAME_STATS_HISTORY samples, only called when LUA asks for them
+	Stage_Percentiles TFStats::percentiles(FrameStage stage)
+	{
+		Stage_Ring &ring = stage_rings[stage];
+		uint32_t written = ring.written.load(std::memory_order_acquire);
+		unsigned count = written < FRAME_STATS_HISTORY ? written : FRAME_STATS_HISTORY;
+
+		Stage_Percentiles result;
+		result.samples = count;
+		if (count == 0)
+			return result;
+
+		float sorted[FRAME_STATS_HISTORY];
+		for (unsigned i = 0; i < count; ++i)
+			sorted[i] = ring.samples_ms[i];
+		std::sort(sorted, sorted + count);
+
+		result.p50 = sorted[(count - 1) * 50 / 100];
+		result.p95 = sorted[(count - 1) * 95 / 100];
+		result.p99 = sorted[(count - 1) * 99 / 100];
+		return result;
+	}
+
+	const char *TFStats::stage_name(FrameStage stage)
+	{
+		return stage_names[stage];
+	}
+
+	void TFStats::reset()
+	{
+		for (Stage_Ring &ring : stage_rings)
+			ring.written.store(0, std::memory_order_release);
+	}
+
+#ifdef FRAME_STATS
+	Stage_Scope::Stage_Scope(FrameStage stage) : _stage(stage)
+	{
+		if (!TFStats::enabled())
+			return;
+
+		ProfilerApi *profiler = TFPlugin::get_api()._profiler;
+		if (profiler)
+			profiler->profile_start(stage_names[stage]);
+		_start = TFStats::now_ticks();
+	}
+
+	Stage_Scope::~Stage_Scope()
+	{
+		if (_start == 0)
+			return;
+
+		TFStats::record(_stage, TFStats::now_ticks() - _start);
+		ProfilerApi *profiler = TFPlugin::get_api()._profiler;
+		if (profiler)
+			profiler->profile_stop();
+	}
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Compiles the per stage frame timing in, without it every scope and record below is empty
+#define FRAME_STATS
+
+namespace PLUGIN_NAMESPACE
+{
+	// Stages of a single inference frame, copies and sync are measured on the host, the ops and the network on the gpu
+	enum FrameStage { StageCopyIn, StageInputOp, StageNetwork, StageOutputOp, StageCopyOut, StageSync, FRAME_STAGE_COUNT };
+
+	// Number of frames the percentiles are computed over
+	const unsigned FRAME_STATS_HISTORY = 256;
+
+	struct Stage_Percentiles
+	{
+		float p50 = 0.0f;
+		float p95 = 0.0f;
+		float p99 = 0.0f;
+		unsigned samples = 0;
+	};
+
+	// Every stage is written by exactly one thread, so a sample is a plain store followed by publishing the write index.
+	// Readers copy the ring without locking, a sample being overwritten while copied only skews one value.
+	class TFStats
+	{
+	public:
+		static void set_enabled(bool enabled);
+		static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+		static uint64_t now_ticks();
+		static double ticks_to_ms(uint64_t ticks);
+		static void record(FrameStage stage, uint64_t ticks);
+		static void record_ms(FrameStage stage, float ms);
+		static Stage_Percentiles percentiles(FrameStage stage);
+		static const char *stage_name(FrameStage stage);
+		static void reset();
+
+	private:
+		static std::atomic<bool> _enabled;
+	};
+
+	// Times a stage and shows it as a scope in the engine profiler
+	class Stage_Scope
+	{
+	public:
+#ifdef FRAME_STATS
+		explicit Stage_Scope(FrameStage stage);
+		~Stage_Scope();
+
+	private:
+		FrameStage _stage;
+		uint64_t _start = 0;
+#else
+		explicit Stage_Scope(FrameStage) {}
+#endif
+	};
+}
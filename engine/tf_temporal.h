@@ -0,0 +1,197 @@
+#pragma once
+
+#include "tf_interactive_io.h"
+#include <cuda_runtime_api.h>
+
+// Temporal reuse of the network result while the view is mostly stable. Every frame the last result gets reprojected
+// with the previous and current view projection, pixels whose previous depth or normal does not match the reprojected
+// surface count as disoccluded. The network only runs every few frames or when too many pixels got disoccluded, its
+// result is blended into the reprojected one where the history is valid and replaces it everywhere else.
+//
+// The matrices are the ones of the engine, row vectors are multiplied from the left and the clip w is the linear depth
+// of the depth target. The normals target holds view space normals.
+
+// Frames between two network runs while the view is stable, the invalid fraction forcing a run earlier and the weight
+// a new network result gets in pixels with a valid history
+const unsigned DEFAULT_TEMPORAL_INTERVAL = 8;
+const float DEFAULT_TEMPORAL_INVALID_FRACTION = 0.05f;
+const float DEFAULT_TEMPORAL_BLEND = 0.25f;
+
+// Relative depth difference and cosine of the normal angle up to which the history of a pixel is reused
+const float TEMPORAL_DEPTH_TOLERANCE = 0.01f;
+const float TEMPORAL_NORMAL_TOLERANCE = 0.9f;
+
+// History values are occlusion in [0, 1], disoccluded pixels are marked with a negative one
+const float TEMPORAL_INVALID = -1.0f;
+
+struct Temporal_Camera
+{
+	float pose[16];
+	float view_projection[16];
+};
+
+// The previous clip position of a pixel is depth * (ndc_x * row 0 + ndc_y * row 1 + row 2) + row 3 of the reprojection,
+// which has the clip z the depth belongs to folded in. The rotation takes current view normals to previous view normals.
+struct Reproject_Params
+{
+	int width;
+	int height;
+	bool has_history;
+	float blend;
+	float reprojection[16];
+	float rotation[9];
+};
+
+// The current normals and depth share a pitch, the previous normals, depth and both history buffers share another one.
+// The network result is missing in frames which only reuse the history, normals are missing for depth only graphs.
+struct Temporal_Surfaces
+{
+	const unsigned char *normals;
+	const float *depth;
+	size_t pitch;
+	const unsigned char *previous_normals;
+	const float *previous_depth;
+	const float *history;
+	float *reprojected;
+	size_t previous_pitch;
+	const unsigned char *network;
+	size_t network_pitch;
+	unsigned char *output;
+	size_t output_pitch;
+	int output_format;
+};
+
+template <typename T>
+IO_FUNC T *temporal_row(T *base, size_t pitch, int y)
+{
+	return (T*)((unsigned char*)base + (size_t)y * pitch);
+}
+
+// Position of the pixel center in the previous frame in pixels, with the linear depth it had there
+IO_FUNC bool reproject_position(const Reproject_Params &params, int x, int y, float depth, float &previous_x, float &previous_y, float &previous_depth)
+{
+	const float ndc_x = (x + 0.5f) / params.width * 2.0f - 1.0f;
+	const float ndc_y = 1.0f - (y + 0.5f) / params.height * 2.0f;
+	const float *m = params.reprojection;
+
+	float previous[4];
+	for (int column = 0; column < 4; ++column)
+		previous[column] = depth * (ndc_x * m[column] + ndc_y * m[4 + column] + m[8 + column]) + m[12 + column];
+	if (previous[3] <= 1e-6f)
+		return false;
+
+	const float inverse_w = 1.0f / previous[3];
+	previous_x = (previous[0] * inverse_w * 0.5f + 0.5f) * params.width - 0.5f;
+	previous_y = (0.5f - previous[1] * inverse_w * 0.5f) * params.height - 0.5f;
+	previous_depth = previous[3];
+	return true;
+}
+
+IO_FUNC bool temporal_normals_match(const Reproject_Params &params, const unsigned char *normal, const unsigned char *previous)
+{
+	float current[3], expected[3], other[3];
+	for (int channel = 0; channel < 3; ++channel)
+	{
+		current[channel] = normal[channel] * (1.0f / 127.5f) - 1.0f;
+		other[channel] = previous[channel] * (1.0f / 127.5f) - 1.0f;
+	}
+	for (int column = 0; column < 3; ++column)
+		expected[column] = current[0] * params.rotation[column] + current[1] * params.rotation[3 + column] + current[2] * params.rotation[6 + column];
+
+	const float dot = expected[0] * other[0] + expected[1] * other[1] + expected[2] * other[2];
+	const float lengths = (expected[0] * expected[0] + expected[1] * expected[1] + expected[2] * expected[2]) * (other[0] * other[0] + other[1] * other[1] + other[2] * other[2]);
+	return dot > 0.0f && dot * dot >= TEMPORAL_NORMAL_TOLERANCE * TEMPORAL_NORMAL_TOLERANCE * lengths;
+}
+
+// Bilinear history over the neighbours which still show the same surface, the normal is checked on the nearest one.
+// Writes the history or TEMPORAL_INVALID and returns whether the pixel was valid.
+IO_FUNC bool reproject_pixel(const Reproject_Params &params, const Temporal_Surfaces &surfaces, int x, int y)
+{
+	float *dest = temporal_row(surfaces.reprojected, surfaces.previous_pitch, y) + x;
+	*dest = TEMPORAL_INVALID;
+	if (!params.has_history)
+		return false;
+
+	float previous_x, previous_y, previous_depth;
+	if (!reproject_position(params, x, y, temporal_row(surfaces.depth, surfaces.pitch, y)[x], previous_x, previous_y, previous_depth))
+		return false;
+	if (previous_x <= -1.0f || previous_y <= -1.0f || previous_x >= params.width || previous_y >= params.height)
+		return false;
+
+	const int nearest_x = (int)(previous_x + 0.5f);
+	const int nearest_y = (int)(previous_y + 0.5f);
+	if (surfaces.normals && surfaces.previous_normals && nearest_x >= 0 && nearest_y >= 0 && nearest_x < params.width && nearest_y < params.height &&
+		!temporal_normals_match(params, temporal_row(surfaces.normals, surfaces.pitch, y) + 4 * x, temporal_row(surfaces.previous_normals, surfaces.previous_pitch, nearest_y) + 4 * nearest_x))
+		return false;
+
+	// Taps outside of the target or on another surface get no weight, clamping keeps the reads inside. The small floor on
+	// the weights keeps a tap exactly on a pixel center from losing its neighbour when that one is the only valid tap.
+	const int tap_x = previous_x < 0.0f ? -1 : (int)previous_x;
+	const int tap_y = previous_y < 0.0f ? -1 : (int)previous_y;
+	const float fraction_x = previous_x - tap_x;
+	const float fraction_y = previous_y - tap_y;
+	const float weight_x[2] = { tap_x >= 0 ? 1.001f - fraction_x : 0.0f, tap_x + 1 < params.width ? fraction_x + 0.001f : 0.0f };
+	const float weight_y[2] = { tap_y >= 0 ? 1.001f - fraction_y : 0.0f, tap_y + 1 < params.height ? fraction_y + 0.001f : 0.0f };
+	const int columns[2] = { tap_x < 0 ? 0 : tap_x, tap_x + 1 < params.width ? tap_x + 1 : tap_x };
+	const int rows[2] = { tap_y < 0 ? 0 : tap_y, tap_y + 1 < params.height ? tap_y + 1 : tap_y };
+	const float tolerance = TEMPORAL_DEPTH_TOLERANCE * previous_depth;
+
+	float sum = 0.0f;
+	float weights = 0.0f;
+	for (int j = 0; j < 2; ++j)
+	{
+		const float *depth = temporal_row(surfaces.previous_depth, surfaces.previous_pitch, rows[j]);
+		const float *history = temporal_row(surfaces.history, surfaces.previous_pitch, rows[j]);
+		for (int i = 0; i < 2; ++i)
+		{
+			const float weight = fabsf(depth[columns[i]] - previous_depth) <= tolerance ? weight_x[i] * weight_y[j] : 0.0f;
+			sum += weight * history[columns[i]];
+			weights += weight;
+		}
+	}
+	if (weights <= 0.0f)
+		return false;
+
+	*dest = sum / weights;
+	return true;
+}
+
+// Blends the network result into the reprojected history, frames without a network result keep the history and fill
+// disoccluded pixels with the last value at the same position
+IO_FUNC void resolve_pixel(const Reproject_Params &params, const Temporal_Surfaces &surfaces, int x, int y)
+{
+	float *history = temporal_row(surfaces.reprojected, surfaces.previous_pitch, y) + x;
+	const float reprojected = *history;
+	const int size = pixel_size(surfaces.output_format);
+
+	float value;
+	if (surfaces.network)
+	{
+		const float network = decode_output(surfaces.output_format, temporal_row(surfaces.network, surfaces.network_pitch, y) + size * x);
+		value = reprojected >= 0.0f ? reprojected + params.blend * (network - reprojected) : network;
+	}
+	else if (reprojected >= 0.0f)
+		value = reprojected;
+	else
+		value = params.has_history ? temporal_row(surfaces.history, surfaces.previous_pitch, y)[x] : 0.0f;
+
+	*history = value;
+	encode_output(surfaces.output_format, value, temporal_row(surfaces.output, surfaces.output_pitch, y) + size * x);
+}
+
+namespace PLUGIN_NAMESPACE
+{
+	// The gpu passes run on the given stream and add the disoccluded pixels to a device counter, the cpu passes are the
+	// reference the benchmark checks and measures
+	class TFTemporal
+	{
+	public:
+		static Temporal_Camera camera(const float pose[16], const float projection[16]);
+		static Reproject_Params reproject_params(const Temporal_Camera &current, const Temporal_Camera &previous, int width, int height, bool has_history, float blend);
+		static bool needs_network(bool has_history, unsigned frames_since_run, unsigned interval, unsigned invalid, unsigned pixels, float invalid_fraction);
+		static cudaError_t reproject(const Reproject_Params &params, const Temporal_Surfaces &surfaces, unsigned *invalid_count, cudaStream_t stream);
+		static cudaError_t resolve(const Reproject_Params &params, const Temporal_Surfaces &surfaces, cudaStream_t stream);
+		static unsigned reproject_cpu(const Reproject_Params &params, const Temporal_Surfaces &surfaces);
+		static void resolve_cpu(const Reproject_Params &params, const Temporal_Surfaces &surfaces);
+	};
+}
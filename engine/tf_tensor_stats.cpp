@@ -0,0 +1,142 @@
+#include "tf_tensor_stats.h"
+#include "tensorflow/core/platform/mutex.h"
+#include <string.h>
+#include <algorithm>
+
+namespace PLUGIN_NAMESPACE
+{
+	enum SlotState { SlotFree, SlotClaimed, SlotNamed };
+
+	// An even sequence is a stable sample, an odd one a publish in flight, zero means nothing was published yet. The ops
+	// of one node a tensorflow session builds for each of its executors share the slot, it is free again after the last.
+	struct Stats_Slot
+	{
+		std::atomic<int> state;
+		const void *binding;
+		char name[TENSOR_STATS_NAME_LENGTH];
+		unsigned users;
+		std::atomic<uint32_t> sequence;
+		Tensor_Stats stats;
+	};
+
+	static Stats_Slot stats_slots[MAX_TENSOR_STATS_SLOTS];
+
+	// Ops register and release while graphs get instantiated and torn down, which is rare enough for a lock. Publishing
+	// and reading never take it.
+	static tensorflow::mutex slots_lock;
+
+	bool slot_matches(const Stats_Slot &slot, const void *binding, const std::string &name)
+	{
+		return slot.state.load(std::memory_order_acquire) == SlotNamed && (binding == nullptr || slot.binding == binding) && name.compare(slot.name) == 0;
+	}
+
+	int TFTensorStats::register_slot(const void *binding, const std::string &name)
+	{
+		tensorflow::mutex_lock lock(slots_lock);
+		for (int i = 0; i < MAX_TENSOR_STATS_SLOTS; ++i)
+		{
+			Stats_Slot &slot = stats_slots[i];
+			if (slot_matches(slot, binding, name))
+			{
+				++slot.users;
+				return i;
+			}
+		}
+
+		for (int i = 0; i < MAX_TENSOR_STATS_SLOTS; ++i)
+		{
+			Stats_Slot &slot = stats_slots[i];
+			if (slot.state.load(std::memory_order_relaxed) != SlotFree)
+				continue;
+
+			slot.state.store(SlotClaimed, std::memory_order_relaxed);
+			slot.binding = binding;
+			strncpy(slot.name, name.c_str(), TENSOR_STATS_NAME_LENGTH - 1);
+			slot.name[TENSOR_STATS_NAME_LENGTH - 1] = '\0';
+			slot.users = 1;
+			slot.sequence.store(0, std::memory_order_relaxed);
+			slot.state.store(SlotNamed, std::memory_order_release);
+			return i;
+		}
+		return -1;
+	}
+
+	// The op has to be done publishing, a read racing with the release finds the slot empty or gone
+	void TFTensorStats::release_slot(int slot_index)
+	{
+		if (slot_index < 0 || slot_index >= MAX_TENSOR_STATS_SLOTS)
+			return;
+
+		tensorflow::mutex_lock lock(slots_lock);
+		Stats_Slot &slot = stats_slots[slot_index];
+		if (slot.state.load(std::memory_order_relaxed) != SlotNamed || --slot.users > 0)
+			return;
+
+		slot.state.store(SlotClaimed, std::memory_order_relaxed);
+		slot.sequence.store(0, std::memory_order_release);
+		slot.state.store(SlotFree, std::memory_order_release);
+	}
+
+	void TFTensorStats::publish(int slot_index, const Tensor_Stats &stats)
+	{
+		if (slot_index < 0 || slot_index >= MAX_TENSOR_STATS_SLOTS)
+			return;
+
+		Stats_Slot &slot = stats_slots[slot_index];
+		uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		if ((sequence & 1) || !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acq_rel))
+			return;
+
+		slot.stats = stats;
+		slot.sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Without a binding the first slot of the name answers, like for a single session
+	bool TFTensorStats::read(const void *binding, const std::string &name, Tensor_Stats &stats)
+	{
+		for (Stats_Slot &slot : stats_slots)
+		{
+			if (!slot_matches(slot, binding, name))
+				continue;
+
+			// A publish only copies a few hundred bytes, a handful of retries is plenty
+			for (int attempt = 0; attempt < 64; ++attempt)
+			{
+				uint32_t before = slot.sequence.load(std::memory_order_acquire);
+				if (before == 0)
+					return false;
+				if (before & 1)
+					continue;
+
+				stats = slot.stats;
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.sequence.load(std::memory_order_relaxed) == before)
+					return true;
+			}
+			return false;
+		}
+		return false;
+	}
+
+	std::vector<std::string> TFTensorStats::names()
+	{
+		std::vector<std::string> result;
+		for (Stats_Slot &slot : stats_slots)
+		{
+			if (slot.state.load(std::memory_order_acquire) == SlotNamed && std::find(result.begin(), result.end(), slot.name) == result.end())
+				result.push_back(slot.name);
+		}
+		return result;
+	}
+
+	// Forgets the samples but keeps the names, the ops hold on to their slot index
+	void TFTensorStats::reset()
+	{
+		for (Stats_Slot &slot : stats_slots)
+		{
+			uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+			if (!(sequence & 1))
+				slot.sequence.compare_exchange_strong(sequence, 0, std::memory_order_acq_rel);
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "tf_interactive_io.h"
+#include <stdint.h>
+#include <float.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace PLUGIN_NAMESPACE
+{
+	// Buckets of the value histogram, values outside of the histogram range land in the first or the last one
+	const int TENSOR_STATS_BINS = 16;
+
+	// Statistics of one sampled tensor. The sum is kept instead of the mean so partial results of blocks merge exactly,
+	// NaNs count as elements but take no part in the min, max, sum or histogram.
+	struct Tensor_Stats
+	{
+		float min;
+		float max;
+		double sum;
+		uint64_t elements;
+		uint64_t nan_count;
+		uint32_t histogram[TENSOR_STATS_BINS];
+		float histogram_min;
+		float histogram_max;
+		uint64_t run;
+	};
+
+	IO_FUNC void clear_tensor_stats(Tensor_Stats &stats, float histogram_min, float histogram_max)
+	{
+		stats.min = FLT_MAX;
+		stats.max = -FLT_MAX;
+		stats.sum = 0.0;
+		stats.elements = 0;
+		stats.nan_count = 0;
+		for (int bin = 0; bin < TENSOR_STATS_BINS; ++bin)
+			stats.histogram[bin] = 0;
+		stats.histogram_min = histogram_min;
+		stats.histogram_max = histogram_max;
+		stats.run = 0;
+	}
+
+	IO_FUNC void accumulate_tensor_stats(Tensor_Stats &stats, float value)
+	{
+		++stats.elements;
+		if (value != value)
+		{
+			++stats.nan_count;
+			return;
+		}
+
+		stats.min = value < stats.min ? value : stats.min;
+		stats.max = value > stats.max ? value : stats.max;
+		stats.sum += value;
+
+		// Clamped as float first, casting infinity to int is undefined
+		float position = (value - stats.histogram_min) / (stats.histogram_max - stats.histogram_min) * TENSOR_STATS_BINS;
+		int bin = position > 0.0f ? (position < (float)TENSOR_STATS_BINS ? (int)position : TENSOR_STATS_BINS - 1) : 0;
+		++stats.histogram[bin];
+	}
+
+	IO_FUNC void merge_tensor_stats(Tensor_Stats &stats, const Tensor_Stats &other)
+	{
+		stats.min = other.min < stats.min ? other.min : stats.min;
+		stats.max = other.max > stats.max ? other.max : stats.max;
+		stats.sum += other.sum;
+		stats.elements += other.elements;
+		stats.nan_count += other.nan_count;
+		for (int bin = 0; bin < TENSOR_STATS_BINS; ++bin)
+			stats.histogram[bin] += other.histogram[bin];
+	}
+
+	inline double tensor_stats_mean(const Tensor_Stats &stats)
+	{
+		uint64_t values = stats.elements - stats.nan_count;
+		return values > 0 ? stats.sum / (double)values : 0.0;
+	}
+
+	// Distinct stats ops the plugin can watch at once, ops beyond that pass their tensor through without sampling
+	const int MAX_TENSOR_STATS_SLOTS = 16;
+	const int TENSOR_STATS_NAME_LENGTH = 128;
+
+	// The InteractiveTensorStats ops publish into one slot per binding and node name, the gpu ops do so from a stream
+	// callback. The binding stands for the tensorflow session of a cached model, execution sessions sharing the model
+	// share its ops and slots. Every slot is a sequence lock, a publish racing with another one is dropped and a read
+	// retries while a publish is in flight, so neither side ever blocks. The ops give their slot back when they go away.
+	class TFTensorStats
+	{
+	public:
+		static int register_slot(const void *binding, const std::string &name);
+		static void release_slot(int slot);
+		static void publish(int slot, const Tensor_Stats &stats);
+		static bool read(const void *binding, const std::string &name, Tensor_Stats &stats);
+		static std::vector<std::string> names();
+		static void reset();
+	};
+}
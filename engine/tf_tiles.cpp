@@ -0,0 +1,323 @@
+#include "tf_tiles.h"
+#include "tf_graph.h"
+#include <plugin_foundation/hash_function.h>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TILES_SSE2
+#endif
+
+// The tile hash runs sixteen murmur lanes over the 32 bit words of the normals and then the depth of every row, word i
+// goes to lane i % 16. A lane only does the xor and multiply of murmur, which maps its state one to one for a given word,
+// so a single changed word always changes the hash. murmur_hash_64 mixes the lanes into the hash at the end. Hashing the
+// rows with murmur_hash_64 itself is not faster with sse2, which has no 64 bit multiply.
+
+namespace {
+
+	void hash_words(uint32_t lanes[TILE_HASH_LANES], const unsigned char *row, unsigned words)
+	{
+		for (unsigned i = 0; i < words; ++i)
+		{
+			uint32_t word;
+			memcpy(&word, row + 4 * i, 4);
+			lanes[i % TILE_HASH_LANES] = tile_hash_step(lanes[i % TILE_HASH_LANES], word);
+		}
+	}
+
+#ifdef TILES_SSE2
+	// Low 32 bits of the four products, sse2 only multiplies the even lanes
+	inline __m128i multiply_lanes(__m128i values, __m128i multiplier)
+	{
+		__m128i even = _mm_mul_epu32(values, multiplier);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(values, 32), multiplier);
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	// Four registers of four lanes take 64 bytes of the row at once, the row has to be a multiple of that
+	void hash_words_sse2(uint32_t lanes[TILE_HASH_LANES], const unsigned char *row, unsigned words)
+	{
+		const __m128i multiplier = _mm_set1_epi32((int)TILE_HASH_MULTIPLIER);
+		__m128i state[4];
+		for (int i = 0; i < 4; ++i)
+			state[i] = _mm_loadu_si128((const __m128i*)(lanes + 4 * i));
+		for (unsigned x = 0; x < words * 4; x += TILE_HASH_LANES * 4)
+		{
+			for (int i = 0; i < 4; ++i)
+				state[i] = multiply_lanes(_mm_xor_si128(state[i], _mm_loadu_si128((const __m128i*)(row + x + 16 * i))), multiplier);
+		}
+		for (int i = 0; i < 4; ++i)
+			_mm_storeu_si128((__m128i*)(lanes + 4 * i), state[i]);
+	}
+#endif
+
+	// A row of a tile is its normals followed by its depth
+	void hash_row(uint32_t lanes[TILE_HASH_LANES], const unsigned char *normals, const float *depth, size_t pitch, const Tile_Rect &rect, unsigned y, bool sse2)
+	{
+		const size_t offset = (size_t)(rect.y + y) * pitch + (size_t)rect.x * 4;
+#ifdef TILES_SSE2
+		if (sse2)
+		{
+			if (normals)
+				hash_words_sse2(lanes, normals + offset, rect.width);
+			hash_words_sse2(lanes, (const unsigned char*)depth + offset, rect.width);
+			return;
+		}
+#endif
+		if (normals)
+			hash_words(lanes, normals + offset, rect.width);
+		hash_words(lanes, (const unsigned char*)depth + offset, rect.width);
+	}
+
+	void init_lanes(uint32_t lanes[TILE_HASH_LANES])
+	{
+		for (unsigned i = 0; i < TILE_HASH_LANES; ++i)
+			lanes[i] = i;
+	}
+
+	uint64_t finish_hash(const uint32_t lanes[TILE_HASH_LANES], const Tile_Rect &rect)
+	{
+		return stingray_plugin_foundation::murmur_hash_64(lanes, TILE_HASH_LANES * 4, (uint64_t)rect.width << 32 | rect.height);
+	}
+
+	// Tiles whose width fills all lanes take the sse2 pass, narrower ones at the right border the scalar one
+	bool use_sse2(const Tile_Rect &rect)
+	{
+#ifdef TILES_SSE2
+		return rect.width % TILE_HASH_LANES == 0;
+#else
+		return false;
+#endif
+	}
+
+} // anonymous namespace
+
+namespace PLUGIN_NAMESPACE
+{
+	Tile_Grid TFTiles::grid(unsigned width, unsigned height, unsigned tile_size)
+	{
+		Tile_Grid grid;
+		grid.width = width;
+		grid.height = height;
+		grid.tile_size = tile_size;
+		grid.columns = (width + tile_size - 1) / tile_size;
+		grid.rows = (height + tile_size - 1) / tile_size;
+		return grid;
+	}
+
+	Tile_Rect TFTiles::tile_rect(const Tile_Grid &grid, unsigned tile)
+	{
+		return grid_tile_rect(grid, tile);
+	}
+
+	unsigned TFTiles::window_size(const Tile_Grid &grid, unsigned halo)
+	{
+		return grid.tile_size + 2 * halo;
+	}
+
+	// Windows are centered on their tile and pushed inside the network frame at its borders, where the frame run pads the
+	// same way
+	Tile_Window TFTiles::window(const Tile_Grid &grid, unsigned tile, unsigned halo, unsigned network_width, unsigned network_height)
+	{
+		const Tile_Rect rect = tile_rect(grid, tile);
+		const unsigned size = window_size(grid, halo);
+		Tile_Window window;
+		window.tile = tile;
+		window.x = std::min(rect.x > halo ? rect.x - halo : 0, network_width - size);
+		window.y = std::min(rect.y > halo ? rect.y - halo : 0, network_height - size);
+		return window;
+	}
+
+	uint64_t TFTiles::hash_tile(const Tile_Grid &grid, unsigned tile, const unsigned char *normals, const float *depth, size_t pitch)
+	{
+		const Tile_Rect rect = tile_rect(grid, tile);
+		uint32_t lanes[TILE_HASH_LANES];
+		init_lanes(lanes);
+		for (unsigned y = 0; y < rect.height; ++y)
+			hash_row(lanes, normals, depth, pitch, rect, y, use_sse2(rect));
+		return finish_hash(lanes, rect);
+	}
+
+	uint64_t TFTiles::hash_tile_reference(const Tile_Grid &grid, unsigned tile, const unsigned char *normals, const float *depth, size_t pitch)
+	{
+		const Tile_Rect rect = tile_rect(grid, tile);
+		uint32_t lanes[TILE_HASH_LANES];
+		init_lanes(lanes);
+		for (unsigned y = 0; y < rect.height; ++y)
+			hash_row(lanes, normals, depth, pitch, rect, y, false);
+		return finish_hash(lanes, rect);
+	}
+
+	void TFTiles::hash_tiles(const Tile_Grid &grid, const unsigned char *normals, const float *depth, size_t pitch, uint64_t *hashes)
+	{
+		std::vector<uint32_t> lanes((size_t)grid.columns * grid.rows * TILE_HASH_LANES);
+		hash_lanes_cpu(grid, normals, depth, pitch, lanes.data());
+		finish_hashes(grid, lanes.data(), hashes);
+	}
+
+	// Goes through the rows of the frame in order with the lanes of a whole row of tiles, which reads the memory in order
+	// instead of jumping a pitch every 64 pixels. The lanes of tile t start at lanes[t * TILE_HASH_LANES].
+	void TFTiles::hash_lanes_cpu(const Tile_Grid &grid, const unsigned char *normals, const float *depth, size_t pitch, uint32_t *lanes)
+	{
+		for (unsigned tile = 0; tile < grid.columns * grid.rows; ++tile)
+			init_lanes(&lanes[tile * TILE_HASH_LANES]);
+
+		for (unsigned row = 0; row < grid.rows; ++row)
+		{
+			const unsigned height = tile_rect(grid, row * grid.columns).height;
+			for (unsigned y = 0; y < height; ++y)
+			{
+				for (unsigned column = 0; column < grid.columns; ++column)
+				{
+					const unsigned tile = row * grid.columns + column;
+					const Tile_Rect rect = tile_rect(grid, tile);
+					hash_row(&lanes[tile * TILE_HASH_LANES], normals, depth, pitch, rect, y, use_sse2(rect));
+				}
+			}
+		}
+	}
+
+	void TFTiles::finish_hashes(const Tile_Grid &grid, const uint32_t *lanes, uint64_t *hashes)
+	{
+		for (unsigned tile = 0; tile < grid.columns * grid.rows; ++tile)
+			hashes[tile] = finish_hash(&lanes[tile * TILE_HASH_LANES], tile_rect(grid, tile));
+	}
+
+	unsigned TFTiles::dirty_tiles(const Tile_Grid &grid, const uint64_t *hashes, const uint64_t *previous, std::vector<unsigned> &dirty)
+	{
+		dirty.clear();
+		for (unsigned tile = 0; tile < grid.columns * grid.rows; ++tile)
+			if (hashes[tile] != previous[tile])
+				dirty.push_back(tile);
+		return (unsigned)dirty.size();
+	}
+
+	// The network reaches the halo around every pixel, so the result of the tiles within it changes with a dirty tile too.
+	// Adds them to the dirty tiles in order and returns the count.
+	unsigned TFTiles::grow_dirty(const Tile_Grid &grid, unsigned halo, std::vector<unsigned> &dirty)
+	{
+		const unsigned reach = (halo + grid.tile_size - 1) / grid.tile_size;
+		const size_t changed = dirty.size();
+		for (size_t i = 0; i < changed; ++i)
+		{
+			const unsigned column = dirty[i] % grid.columns;
+			const unsigned row = dirty[i] / grid.columns;
+			const unsigned last_column = std::min(column + reach, grid.columns - 1);
+			const unsigned last_row = std::min(row + reach, grid.rows - 1);
+			for (unsigned y = row > reach ? row - reach : 0; y <= last_row; ++y)
+				for (unsigned x = column > reach ? column - reach : 0; x <= last_column; ++x)
+					dirty.push_back(y * grid.columns + x);
+		}
+		std::sort(dirty.begin(), dirty.end());
+		dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+		return (unsigned)dirty.size();
+	}
+
+	// Returns false when the windows cover more pixels than the frame, running the frame is cheaper then
+	bool TFTiles::plan_windows(const Tile_Grid &grid, const std::vector<unsigned> &dirty, unsigned halo, unsigned network_width, unsigned network_height, std::vector<Tile_Window> &windows)
+	{
+		windows.clear();
+		const unsigned size = window_size(grid, halo);
+		if (size > network_width || size > network_height || (uint64_t)dirty.size() * size * size >= (uint64_t)network_width * network_height)
+			return false;
+
+		for (unsigned tile : dirty)
+			windows.push_back(window(grid, tile, halo, network_width, network_height));
+		return true;
+	}
+
+	// The largest window fitting the ceiling with a batch of one, and as many windows per batch as fit beside it. Tiles
+	// stay multiples of the pooling alignment so every window origin is one as well. A ceiling below the smallest window
+	// still gets the smallest window. Returns false when the frame fits the ceiling or is too small for a window.
+	bool TFTiles::plan_tiling(unsigned network_width, unsigned network_height, uint64_t memory_ceiling, unsigned bytes_per_pixel, unsigned halo, Tile_Plan &plan)
+	{
+		plan = Tile_Plan();
+		const uint64_t pixels = memory_ceiling / bytes_per_pixel;
+		if (memory_ceiling == 0 || (uint64_t)network_width * network_height <= pixels)
+			return false;
+
+		unsigned size = (unsigned)std::sqrt((double)pixels) / NETWORK_SIZE_ALIGNMENT * NETWORK_SIZE_ALIGNMENT;
+		size = std::min(size, std::min(network_width, network_height));
+		if (size < probe_size(halo))
+			size = probe_size(halo);
+		if (size > network_width || size > network_height)
+			return false;
+
+		// The tile shrinks as far as the number of columns and rows allows, which frees memory for more windows per batch
+		unsigned tile = size - 2 * halo;
+		const unsigned columns = (network_width + tile - 1) / tile;
+		const unsigned rows = (network_height + tile - 1) / tile;
+		tile = std::max((network_width + columns - 1) / columns, (network_height + rows - 1) / rows);
+		tile = (tile + NETWORK_SIZE_ALIGNMENT - 1) / NETWORK_SIZE_ALIGNMENT * NETWORK_SIZE_ALIGNMENT;
+		size = tile + 2 * halo;
+
+		plan.grid = grid(network_width, network_height, tile);
+		plan.halo = halo;
+		plan.window_size = size;
+		const unsigned tiles = plan.grid.columns * plan.grid.rows;
+		plan.batch = (unsigned)std::min<uint64_t>(std::max<uint64_t>(pixels / ((uint64_t)size * size), 1), std::min(tiles, MAX_BATCH_ENTRIES));
+		plan.runs = (tiles + plan.batch - 1) / plan.batch;
+		return true;
+	}
+
+	uint64_t TFTiles::peak_bytes(const Tile_Plan &plan, unsigned bytes_per_pixel)
+	{
+		if (plan.batch == 0)
+			return (uint64_t)plan.grid.width * plan.grid.height * bytes_per_pixel;
+		return (uint64_t)plan.batch * plan.window_size * plan.window_size * bytes_per_pixel;
+	}
+
+	// The smallest window a tiled frame runs in, the memory of a graph is measured on it
+	unsigned TFTiles::probe_size(unsigned halo)
+	{
+		return 2 * halo + NETWORK_SIZE_ALIGNMENT;
+	}
+
+	// Rounds the measured peak of a run up to whole bytes per pixel, a peak of zero comes from an allocator without stats
+	unsigned TFTiles::bytes_per_pixel(uint64_t peak_bytes, unsigned width, unsigned height)
+	{
+		const uint64_t pixels = (uint64_t)width * height;
+		if (peak_bytes == 0 || pixels == 0)
+			return NETWORK_BYTES_PER_PIXEL;
+		return (unsigned)((peak_bytes + pixels - 1) / pixels);
+	}
+
+	// The entry reads the window out of the surfaces of the transfer data and writes the tile into its output
+	void bind_window(const Tile_Grid &grid, const Tile_Window &tile_window, int output_format, CUDA_transfer_data &data, Batch_Entry &entry)
+	{
+		const Tile_Rect rect = TFTiles::tile_rect(grid, tile_window.tile);
+		entry.input_memory = data._input_memory ? (unsigned char*)data._input_memory + tile_window.y * data._pitch + tile_window.x * NORMALS_PIXEL_SIZE : nullptr;
+		entry.depth_memory = (unsigned char*)data._depth_memory + tile_window.y * data._pitch + tile_window.x * sizeof(float);
+		entry.output_memory = (unsigned char*)data._output_memory + rect.y * data._output_pitch + rect.x * pixel_size(output_format);
+		entry.output_x = rect.x - tile_window.x;
+		entry.output_y = rect.y - tile_window.y;
+		entry.output_width = rect.width;
+		entry.output_height = rect.height;
+	}
+
+	// Points the batch entries at the windows of the tiles of a run, every entry writes its tile into the frame output.
+	// Returns the windows of the run, the last run can be smaller than the batch.
+	unsigned TFTiles::bind_tiles(const Tile_Plan &plan, unsigned run, int output_format, CUDA_transfer_data &data)
+	{
+		const unsigned tiles = plan.grid.columns * plan.grid.rows;
+		const unsigned first = run * plan.batch;
+		const unsigned count = first < tiles ? std::min(plan.batch, tiles - first) : 0;
+		for (unsigned i = 0; i < count; ++i)
+			bind_window(plan.grid, window(plan.grid, first + i, plan.halo, plan.grid.width, plan.grid.height), output_format, data, data._batch[i]);
+		data._batch_count = count;
+		return count;
+	}
+
+	// The same for the windows of dirty tiles starting at first, the output of the transfer data is the result of the
+	// earlier frames the tiles get patched into
+	unsigned TFTiles::bind_windows(const Tile_Grid &grid, const std::vector<Tile_Window> &windows, unsigned first, unsigned batch, int output_format, CUDA_transfer_data &data)
+	{
+		const unsigned count = first < windows.size() ? std::min(batch, (unsigned)windows.size() - first) : 0;
+		for (unsigned i = 0; i < count; ++i)
+			bind_window(grid, windows[first + i], output_format, data, data._batch[i]);
+		data._batch_count = count;
+		return count;
+	}
+}
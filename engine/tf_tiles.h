@@ -0,0 +1,113 @@
+#pragma once
+
+#include "tf_interactive_io.h"
+#include "tf_cuda.h"
+#include <stdint.h>
+#include <vector>
+
+// Dirty tile tracking for scenes where most of the normals and depth stay the same between frames. Every tile of the
+// G-buffer gets a hash, only the tiles whose hash changed run through the network again and get patched into the result
+// of the earlier frames. A tile runs in a window reaching the receptive field of the network beyond the tile, so the
+// pixels of the tile come out like in a run over the whole frame. Sessions hash on the device right behind the copy-in
+// and the windows write their tiles straight into the result the session keeps.
+//
+// Tiled execution uses the same windows to bound the activation memory of large frames. The network runs on batches of
+// windows instead of the whole frame and every window writes its tile into the output.
+
+const unsigned TILE_SIZE = 64;
+
+// The hash of a tile runs sixteen 32 bit murmur lanes, word i of a row goes to lane i % 16
+const unsigned TILE_HASH_LANES = 16;
+const uint32_t TILE_HASH_MULTIPLIER = 0x5bd1e995u;
+
+// Radius of the receptive field of the NNAO network, 91 pixels, rounded up to the pooling alignment. A window origin
+// on a multiple of the alignment keeps the pooling grid of the window the one of the frame.
+const unsigned TILE_HALO = 96;
+
+// Peak memory of a NNAO run per pixel of the frame or of the windows of a batch. It covers the full resolution tensors
+// alive at the last skip connection, the input, the skip, the upsampled features, their concatenation and the
+// convolution behind it. Sessions measure the peak of their graph on a run of the probe window instead and only fall
+// back to this when the device allocator keeps no stats.
+const unsigned NETWORK_BYTES_PER_PIXEL = 192;
+
+// The last column and row of tiles can be smaller than the tile size
+struct Tile_Grid
+{
+	unsigned width;
+	unsigned height;
+	unsigned tile_size;
+	unsigned columns;
+	unsigned rows;
+};
+
+struct Tile_Rect
+{
+	unsigned x;
+	unsigned y;
+	unsigned width;
+	unsigned height;
+};
+
+// A dirty tile and the origin of the window it runs in, windows have the same size so one graph runs all of them
+struct Tile_Window
+{
+	unsigned tile;
+	unsigned x;
+	unsigned y;
+};
+
+// Tiles of a frame running through a network specialized to the window size, batch windows per run. A batch of zero
+// runs the whole frame at once.
+struct Tile_Plan
+{
+	Tile_Grid grid;
+	unsigned halo;
+	unsigned window_size;
+	unsigned batch;
+	unsigned runs;
+};
+
+IO_FUNC uint32_t tile_hash_step(uint32_t lane, uint32_t word)
+{
+	return (lane ^ word) * TILE_HASH_MULTIPLIER;
+}
+
+IO_FUNC Tile_Rect grid_tile_rect(const Tile_Grid &grid, unsigned tile)
+{
+	Tile_Rect rect;
+	rect.x = tile % grid.columns * grid.tile_size;
+	rect.y = tile / grid.columns * grid.tile_size;
+	rect.width = grid.width - rect.x < grid.tile_size ? grid.width - rect.x : grid.tile_size;
+	rect.height = grid.height - rect.y < grid.tile_size ? grid.height - rect.y : grid.tile_size;
+	return rect;
+}
+
+namespace PLUGIN_NAMESPACE
+{
+	// The hash of a tile covers the normals and depth rows of the tile, normals are skipped for depth only graphs. The
+	// reference hash is the scalar version of the sse2 one and has to give the same value. The lanes of every tile can
+	// run on the device, finish_hashes turns them into the hashes hash_tiles gives.
+	class TFTiles
+	{
+	public:
+		static Tile_Grid grid(unsigned width, unsigned height, unsigned tile_size);
+		static Tile_Rect tile_rect(const Tile_Grid &grid, unsigned tile);
+		static unsigned window_size(const Tile_Grid &grid, unsigned halo);
+		static Tile_Window window(const Tile_Grid &grid, unsigned tile, unsigned halo, unsigned network_width, unsigned network_height);
+		static uint64_t hash_tile(const Tile_Grid &grid, unsigned tile, const unsigned char *normals, const float *depth, size_t pitch);
+		static uint64_t hash_tile_reference(const Tile_Grid &grid, unsigned tile, const unsigned char *normals, const float *depth, size_t pitch);
+		static void hash_tiles(const Tile_Grid &grid, const unsigned char *normals, const float *depth, size_t pitch, uint64_t *hashes);
+		static cudaError_t hash_lanes(const Tile_Grid &grid, const unsigned char *normals, const float *depth, size_t pitch, uint32_t *lanes, cudaStream_t stream);
+		static void hash_lanes_cpu(const Tile_Grid &grid, const unsigned char *normals, const float *depth, size_t pitch, uint32_t *lanes);
+		static void finish_hashes(const Tile_Grid &grid, const uint32_t *lanes, uint64_t *hashes);
+		static unsigned dirty_tiles(const Tile_Grid &grid, const uint64_t *hashes, const uint64_t *previous, std::vector<unsigned> &dirty);
+		static unsigned grow_dirty(const Tile_Grid &grid, unsigned halo, std::vector<unsigned> &dirty);
+		static bool plan_windows(const Tile_Grid &grid, const std::vector<unsigned> &dirty, unsigned halo, unsigned network_width, unsigned network_height, std::vector<Tile_Window> &windows);
+		static bool plan_tiling(unsigned network_width, unsigned network_height, uint64_t memory_ceiling, unsigned bytes_per_pixel, unsigned halo, Tile_Plan &plan);
+		static uint64_t peak_bytes(const Tile_Plan &plan, unsigned bytes_per_pixel);
+		static unsigned probe_size(unsigned halo);
+		static unsigned bytes_per_pixel(uint64_t peak_bytes, unsigned width, unsigned height);
+		static unsigned bind_tiles(const Tile_Plan &plan, unsigned run, int output_format, CUDA_transfer_data &data);
+		static unsigned bind_windows(const Tile_Grid &grid, const std::vector<Tile_Window> &windows, unsigned first, unsigned batch, int output_format, CUDA_transfer_data &data);
+	};
+}
@@ -0,0 +1,303 @@
+#include "tf_trace.h"
+#include "tf_plugin.h"
+#include "tf_graph.h"
+#include <algorithm>
+
+namespace PLUGIN_NAMESPACE
+{
+	static unsigned trace_interval = 0;
+	static std::vector<Trace_Profile> profiles;
+	static ThreadCriticalSection *trace_lock = nullptr;
+
+	// Runs get traced on the worker while LUA dumps and resets the profiles
+	struct Trace_Lock
+	{
+		Trace_Lock() { if (trace_lock) TFPlugin::get_api()._thread->enter_critical_section(trace_lock); }
+		~Trace_Lock() { if (trace_lock) TFPlugin::get_api()._thread->leave_critical_section(trace_lock); }
+	};
+
+	// Follows identities down to the constant or variable holding the weights and returns its shape
+	bool weight_shape(const TF::GraphDef &graph, const std::string &name, std::vector<int64_t> &dims)
+	{
+		const TF::NodeDef *node = TFGraph::find_node(graph, name);
+		while (node && node->op() == "Identity" && node->input_size() > 0)
+			node = TFGraph::find_node(graph, node->input(0));
+		if (node == nullptr)
+			return false;
+
+		dims.clear();
+		if (node->op() == "Const" && node->attr().count("value"))
+		{
+			for (const auto &dim : node->attr().at("value").tensor().tensor_shape().dim())
+				dims.push_back(dim.size());
+		}
+		else if (node->op() == "VariableV2" && node->attr().count("shape"))
+		{
+			for (const auto &dim : node->attr().at("shape").shape().dim())
+				dims.push_back(dim.size());
+		}
+		return !dims.empty();
+	}
+
+	int64_t window_size(const TF::NodeDef &node, const char *attribute)
+	{
+		if (!node.attr().count(attribute))
+			return 1;
+		const auto &values = node.attr().at(attribute).list().i();
+		return values.size() == 4 ? values.Get(1) * values.Get(2) : 1;
+	}
+
+	// Multiply-adds count as two operations, elementwise nodes as one per output element
+	double estimate_flops(const TF::GraphDef &graph, const TF::NodeDef *node, int64_t output_elements)
+	{
+		if (node == nullptr || output_elements <= 0)
+			return 0.0;
+
+		std::vector<int64_t> filter;
+		const std::string &op = node->op();
+		if (op == "Conv2D" && node->input_size() > 1 && weight_shape(graph, node->input(1), filter) && filter.size() == 4)
+			return 2.0 * output_elements * filter[0] * filter[1] * filter[2];
+
+		// The filter of a transposed convolution is (height, width, output channels, input channels)
+		if (op == "Conv2DBackpropInput" && node->input_size() > 1 && weight_shape(graph, node->input(1), filter) && filter.size() == 4)
+			return 2.0 * output_elements * filter[0] * filter[1] * filter[3] / (double)window_size(*node, "strides");
+
+		if (op == "AvgPool" || op == "MaxPool")
+			return (double)output_elements * window_size(*node, "ksize");
+
+		if (op == "Relu" || op == "Add" || op == "Mul" || op == "BiasAdd" || op == "Sub")
+			return (double)output_elements;
+
+		return 0.0;
+	}
+
+	// Individual gpu streams and copies would count the kernels of "stream:all" twice
+	bool skip_device(const std::string &device)
+	{
+		size_t stream = device.find("/stream:");
+		if (stream != std::string::npos && device.compare(stream, std::string::npos, "/stream:all") != 0)
+			return true;
+		return device.find("/memcpy") != std::string::npos;
+	}
+
+	std::string escape_json(const std::string &text)
+	{
+		std::string result;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result;
+	}
+
+	void TFTrace::init()
+	{
+		ApiInterface &api = TFPlugin::get_api();
+		if (trace_lock == nullptr && api._thread)
+			trace_lock = api._thread->create_critical_section(api._allocator_object);
+	}
+
+	void TFTrace::shutdown()
+	{
+		reset();
+
+		ApiInterface &api = TFPlugin::get_api();
+		if (trace_lock)
+		{
+			api._thread->destroy_critical_section(trace_lock, api._allocator_object);
+			trace_lock = nullptr;
+		}
+	}
+
+	void TFTrace::set_interval(unsigned frames)
+	{
+		trace_interval = frames;
+	}
+
+	bool TFTrace::due(uint64_t run)
+	{
+		return trace_interval > 0 && run % trace_interval == 0;
+	}
+
+	TF::Status TFTrace::traced_run(TF::Session *session, const std::string &label, const TF::GraphDef &graph,
+		const std::vector<std::pair<std::string, TF::Tensor>> &inputs, const std::string &output_name, std::vector<TF::Tensor> &outputs)
+	{
+		TF::RunOptions options;
+		options.set_trace_level(TF::RunOptions::FULL_TRACE);
+		TF::RunMetadata metadata;
+
+		outputs.clear();
+		TF::Status status = session->Run(options, inputs, { output_name }, {}, &outputs, &metadata);
+		if (status.ok())
+			collect(label, graph, metadata);
+		return status;
+	}
+
+	void TFTrace::collect(const std::string &label, const TF::GraphDef &graph, const TF::RunMetadata &metadata)
+	{
+		Trace_Lock lock;
+
+		auto it = std::find_if(profiles.begin(), profiles.end(), [&label](const Trace_Profile &profile) { return profile.label == label; });
+		if (it == profiles.end())
+		{
+			profiles.emplace_back();
+			profiles.back().label = label;
+			it = profiles.end() - 1;
+		}
+
+		Trace_Profile &profile = *it;
+		profile.last_run.clear();
+		++profile.traced_runs;
+
+		for (const TF::DeviceStepStats &device_stats : metadata.step_stats().dev_stats())
+		{
+			const std::string &device = device_stats.device();
+			if (skip_device(device))
+				continue;
+
+			unsigned device_index = (unsigned)(std::find(profile.devices.begin(), profile.devices.end(), device) - profile.devices.begin());
+			if (device_index == profile.devices.size())
+				profile.devices.push_back(device);
+
+			for (const TF::NodeExecStats &node_stats : device_stats.node_stats())
+			{
+				// Gpu kernels are named "node:Op"
+				std::string name = node_stats.node_name();
+				size_t colon = name.find(':');
+				if (colon != std::string::npos)
+					name = name.substr(0, colon);
+				if (name == "_SOURCE" || name == "_SINK")
+					continue;
+
+				const TF::NodeDef *node = TFGraph::find_node(graph, name);
+				int64_t output_elements = 0;
+				uint64_t output_bytes = 0;
+				for (const TF::NodeOutput &output : node_stats.output())
+				{
+					const TF::TensorDescription &description = output.tensor_description();
+					int64_t elements = 1;
+					for (const auto &dim : description.shape().dim())
+						elements *= dim.size() > 0 ? dim.size() : 1;
+					output_elements += elements;
+					output_bytes += description.allocation_description().allocated_bytes();
+				}
+
+				uint64_t peak_bytes = 0;
+				for (const TF::AllocatorMemoryUsed &memory : node_stats.memory())
+					peak_bytes += memory.peak_bytes();
+
+				std::string key = device + "|" + name;
+				auto found = profile.node_index.find(key);
+				if (found == profile.node_index.end())
+				{
+					Node_Profile node_profile;
+					node_profile.name = name;
+					node_profile.op = node ? node->op() : std::string();
+					node_profile.device = device;
+					found = profile.node_index.emplace(key, profile.nodes.size()).first;
+					profile.nodes.push_back(node_profile);
+				}
+
+				uint64_t micros = (uint64_t)node_stats.all_end_rel_micros();
+				Node_Profile &node_profile = profile.nodes[found->second];
+				++node_profile.runs;
+				node_profile.compute_micros += micros;
+				node_profile.max_micros = std::max(node_profile.max_micros, micros);
+				node_profile.output_bytes = std::max(node_profile.output_bytes, output_bytes);
+				node_profile.peak_bytes = std::max(node_profile.peak_bytes, peak_bytes);
+				node_profile.flops = estimate_flops(graph, node, output_elements);
+
+				Trace_Event event;
+				event.name = name;
+				event.op = node_profile.op;
+				event.device = device_index;
+				event.thread = node_stats.thread_id();
+				event.start_micros = node_stats.all_start_micros();
+				event.duration_micros = (int64_t)micros;
+				profile.last_run.push_back(event);
+			}
+		}
+	}
+
+	// One table per profiled graph size, nodes sorted by their mean time
+	std::string TFTrace::table()
+	{
+		Trace_Lock lock;
+
+		std::string result;
+		for (const Trace_Profile &profile : profiles)
+		{
+			std::vector<const Node_Profile*> sorted;
+			double total_micros = 0.0;
+			for (const Node_Profile &node : profile.nodes)
+			{
+				sorted.push_back(&node);
+				total_micros += (double)node.compute_micros / node.runs;
+			}
+			std::sort(sorted.begin(), sorted.end(), [](const Node_Profile *a, const Node_Profile *b) {
+				return (double)a->compute_micros / a->runs > (double)b->compute_micros / b->runs;
+			});
+
+			result += TF::strings::Printf("%s, %u traced runs, %.3f ms summed node time\n", profile.label.c_str(), profile.traced_runs, total_micros / 1000.0);
+			result += TF::strings::Printf("%-40s %-22s %10s %10s %7s %10s %9s %10s  %s\n", "node", "op", "mean ms", "max ms", "share", "mflops", "gflop/s", "output kb", "device");
+			for (const Node_Profile *node : sorted)
+			{
+				double mean_micros = (double)node->compute_micros / node->runs;
+				double gflops_per_second = mean_micros > 0.0 ? node->flops / (mean_micros * 1000.0) : 0.0;
+				result += TF::strings::Printf("%-40s %-22s %10.3f %10.3f %6.1f%% %10.1f %9.1f %10.1f  %s\n",
+					node->name.c_str(), node->op.c_str(), mean_micros / 1000.0, node->max_micros / 1000.0,
+					total_micros > 0.0 ? 100.0 * mean_micros / total_micros : 0.0, node->flops / 1e6, gflops_per_second,
+					node->output_bytes / 1024.0, node->device.c_str());
+			}
+			result += "\n";
+		}
+		return result;
+	}
+
+	// Writes the table to "<prefix>.txt" and the last traced run of every profile to "<prefix>.json", which loads in chrome://tracing
+	TF::Status TFTrace::dump(const std::string &path_prefix)
+	{
+		TF::Env *env = TF::Env::Default();
+		TF::Status status = TF::WriteStringToFile(env, path_prefix + ".txt", table());
+		if (!status.ok())
+			return status;
+
+		Trace_Lock lock;
+		std::string json = "{\"traceEvents\":[";
+		bool first = true;
+		unsigned process = 0;
+		for (const Trace_Profile &profile : profiles)
+		{
+			int64_t origin = 0;
+			for (const Trace_Event &event : profile.last_run)
+				origin = origin == 0 ? event.start_micros : std::min(origin, event.start_micros);
+
+			for (unsigned device = 0; device < profile.devices.size(); ++device)
+			{
+				json += TF::strings::Printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%s %s\"}}",
+					first ? "" : ",", process + device, escape_json(profile.label).c_str(), escape_json(profile.devices[device]).c_str());
+				first = false;
+			}
+
+			for (const Trace_Event &event : profile.last_run)
+			{
+				json += TF::strings::Printf("%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"args\":{\"op\":\"%s\"}}",
+					first ? "" : ",", escape_json(event.name).c_str(), escape_json(event.op).c_str(), process + event.device, event.thread,
+					(long long)(event.start_micros - origin), (long long)event.duration_micros, escape_json(event.op).c_str());
+				first = false;
+			}
+			process += (unsigned)profile.devices.size();
+		}
+		json += "]}\n";
+
+		return TF::WriteStringToFile(env, path_prefix + ".json", json);
+	}
+
+	void TFTrace::reset()
+	{
+		Trace_Lock lock;
+		profiles.clear();
+	}
+}
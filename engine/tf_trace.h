@@ -0,0 +1,69 @@
+#pragma once
+
+#include "tf_settings.h"
+#pragma warning(push, 0)
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#pragma warning(pop)
+#include <vector>
+#include <map>
+#include <stdint.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	namespace TF = tensorflow;
+
+	// Accumulated cost of one node on one device over all traced runs
+	struct Node_Profile
+	{
+		std::string name;
+		std::string op;
+		std::string device;
+		uint64_t runs = 0;
+		uint64_t compute_micros = 0;
+		uint64_t max_micros = 0;
+		uint64_t output_bytes = 0;
+		uint64_t peak_bytes = 0;
+		double flops = 0.0;
+	};
+
+	// Single node execution of the last traced run, used for the chrome trace
+	struct Trace_Event
+	{
+		std::string name;
+		std::string op;
+		unsigned device = 0;
+		uint32_t thread = 0;
+		int64_t start_micros = 0;
+		int64_t duration_micros = 0;
+	};
+
+	// Profile of one graph at one network size
+	struct Trace_Profile
+	{
+		std::string label;
+		unsigned traced_runs = 0;
+		std::vector<Node_Profile> nodes;
+		std::map<std::string, size_t> node_index;
+		std::vector<std::string> devices;
+		std::vector<Trace_Event> last_run;
+	};
+
+	// Opt-in per node profiler built on the step stats of FULL_TRACE runs. Only depends on tensorflow, so the same
+	// aggregation works for the gpu device in the engine and for the cpu device on machines without one.
+	class TFTrace
+	{
+	public:
+		static void init();
+		static void shutdown();
+		static void set_interval(unsigned frames);
+		static bool due(uint64_t run);
+		static TF::Status traced_run(TF::Session *session, const std::string &label, const TF::GraphDef &graph,
+			const std::vector<std::pair<std::string, TF::Tensor>> &inputs, const std::string &output_name, std::vector<TF::Tensor> &outputs);
+		static void collect(const std::string &label, const TF::GraphDef &graph, const TF::RunMetadata &metadata);
+		static std::string table();
+		static TF::Status dump(const std::string &path_prefix);
+		static void reset();
+	};
+}
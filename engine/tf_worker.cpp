@@ -0,0 +1,185 @@
+#include "tf_worker.h"
+#include "tf_plugin.h"
+
+namespace PLUGIN_NAMESPACE
+{
+	// Enough room for every pipeline slot of a handful of sessions
+	const unsigned MAX_WORKER_JOBS = 64;
+
+	enum WorkerJobType { RunJob, LoadJob, ReloadJob };
+
+	struct Worker_Job
+	{
+		WorkerJobType type;
+		Graph_Execution_Session *session;
+		unsigned slot;
+	};
+
+	// Every queue has a thread of its own, so loading a graph never holds up the frames of the running sessions
+	struct Worker_Queue
+	{
+		const char *name;
+		ThreadID thread;
+		ThreadEvent *event;
+		ThreadCriticalSection *lock;
+		Worker_Job jobs[MAX_WORKER_JOBS];
+		unsigned read;
+		unsigned write;
+	};
+
+	static Worker_Queue run_queue = { "TensorflowWorker" };
+	static Worker_Queue load_queue = { "TensorflowLoader" };
+	static volatile bool worker_running = false;
+
+	bool pop_job(Worker_Queue &queue, Worker_Job &job)
+	{
+		ThreadApi *thread = TFPlugin::get_api()._thread;
+		thread->enter_critical_section(queue.lock);
+		bool has_job = queue.read != queue.write;
+		if (has_job)
+		{
+			job = queue.jobs[queue.read % MAX_WORKER_JOBS];
+			++queue.read;
+		}
+		thread->leave_critical_section(queue.lock);
+		return has_job;
+	}
+
+	void worker_entry(void *user_data)
+	{
+		ApiInterface &api = TFPlugin::get_api();
+		ThreadApi *thread = api._thread;
+		Worker_Queue &queue = *static_cast<Worker_Queue*>(user_data);
+
+		// The stage scopes of the worker only show up in the engine profiler with a profiler of its own
+		bool owns_profiler = api._profiler && !api._profiler->has_thread_profiler();
+		if (owns_profiler)
+			api._profiler->make_thread_profiler(api._allocator_object);
+
+		while (worker_running)
+		{
+			thread->wait_for_event(queue.event);
+
+			Worker_Job job;
+			while (pop_job(queue, job))
+			{
+				// Loads hold a reference on the session, a session destroyed meanwhile is not loaded anymore and gets freed here
+				if (job.type == LoadJob || job.type == ReloadJob)
+				{
+					if (job.session->references > 1)
+					{
+						if (job.type == LoadJob)
+							TFSession::load(job.session);
+						else
+							TFSession::reload(job.session);
+					}
+					TFSession::release(job.session);
+				}
+				else
+				{
+					TFSession::run_slot(job.session, job.slot);
+					thread->set_event(job.session->slot_events[job.slot]);
+				}
+			}
+		}
+
+		if (owns_profiler)
+			api._profiler->delete_thread_profiler(api._allocator_object);
+	}
+
+	void start_queue(Worker_Queue &queue)
+	{
+		ApiInterface &api = TFPlugin::get_api();
+		queue.event = api._thread->create_event(api._allocator_object, false, false, queue.name);
+		queue.lock = api._thread->create_critical_section(api._allocator_object);
+		queue.read = queue.write = 0;
+		queue.thread = api._thread->create_thread(queue.name, worker_entry, &queue, PLUGIN_THREAD_PRIORITY_NORMAL);
+	}
+
+	void stop_queue(Worker_Queue &queue)
+	{
+		ApiInterface &api = TFPlugin::get_api();
+		api._thread->set_event(queue.event);
+		api._thread->wait_for_thread(queue.thread);
+		api._thread->destroy_critical_section(queue.lock, api._allocator_object);
+		api._thread->destroy_event(queue.event, api._allocator_object);
+		queue.thread = nullptr;
+		queue.lock = nullptr;
+		queue.event = nullptr;
+	}
+
+	bool TFWorker::start()
+	{
+		if (worker_running)
+			return true;
+
+		ApiInterface &api = TFPlugin::get_api();
+		if (api._thread == nullptr)
+			return false;
+
+		worker_running = true;
+		start_queue(run_queue);
+		start_queue(load_queue);
+		return true;
+	}
+
+	void TFWorker::stop()
+	{
+		if (!worker_running)
+			return;
+
+		worker_running = false;
+		stop_queue(run_queue);
+		stop_queue(load_queue);
+	}
+
+	bool TFWorker::running()
+	{
+		return worker_running;
+	}
+
+	bool push_job(Worker_Queue &queue, const Worker_Job &job)
+	{
+		if (!worker_running)
+			return false;
+
+		ThreadApi *thread = TFPlugin::get_api()._thread;
+		thread->enter_critical_section(queue.lock);
+		bool has_room = queue.write - queue.read < MAX_WORKER_JOBS;
+		if (has_room)
+		{
+			queue.jobs[queue.write % MAX_WORKER_JOBS] = job;
+			++queue.write;
+		}
+		thread->leave_critical_section(queue.lock);
+
+		if (has_room)
+			thread->set_event(queue.event);
+		return has_room;
+	}
+
+	// The reference of a load is taken before the job is visible to the loader
+	bool push_load_job(const Worker_Job &job)
+	{
+		++job.session->references;
+		if (push_job(load_queue, job))
+			return true;
+		--job.session->references;
+		return false;
+	}
+
+	bool TFWorker::push(Graph_Execution_Session *session, unsigned slot)
+	{
+		return push_job(run_queue, { RunJob, session, slot });
+	}
+
+	bool TFWorker::push_load(Graph_Execution_Session *session)
+	{
+		return push_load_job({ LoadJob, session, 0 });
+	}
+
+	bool TFWorker::push_reload(Graph_Execution_Session *session)
+	{
+		return push_load_job({ ReloadJob, session, 0 });
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <engine_plugin_api/plugin_api.h>
+
+namespace PLUGIN_NAMESPACE
+{
+	struct Graph_Execution_Session;
+
+	// Background threads running and loading the tensorflow sessions. Frames and loads go to separate threads, each of them
+	// executes its jobs in the order they were pushed.
+	class TFWorker
+	{
+	public:
+		static bool start();
+		static void stop();
+		static bool running();
+		static bool push(Graph_Execution_Session *session, unsigned slot);
+		static bool push_load(Graph_Execution_Session *session);
+		static bool push_reload(Graph_Execution_Session *session);
+	};
+}
@@ -1,5 +1,5 @@
 import tensorflow as tf
-from nnao_network import build_nnao_network
+from nnao_network import build_nnao_network, build_nnao_network_slim
 from helper.save_data import freeze_graph
 from helper.constants import get_width, get_height
 
@@ -20,7 +20,12 @@ def export_frozen_graph(identifier, session):
 
 #======================
 
+# The plugin specializes the graph to the render target size when loading it,
+# a single export at any size divisible by 16 serves every resolution
 sess = tf.Session()
 result, _, _ = build_nnao_network(print_shapes=True)
-export_frozen_graph(str(IMG_WIDTH) + "x" + str(IMG_HEIGHT), sess)
-#tf.train.write_graph(sess.graph_def, '.', 'nnao_graph_' + str(IMG_WIDTH) + "x" + str(IMG_HEIGHT) + '.pbtxt')
+export_frozen_graph("nnao", sess)
+# The depth only network, the plugin reads the single input channel from the graph and skips the normals
+#result, _, _ = build_nnao_network_slim(print_shapes=True)
+#export_frozen_graph("nnao_slim", sess)
+#tf.train.write_graph(sess.graph_def, '.', 'nnao_graph_nnao.pbtxt')
@@ -1,6 +1,7 @@
 IMG_WIDTH = 1280
 IMG_HEIGHT = 720
 IMG_CHANNELS = 4
+OCTAHEDRAL_CHANNELS = 3
 
 def get_width():
     return IMG_WIDTH
@@ -8,5 +9,5 @@ def get_width():
 def get_height():
     return IMG_HEIGHT
 
-def get_channels():
-    return IMG_CHANNELS
\ No newline at end of file
+def get_channels(octahedral=False):
+    return OCTAHEDRAL_CHANNELS if octahedral else IMG_CHANNELS
\ No newline at end of file
@@ -8,17 +8,40 @@ IMG_WIDTH = get_width()
 IMG_HEIGHT = get_height()
 IMG_CHANNELS = get_channels()
 
-def read_input_data(near, far, r_channel, g_channel, b_channel, d_channel):
-    data = np.zeros([1,IMG_WIDTH, IMG_HEIGHT, IMG_CHANNELS], dtype=np.float32)
+# Same encoding as octahedral_normal of the plugin, the channels hold normal * 0.5 + 0.5 and so does the encoded normal
+def octahedral_normal(r, g, b):
+    x = r * 2.0 - 1.0
+    y = g * 2.0 - 1.0
+    z = b * 2.0 - 1.0
+    length = abs(x) + abs(y) + abs(z)
+    if length <= 0.0:
+        return 0.5, 0.5
+    u = x / length
+    v = y / length
+    if z < 0.0:
+        u, v = (1.0 - abs(v)) * (1.0 if u >= 0.0 else -1.0), (1.0 - abs(u)) * (1.0 if v >= 0.0 else -1.0)
+    return u * 0.5 + 0.5, v * 0.5 + 0.5
+
+def write_input_pixel(data, index, x, y, r, g, b, normalized_d, octahedral):
+    if octahedral:
+        u, v = octahedral_normal(r, g, b)
+        data[index, x, y, 0] = u
+        data[index, x, y, 1] = v
+        data[index, x, y, 2] = normalized_d
+    else:
+        data[index, x, y, 0] = r
+        data[index, x, y, 1] = g
+        data[index, x, y, 2] = b
+        data[index, x, y, 3] = normalized_d
+
+def read_input_data(near, far, r_channel, g_channel, b_channel, d_channel, octahedral=False):
+    data = np.zeros([1,IMG_WIDTH, IMG_HEIGHT, get_channels(octahedral)], dtype=np.float32)
     value_range = far - near
     for y in range(IMG_HEIGHT):
         for x in range(IMG_WIDTH):
             pos = y * IMG_WIDTH + x
             normalized_d = (d_channel[pos] - near) / value_range
-            data[0, x, y, 0] = r_channel[pos]
-            data[0, x, y, 1] = g_channel[pos]
-            data[0, x, y, 2] = b_channel[pos]
-            data[0, x, y, 3] = normalized_d
+            write_input_pixel(data, 0, x, y, r_channel[pos], g_channel[pos], b_channel[pos], normalized_d, octahedral)
     return data
 
 def read_truth_data(t_channel):
@@ -29,7 +52,7 @@ def read_truth_data(t_channel):
             data[0, x, y, 0] = t_channel[pos]
     return data
 
-def read_input_set(modellocation, count, path):
+def read_input_set(modellocation, count, path, octahedral=False):
     near_range = 0.1
     far_range = 1000.0
     models = []
@@ -41,7 +64,7 @@ def read_input_set(modellocation, count, path):
             models.append(line)
 
     model_count = 0
-    data = np.zeros([len(models), IMG_WIDTH, IMG_HEIGHT, IMG_CHANNELS], dtype=np.float32)
+    data = np.zeros([len(models), IMG_WIDTH, IMG_HEIGHT, get_channels(octahedral)], dtype=np.float32)
     for model in models:
         input_filename = path + model + "/input_" + model + "_" + str(count) + ".exr"
         img_file = OpenEXR.InputFile(input_filename)
@@ -53,10 +76,7 @@ def read_input_set(modellocation, count, path):
             for x in range(IMG_WIDTH):
                 pos = y * IMG_WIDTH + x
                 normalized_d = (D[pos] - near_range) / value_range
-                data[model_count, x, y, 0] = R[pos]
-                data[model_count, x, y, 1] = G[pos]
-                data[model_count, x, y, 2] = B[pos]
-                data[model_count, x, y, 3] = normalized_d
+                write_input_pixel(data, model_count, x, y, R[pos], G[pos], B[pos], normalized_d, octahedral)
         model_count += 1
     return data
 
@@ -21,15 +21,17 @@ PADDING_CONFIG = "SAME"
 DATA_FORMAT_CONFIG = "NHWC"
 
 # Building NNAO Network Structure
-def build_nnao_network(print_shapes=False):
-    image_data = tf.placeholder(dtype=tf.float32, shape=[None, IMG_WIDTH, IMG_HEIGHT, IMG_CHANNELS], name="image_data")
+# With octahedral set the input holds the octahedral encoded normals and the depth, see helper/load_data.py
+def build_nnao_network(print_shapes=False, octahedral=False):
+    input_channels = get_channels(octahedral)
+    image_data = tf.placeholder(dtype=tf.float32, shape=[None, IMG_WIDTH, IMG_HEIGHT, input_channels], name="image_data")
     ground_truth = tf.placeholder(dtype=tf.float32, shape=[None, IMG_WIDTH, IMG_HEIGHT, 1], name="ground_truth")
     batch_size = tf.shape(image_data)[0]
     if print_shapes:
         print("Image Data: ", image_data.shape)
 
     # Level 0 Down
-    weight_conv_0d = tf.Variable(tf.truncated_normal([CONV_FILTER_SIZE, CONV_FILTER_SIZE, IMG_CHANNELS, CONV_0_SIZE], stddev=DEFAULT_DEV))
+    weight_conv_0d = tf.Variable(tf.truncated_normal([CONV_FILTER_SIZE, CONV_FILTER_SIZE, input_channels, CONV_0_SIZE], stddev=DEFAULT_DEV))
     bias_conv_0d = tf.Variable(tf.constant(DEFAULT_DEV, shape=[CONV_0_SIZE]))
     transposed_data = tf.transpose(image_data, [0, 2, 1, 3], name="start_transpose")
     conv_0d = tf.nn.conv2d(input=transposed_data, filter=weight_conv_0d, strides=CONV_STRIDES, padding=PADDING_CONFIG, data_format=DATA_FORMAT_CONFIG, name="convolution_0_down")
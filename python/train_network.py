@@ -45,6 +45,8 @@ def train_network(from_beginning, min_error, data_set_size, epochs, models, trai
 # Creation of the network and training structures
 sess = tf.Session()
 #result, image_data, ground_truth = build_nnao_network(print_shapes=False)
+# Octahedral normals need read_input_set(models, count, train_path, octahedral=True) in the training loop
+#result, image_data, ground_truth = build_nnao_network(print_shapes=False, octahedral=True)
 result, image_data, ground_truth = build_nnao_network_slim(print_shapes=False)
 mse = tf.losses.mean_squared_error(labels=ground_truth, predictions=result)
 train = tf.train.GradientDescentOptimizer(0.01).minimize(mse)